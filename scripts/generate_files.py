@@ -19,13 +19,19 @@ import argparse
 import os
 import re
 import sys
+import xml.etree.ElementTree as ET
 
 from pathlib import Path
-from typing import List, Any
+from typing import Dict, List, Any, Optional
 
 doc = """
 Generates the layer manifest JSON files and linker scripts from the C++ source
-code in each VkLayer_* directory.
+code in each VkLayer_* directory, plus the linker scripts of the
+gf_layers_spirv_tools library (which the layers load on first use).
+
+Also generates the dispatch tables and hook registries of each layer that has a
+vulkan_functions.txt file, using the Vulkan registry (vk.xml) from
+third_party/Vulkan-Headers. See generate_dispatch_header.
 
 The C++ files must include commented layer properties like this:
 
@@ -138,9 +144,13 @@ ANDROID_EXPORTS = [
 ]
 
 
-def generate_linker_scripts(layer_dir: Path, layer_name: str, check_only: bool) -> bool:
+def generate_linker_scripts(
+        layer_dir: Path, layer_name: str, check_only: bool, android_exports: Optional[List[str]] = None) -> bool:
     result = True
 
+    if android_exports is None:
+        android_exports = ANDROID_EXPORTS
+
     # Collect the exported functions by scanning all source files.
     non_android_exported_functions: List[str] = []
     src_files = [f for f in layer_dir.glob("src/*.cc")]
@@ -151,7 +161,7 @@ def generate_linker_scripts(layer_dir: Path, layer_name: str, check_only: bool)
             contents,
         )
         for function_name in function_names:
-            if function_name not in ANDROID_EXPORTS:
+            if function_name not in android_exports:
                 non_android_exported_functions.append(function_name)
 
     # Write out the linker scripts.
@@ -215,8 +225,9 @@ def generate_linker_scripts(layer_dir: Path, layer_name: str, check_only: bool)
     for function in non_android_exported_functions:
         lds_android_contents += f"    {function};\n"
     # Just for Android:
-    lds_android_contents += "    # Introspection functions must be exported on Android.\n"
-    for function in ANDROID_EXPORTS:
+    if android_exports:
+        lds_android_contents += "    # Introspection functions must be exported on Android.\n"
+    for function in android_exports:
         lds_android_contents += f"    {function};\n"
     lds_android_contents += "local:\n"
     lds_android_contents += "    *;\n"
@@ -232,6 +243,330 @@ def generate_linker_scripts(layer_dir: Path, layer_name: str, check_only: bool)
     return result
 
 
+# Functions that every layer intercepts, in the order that they appear in the
+# hook registries. The global functions are provided via vkGetInstanceProcAddr.
+STANDARD_INSTANCE_HOOKS = [
+    # The standard introspection functions.
+    "vkEnumerateInstanceLayerProperties",
+    "vkEnumerateDeviceLayerProperties",
+    "vkEnumerateInstanceExtensionProperties",
+    "vkEnumerateDeviceExtensionProperties",
+    # Standard functions that most layers must implement.
+    "vkCreateInstance",
+    "vkCreateDevice",
+    "vkGetInstanceProcAddr",
+    "vkGetDeviceProcAddr",
+    "vkDestroyInstance",
+]
+
+STANDARD_DEVICE_HOOKS = [
+    "vkGetDeviceProcAddr",
+    "vkDestroyDevice",
+]
+
+# Functions of the next layer that every layer stores in its dispatch tables.
+# The *ProcAddr functions are obtained from the layer chain info, rather than
+# from the next layer's vkGet*ProcAddr.
+STANDARD_INSTANCE_CALLS = [
+    "vkGetInstanceProcAddr",
+    "vkEnumerateDeviceExtensionProperties",
+    "vkDestroyInstance",
+]
+
+STANDARD_DEVICE_CALLS = [
+    "vkGetDeviceProcAddr",
+    "vkDestroyDevice",
+]
+
+DEVICE_DISPATCHABLE_TYPES = ["VkDevice", "VkQueue", "VkCommandBuffer"]
+
+INSTANCE_DISPATCHABLE_TYPES = ["VkInstance", "VkPhysicalDevice"]
+
+
+class VulkanCommand:
+    def __init__(self, name: str, first_param_type: Optional[str]):
+        self.name = name
+        # The type of the first parameter, or None if there are no parameters.
+        self.first_param_type = first_param_type
+        # The preprocessor macro that guards the command, for platform-specific
+        # extensions (e.g. VK_USE_PLATFORM_ANDROID_KHR).
+        self.protect: Optional[str] = None
+        # Whether the command is from an extension (as opposed to core Vulkan).
+        # Extension commands are only available if the extension is enabled.
+        self.is_extension = False
+
+    def is_device_level(self) -> bool:
+        return self.first_param_type in DEVICE_DISPATCHABLE_TYPES
+
+    def is_instance_level(self) -> bool:
+        return self.first_param_type in INSTANCE_DISPATCHABLE_TYPES
+
+
+def is_vulkan_api(element: ET.Element) -> bool:
+    # Newer registries also describe Vulkan SC; skip elements that are not for
+    # Vulkan.
+    api = element.get("api")
+    return api is None or "vulkan" in api.split(",")
+
+
+def load_vulkan_registry(registry_path: Path) -> Dict[str, VulkanCommand]:
+    root = ET.parse(str(registry_path)).getroot()
+
+    commands: Dict[str, VulkanCommand] = {}
+    aliases: Dict[str, str] = {}
+
+    for command in root.findall("commands/command"):
+        if not is_vulkan_api(command):
+            continue
+        alias = command.get("alias")
+        if alias is not None:
+            aliases[not_none(command.get("name"))] = alias
+            continue
+        name = not_none(command.findtext("proto/name"))
+        params = [param for param in command.findall("param") if is_vulkan_api(param)]
+        first_param_type = params[0].findtext("type") if params else None
+        commands[name] = VulkanCommand(name, first_param_type)
+
+    # An alias has the same dispatch level as the command that it aliases.
+    for alias, name in aliases.items():
+        commands[alias] = VulkanCommand(alias, commands[name].first_param_type)
+
+    protect_by_platform: Dict[str, str] = {}
+    for platform in root.findall("platforms/platform"):
+        protect_by_platform[not_none(platform.get("name"))] = not_none(platform.get("protect"))
+
+    for extension in root.findall("extensions/extension"):
+        if extension.get("supported") == "disabled":
+            continue
+        platform_name = extension.get("platform")
+        protect = protect_by_platform[platform_name] if platform_name else extension.get("protect")
+        for command in extension.findall("require/command"):
+            name = not_none(command.get("name"))
+            if name not in commands:
+                continue
+            commands[name].is_extension = True
+            if protect:
+                commands[name].protect = protect
+
+    return commands
+
+
+class LayerFunctions:
+    def __init__(self):
+        # Functions that the layer intercepts.
+        self.hooks: List[str] = []
+        # Functions that the layer calls but does not intercept.
+        self.calls: List[str] = []
+
+
+def read_layer_functions(functions_file: Path) -> LayerFunctions:
+    result = LayerFunctions()
+    for line_number, line in enumerate(functions_file.read_text(encoding="utf-8", errors="ignore").splitlines(), 1):
+        line = line.split("#", 1)[0].strip()
+        if not line:
+            continue
+        parts = line.split()
+        if len(parts) != 2 or parts[0] not in ["hook", "call"]:
+            raise AssertionError(f"{str(functions_file)}:{line_number}: expected 'hook <function>' or "
+                                 f"'call <function>'")
+        if parts[0] == "hook":
+            result.hooks.append(parts[1])
+        else:
+            result.calls.append(parts[1])
+    return result
+
+
+def unique(names: List[str]) -> List[str]:
+    result: List[str] = []
+    for name in names:
+        if name not in result:
+            result.append(name)
+    return result
+
+
+def align_escaped_newlines(text: str) -> str:
+    # Aligns the backslashes of each multi-line macro to its longest line, like clang-format.
+    lines = text.split("\n")
+    result: List[str] = []
+    block: List[str] = []
+    for line in lines:
+        if line.endswith("\\"):
+            block.append(line[:-1].rstrip())
+            continue
+        if block:
+            block.append(line)
+            width = max(len(block_line) for block_line in block) + 1
+            result += [block_line.ljust(width) + "\\" for block_line in block[:-1]]
+            block = []
+        result.append(line)
+    return "\n".join(result)
+
+
+def generate_function_list(macro_name: str, commands: List[VulkanCommand]) -> str:
+    lines = [f"#define {macro_name}(HANDLE)"] + [f"  HANDLE({command.name})" for command in commands]
+    return " \\\n".join(lines) + "\n"
+
+
+def generate_dispatch_header(
+        layer_dir: Path, layer_name: str, commands: Dict[str, VulkanCommand], check_only: bool) -> bool:
+    """
+    Generates include/<layer_name>/dispatch.h from <layer_dir>/vulkan_functions.txt, which lists the Vulkan functions
+    that the layer intercepts ("hook <function>") and the functions that it only calls ("call <function>"). The
+    standard functions that every layer needs are added implicitly. The header contains:
+
+    - X-macros that list the functions that the layer intercepts, for the layer's vkGet*ProcAddr functions.
+    - InstanceDispatchTable and DeviceDispatchTable: the next layer's functions that the layer uses, and functions to
+      initialize them. Core functions are required; extension functions are null if the extension is not enabled.
+
+    The dispatch level of each function (instance or device) is decided by the type of its first parameter.
+    """
+    functions_file = layer_dir / "vulkan_functions.txt"
+    if not functions_file.is_file():
+        return True
+
+    layer_functions = read_layer_functions(functions_file)
+
+    for name in layer_functions.hooks + layer_functions.calls:
+        if name not in commands:
+            raise AssertionError(f"{str(functions_file)}: unknown Vulkan function: {name}")
+        if commands[name].protect is not None:
+            # The X-macros cannot contain preprocessor conditionals.
+            raise AssertionError(f"{str(functions_file)}: platform-specific functions are not supported: {name}")
+
+    def get_commands(names: List[str]) -> List[VulkanCommand]:
+        return [commands[name] for name in unique(names)]
+
+    instance_hooks = get_commands(
+        STANDARD_INSTANCE_HOOKS + [name for name in layer_functions.hooks if not commands[name].is_device_level()])
+    device_hooks = get_commands(
+        STANDARD_DEVICE_HOOKS + [name for name in layer_functions.hooks if commands[name].is_device_level()])
+
+    used = layer_functions.hooks + layer_functions.calls
+    # The next layer's vkGet*ProcAddr functions are obtained from the layer chain info.
+    instance_calls = [
+        command for command in get_commands(
+            STANDARD_INSTANCE_CALLS + [name for name in used if commands[name].is_instance_level()])
+        if command.name != "vkGetInstanceProcAddr"
+    ]
+    device_calls = [
+        command for command in get_commands(
+            STANDARD_DEVICE_CALLS + [name for name in used if commands[name].is_device_level()])
+        if command.name != "vkGetDeviceProcAddr"
+    ]
+
+    short_name = layer_name[len("VkLayer_GF_"):]
+    guard = f"{layer_name.upper()}_DISPATCH_H"
+    prefix = f"GF_LAYERS_{short_name.upper()}"
+
+    def core(command_list: List[VulkanCommand]) -> List[VulkanCommand]:
+        return [command for command in command_list if not command.is_extension]
+
+    def extension(command_list: List[VulkanCommand]) -> List[VulkanCommand]:
+        return [command for command in command_list if command.is_extension]
+
+    contents = f"""// Generated file; do not edit.
+// Generated by scripts/generate_files.py from vulkan_functions.txt.
+
+#ifndef {guard}
+#define {guard}
+
+#include <vulkan/vulkan.h>
+
+// The global and instance functions intercepted by this layer.
+{generate_function_list(f"{prefix}_INSTANCE_HOOKS", instance_hooks)}
+// The device functions intercepted by this layer.
+{generate_function_list(f"{prefix}_DEVICE_HOOKS", device_hooks)}
+// The next layer's instance functions used by this layer, other than
+// vkGetInstanceProcAddr.
+{generate_function_list(f"{prefix}_INSTANCE_CORE_CALLS", core(instance_calls))}
+{generate_function_list(f"{prefix}_INSTANCE_EXTENSION_CALLS", extension(instance_calls))}
+// The next layer's device functions used by this layer, other than
+// vkGetDeviceProcAddr.
+{generate_function_list(f"{prefix}_DEVICE_CORE_CALLS", core(device_calls))}
+{generate_function_list(f"{prefix}_DEVICE_EXTENSION_CALLS", extension(device_calls))}
+namespace gf_layers::{short_name}_layer {{
+
+struct InstanceDispatchTable {{
+  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = {{}};
+#define HANDLE(func) PFN_##func func = {{}};
+  {prefix}_INSTANCE_CORE_CALLS(HANDLE)
+  {prefix}_INSTANCE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+}};
+
+struct DeviceDispatchTable {{
+  PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr = {{}};
+#define HANDLE(func) PFN_##func func = {{}};
+  {prefix}_DEVICE_CORE_CALLS(HANDLE)
+  {prefix}_DEVICE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+}};
+
+// Initializes |table| from the next layer's vkGetInstanceProcAddr. Returns
+// false if a core function is missing. Extension functions are null if the
+// extension is not enabled.
+inline bool InitInstanceDispatchTable(
+    VkInstance instance, PFN_vkGetInstanceProcAddr next_get_proc_addr,
+    InstanceDispatchTable* table) {{
+  table->vkGetInstanceProcAddr = next_get_proc_addr;
+#define HANDLE(func) \\
+  table->func = reinterpret_cast<PFN_##func>( \\
+      next_get_proc_addr(instance, #func)); \\
+  if (table->func == nullptr) {{ \\
+    return false; \\
+  }}
+  {prefix}_INSTANCE_CORE_CALLS(HANDLE)
+#undef HANDLE
+#define HANDLE(func) \\
+  table->func = reinterpret_cast<PFN_##func>( \\
+      next_get_proc_addr(instance, #func));
+  {prefix}_INSTANCE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+  return true;
+}}
+
+// Initializes |table| from the next layer's vkGetDeviceProcAddr. Returns false
+// if a core function is missing. Extension functions are null if the extension
+// is not enabled.
+inline bool InitDeviceDispatchTable(VkDevice device,
+                                    PFN_vkGetDeviceProcAddr next_get_proc_addr,
+                                    DeviceDispatchTable* table) {{
+  table->vkGetDeviceProcAddr = next_get_proc_addr;
+#define HANDLE(func) \\
+  table->func = reinterpret_cast<PFN_##func>( \\
+      next_get_proc_addr(device, #func)); \\
+  if (table->func == nullptr) {{ \\
+    return false; \\
+  }}
+  {prefix}_DEVICE_CORE_CALLS(HANDLE)
+#undef HANDLE
+#define HANDLE(func) \\
+  table->func = reinterpret_cast<PFN_##func>( \\
+      next_get_proc_addr(device, #func));
+  {prefix}_DEVICE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+  return true;
+}}
+
+}}  // namespace gf_layers::{short_name}_layer
+
+#endif  // {guard}
+"""
+
+    contents = align_escaped_newlines(contents)
+
+    header_path = layer_dir / "include" / layer_name / "dispatch.h"
+    log(f"Processing: {str(header_path)}")
+    if check_only:
+        if not header_path.is_file() or header_path.read_text(encoding="utf-8", errors="ignore") != contents:
+            log("Error: file needs to be re-generated")
+            return False
+    else:
+        header_path.parent.mkdir(parents=True, exist_ok=True)
+        header_path.write_text(contents, encoding="utf-8", errors="ignore")
+    return True
+
+
 def main(args) -> None:
 
     raw_help_formatter: Any = argparse.RawDescriptionHelpFormatter
@@ -248,12 +583,20 @@ def main(args) -> None:
         action="store_true",
     )
 
+    parser.add_argument(
+        "--registry",
+        help="Path to the Vulkan registry.",
+        default="third_party/Vulkan-Headers/registry/vk.xml",
+    )
+
     parsed_args = parser.parse_args(args[1:])
 
     check_only: bool = parsed_args.check_only
 
     os.chdir(os.environ["GF_LAYERS_REPO_ROOT"])
 
+    vulkan_commands = load_vulkan_registry(Path(parsed_args.registry))
+
     layer_dirs = [d for d in Path().glob("src/VkLayer_*/") if d.is_dir()]
 
     result = True
@@ -263,6 +606,14 @@ def main(args) -> None:
         layer_properties = LayerProperties()
         result &= generate_manifests(layer_dir, layer_properties, check_only)
         result &= generate_linker_scripts(layer_dir, layer_name=layer_properties.layer_name, check_only=check_only)
+        result &= generate_dispatch_header(
+            layer_dir, not_none(layer_properties.layer_name), vulkan_commands, check_only=check_only)
+
+    # The gf_layers_spirv_tools library is not a layer, so it does not export
+    # the Android introspection functions.
+    result &= generate_linker_scripts(
+        Path("src/gf_layers_spirv_tools"), layer_name="gf_layers_spirv_tools", check_only=check_only,
+        android_exports=[])
 
     if not result:
         raise AssertionError("Checks failed. See above.")
@@ -25,99 +25,59 @@
 #include "VkLayer_GF_amber_scoop/command_buffer_data.h"
 #include "VkLayer_GF_amber_scoop/create_info_wrapper.h"
 #include "VkLayer_GF_amber_scoop/descriptor_set_data.h"
+#include "VkLayer_GF_amber_scoop/dispatch.h"
 #include "VkLayer_GF_amber_scoop/graphics_pipeline_data.h"
+#include "gf_layers_layer_util/allocator.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/slot_map.h"
 #include "gf_layers_layer_util/util.h"
 
 namespace gf_layers::amber_scoop_layer {
 
-struct InstanceData {
-  VkInstance instance;
-
-  // Most layers must store this. Required to implement vkGetInstanceProcAddr.
-  // Should not be used otherwise; all required instance function pointers
-  // should be obtained during vkCreateInstance.
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
-
-  // Most layers must store this. Required to implement
-  // vkEnumerateDeviceExtensionProperties.
-  PFN_vkEnumerateDeviceExtensionProperties vkEnumerateDeviceExtensionProperties;
-
-  // Other instance functions: (used but not intercepted)
-  PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties;
+// The instance function pointers are in InstanceDispatchTable, which is
+// generated from vulkan_functions.txt.
+struct InstanceData : InstanceDispatchTable {
+  VkInstance instance = {};
 };
 
-struct DeviceData {
+// The device function pointers are in DeviceDispatchTable, which is generated
+// from vulkan_functions.txt.
+struct DeviceData : DeviceDispatchTable {
+  // |callbacks| is the pAllocator given to vkCreateDevice, or nullptr.
+  explicit DeviceData(const VkAllocationCallbacks* callbacks)
+      : allocator(callbacks) {}
+
   VkDevice device = {};
   InstanceData* instance_data = {};
   VkPhysicalDevice physical_device = {};
 
-  // Most layers must store this. Required to implement vkGetDeviceProcAddr.
-  // Should not be used otherwise; all required device function pointers
-  // should be obtained during vkCreateDevice.
-  PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr = {};
-
-  // Other device functions:
-
-  // vkAllocate* and vkFree* functions:
-  PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers = {};
-  PFN_vkFreeCommandBuffers vkFreeCommandBuffers = {};
-  PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets = {};
-  PFN_vkFreeDescriptorSets vkFreeDescriptorSets = {};
-  // vkCreate* and vkDelete* functions:
-  PFN_vkCreateBuffer vkCreateBuffer = {};
-  PFN_vkDestroyBuffer vkDestroyBuffer = {};
-  PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines = {};
-  PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout = {};
-  PFN_vkDestroyDescriptorSetLayout vkDestroyDescriptorSetLayout = {};
-  PFN_vkCreatePipelineLayout vkCreatePipelineLayout = {};
-  PFN_vkDestroyPipelineLayout vkDestroyPipelineLayout = {};
-  PFN_vkCreateShaderModule vkCreateShaderModule = {};
-  PFN_vkDestroyShaderModule vkDestroyShaderModule = {};
-  // vkCmd* functions:
-  PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass = {};
-  PFN_vkCmdBindDescriptorSets vkCmdBindDescriptorSets = {};
-  PFN_vkCmdBindIndexBuffer vkCmdBindIndexBuffer = {};
-  PFN_vkCmdBindPipeline vkCmdBindPipeline = {};
-  PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers = {};
-  PFN_vkCmdDraw vkCmdDraw = {};
-  PFN_vkCmdDrawIndexed vkCmdDrawIndexed = {};
-  PFN_vkCmdPipelineBarrier vkCmdPipelineBarrier = {};
-  // Others:
-  PFN_vkQueueSubmit vkQueueSubmit = {};
-  PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets = {};
-
-  // Functions used by the layer but not intercepted:
-  PFN_vkAllocateMemory vkAllocateMemory = {};
-  PFN_vkFreeMemory vkFreeMemory = {};
-  PFN_vkBeginCommandBuffer vkBeginCommandBuffer = {};
-  PFN_vkEndCommandBuffer vkEndCommandBuffer = {};
-  PFN_vkBindBufferMemory vkBindBufferMemory = {};
-  PFN_vkCmdCopyBuffer vkCmdCopyBuffer = {};
-  PFN_vkCreateFence vkCreateFence = {};
-  PFN_vkDestroyFence vkDestroyFence = {};
-  PFN_vkGetBufferMemoryRequirements vkGetBufferMemoryRequirements = {};
-  PFN_vkInvalidateMappedMemoryRanges vkInvalidateMappedMemoryRanges = {};
-  PFN_vkMapMemory vkMapMemory = {};
-  PFN_vkQueueWaitIdle vkQueueWaitIdle = {};
-  PFN_vkUnmapMemory vkUnmapMemory = {};
-  PFN_vkWaitForFences vkWaitForFences = {};
+  // Allocates the tracked device data below, and so must be declared before
+  // it (so that it is destroyed after it). See allocator.h.
+  LayerAllocator allocator;
 
   // Tracked device data:
-
-  ProtectedMap<VkBuffer, BufferData> buffers;
-  ProtectedMap<VkCommandBuffer, CommandBufferData> command_buffers_data;
-  ProtectedMap<VkDescriptorSet, DescriptorSetData> descriptor_sets;
-  ProtectedMap<VkDescriptorSetLayout, DescriptorSetLayoutData>
+  //
+  // These maps are read on nearly every intercepted call (possibly from many
+  // threads recording command buffers in parallel) but only written when
+  // objects are created or destroyed, so we use maps with lock-free lookups.
+  // Slot maps also store the data densely and replace the data of a handle
+  // that is reused after its object was destroyed (which we may not see, e.g.
+  // for pipelines).
+
+  ProtectedSlotMap<VkBuffer, BufferData> buffers;
+  ProtectedSlotMap<VkCommandBuffer, CommandBufferData> command_buffers_data;
+  ProtectedSlotMap<VkDescriptorSet, DescriptorSetData> descriptor_sets;
+  ProtectedSlotMap<VkDescriptorSetLayout, DescriptorSetLayoutData>
       descriptor_set_layouts;
-  ProtectedMap<VkPipeline, std::unique_ptr<GraphicsPipelineData>>
+  ProtectedSlotMap<VkPipeline, std::unique_ptr<GraphicsPipelineData>>
       graphics_pipelines;
-  ProtectedMap<VkPipelineLayout, PipelineLayoutData> pipeline_layouts;
+  ProtectedSlotMap<VkPipelineLayout, PipelineLayoutData> pipeline_layouts;
 
   // Map of shader modules. Shared pointers are used because
   // |GraphicsPipelineData| may also hold a reference. |ShaderModuleData| will
   // be deleted when the last pipeline using it is destroyed and the shader
   // module itself is destroyed via vkDestroyShaderModule.
-  ProtectedMap<VkShaderModule, std::shared_ptr<ShaderModuleData>>
+  ProtectedSlotMap<VkShaderModule, std::shared_ptr<ShaderModuleData>>
       shader_modules_data;
 };
 
@@ -125,16 +85,17 @@ using InstanceMap = gf_layers::ProtectedTinyStaleMap<void*, InstanceData>;
 using DeviceMap =
     gf_layers::ProtectedTinyStaleMap<void*, std::unique_ptr<DeviceData>>;
 
-// Read-only once initialized.
+// A snapshot of the settings; see |GlobalData::settings|.
 struct AmberScoopLayerSettings {
-  bool init = false;
   // Number of the first draw call to be captured. Can be set via env variable
   // "VkLayer_GF_amber_scoop_START_DRAW_CALL" or Android property
   // "debug.gf.as.start_draw_call"
   uint64_t start_draw_call = 0;
-  // Number of the last draw call to be captured. Last draw call is
-  // "start_draw_call" + "VkLayer_GF_amber_scoop_DRAW_CALL_COUNT".
-  uint64_t last_draw_call = 0;
+  // Number of draw calls to be captured after the first one; the last draw
+  // call captured is "start_draw_call" + "draw_call_count". Can be set via env
+  // variable "VkLayer_GF_amber_scoop_DRAW_CALL_COUNT" or Android property
+  // "debug.gf.as.draw_call_count".
+  uint64_t draw_call_count = 1;
   // Prefix used in output file names. Can be set via env variable
   // "VkLayer_GF_amber_scoop_OUTPUT_FILE_PREFIX"
   std::string output_file_prefix = "amber_scoop_output";
@@ -146,12 +107,12 @@ struct GlobalData {
   // Draw call counter used to detect the draw call to be captured.
   std::atomic<uint64_t> current_draw_call = {};
 
-  // In vkCreateInstance, we initialize |settings| by reading environment
-  // variables while holding |settings_mutex|, after which |settings| is
-  // read-only. Thus, in instance or device functions (such as
-  // vkQueuePresentKHR) we can read |settings| without holding |settings_mutex|.
+  // In vkCreateInstance, we register and load |settings| while holding
+  // |settings_mutex|. Afterwards, |settings| can be read (and reloaded in
+  // vkQueueSubmit) without holding |settings_mutex|.
   gf_layers::MutexType settings_mutex;
-  AmberScoopLayerSettings settings;
+  bool settings_init = false;
+  SettingsRegistry<AmberScoopLayerSettings> settings;
 };
 
 }  // namespace gf_layers::amber_scoop_layer
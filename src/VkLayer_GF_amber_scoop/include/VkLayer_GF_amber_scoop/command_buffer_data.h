@@ -18,9 +18,11 @@
 #include <vulkan/vulkan.h>
 
 #include <memory>
-#include <vector>
+#include <type_traits>
+#include <utility>
 
 #include "VkLayer_GF_amber_scoop/vulkan_commands.h"
+#include "gf_layers_layer_util/allocator.h"
 
 namespace gf_layers::amber_scoop_layer {
 
@@ -29,21 +31,40 @@ namespace gf_layers::amber_scoop_layer {
 // buffer has been submitted. It also keeps track of whether the command buffer
 // contains any draw calls. The class is not thread-safe, but it shouldn't
 // matter because the Vulkan spec requires Vulkan applications to record
-// commands without races.
+// commands without races. For the same reason, the commands are allocated
+// from a linear allocator without locking; its blocks, like the command list,
+// come from the device's allocator and are reused after the command buffer is
+// reset.
 class CommandBufferData {
  public:
-  explicit CommandBufferData(const VkCommandBufferAllocateInfo& allocate_info)
-      : allocate_info_(allocate_info) {}
+  CommandBufferData(LayerAllocator* allocator,
+                    const VkCommandBufferAllocateInfo& allocate_info)
+      : allocate_info_(allocate_info),
+        command_allocator_(allocator),
+        command_list(StlAllocator<std::unique_ptr<Cmd>>(allocator)) {}
 
-  // Adds |cmd| to the command list.
-  void AddCommand(std::unique_ptr<Cmd> cmd);
+  // Adds a |CmdType| command constructed from |args| to the command list. The
+  // command is allocated from the command buffer's linear allocator, which is
+  // also passed first to the constructors of the commands that copy arrays.
+  template <typename CmdType, typename... Args>
+  void AddCommand(Args&&... args) {
+    Cmd* cmd = nullptr;
+    if constexpr (std::is_constructible_v<CmdType, LinearAllocator*,
+                                          Args...>) {
+      cmd = new (&command_allocator_)
+          CmdType(&command_allocator_, std::forward<Args>(args)...);
+    } else {
+      cmd = new (&command_allocator_) CmdType(std::forward<Args>(args)...);
+    }
+    AddCommand(std::unique_ptr<Cmd>(cmd));
+  }
 
   // Returns true if the command list contains a draw call.
   [[nodiscard]] bool ContainsDrawCalls() const { return contains_draw_calls_; }
 
   // Returns the list of captured commands. The list can't be modified directly.
   // Use AddCommand() to append to the list.
-  [[nodiscard]] const std::vector<std::unique_ptr<Cmd>>& GetCommandList()
+  [[nodiscard]] const LayerVector<std::unique_ptr<Cmd>>& GetCommandList()
       const {
     return command_list;
   }
@@ -59,10 +80,16 @@ class CommandBufferData {
  private:
   // VkCommandBufferAllocateInfo used to allocate this command buffer.
   const VkCommandBufferAllocateInfo allocate_info_;
+  // Adds |cmd| to the command list.
+  void AddCommand(std::unique_ptr<Cmd> cmd);
+
   // Flag to tell if the command list contains any draw calls.
   bool contains_draw_calls_ = false;
+  // Allocates the tracked commands; declared before |command_list| so that the
+  // commands are destroyed first.
+  LinearAllocator command_allocator_;
   // List of tracked commands.
-  std::vector<std::unique_ptr<Cmd>> command_list = {};
+  LayerVector<std::unique_ptr<Cmd>> command_list;
 };
 
 }  // namespace gf_layers::amber_scoop_layer
@@ -15,10 +15,10 @@
 #ifndef VKLAYER_GF_AMBER_SCOOP_CREATE_INFO_WRAPPER_H
 #define VKLAYER_GF_AMBER_SCOOP_CREATE_INFO_WRAPPER_H
 
-#include <memory>
-#include <vector>
+#include <utility>
 
 #include "VkLayer_GF_amber_scoop/vk_deep_copy.h"
+#include "gf_layers_layer_util/allocator.h"
 
 namespace gf_layers::amber_scoop_layer {
 
@@ -26,25 +26,35 @@ namespace gf_layers::amber_scoop_layer {
 // deep copied, i.e. structs that contain pointers to other structs. DeepCopy is
 // called in the constructor and DeepDelete in the destructor. The class can be
 // inherited if more functionality is needed. There must be a DeepCopy and
-// DeepDelete functions for the given |CreateInfoType|.
+// DeepDelete functions for the given |CreateInfoType|. The copy is allocated
+// from the given |ObjectAllocator|, which should use the VkAllocationCallbacks
+// given when the object was created.
 template <typename CreateInfoType>
 class CreateInfoWrapper {
  public:
-  explicit CreateInfoWrapper(const CreateInfoType& create_info)
-      : create_info_(std::make_unique<CreateInfoType>(DeepCopy(create_info))) {}
-
-  // Default move constructor and move assign operator. Moves the ownership of
-  // the |create_info_| to the other object.
-  CreateInfoWrapper(CreateInfoWrapper&& other) noexcept = default;
-  CreateInfoWrapper& operator=(CreateInfoWrapper&& other) noexcept = default;
+  CreateInfoWrapper(const ObjectAllocator& allocator,
+                    const CreateInfoType& create_info)
+      : allocator_(allocator),
+        create_info_(allocator.NewArray<CreateInfoType>(1)) {
+    *create_info_ = DeepCopy(allocator_, create_info);
+  }
 
-  virtual ~CreateInfoWrapper() {
-    // |create_info| may be nullptr if the ownership has been moved.
-    if (create_info_ != nullptr) {
-      DeepDelete(*create_info_);
+  // Move constructor and move assign operator. Moves the ownership of the
+  // |create_info_| to the other object.
+  CreateInfoWrapper(CreateInfoWrapper&& other) noexcept
+      : allocator_(other.allocator_),
+        create_info_(std::exchange(other.create_info_, nullptr)) {}
+  CreateInfoWrapper& operator=(CreateInfoWrapper&& other) noexcept {
+    if (this != &other) {
+      Delete();
+      allocator_ = other.allocator_;
+      create_info_ = std::exchange(other.create_info_, nullptr);
     }
+    return *this;
   }
 
+  virtual ~CreateInfoWrapper() { Delete(); }
+
   // Disabled copy constructor and copy assign operator.
   CreateInfoWrapper(const CreateInfoWrapper&) = delete;
   CreateInfoWrapper& operator=(const CreateInfoWrapper&) = delete;
@@ -54,8 +64,23 @@ class CreateInfoWrapper {
     return *create_info_;
   }
 
+  // Returns the allocator of the create info struct.
+  [[nodiscard]] const ObjectAllocator& GetAllocator() const {
+    return allocator_;
+  }
+
  private:
-  std::unique_ptr<CreateInfoType> create_info_;
+  void Delete() {
+    // |create_info| may be nullptr if the ownership has been moved.
+    if (create_info_ != nullptr) {
+      DeepDelete(allocator_, *create_info_);
+      allocator_.DeleteArray(create_info_, 1);
+      create_info_ = nullptr;
+    }
+  }
+
+  ObjectAllocator allocator_;
+  CreateInfoType* create_info_;
 };
 
 // Type aliases for create info structs wrapped to CreateInfoWrapper.
@@ -18,20 +18,31 @@
 #include <vulkan/vulkan.h>
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <unordered_map>
-#include <vector>
+#include <utility>
 
 #include "VkLayer_GF_amber_scoop/create_info_wrapper.h"
+#include "gf_layers_layer_util/allocator.h"
 
 namespace gf_layers::amber_scoop_layer {
 
-// This class is used to store descriptor set's state.
+// This class is used to store descriptor set's state. The state is allocated
+// from the device's allocator.
 class DescriptorSetData {
  public:
   // Type alias used to clarify the maps' key types.
   using BindingNumber = uint32_t;
 
+  // Map from binding numbers to the binding's descriptors.
+  template <typename DescriptorType>
+  using BindingMap = std::unordered_map<
+      BindingNumber, LayerVector<DescriptorType>, std::hash<BindingNumber>,
+      std::equal_to<BindingNumber>,
+      StlAllocator<
+          std::pair<const BindingNumber, LayerVector<DescriptorType>>>>;
+
   // Flattened descriptor types. Used f.ex. to easily choose where the
   // descriptor writes are taken from and where they are stored.
   enum FlattenedDescriptorType {
@@ -41,14 +52,14 @@ class DescriptorSetData {
     UNSUPPORTED
   };
 
-  // Constructor. Stores the given pointer to the layout used to allocate this
-  // descriptor set and allocates the vectors where the information about
-  // descriptors will be stored when updating the descriptor set.
-  explicit DescriptorSetData(const DescriptorSetLayoutData* layout_data);
+  // Constructor. Stores a copy of the layout used to allocate this descriptor
+  // set and allocates the vectors where the information about descriptors will
+  // be stored when updating the descriptor set.
+  DescriptorSetData(LayerAllocator* allocator,
+                    const DescriptorSetLayoutData* layout_data);
 
   // Returns the descriptor bindings of buffer type.
-  [[nodiscard]] const std::unordered_map<BindingNumber,
-                                         std::vector<VkDescriptorBufferInfo>>*
+  [[nodiscard]] const BindingMap<VkDescriptorBufferInfo>*
   GetDescriptorBufferBindings() const {
     return &descriptor_buffer_bindings_;
   }
@@ -68,14 +79,11 @@ class DescriptorSetData {
   // Layout used to allocate this descriptor set.
   std::unique_ptr<DescriptorSetLayoutData> descriptor_set_layout_data_;
   // |VkDescriptorBufferInfo| for each descriptor of "buffer" type.
-  std::unordered_map<BindingNumber, std::vector<VkDescriptorBufferInfo>>
-      descriptor_buffer_bindings_;
+  BindingMap<VkDescriptorBufferInfo> descriptor_buffer_bindings_;
   // Image and sampler bindings. Not used yet.
-  std::unordered_map<BindingNumber, std::vector<VkDescriptorImageInfo>>
-      image_and_sampler_bindings_;
+  BindingMap<VkDescriptorImageInfo> image_and_sampler_bindings_;
   // Texel buffer bindings. Not used yet.
-  std::unordered_map<BindingNumber, std::vector<VkBufferView>>
-      texel_buffer_view_bindings_;
+  BindingMap<VkBufferView> texel_buffer_view_bindings_;
 };
 
 }  // namespace gf_layers::amber_scoop_layer
@@ -0,0 +1,168 @@
+// Generated file; do not edit.
+// Generated by scripts/generate_files.py from vulkan_functions.txt.
+
+#ifndef VKLAYER_GF_AMBER_SCOOP_DISPATCH_H
+#define VKLAYER_GF_AMBER_SCOOP_DISPATCH_H
+
+#include <vulkan/vulkan.h>
+
+// The global and instance functions intercepted by this layer.
+#define GF_LAYERS_AMBER_SCOOP_INSTANCE_HOOKS(HANDLE) \
+  HANDLE(vkEnumerateInstanceLayerProperties)         \
+  HANDLE(vkEnumerateDeviceLayerProperties)           \
+  HANDLE(vkEnumerateInstanceExtensionProperties)     \
+  HANDLE(vkEnumerateDeviceExtensionProperties)       \
+  HANDLE(vkCreateInstance)                           \
+  HANDLE(vkCreateDevice)                             \
+  HANDLE(vkGetInstanceProcAddr)                      \
+  HANDLE(vkGetDeviceProcAddr)                        \
+  HANDLE(vkDestroyInstance)
+
+// The device functions intercepted by this layer.
+#define GF_LAYERS_AMBER_SCOOP_DEVICE_HOOKS(HANDLE) \
+  HANDLE(vkGetDeviceProcAddr)                      \
+  HANDLE(vkDestroyDevice)                          \
+  HANDLE(vkAllocateCommandBuffers)                 \
+  HANDLE(vkFreeCommandBuffers)                     \
+  HANDLE(vkAllocateDescriptorSets)                 \
+  HANDLE(vkFreeDescriptorSets)                     \
+  HANDLE(vkCreateBuffer)                           \
+  HANDLE(vkDestroyBuffer)                          \
+  HANDLE(vkCreateDescriptorSetLayout)              \
+  HANDLE(vkDestroyDescriptorSetLayout)             \
+  HANDLE(vkCreateGraphicsPipelines)                \
+  HANDLE(vkCreatePipelineLayout)                   \
+  HANDLE(vkDestroyPipelineLayout)                  \
+  HANDLE(vkCreateShaderModule)                     \
+  HANDLE(vkDestroyShaderModule)                    \
+  HANDLE(vkQueueSubmit)                            \
+  HANDLE(vkUpdateDescriptorSets)                   \
+  HANDLE(vkCmdBeginRenderPass)                     \
+  HANDLE(vkCmdBindDescriptorSets)                  \
+  HANDLE(vkCmdBindIndexBuffer)                     \
+  HANDLE(vkCmdBindPipeline)                        \
+  HANDLE(vkCmdBindVertexBuffers)                   \
+  HANDLE(vkCmdDraw)                                \
+  HANDLE(vkCmdDrawIndexed)                         \
+  HANDLE(vkCmdPipelineBarrier)
+
+// The next layer's instance functions used by this layer, other than
+// vkGetInstanceProcAddr.
+#define GF_LAYERS_AMBER_SCOOP_INSTANCE_CORE_CALLS(HANDLE) \
+  HANDLE(vkEnumerateDeviceExtensionProperties)            \
+  HANDLE(vkDestroyInstance)                               \
+  HANDLE(vkGetPhysicalDeviceMemoryProperties)
+
+#define GF_LAYERS_AMBER_SCOOP_INSTANCE_EXTENSION_CALLS(HANDLE)
+
+// The next layer's device functions used by this layer, other than
+// vkGetDeviceProcAddr.
+#define GF_LAYERS_AMBER_SCOOP_DEVICE_CORE_CALLS(HANDLE) \
+  HANDLE(vkDestroyDevice)                               \
+  HANDLE(vkAllocateCommandBuffers)                      \
+  HANDLE(vkFreeCommandBuffers)                          \
+  HANDLE(vkAllocateDescriptorSets)                      \
+  HANDLE(vkFreeDescriptorSets)                          \
+  HANDLE(vkCreateBuffer)                                \
+  HANDLE(vkDestroyBuffer)                               \
+  HANDLE(vkCreateDescriptorSetLayout)                   \
+  HANDLE(vkDestroyDescriptorSetLayout)                  \
+  HANDLE(vkCreateGraphicsPipelines)                     \
+  HANDLE(vkCreatePipelineLayout)                        \
+  HANDLE(vkDestroyPipelineLayout)                       \
+  HANDLE(vkCreateShaderModule)                          \
+  HANDLE(vkDestroyShaderModule)                         \
+  HANDLE(vkQueueSubmit)                                 \
+  HANDLE(vkUpdateDescriptorSets)                        \
+  HANDLE(vkCmdBeginRenderPass)                          \
+  HANDLE(vkCmdBindDescriptorSets)                       \
+  HANDLE(vkCmdBindIndexBuffer)                          \
+  HANDLE(vkCmdBindPipeline)                             \
+  HANDLE(vkCmdBindVertexBuffers)                        \
+  HANDLE(vkCmdDraw)                                     \
+  HANDLE(vkCmdDrawIndexed)                              \
+  HANDLE(vkCmdPipelineBarrier)                          \
+  HANDLE(vkAllocateMemory)                              \
+  HANDLE(vkFreeMemory)                                  \
+  HANDLE(vkBeginCommandBuffer)                          \
+  HANDLE(vkEndCommandBuffer)                            \
+  HANDLE(vkBindBufferMemory)                            \
+  HANDLE(vkCmdCopyBuffer)                               \
+  HANDLE(vkCreateFence)                                 \
+  HANDLE(vkDestroyFence)                                \
+  HANDLE(vkGetBufferMemoryRequirements)                 \
+  HANDLE(vkInvalidateMappedMemoryRanges)                \
+  HANDLE(vkMapMemory)                                   \
+  HANDLE(vkQueueWaitIdle)                               \
+  HANDLE(vkUnmapMemory)                                 \
+  HANDLE(vkWaitForFences)
+
+#define GF_LAYERS_AMBER_SCOOP_DEVICE_EXTENSION_CALLS(HANDLE)
+
+namespace gf_layers::amber_scoop_layer {
+
+struct InstanceDispatchTable {
+  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = {};
+#define HANDLE(func) PFN_##func func = {};
+  GF_LAYERS_AMBER_SCOOP_INSTANCE_CORE_CALLS(HANDLE)
+  GF_LAYERS_AMBER_SCOOP_INSTANCE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+};
+
+struct DeviceDispatchTable {
+  PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr = {};
+#define HANDLE(func) PFN_##func func = {};
+  GF_LAYERS_AMBER_SCOOP_DEVICE_CORE_CALLS(HANDLE)
+  GF_LAYERS_AMBER_SCOOP_DEVICE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+};
+
+// Initializes |table| from the next layer's vkGetInstanceProcAddr. Returns
+// false if a core function is missing. Extension functions are null if the
+// extension is not enabled.
+inline bool InitInstanceDispatchTable(
+    VkInstance instance, PFN_vkGetInstanceProcAddr next_get_proc_addr,
+    InstanceDispatchTable* table) {
+  table->vkGetInstanceProcAddr = next_get_proc_addr;
+#define HANDLE(func)                          \
+  table->func = reinterpret_cast<PFN_##func>( \
+      next_get_proc_addr(instance, #func));   \
+  if (table->func == nullptr) {               \
+    return false;                             \
+  }
+  GF_LAYERS_AMBER_SCOOP_INSTANCE_CORE_CALLS(HANDLE)
+#undef HANDLE
+#define HANDLE(func)                          \
+  table->func = reinterpret_cast<PFN_##func>( \
+      next_get_proc_addr(instance, #func));
+  GF_LAYERS_AMBER_SCOOP_INSTANCE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+  return true;
+}
+
+// Initializes |table| from the next layer's vkGetDeviceProcAddr. Returns false
+// if a core function is missing. Extension functions are null if the extension
+// is not enabled.
+inline bool InitDeviceDispatchTable(VkDevice device,
+                                    PFN_vkGetDeviceProcAddr next_get_proc_addr,
+                                    DeviceDispatchTable* table) {
+  table->vkGetDeviceProcAddr = next_get_proc_addr;
+#define HANDLE(func)                          \
+  table->func = reinterpret_cast<PFN_##func>( \
+      next_get_proc_addr(device, #func));     \
+  if (table->func == nullptr) {               \
+    return false;                             \
+  }
+  GF_LAYERS_AMBER_SCOOP_DEVICE_CORE_CALLS(HANDLE)
+#undef HANDLE
+#define HANDLE(func)                          \
+  table->func = reinterpret_cast<PFN_##func>( \
+      next_get_proc_addr(device, #func));
+  GF_LAYERS_AMBER_SCOOP_DEVICE_EXTENSION_CALLS(HANDLE)
+#undef HANDLE
+  return true;
+}
+
+}  // namespace gf_layers::amber_scoop_layer
+
+#endif  // VKLAYER_GF_AMBER_SCOOP_DISPATCH_H
@@ -27,6 +27,7 @@
 #include "VkLayer_GF_amber_scoop/create_info_wrapper.h"
 #include "VkLayer_GF_amber_scoop/graphics_pipeline_data.h"
 #include "VkLayer_GF_amber_scoop/vulkan_commands.h"
+#include "absl/types/span.h"
 #include "gf_layers_layer_util/util.h"
 
 namespace gf_layers::amber_scoop_layer {
@@ -131,7 +132,7 @@ class DrawCallTracker {
   // a value is read from the vector.
   void BindGraphicsDescriptorSet(uint32_t set_number,
                                  VkDescriptorSet descriptor_set,
-                                 const std::vector<uint32_t>& dynamic_offsets,
+                                 absl::Span<const uint32_t> dynamic_offsets,
                                  uint32_t* dynamic_offset_idx);
 
   // Handles all of the draw calls. An Amber file will be generated
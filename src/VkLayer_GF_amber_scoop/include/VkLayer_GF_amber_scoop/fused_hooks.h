@@ -0,0 +1,47 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VKLAYER_GF_AMBER_SCOOP_FUSED_HOOKS_H
+#define VKLAYER_GF_AMBER_SCOOP_FUSED_HOOKS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// The hooks of the functions that this layer intercepts along with other
+// layers hosted by VkLayer_GF_fused, which calls them after looking up the
+// device once per call; see fused_layer.cc. Our own entry points call the same
+// hooks.
+
+namespace gf_layers::amber_scoop_layer {
+
+struct DeviceData;
+
+// Returns our data for |device|, to pass to the hooks below.
+DeviceData* GetHookDeviceData(VkDevice device);
+
+// Called before the next layer's vkQueueSubmit. Processes the commands of the
+// submitted command buffers, capturing the requested draw calls.
+void PreQueueSubmit(DeviceData* device_data, VkQueue queue,
+                    uint32_t submitCount, const VkSubmitInfo* pSubmits);
+
+// Called after the next layer's vkCreateShaderModule created |shader_module|
+// from |pCreateInfo| (as passed to this layer).
+void PostCreateShaderModule(DeviceData* device_data,
+                            const VkShaderModuleCreateInfo* pCreateInfo,
+                            VkShaderModule shader_module);
+
+}  // namespace gf_layers::amber_scoop_layer
+
+#endif  // VKLAYER_GF_AMBER_SCOOP_FUSED_HOOKS_H
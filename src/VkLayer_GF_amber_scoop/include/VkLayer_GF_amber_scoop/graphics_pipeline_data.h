@@ -30,8 +30,9 @@ namespace gf_layers::amber_scoop_layer {
 class GraphicsPipelineData
     : public CreateInfoWrapper<VkGraphicsPipelineCreateInfo> {
  public:
-  explicit GraphicsPipelineData(const VkGraphicsPipelineCreateInfo& create_info)
-      : CreateInfoWrapper(create_info) {}
+  GraphicsPipelineData(const ObjectAllocator& allocator,
+                       const VkGraphicsPipelineCreateInfo& create_info)
+      : CreateInfoWrapper(allocator, create_info) {}
 
   ~GraphicsPipelineData() override;
 
@@ -19,20 +19,23 @@
 
 #include <cstdint>
 
+#include "gf_layers_layer_util/allocator.h"
+
 namespace gf_layers::amber_scoop_layer {
 
-// Allocates a new array of type T with size of "num_elements" and copies data
-// from the array "p_data" starting from element with the given offset. The
-// allocated memory is not freed automatically. Use "delete[]" to free the
-// memory.
+// Allocates a new array of type T with size of "num_elements" - "offset" from
+// "allocator" and copies data from the array "p_data" starting from element
+// with the given offset. Returns nullptr if "p_data" is nullptr or there are no
+// elements to copy. The allocated memory is not freed automatically. Use
+// "allocator.DeleteArray" to free the memory.
 template <typename T>
-T* CopyArray(T const* p_data, uint64_t num_elements, uint64_t offset) {
-  if (p_data == nullptr) {
+T* CopyArray(const ObjectAllocator& allocator, T const* p_data,
+             uint64_t num_elements, uint64_t offset) {
+  if (p_data == nullptr || num_elements <= offset) {
     return nullptr;
   }
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  T* result = new T[num_elements - offset];
-  for (uint64_t i = 0; i < num_elements; i++) {
+  T* result = allocator.NewArray<T>(num_elements - offset);
+  for (uint64_t i = 0; i < num_elements - offset; i++) {
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
     result[i] = p_data[i + offset];
   }
@@ -41,107 +44,112 @@ T* CopyArray(T const* p_data, uint64_t num_elements, uint64_t offset) {
 
 // Shortcut for CopyArray with zero offset.
 template <typename T>
-T* CopyArray(T const* p_data, uint64_t num_elements) {
-  return CopyArray(p_data, num_elements, 0);
+T* CopyArray(const ObjectAllocator& allocator, T const* p_data,
+             uint64_t num_elements) {
+  return CopyArray(allocator, p_data, num_elements, 0);
 }
 
 // Commands for making a deep / recursive copy of Vulkan structs. Each DeepCopy
 // function has an associated DeepDelete function for freeing the memory in the
 // DeepCopy. Typically these functions are called from constructors and
 // destructors of gf_layers::amber_scoop_layer::CmdXXXX structs. See
-// vulkan_commands.h.
+// vulkan_commands.h. The memory is allocated from the given allocator, and
+// must be freed with the same allocator.
 
 // Makes a deep copy of VkBufferCreateInfo struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkBufferCreateInfo const*) to recursively free all
 // the allocated memory.
-VkBufferCreateInfo DeepCopy(const VkBufferCreateInfo& create_info);
+VkBufferCreateInfo DeepCopy(const ObjectAllocator& allocator,
+                            const VkBufferCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkBufferCreateInfo struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkBufferCreateInfo& create_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkBufferCreateInfo& create_info);
 
 // Makes a deep copy of VkDescriptorSetLayoutBinding struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkDescriptorSetLayoutBinding const*) to recursively free all
 // the allocated memory.
 VkDescriptorSetLayoutBinding DeepCopy(
+    const ObjectAllocator& allocator,
     const VkDescriptorSetLayoutBinding& descriptor_set_layout_binding);
 
 // Recursively deletes all the allocated memory of the given
 // VkDescriptorSetLayoutBinding struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkDescriptorSetLayoutBinding& binding);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkDescriptorSetLayoutBinding& binding);
 
 // Makes a deep copy of VkDescriptorSetLayoutCreateInfo struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkDescriptorSetLayoutCreateInfo const*) to recursively free all
 // the allocated memory.
 VkDescriptorSetLayoutCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkDescriptorSetLayoutCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkDescriptorSetLayoutBinding struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkDescriptorSetLayoutCreateInfo& create_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkDescriptorSetLayoutCreateInfo& create_info);
 
 // Makes a deep copy of VkGraphicsPipelineCreateInfo struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkGraphicsPipelineCreateInfo const*) to recursively free all
 // the allocated memory.
 VkGraphicsPipelineCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkGraphicsPipelineCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkGraphicsPipelineCreateInfo struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkGraphicsPipelineCreateInfo& create_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkGraphicsPipelineCreateInfo& create_info);
 
 // Makes a deep copy of VkPipelineLayoutCreateInfo struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkPipelineLayoutCreateInfo const*) to recursively free all
 // the allocated memory.
 VkPipelineLayoutCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkPipelineLayoutCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkPipelineLayoutCreateInfo struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkPipelineLayoutCreateInfo& create_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkPipelineLayoutCreateInfo& create_info);
 
 // Makes a deep copy of VkPipelineShaderStageCreateInfo struct. The allocated
 // memory is not freed automatically. Use
 // DeepDelete(VkPipelineShaderStageCreateInfo const*) to recursively free all
 // the allocated memory.
 VkPipelineShaderStageCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkPipelineShaderStageCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkPipelineShaderStageCreateInfo struct. Should be used only for structs
 // created with associated DeepCopy(...) function.
-void DeepDelete(const VkPipelineShaderStageCreateInfo& create_info);
-
-// Makes a deep copy of VkRenderPassBeginInfo struct. The allocated memory is
-// not freed automatically. Use DeepDelete(VkRenderPassBeginInfo const*) to
-// recursively free all the allocated memory.
-VkRenderPassBeginInfo DeepCopy(
-    VkRenderPassBeginInfo const* p_render_pass_begin_info);
-
-// Recursively deletes all the allocated memory of the given
-// VkRenderPassBeginInfo struct. Should be used only for structs created with
-// associated DeepCopy(...) function.
-void DeepDelete(VkRenderPassBeginInfo const* p_render_pass_begin_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkPipelineShaderStageCreateInfo& create_info);
 
 // Makes a deep copy of VkShaderModuleCreateInfo struct. The allocated memory is
 // not freed automatically. Use DeepDelete(VkShaderModuleCreateInfo const*) to
 // recursively free all the allocated memory.
-VkShaderModuleCreateInfo DeepCopy(const VkShaderModuleCreateInfo& create_info);
+VkShaderModuleCreateInfo DeepCopy(const ObjectAllocator& allocator,
+                                  const VkShaderModuleCreateInfo& create_info);
 
 // Recursively deletes all the allocated memory of the given
 // VkShaderModuleCreateInfo struct. Should be used only for structs created with
 // associated DeepCopy(...) function.
-void DeepDelete(const VkShaderModuleCreateInfo& create_info);
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkShaderModuleCreateInfo& create_info);
 
 }  // namespace gf_layers::amber_scoop_layer
 
@@ -17,10 +17,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
 
-#include "VkLayer_GF_amber_scoop/vk_deep_copy.h"
+#include "absl/types/span.h"
+#include "gf_layers_layer_util/allocator.h"
 
 namespace gf_layers::amber_scoop_layer {
 
@@ -35,6 +36,12 @@ class DrawCallTracker;
 // Cmd is a base for all vkCmdXX commands (Vulkan command buffer commands) we
 // are interested in. The interesting commands include all the commands that may
 // affect the draw command(s) that will be captured.
+//
+// Commands are allocated from their command buffer's linear allocator via
+// |new (allocator) CmdXXXX(...)|, as are the arrays they copy. Deleting a
+// command only runs its destructor; the memory is reclaimed when the allocator
+// is reset. Thus, commands must be trivially destructible apart from their
+// base class.
 class Cmd {
  public:
   Cmd();
@@ -46,6 +53,13 @@ class Cmd {
   Cmd& operator=(const Cmd&) = delete;
   Cmd& operator=(Cmd&&) = delete;
 
+  static void* operator new(std::size_t size, LinearAllocator* allocator) {
+    return allocator->Allocate(size, alignof(std::max_align_t));
+  }
+  static void operator delete(void* /*memory*/,
+                              LinearAllocator* /*allocator*/) {}
+  static void operator delete(void* /*memory*/) {}
+
   virtual bool IsDrawCall() { return false; }
 
   // Overriding function should either update the given draw call tracker (most
@@ -55,11 +69,13 @@ class Cmd {
 
 class CmdBeginRenderPass : public Cmd {
  public:
-  CmdBeginRenderPass(VkRenderPassBeginInfo const* renderpass_begin,
+  CmdBeginRenderPass(LinearAllocator* allocator,
+                     VkRenderPassBeginInfo const* renderpass_begin,
                      VkSubpassContents contents)
-      : render_pass_begin_(DeepCopy(renderpass_begin)), contents_(contents) {}
-
-  ~CmdBeginRenderPass() override { DeepDelete(&render_pass_begin_); }
+      : render_pass_begin_(*renderpass_begin), contents_(contents) {
+    render_pass_begin_.pClearValues = allocator->CopyArray(
+        renderpass_begin->pClearValues, renderpass_begin->clearValueCount);
+  }
 
   // Disabled copy/move constructors and copy/move assign operators
   CmdBeginRenderPass(const CmdBeginRenderPass&) = delete;
@@ -77,7 +93,8 @@ class CmdBeginRenderPass : public Cmd {
 
 class CmdBindDescriptorSets : public Cmd {
  public:
-  CmdBindDescriptorSets(VkPipelineBindPoint pipeline_bind_point,
+  CmdBindDescriptorSets(LinearAllocator* allocator,
+                        VkPipelineBindPoint pipeline_bind_point,
                         VkPipelineLayout layout, uint32_t first_set,
                         uint32_t descriptor_set_count,
                         const VkDescriptorSet* descriptor_sets,
@@ -85,21 +102,13 @@ class CmdBindDescriptorSets : public Cmd {
                         const uint32_t* dynamic_offsets)
       : pipeline_bind_point_(pipeline_bind_point),
         layout_(layout),
-        first_set_(first_set) {
-    if (descriptor_set_count > 0) {
-      descriptor_sets_.assign(
-          descriptor_sets,
-          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-          descriptor_sets + descriptor_set_count);
-    }
-
-    if (dynamic_offset_count > 0) {
-      dynamic_offsets_.assign(
-          dynamic_offsets,
-          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-          dynamic_offsets + dynamic_offset_count);
-    }
-  }
+        first_set_(first_set),
+        descriptor_sets_(
+            allocator->CopyArray(descriptor_sets, descriptor_set_count),
+            descriptor_set_count),
+        dynamic_offsets_(
+            allocator->CopyArray(dynamic_offsets, dynamic_offset_count),
+            dynamic_offset_count) {}
 
   // Sets vertex buffer bindings and their offsets.
   void ProcessSubmittedCommand(
@@ -109,8 +118,8 @@ class CmdBindDescriptorSets : public Cmd {
   VkPipelineBindPoint pipeline_bind_point_;
   VkPipelineLayout layout_;
   uint32_t first_set_;
-  std::vector<VkDescriptorSet> descriptor_sets_;
-  std::vector<uint32_t> dynamic_offsets_;
+  absl::Span<const VkDescriptorSet> descriptor_sets_;
+  absl::Span<const uint32_t> dynamic_offsets_;
 };
 
 class CmdBindIndexBuffer : public Cmd {
@@ -145,13 +154,12 @@ class CmdBindPipeline : public Cmd {
 
 class CmdBindVertexBuffers : public Cmd {
  public:
-  CmdBindVertexBuffers(uint32_t first_binding, uint32_t binding_count,
-                       const VkBuffer* buffers, const VkDeviceSize* offsets)
+  CmdBindVertexBuffers(LinearAllocator* allocator, uint32_t first_binding,
+                       uint32_t binding_count, const VkBuffer* buffers,
+                       const VkDeviceSize* offsets)
       : first_binding_(first_binding),
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        buffers_(buffers, buffers + binding_count),
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        offsets_(offsets, offsets + binding_count) {}
+        buffers_(allocator->CopyArray(buffers, binding_count), binding_count),
+        offsets_(allocator->CopyArray(offsets, binding_count), binding_count) {}
 
   // Sets vertex buffer bindings and their offsets.
   void ProcessSubmittedCommand(
@@ -159,8 +167,8 @@ class CmdBindVertexBuffers : public Cmd {
 
  private:
   uint32_t first_binding_;
-  std::vector<VkBuffer> buffers_;
-  std::vector<VkDeviceSize> offsets_;
+  absl::Span<const VkBuffer> buffers_;
+  absl::Span<const VkDeviceSize> offsets_;
 };
 
 class CmdDraw : public Cmd {
@@ -212,7 +220,8 @@ class CmdDrawIndexed : public Cmd {
 
 class CmdPipelineBarrier : public Cmd {
  public:
-  CmdPipelineBarrier(VkPipelineStageFlags src_stage_mask,
+  CmdPipelineBarrier(LinearAllocator* allocator,
+                     VkPipelineStageFlags src_stage_mask,
                      VkPipelineStageFlags dst_stage_mask,
                      VkDependencyFlags dependency_flags,
                      uint32_t memory_barrier_count,
@@ -223,27 +232,17 @@ class CmdPipelineBarrier : public Cmd {
                      const VkImageMemoryBarrier* image_memory_barriers)
       : src_stage_mask_(src_stage_mask),
         dst_stage_mask_(dst_stage_mask),
-        dependency_flags_(dependency_flags) {
-    // Copy the barriers to vectors for easier access.
-    if (memory_barrier_count > 0) {
-      memory_barriers_.assign(
-          memory_barriers,
-          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-          memory_barriers + memory_barrier_count);
-    }
-    if (buffer_memory_barrier_count > 0) {
-      buffer_memory_barriers_.assign(
-          buffer_memory_barriers,
-          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-          buffer_memory_barriers + buffer_memory_barrier_count);
-    }
-    if (image_memory_barrier_count > 0) {
-      image_memory_barriers_.assign(
-          image_memory_barriers,
-          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-          image_memory_barriers + image_memory_barrier_count);
-    }
-  }
+        dependency_flags_(dependency_flags),
+        memory_barriers_(
+            allocator->CopyArray(memory_barriers, memory_barrier_count),
+            memory_barrier_count),
+        buffer_memory_barriers_(
+            allocator->CopyArray(buffer_memory_barriers,
+                                 buffer_memory_barrier_count),
+            buffer_memory_barrier_count),
+        image_memory_barriers_(allocator->CopyArray(image_memory_barriers,
+                                                    image_memory_barrier_count),
+                               image_memory_barrier_count) {}
 
   // Sets the index buffer binding.
   void ProcessSubmittedCommand(
@@ -260,15 +259,15 @@ class CmdPipelineBarrier : public Cmd {
   [[nodiscard]] VkDependencyFlags GetDependencyFlags() const {
     return dependency_flags_;
   }
-  [[nodiscard]] const std::vector<VkMemoryBarrier>& GetMemoryBarriers() const {
+  [[nodiscard]] absl::Span<const VkMemoryBarrier> GetMemoryBarriers() const {
     return memory_barriers_;
   }
-  [[nodiscard]] const std::vector<VkBufferMemoryBarrier>&
+  [[nodiscard]] absl::Span<const VkBufferMemoryBarrier>
   GetBufferMemoryBarriers() const {
     return buffer_memory_barriers_;
   }
-  [[nodiscard]] const std::vector<VkImageMemoryBarrier>&
-  GetImageMemoryBarriers() const {
+  [[nodiscard]] absl::Span<const VkImageMemoryBarrier> GetImageMemoryBarriers()
+      const {
     return image_memory_barriers_;
   }
 
@@ -276,9 +275,9 @@ class CmdPipelineBarrier : public Cmd {
   VkPipelineStageFlags src_stage_mask_;
   VkPipelineStageFlags dst_stage_mask_;
   VkDependencyFlags dependency_flags_;
-  std::vector<VkMemoryBarrier> memory_barriers_;
-  std::vector<VkBufferMemoryBarrier> buffer_memory_barriers_;
-  std::vector<VkImageMemoryBarrier> image_memory_barriers_;
+  absl::Span<const VkMemoryBarrier> memory_barriers_;
+  absl::Span<const VkBufferMemoryBarrier> buffer_memory_barriers_;
+  absl::Span<const VkImageMemoryBarrier> image_memory_barriers_;
 };
 
 #pragma clang diagnostic pop
@@ -18,17 +18,26 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <cstddef>
 #include <cstring>
 #include <memory>
 #include <utility>
+#include <string_view>
 #include <vector>
 
 #include "VkLayer_GF_amber_scoop/command_buffer_data.h"
 #include "VkLayer_GF_amber_scoop/draw_call_tracker.h"
+#include "VkLayer_GF_amber_scoop/fused_hooks.h"
 #include "VkLayer_GF_amber_scoop/vulkan_commands.h"
 #include "absl/types/span.h"
+#include "gf_layers_layer_util/allocator.h"
+#include "gf_layers_layer_util/instrumentation.h"
+#include "gf_layers_layer_util/live_stats.h"
 #include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/proc_table.h"
 #include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/thread_pool.h"
+#include "gf_layers_layer_util/trace.h"
 #include "gf_layers_layer_util/util.h"
 
 namespace gf_layers::amber_scoop_layer {
@@ -67,35 +76,54 @@ bool IsThisLayer(const char* pLayerName) {
           strcmp(pLayerName, kLayerProperties[0].layerName) == 0);
 }
 
+//
+// The functions provided by this layer, used by our vkGet*ProcAddr functions.
+// The lists are generated from vulkan_functions.txt.
+//
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kDeviceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_AMBER_SCOOP_DEVICE_HOOKS(HANDLE)});
+constexpr auto kInstanceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_AMBER_SCOOP_INSTANCE_HOOKS(HANDLE)});
+#undef HANDLE
+
+static_assert(kDeviceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of device functions");
+static_assert(kInstanceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of instance functions");
+
 void InitSettingsIfNeeded() {
-  gf_layers::ScopedLock lock(GetGlobalData()->settings_mutex);
-
-  AmberScoopLayerSettings& settings = GetGlobalData()->settings;
-
-  if (!settings.init) {
-    uint64_t draw_call_count = 1;
-    GetSettingUint64("VkLayer_GF_amber_scoop_START_DRAW_CALL",
-                     "debug.gf.as.start_draw_call", &settings.start_draw_call);
-    GetSettingUint64("VkLayer_GF_amber_scoop_DRAW_CALL_COUNT",
-                     "debug.gf.as.draw_call_count", &draw_call_count);
-    GetSettingString("VkLayer_GF_amber_scoop_OUTPUT_FILE_PREFIX",
-                     "debug.gf.as.output_file_prefix",
-                     &settings.output_file_prefix);
-    settings.last_draw_call = settings.start_draw_call + draw_call_count;
-    settings.init = true;
+  GlobalData* global_data = GetGlobalData();
+  gf_layers::ScopedLock lock(global_data->settings_mutex);
+
+  if (!global_data->settings_init) {
+    SettingsRegistry<AmberScoopLayerSettings>& settings = global_data->settings;
+    settings.Add("VkLayer_GF_amber_scoop_START_DRAW_CALL",
+                 "debug.gf.as.start_draw_call",
+                 &AmberScoopLayerSettings::start_draw_call);
+    settings.Add("VkLayer_GF_amber_scoop_DRAW_CALL_COUNT",
+                 "debug.gf.as.draw_call_count",
+                 &AmberScoopLayerSettings::draw_call_count);
+    settings.Add("VkLayer_GF_amber_scoop_OUTPUT_FILE_PREFIX",
+                 "debug.gf.as.output_file_prefix",
+                 &AmberScoopLayerSettings::output_file_prefix);
+    settings.Load();
+    global_data->settings_init = true;
   }
 }
 
-// Adds |command| to the list of tracked commands for |command_buffer|. Tracked
-// commands will be parsed later when |command_buffer| is submitted via the
-// vkQueueSubmit function.
+// Adds a |CmdType| command constructed from |args| to the list of tracked
+// commands for |command_buffer|. Tracked commands will be parsed later when
+// |command_buffer| is submitted via the vkQueueSubmit function.
+template <typename CmdType, typename... Args>
 void AddCommand(DeviceData* device_data, VkCommandBuffer command_buffer,
-                std::unique_ptr<Cmd> command) {
+                Args&&... args) {
   CommandBufferData* tracked_command_buffer =
       device_data->command_buffers_data.Get(command_buffer);
   // All of the command buffers should be tracked.
   DEBUG_ASSERT(tracked_command_buffer != nullptr);
-  tracked_command_buffer->AddCommand(std::move(command));
+  tracked_command_buffer->AddCommand<CmdType>(std::forward<Args>(args)...);
 }
 
 // Intercepted "vkCmd..." functions.
@@ -106,6 +134,7 @@ void AddCommand(DeviceData* device_data, VkCommandBuffer command_buffer,
 VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(
     VkCommandBuffer commandBuffer,
     const VkRenderPassBeginInfo* pRenderPassBegin, VkSubpassContents contents) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -113,8 +142,8 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(
   // Call the original function.
   device_data->vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
 
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdBeginRenderPass>(pRenderPassBegin, contents));
+  AddCommand<CmdBeginRenderPass>(device_data, commandBuffer, pRenderPassBegin,
+                                 contents);
 }
 
 //
@@ -125,6 +154,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(
     VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
     const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount,
     const uint32_t* pDynamicOffsets) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(commandBuffer));
 
   // Call the original function.
@@ -132,10 +162,9 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(
       commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount,
       pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
 
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdBindDescriptorSets>(
-                 pipelineBindPoint, layout, firstSet, descriptorSetCount,
-                 pDescriptorSets, dynamicOffsetCount, pDynamicOffsets));
+  AddCommand<CmdBindDescriptorSets>(
+      device_data, commandBuffer, pipelineBindPoint, layout, firstSet,
+      descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
 }
 
 //
@@ -145,6 +174,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer,
                                                 VkBuffer buffer,
                                                 VkDeviceSize offset,
                                                 VkIndexType indexType) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -152,8 +182,8 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer,
   // Call the original function.
   device_data->vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
 
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdBindIndexBuffer>(buffer, offset, indexType));
+  AddCommand<CmdBindIndexBuffer>(device_data, commandBuffer, buffer, offset,
+                                 indexType);
 }
 
 //
@@ -162,6 +192,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer,
 VKAPI_ATTR void VKAPI_CALL
 vkCmdBindPipeline(VkCommandBuffer commandBuffer,
                   VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -169,8 +200,8 @@ vkCmdBindPipeline(VkCommandBuffer commandBuffer,
   // Call the original function.
   device_data->vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
 
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdBindPipeline>(pipelineBindPoint, pipeline));
+  AddCommand<CmdBindPipeline>(device_data, commandBuffer, pipelineBindPoint,
+                              pipeline);
 }
 
 //
@@ -179,6 +210,7 @@ vkCmdBindPipeline(VkCommandBuffer commandBuffer,
 VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(
     VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
     VkBuffer const* pBuffers, VkDeviceSize const* pOffsets) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -186,9 +218,8 @@ VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(
   // Call the original function.
   device_data->vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount,
                                       pBuffers, pOffsets);
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdBindVertexBuffers>(firstBinding, bindingCount,
-                                                    pBuffers, pOffsets));
+  AddCommand<CmdBindVertexBuffers>(device_data, commandBuffer, firstBinding,
+                                   bindingCount, pBuffers, pOffsets);
 }
 
 //
@@ -199,6 +230,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer,
                                      uint32_t instanceCount,
                                      uint32_t firstVertex,
                                      uint32_t firstInstance) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -207,9 +239,8 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer,
   device_data->vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex,
                          firstInstance);
 
-  AddCommand(device_data, commandBuffer,
-             std::make_unique<CmdDraw>(vertexCount, instanceCount, firstVertex,
-                                       firstInstance));
+  AddCommand<CmdDraw>(device_data, commandBuffer, vertexCount, instanceCount,
+                      firstVertex, firstInstance);
 }
 
 //
@@ -218,6 +249,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer,
 VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(
     VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
     uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -226,10 +258,9 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(
   device_data->vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount,
                                 firstIndex, vertexOffset, firstInstance);
 
-  AddCommand(
-      device_data, commandBuffer,
-      std::make_unique<CmdDrawIndexed>(indexCount, instanceCount, firstIndex,
-                                       vertexOffset, firstInstance));
+  AddCommand<CmdDrawIndexed>(device_data, commandBuffer, indexCount,
+                             instanceCount, firstIndex, vertexOffset,
+                             firstInstance);
 }
 
 //
@@ -245,6 +276,7 @@ void vkCmdPipelineBarrier(VkCommandBuffer commandBuffer,
                           VkBufferMemoryBarrier const* pBufferMemoryBarriers,
                           uint32_t imageMemoryBarrierCount,
                           VkImageMemoryBarrier const* pImageMemoryBarriers) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data =
       global_data->device_map.Get(DeviceKey(commandBuffer))->get();
@@ -255,12 +287,10 @@ void vkCmdPipelineBarrier(VkCommandBuffer commandBuffer,
       memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
       pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
 
-  AddCommand(
-      device_data, commandBuffer,
-      std::make_unique<CmdPipelineBarrier>(
-          srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount,
-          pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers,
-          imageMemoryBarrierCount, pImageMemoryBarriers));
+  AddCommand<CmdPipelineBarrier>(
+      device_data, commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+      memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+      pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
 }
 
 // Other intercepted vulkan functions.
@@ -271,6 +301,7 @@ void vkCmdPipelineBarrier(VkCommandBuffer commandBuffer,
 VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
     VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
     VkCommandBuffer* pCommandBuffers) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -286,8 +317,9 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
       absl::MakeConstSpan(pCommandBuffers, pAllocateInfo->commandBufferCount);
 
   for (VkCommandBuffer command_buffer : command_buffers) {
-    device_data->command_buffers_data.Put(command_buffer,
-                                          CommandBufferData(*pAllocateInfo));
+    device_data->command_buffers_data.Put(
+        command_buffer,
+        CommandBufferData(&device_data->allocator, *pAllocateInfo));
   }
 
   return result;
@@ -299,6 +331,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
 void vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
                           uint32_t commandBufferCount,
                           const VkCommandBuffer* pCommandBuffers) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -320,6 +353,7 @@ void vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
 VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(
     VkDevice device, VkDescriptorSetAllocateInfo const* pAllocateInfo,
     VkDescriptorSet* pDescriptorSets) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -336,7 +370,8 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(
         device_data->descriptor_set_layouts.Get(pAllocateInfo->pSetLayouts[i]);
     device_data->descriptor_sets.Put(
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        pDescriptorSets[i], DescriptorSetData(layout_data));
+        pDescriptorSets[i],
+        DescriptorSetData(&device_data->allocator, layout_data));
   }
   return result;
 }
@@ -347,6 +382,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(
 void vkFreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool,
                           uint32_t descriptorSetCount,
                           VkDescriptorSet const* pDescriptorSets) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -366,6 +402,7 @@ void vkFreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool,
 VKAPI_ATTR VkResult VKAPI_CALL
 vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
                const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   VkBufferCreateInfo create_info = *pCreateInfo;
@@ -385,7 +422,10 @@ vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
       device_data->vkCreateBuffer(device, &create_info, pAllocator, pBuffer);
 
   if (result == VK_SUCCESS) {
-    device_data->buffers.Put(*pBuffer, BufferData(create_info));
+    device_data->buffers.Put(
+        *pBuffer,
+        BufferData(ObjectAllocator(&device_data->allocator, pAllocator),
+                   create_info));
   }
 
   return result;
@@ -396,6 +436,7 @@ vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
 //
 void vkDestroyBuffer(VkDevice device, VkBuffer buffer,
                      const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -411,6 +452,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(
     VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
     VkDescriptorSetLayout* pSetLayout) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -422,7 +464,9 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(
   }
 
   device_data->descriptor_set_layouts.Put(
-      *pSetLayout, DescriptorSetLayoutData(*pCreateInfo));
+      *pSetLayout,
+      DescriptorSetLayoutData(
+          ObjectAllocator(&device_data->allocator, pAllocator), *pCreateInfo));
   return result;
 }
 
@@ -432,6 +476,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(
 void vkDestroyDescriptorSetLayout(VkDevice device,
                                   VkDescriptorSetLayout descriptorSetLayout,
                                   VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -448,6 +493,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(
     VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
     const VkGraphicsPipelineCreateInfo* pCreateInfos,
     const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -465,10 +511,12 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(
       absl::MakeConstSpan(pPipelines, createInfoCount);
 
   // For each pipeline created, add a |GraphicsPipelineData| to our
-  // |graphics_pipelines| map.
+  // |graphics_pipelines| map. We do not intercept vkDestroyPipeline, so the
+  // data lives until the device is destroyed and is allocated with the
+  // device's callbacks rather than |pAllocator|.
   for (uint32_t i = 0; i < createInfoCount; i++) {
-    auto graphics_pipeline_data =
-        std::make_unique<GraphicsPipelineData>(create_infos[i]);
+    auto graphics_pipeline_data = std::make_unique<GraphicsPipelineData>(
+        ObjectAllocator(&device_data->allocator), create_infos[i]);
 
     // For each shader module in the pipeline, add the corresponding
     // |ShaderModuleData| to the |graphics_pipeline_data|.
@@ -500,6 +548,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(
     VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
     VkPipelineLayout* pPipelineLayout) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -508,8 +557,10 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(
   if (result != VK_SUCCESS) {
     return result;
   }
-  device_data->pipeline_layouts.Put(*pPipelineLayout,
-                                    PipelineLayoutData(*pCreateInfo));
+  device_data->pipeline_layouts.Put(
+      *pPipelineLayout,
+      PipelineLayoutData(ObjectAllocator(&device_data->allocator, pAllocator),
+                         *pCreateInfo));
   return result;
 }
 
@@ -518,6 +569,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(
 //
 void vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout,
                              VkAllocationCallbacks const* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
   // Call the original function.
   device_data->vkDestroyPipelineLayout(device, pipelineLayout, pAllocator);
@@ -531,15 +583,13 @@ void vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout,
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(
     VkDevice device, VkShaderModuleCreateInfo const* pCreateInfo,
     VkAllocationCallbacks const* pAllocator, VkShaderModule* pShaderModule) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   auto result = device_data->vkCreateShaderModule(device, pCreateInfo,
                                                   pAllocator, pShaderModule);
   if (result == VK_SUCCESS) {
-    // Create a ShaderModuleData object to keep track of the shader module's
-    // lifetime.
-    device_data->shader_modules_data.Put(
-        *pShaderModule, std::make_shared<ShaderModuleData>(*pCreateInfo));
+    PostCreateShaderModule(device_data, pCreateInfo, *pShaderModule);
   }
   return result;
 }
@@ -549,6 +599,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(
 //
 void vkDestroyShaderModule(VkDevice device, VkShaderModule shaderModule,
                            VkAllocationCallbacks const* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -565,53 +616,11 @@ VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
                                              uint32_t submitCount,
                                              VkSubmitInfo const* pSubmits,
                                              VkFence fence) {
-  // Go through all tracked commands in all of the submitted command buffers.
-  // Every command buffer containing a draw call will be parsed to get the
-  // state of every resource required by a draw call. If the draw call is
-  // requested to be captured, an Amber file will be generated.
-
-  GlobalData* global_data = GetGlobalData();
-  DeviceData* device_data =
-      global_data->device_map.Get(DeviceKey(queue))->get();
-
-  // For each queue submit...
-  for (const VkSubmitInfo& submit_info :
-       absl::MakeConstSpan(pSubmits, submitCount)) {
-    // For each command buffer...
-    for (const VkCommandBuffer& command_buffer : absl::MakeConstSpan(
-             submit_info.pCommandBuffers, submit_info.commandBufferCount)) {
-      CommandBufferData* command_buffer_data =
-          device_data->command_buffers_data.Get(command_buffer);
-
-      // All of the command buffers should be tracked.
-      DEBUG_ASSERT(command_buffer_data != nullptr);
-
-      // Skip all command buffers that don't contain any draw calls.
-      if (!command_buffer_data->ContainsDrawCalls()) {
-        // Reset the command buffer data state because the command buffer has
-        // been submitted.
-        command_buffer_data->ResetState();
-        continue;
-      }
-
-      // Create a new draw call state tracker. Tracker stores the state of the
-      // command buffer being processed, i.e. what pipeline is bound, push
-      // constant values, bound vertex and index buffers, etc. This information
-      // is needed when a draw call needs to be processed to an Amber file.
-      DrawCallTracker draw_call_tracker(global_data, command_buffer, queue);
-
-      // Process all submitted commands. Most of the commands update the state
-      // of the draw call tracker and draw commands generate the Amber files.
-      for (const std::unique_ptr<Cmd>& cmd :
-           command_buffer_data->GetCommandList()) {
-        cmd->ProcessSubmittedCommand(&draw_call_tracker);
-      }
-
-      // Reset the command buffer data state because the command buffer has
-      // been submitted.
-      command_buffer_data->ResetState();
-    }
-  }
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
+  TraceSpan trace_span("vkQueueSubmit");
+  trace_span.AddArg("submit_count", submitCount);
+  DeviceData* device_data = GetDeviceData(DeviceKey(queue));
+  PreQueueSubmit(device_data, queue, submitCount, pSubmits);
 
   // Call the original function.
   VkResult result =
@@ -627,6 +636,7 @@ void vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount,
                             VkWriteDescriptorSet const* pDescriptorWrites,
                             uint32_t descriptorCopyCount,
                             VkCopyDescriptorSet const* pDescriptorCopies) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DeviceData* device_data = GetDeviceData(DeviceKey(device));
 
   // Call the original function.
@@ -660,6 +670,7 @@ void vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount,
 //
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
     uint32_t* pPropertyCount, VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG("vkEnumerateInstanceLayerProperties");
 
   if (pProperties == nullptr) {
@@ -684,6 +695,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
     VkPhysicalDevice /*physicalDevice*/, uint32_t* pPropertyCount,
     VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG(
       "vkEnumerateDeviceLayerProperties (calling "
       "vkEnumerateInstanceLayerProperties)");
@@ -697,6 +709,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
     const char* pLayerName, uint32_t* pPropertyCount,
     VkExtensionProperties* /*pProperties*/) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG("vkEnumerateInstanceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -712,6 +725,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
     VkPhysicalDevice physicalDevice, const char* pLayerName,
     uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG("vkEnumerateDeviceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -734,6 +748,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
     const VkInstanceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkInstance* pInstance) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG("vkCreateInstance");
 
   InitSettingsIfNeeded();
@@ -778,21 +793,16 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 
   instance_data.instance = *pInstance;
 
-#define HANDLE(func)                                      \
-  instance_data.func = reinterpret_cast<PFN_##func>(      \
-      next_get_instance_proc_address(*pInstance, #func)); \
-  if (!instance_data.func) {                              \
-    return VK_ERROR_INITIALIZATION_FAILED;                \
+  if (!InitInstanceDispatchTable(*pInstance, next_get_instance_proc_address,
+                                 &instance_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-  HANDLE(vkGetPhysicalDeviceMemoryProperties)
-#undef HANDLE
-
-  instance_data.vkGetInstanceProcAddr = next_get_instance_proc_address;
-
   GetGlobalData()->instance_map.Put(InstanceKey(*pInstance), instance_data);
 
+  // Captured draw calls are written on the thread pool.
+  AcquireLayerThreadPool();
+
   return result;
 }
 
@@ -802,6 +812,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
     VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_LOG("vkCreateDevice");
 
   // Get the layer device create info, which we need so we can:
@@ -853,66 +864,84 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
   // Initialize our DeviceData, including all device function pointers that
   // we will need.
 
-  std::unique_ptr<DeviceData> device_data = std::make_unique<DeviceData>();
+  std::unique_ptr<DeviceData> device_data =
+      std::make_unique<DeviceData>(pAllocator);
 
   device_data->physical_device = physicalDevice;
   device_data->device = *pDevice;
   device_data->instance_data = instance_data;
 
-#define HANDLE(func)                                  \
-  device_data->func = reinterpret_cast<PFN_##func>(   \
-      next_get_device_proc_address(*pDevice, #func)); \
-  if (!device_data->func) {                           \
-    return VK_ERROR_INITIALIZATION_FAILED;            \
+  if (!InitDeviceDispatchTable(*pDevice, next_get_device_proc_address,
+                               device_data.get())) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkAllocateCommandBuffers)
-  HANDLE(vkFreeCommandBuffers)
-  HANDLE(vkAllocateDescriptorSets)
-  HANDLE(vkFreeDescriptorSets)
-  HANDLE(vkCreateBuffer)
-  HANDLE(vkDestroyBuffer)
-  HANDLE(vkCreateDescriptorSetLayout)
-  HANDLE(vkDestroyDescriptorSetLayout)
-  HANDLE(vkCreateGraphicsPipelines)
-  HANDLE(vkCreatePipelineLayout)
-  HANDLE(vkDestroyPipelineLayout)
-  HANDLE(vkCreateShaderModule)
-  HANDLE(vkDestroyShaderModule)
-  HANDLE(vkQueueSubmit)
-  HANDLE(vkUpdateDescriptorSets)
-  HANDLE(vkCmdBeginRenderPass)
-  HANDLE(vkCmdBindDescriptorSets)
-  HANDLE(vkCmdBindIndexBuffer)
-  HANDLE(vkCmdBindPipeline)
-  HANDLE(vkCmdBindVertexBuffers)
-  HANDLE(vkCmdDraw)
-  HANDLE(vkCmdDrawIndexed)
-  HANDLE(vkCmdPipelineBarrier)
-
-  // Functions used by the layer but not intercepted:
-  HANDLE(vkAllocateMemory)
-  HANDLE(vkFreeMemory)
-  HANDLE(vkBeginCommandBuffer)
-  HANDLE(vkEndCommandBuffer)
-  HANDLE(vkBindBufferMemory)
-  HANDLE(vkCmdCopyBuffer)
-  HANDLE(vkCreateFence)
-  HANDLE(vkDestroyFence)
-  HANDLE(vkGetBufferMemoryRequirements)
-  HANDLE(vkInvalidateMappedMemoryRanges)
-  HANDLE(vkMapMemory)
-  HANDLE(vkQueueWaitIdle)
-  HANDLE(vkUnmapMemory)
-  HANDLE(vkWaitForFences)
+  GetGlobalData()->device_map.Put(DeviceKey(*pDevice), std::move(device_data));
 
-#undef HANDLE
+  return result;
+}
 
-  device_data->vkGetDeviceProcAddr = next_get_device_proc_address;
+//
+// Our vkDestroyDevice function.
+//
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
+  DEBUG_LOG("vkDestroyDevice");
 
-  GetGlobalData()->device_map.Put(DeviceKey(*pDevice), std::move(device_data));
+  if (device == nullptr) {
+    return;
+  }
 
-  return result;
+  // Get the key before the device is destroyed, as the key is read from the
+  // device object.
+  void* device_key = DeviceKey(device);
+  DeviceData* device_data = GetDeviceData(device_key);
+
+  device_data->vkDestroyDevice(device, pAllocator);
+
+  AllocatorStats stats = device_data->allocator.GetStats();
+  LOG("Layer allocations for the device: %llu (%llu via the application's "
+      "callbacks), peak %llu bytes, arena blocks %llu bytes.",
+      static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+          stats.allocation_count),
+      static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+          stats.callback_allocation_count),
+      static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+          stats.peak_live_bytes),
+      static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+          stats.arena_block_bytes));
+
+  // Frees the device data, including all tracked objects of the device.
+  GetGlobalData()->device_map.Remove(device_key);
+
+  GF_LAYERS_DUMP_INSTRUMENTATION("VkLayer_GF_amber_scoop");
+}
+
+//
+// Our vkDestroyInstance function.
+//
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
+  DEBUG_LOG("vkDestroyInstance");
+
+  if (instance == nullptr) {
+    return;
+  }
+
+  // Get the key before the instance is destroyed, as the key is read from the
+  // instance object.
+  void* instance_key = InstanceKey(instance);
+  GlobalData* global_data = GetGlobalData();
+  InstanceData* instance_data = global_data->instance_map.Get(instance_key);
+
+  instance_data->vkDestroyInstance(instance, pAllocator);
+
+  global_data->instance_map.Remove(instance_key);
+
+  // Waits for the captured draw calls to be written.
+  ReleaseLayerThreadPool();
 }
 
 //
@@ -920,45 +949,26 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
 //
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
 vkGetDeviceProcAddr(VkDevice device, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_ASSERT(pName);
   DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
-  }
-
-  // The device functions provided by this layer:
-
-  // Standard device functions that most layers must implement:
-  HANDLE(vkGetDeviceProcAddr)  // Self-reference.
-
-  // Other device functions that this layer intercepts:
-  HANDLE(vkAllocateCommandBuffers)
-  HANDLE(vkFreeCommandBuffers)
-  HANDLE(vkAllocateDescriptorSets)
-  HANDLE(vkFreeDescriptorSets)
-  HANDLE(vkCreateBuffer)
-  HANDLE(vkDestroyBuffer)
-  HANDLE(vkCreateDescriptorSetLayout)
-  HANDLE(vkDestroyDescriptorSetLayout)
-  HANDLE(vkCreateGraphicsPipelines)
-  HANDLE(vkCreatePipelineLayout)
-  HANDLE(vkDestroyPipelineLayout)
-  HANDLE(vkCreateShaderModule)
-  HANDLE(vkDestroyShaderModule)
-  HANDLE(vkQueueSubmit)
-  HANDLE(vkUpdateDescriptorSets)
-  HANDLE(vkCmdBeginRenderPass)
-  HANDLE(vkCmdBindDescriptorSets)
-  HANDLE(vkCmdBindIndexBuffer)
-  HANDLE(vkCmdBindPipeline)
-  HANDLE(vkCmdBindVertexBuffers)
-  HANDLE(vkCmdDraw)
-  HANDLE(vkCmdDrawIndexed)
-  HANDLE(vkCmdPipelineBarrier)
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kDeviceFunctionTable.size()>
+      kDeviceFunctions = {GF_LAYERS_AMBER_SCOOP_DEVICE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  // Unlike the other layers, we intercept all of our device functions
+  // regardless of the settings: draw calls are numbered in submission order
+  // and captured from commands that may have been recorded long before (and
+  // submitted many times), so every command must be tracked, even while the
+  // capture window is far off.
+  PFN_vkVoidFunction result =
+      kDeviceFunctionTable.Lookup(pName, kDeviceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
   if (device == nullptr) {
     return nullptr;
   }
@@ -978,33 +988,22 @@ vkGetDeviceProcAddr(VkDevice device, const char* pName) {
 //
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
 vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_amber_scoop");
   DEBUG_ASSERT(pName);
 
   DEBUG_LOG("vkGetInstanceProcAddr: %s", pName);
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
-  }
-
-  // The global and instance functions provided by this layer:
-
-  // The standard introspection functions.
-  HANDLE(vkEnumerateInstanceLayerProperties)
-  HANDLE(vkEnumerateDeviceLayerProperties)
-  HANDLE(vkEnumerateInstanceExtensionProperties)
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-
-  // Standard functions that most layers must implement:
-  HANDLE(vkCreateInstance)
-  HANDLE(vkCreateDevice)
-  HANDLE(vkGetInstanceProcAddr)  // Self-reference.
-  HANDLE(vkGetDeviceProcAddr)
-
-  // Other instance functions that this layer intercepts: (none)
-
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kInstanceFunctionTable.size()>
+      kInstanceFunctions = {GF_LAYERS_AMBER_SCOOP_INSTANCE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  PFN_vkVoidFunction result =
+      kInstanceFunctionTable.Lookup(pName, kInstanceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
   // We could move this up, as instance must be non-null in all but a few cases.
   // But it is not the job of this layer to detect invalid calls, so we can just
   // leave this check until the last possible moment.
@@ -1023,6 +1022,86 @@ vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
 }
 
 }  // namespace
+
+//
+// The hooks called by VkLayer_GF_fused; see fused_hooks.h.
+//
+
+DeviceData* GetHookDeviceData(VkDevice device) {
+  return GetDeviceData(DeviceKey(device));
+}
+
+void PreQueueSubmit(DeviceData* device_data, VkQueue queue,
+                    uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+  LayerCpuTimer layer_cpu_timer;
+
+  // Go through all tracked commands in all of the submitted command buffers.
+  // Every command buffer containing a draw call will be parsed to get the
+  // state of every resource required by a draw call. If the draw call is
+  // requested to be captured, an Amber file will be generated.
+
+  GlobalData* global_data = GetGlobalData();
+
+  // If the settings file changed, re-arm the capture: the draw calls are
+  // counted again from this submission.
+  if (global_data->settings.ReloadIfChanged()) {
+    global_data->current_draw_call.store(0, std::memory_order_relaxed);
+    LOG("Reloaded the settings; counting draw calls from now.");
+  }
+
+  // For each queue submit...
+  for (const VkSubmitInfo& submit_info :
+       absl::MakeConstSpan(pSubmits, submitCount)) {
+    // For each command buffer...
+    for (const VkCommandBuffer& command_buffer : absl::MakeConstSpan(
+             submit_info.pCommandBuffers, submit_info.commandBufferCount)) {
+      CommandBufferData* command_buffer_data =
+          device_data->command_buffers_data.Get(command_buffer);
+
+      // All of the command buffers should be tracked.
+      DEBUG_ASSERT(command_buffer_data != nullptr);
+
+      // Skip all command buffers that don't contain any draw calls.
+      if (!command_buffer_data->ContainsDrawCalls()) {
+        // Reset the command buffer data state because the command buffer has
+        // been submitted.
+        command_buffer_data->ResetState();
+        continue;
+      }
+
+      // Create a new draw call state tracker. Tracker stores the state of the
+      // command buffer being processed, i.e. what pipeline is bound, push
+      // constant values, bound vertex and index buffers, etc. This information
+      // is needed when a draw call needs to be processed to an Amber file.
+      DrawCallTracker draw_call_tracker(global_data, command_buffer, queue);
+
+      // Process all submitted commands. Most of the commands update the state
+      // of the draw call tracker and draw commands generate the Amber files.
+      for (const std::unique_ptr<Cmd>& cmd :
+           command_buffer_data->GetCommandList()) {
+        cmd->ProcessSubmittedCommand(&draw_call_tracker);
+      }
+
+      // Reset the command buffer data state because the command buffer has
+      // been submitted.
+      command_buffer_data->ResetState();
+    }
+  }
+}
+
+void PostCreateShaderModule(DeviceData* device_data,
+                            const VkShaderModuleCreateInfo* pCreateInfo,
+                            VkShaderModule shader_module) {
+  // Create a ShaderModuleData object to keep track of the shader module's
+  // lifetime. Pipelines may keep the data after the shader module is
+  // destroyed, so it is allocated with the device's callbacks rather than
+  // those passed to vkCreateShaderModule.
+  device_data->shader_modules_data.Put(
+      shader_module,
+      std::make_shared<ShaderModuleData>(
+          ObjectAllocator(&device_data->allocator), *pCreateInfo));
+}
+
 }  // namespace gf_layers::amber_scoop_layer
 
 //
@@ -1075,7 +1154,7 @@ VkLayer_GF_amber_scoopGetDeviceProcAddr(VkDevice device, const char* pName) {
   return gf_layers::amber_scoop_layer::vkGetDeviceProcAddr(device, pName);
 }
 
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) && !defined(GF_LAYERS_FUSED_LAYER)
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount,
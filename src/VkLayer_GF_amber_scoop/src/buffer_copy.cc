@@ -16,6 +16,7 @@
 
 #include "VkLayer_GF_amber_scoop/vulkan_util.h"
 #include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/trace.h"
 #include "gf_layers_layer_util/util.h"
 
 namespace gf_layers::amber_scoop_layer {
@@ -24,6 +25,9 @@ BufferCopy::BufferCopy(DeviceData* device_data, const VkBuffer& buffer,
                        VkDeviceSize buffer_size, VkQueue queue,
                        VkCommandPool command_pool)
     : device_data_(device_data) {
+  TraceSpan trace_span("BufferCopy");
+  trace_span.AddArg("size", buffer_size);
+
   VkDevice device = device_data_->device;
 
   // Create a buffer where the data will be copied to.
@@ -33,6 +33,7 @@ void CommandBufferData::AddCommand(std::unique_ptr<Cmd> cmd) {
 
 void CommandBufferData::ResetState() {
   command_list.clear();
+  command_allocator_.Reset();
   contains_draw_calls_ = false;
 }
 
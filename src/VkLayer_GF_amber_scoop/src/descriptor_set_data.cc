@@ -20,7 +20,10 @@
 // notice it, so we need to manually keep the includes.
 #include <cstdio>   // IWYU pragma: keep
 #include <cstdlib>  // IWYU pragma: keep
+#include <memory>
 
+#include "VkLayer_GF_amber_scoop/create_info_wrapper.h"
+#include "gf_layers_layer_util/allocator.h"
 #include "gf_layers_layer_util/logging.h"
 
 namespace gf_layers::amber_scoop_layer {
@@ -68,9 +71,18 @@ DescriptorSetData::FlattenedDescriptorType GetFlattenedDescriptorType(
 }
 }  // namespace
 
-DescriptorSetData::DescriptorSetData(const DescriptorSetLayoutData* layout_data)
+DescriptorSetData::DescriptorSetData(
+    LayerAllocator* allocator, const DescriptorSetLayoutData* layout_data)
     : descriptor_set_layout_data_(std::make_unique<DescriptorSetLayoutData>(
-          layout_data->GetCreateInfo())) {
+          ObjectAllocator(allocator), layout_data->GetCreateInfo())),
+      descriptor_buffer_bindings_(
+          StlAllocator<BindingMap<VkDescriptorBufferInfo>::value_type>(
+              allocator)),
+      image_and_sampler_bindings_(
+          StlAllocator<BindingMap<VkDescriptorImageInfo>::value_type>(
+              allocator)),
+      texel_buffer_view_bindings_(
+          StlAllocator<BindingMap<VkBufferView>::value_type>(allocator)) {
   const VkDescriptorSetLayoutCreateInfo& create_info =
       layout_data->GetCreateInfo();
 
@@ -85,8 +97,11 @@ DescriptorSetData::DescriptorSetData(const DescriptorSetLayoutData* layout_data)
         DEBUG_ASSERT_MSG(false, "Images and samplers are not implemented.");
         break;
       case BUFFER: {
-        descriptor_buffer_bindings_[binding_number] =
-            std::vector<VkDescriptorBufferInfo>(binding.descriptorCount);
+        descriptor_buffer_bindings_.emplace(
+            binding_number,
+            LayerVector<VkDescriptorBufferInfo>(
+                binding.descriptorCount,
+                StlAllocator<VkDescriptorBufferInfo>(allocator)));
         break;
       }
       case TEXEL_BUFFER:
@@ -149,7 +164,7 @@ void DescriptorSetData::WriteDescriptorSet(
                   descriptor_set_layout_data_->GetCreateInfo().bindingCount,
               "Descriptor set binding overflow.");
         }
-        descriptor_buffer_bindings_[binding_idx][array_element] =
+        descriptor_buffer_bindings_.at(binding_idx)[array_element] =
             // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
             write_descriptor_set.pBufferInfo[descriptor_read_idx];
         // Jump to the next array element.
@@ -18,11 +18,11 @@
 
 #include <algorithm>
 #include <atomic>
-#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "VkLayer_GF_amber_scoop/amber_scoop_layer.h"
 #include "VkLayer_GF_amber_scoop/buffer_copy.h"
@@ -32,95 +32,94 @@
 #include "VkLayer_GF_amber_scoop/graphics_pipeline_data.h"
 #include "VkLayer_GF_amber_scoop/vulkan_formats.h"
 #include "absl/types/span.h"
+#include "gf_layers_layer_util/allocator.h"
+#include "gf_layers_layer_util/file_writer.h"
+#include "gf_layers_layer_util/live_stats.h"
 #include "gf_layers_layer_util/logging.h"
-#include "gf_layers_layer_util/spirv.h"
+#include "gf_layers_layer_util/spirv_tools.h"
+#include "gf_layers_layer_util/thread_pool.h"
+#include "gf_layers_layer_util/trace.h"
 #include "gf_layers_layer_util/util.h"
 
-#pragma warning(push, 1)  // MSVC: reduces warning level to W1.
-
-#include "spirv-tools/libspirv.h"
-#include "spirv-tools/libspirv.hpp"
-
-#pragma warning(pop)
-
 namespace gf_layers::amber_scoop_layer {
 
 namespace {
 
-std::string DisassembleShaderModule(
+// Returns a copy of the SPIR-V words of a shader module.
+std::vector<uint32_t> CopyShaderModuleCode(
     const VkShaderModuleCreateInfo& create_info) {
-  // Get SPIR-V shader module version.
-
-  // Get a span containing the shader code. |create_info.codeSize| gives the
-  // size in bytes, so we convert it to words.
-  absl::Span<const uint32_t> code =
-      absl::MakeConstSpan(create_info.pCode, create_info.codeSize / 4);
-
-  uint32_t version_word = code[1];
-
-  uint8_t major_version = GetSpirvVersionMajorPart(version_word);
-  uint8_t minor_version = GetSpirvVersionMinorPart(version_word);
+  // |create_info.codeSize| gives the size in bytes, so we convert it to words.
+  return std::vector<uint32_t>(
+      create_info.pCode,
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      create_info.pCode + create_info.codeSize / 4);
+}
 
-  if (major_version != 1) {
-    LOG("Unknown SPIR-V major version %u", major_version);
-    RUNTIME_ASSERT(false);
-  }
+// Disassembles |code| into |disassembly|. Returns false on failure, e.g. if
+// the gf_layers_spirv_tools library could not be loaded.
+bool DisassembleShaderModule(const std::vector<uint32_t>& code,
+                             std::string* disassembly) {
+  // This loads the gf_layers_spirv_tools library on first use.
+  return DisassembleSpirv(code.data(), code.size(), disassembly);
+}
 
-  spv_target_env target_env;  // NOLINT(cppcoreguidelines-init-variables)
-  switch (minor_version) {
-    case 0:
-      target_env = SPV_ENV_UNIVERSAL_1_0;
-      break;
-    case 1:
-      target_env = SPV_ENV_UNIVERSAL_1_1;
-      break;
-    case 2:
-      target_env = SPV_ENV_UNIVERSAL_1_2;
-      break;
-    case 3:
-      target_env = SPV_ENV_UNIVERSAL_1_3;
-      break;
-    case 4:
-      target_env = SPV_ENV_UNIVERSAL_1_4;
-      break;
-      // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    case 5:
-      target_env = SPV_ENV_UNIVERSAL_1_5;
-      break;
-    default:
-      LOG("Unknown SPIR-V minor version %u", minor_version);
-      RUNTIME_ASSERT(false);
+// Everything needed to write the Amber file of a captured draw call, copied
+// from the tracked state so that the file can be written on the layer's
+// thread pool.
+struct AmberFileContents {
+  std::string file_name;
+  std::vector<uint32_t> vertex_shader_code;
+  std::vector<uint32_t> fragment_shader_code;
+  std::string buffer_declarations;
+  std::string pipeline;
+  std::string run_command;
+};
+
+void WriteAmberFile(const AmberFileContents& contents) {
+  TraceSpan trace_span("WriteAmberFile");
+
+  std::string vertex_shader;
+  std::string fragment_shader;
+  if (!DisassembleShaderModule(contents.vertex_shader_code, &vertex_shader) ||
+      !DisassembleShaderModule(contents.fragment_shader_code,
+                               &fragment_shader)) {
+    // Logged once, as it usually means that the gf_layers_spirv_tools library
+    // could not be loaded, so every capture will fail.
+    static std::atomic<bool> logged{false};
+    if (!logged.exchange(true, std::memory_order_relaxed)) {
+      LOG("Failed to disassemble the shader modules of a draw call; captured "
+          "draw calls whose shaders cannot be disassembled are not written.");
+    }
+    return;
   }
 
-  spvtools::SpirvTools tools(target_env);
-  if (!tools.IsValid()) {
-    LOG("Failed to instantiate SpirvTools object.");
-    RUNTIME_ASSERT(false);
-  }
+  std::ostringstream amber_file;
 
-  std::vector<uint32_t> binary(code.begin(), code.end());
+  // Add shader modules.
+  amber_file << "#!amber" << std::endl << std::endl;
+  amber_file << "SHADER vertex vertex_shader SPIRV-ASM" << std::endl;
+  amber_file << vertex_shader << std::endl;
+  amber_file << "END" << std::endl << std::endl;
+  amber_file << "SHADER fragment fragment_shader SPIRV-ASM" << std::endl;
+  amber_file << fragment_shader << std::endl;
+  amber_file << "END" << std::endl << std::endl;
 
-  std::string disassembly;
-  tools.Disassemble(binary, &disassembly, SPV_BINARY_TO_TEXT_OPTION_INDENT);
+  // Append string streams to the Amber file.
+  amber_file << contents.buffer_declarations;
+  amber_file << contents.pipeline;
+  amber_file << contents.run_command;
 
-  return disassembly;
+  WriteFileAsync(contents.file_name, WriteBuffer(amber_file.str()));
 }
 
-// Creates / opens the file |file_path| and writes the given data |data_span| to
-// it. Existing file will be overwritten. Asserts if the file can't be opened.
+// Queues writing a copy of |data_span| to the file |file_path|. Existing file
+// will be overwritten.
 void WriteDataToFile(const std::string& file_path,
                      const absl::Span<const char>& data_span) {
-  // |file_stream| is closed automatically in it's destructor.
-  std::ofstream file_stream;
-  file_stream.open(file_path,
-                   std::ios::out | std::ios::binary | std::ios::trunc);
-  // open() doesn't throw exception so we must check that the file is open.
-  RUNTIME_ASSERT_MSG(file_stream.is_open(), "Unable to open file: %s",
-                     file_path.c_str());
-
-  file_stream.write(data_span.data(),
-                    static_cast<std::streamsize>(data_span.size()));
-  file_stream.flush();
+  // The copy is made now, as the buffer copy is destroyed once the draw call
+  // is captured.
+  WriteFileAsync(file_path, WriteBuffer(std::vector<char>(data_span.begin(),
+                                                          data_span.end())));
 }
 
 // Returns a buffer/image type name used in Amber's BIND BUFFER/SAMPLER
@@ -162,7 +161,7 @@ const char* GetDescriptorTypeName(VkDescriptorType descriptor_type) {
 
 void DrawCallTracker::BindGraphicsDescriptorSet(
     uint32_t set_number, VkDescriptorSet descriptor_set,
-    const std::vector<uint32_t>& dynamic_offsets,
+    absl::Span<const uint32_t> dynamic_offsets,
     uint32_t* dynamic_offset_idx) {
   // Initialize the descriptor set state with an empty map of bindings.
   draw_call_state_.graphics_pipeline_descriptor_sets[set_number] = {};
@@ -190,7 +189,7 @@ void DrawCallTracker::BindGraphicsDescriptorSet(
   // in order. dynamicOffsetCount must equal the total number of dynamic
   // descriptors in the sets being bound.
   for (const std::pair<const BindingNumber,
-                       std::vector<VkDescriptorBufferInfo>>& binding :
+                       LayerVector<VkDescriptorBufferInfo>>& binding :
        *descriptor_set_data->GetDescriptorBufferBindings()) {
     uint32_t binding_number = binding.first;
     const VkDescriptorSetLayoutBinding& layout_binding =
@@ -225,13 +224,19 @@ void DrawCallTracker::HandleDrawCall(uint32_t first_index, uint32_t index_count,
   DEBUG_ASSERT(draw_call_state_.current_render_pass);
 
   const uint64_t current_draw_call = global_data_->current_draw_call++;
+  const AmberScoopLayerSettings& settings = global_data_->settings.Get();
 
   // Return if current draw call should not be captured.
-  if (current_draw_call < global_data_->settings.start_draw_call ||
-      current_draw_call > global_data_->settings.last_draw_call) {
+  if (current_draw_call < settings.start_draw_call ||
+      current_draw_call - settings.start_draw_call >
+          settings.draw_call_count) {
     return;
   }
 
+  TraceSpan trace_span("CaptureDrawCall");
+  trace_span.AddArg("draw_call", current_draw_call);
+  AddLiveStat(LiveStatsValue::kCapturedDrawCalls, 1);
+
   DeviceData* device_data =
       global_data_->device_map.Get(DeviceKey(draw_call_state_.queue))->get();
 
@@ -294,53 +299,41 @@ void DrawCallTracker::HandleDrawCall(uint32_t first_index, uint32_t index_count,
   // End pipeline
   pipeline_str << "END" << std::endl << std::endl;
 
-  std::string amber_file_name = global_data_->settings.output_file_prefix +
-                                "_" + std::to_string(current_draw_call) +
-                                ".amber";
-
-  // Start generating the Amber file.
-  std::ofstream amber_file;
-  amber_file.open(amber_file_name, std::ios::trunc | std::ios::out);
-
-  // Add shader modules.
-  amber_file << "#!amber" << std::endl << std::endl;
-  amber_file << "SHADER vertex vertex_shader SPIRV-ASM" << std::endl;
-  amber_file << DisassembleShaderModule(
-                    graphics_pipeline_data
-                        ->GetShaderModuleData(vertex_shader->module)
-                        ->GetCreateInfo())
-             << std::endl;
-  amber_file << "END" << std::endl << std::endl;
-  amber_file << "SHADER fragment fragment_shader SPIRV-ASM" << std::endl;
-  amber_file << DisassembleShaderModule(
-                    graphics_pipeline_data
-                        ->GetShaderModuleData(fragment_shader->module)
-                        ->GetCreateInfo())
-             << std::endl;
-  amber_file << "END" << std::endl << std::endl;
-
-  // Append string streams to the Amber file.
-  amber_file << buffer_declaration_str.str();
-  amber_file << pipeline_str.str();
-
   // TODO(ilkkasaa): get primitive topology from VkGraphicsPipelineCreateInfo
   const std::string topology = "TRIANGLE_LIST";
 
   // Add run commands.
+  std::ostringstream run_str;
   if (index_count > 0) {
-    amber_file << "RUN pipeline DRAW_ARRAY AS " << topology
-               << " INDEXED START_IDX " << first_index << " COUNT "
-               << index_count;
+    run_str << "RUN pipeline DRAW_ARRAY AS " << topology
+            << " INDEXED START_IDX " << first_index << " COUNT " << index_count;
   } else {
-    amber_file << "RUN pipeline DRAW_ARRAY AS " << topology;
+    run_str << "RUN pipeline DRAW_ARRAY AS " << topology;
   }
   if (instance_count > 0) {
-    amber_file << " START_INSTANCE " << first_instance << " INSTANCE_COUNT "
-               << instance_count;
+    run_str << " START_INSTANCE " << first_instance << " INSTANCE_COUNT "
+            << instance_count;
   }
-  amber_file << std::endl;
-
-  amber_file.close();
+  run_str << std::endl;
+
+  // The buffers have been read back, so the rest (disassembling the shaders
+  // and writing the Amber file) does not need the device and can be done on
+  // the thread pool; the shader modules may be destroyed in the meantime, so
+  // their code is copied.
+  AmberFileContents contents;
+  contents.file_name = settings.output_file_prefix + "_" +
+                       std::to_string(current_draw_call) + ".amber";
+  contents.vertex_shader_code = CopyShaderModuleCode(
+      graphics_pipeline_data->GetShaderModuleData(vertex_shader->module)
+          ->GetCreateInfo());
+  contents.fragment_shader_code = CopyShaderModuleCode(
+      graphics_pipeline_data->GetShaderModuleData(fragment_shader->module)
+          ->GetCreateInfo());
+  contents.buffer_declarations = buffer_declaration_str.str();
+  contents.pipeline = pipeline_str.str();
+  contents.run_command = run_str.str();
+  GetLayerThreadPool()->Submit(
+      [contents = std::move(contents)]() { WriteAmberFile(contents); });
 }
 
 void DrawCallTracker::CreateDescriptorSetDeclarations(
@@ -364,7 +357,7 @@ void DrawCallTracker::CreateDescriptorSetDeclarations(
     // Loop through all uniform / storage buffer descriptors within the set.
     // Copy the buffers used by the descriptors and store the contents to files.
     for (const std::pair<const DescriptorSetData::BindingNumber,
-                         std::vector<VkDescriptorBufferInfo>>& buffer_binding :
+                         LayerVector<VkDescriptorBufferInfo>>& buffer_binding :
          *descriptor_set_data->GetDescriptorBufferBindings()) {
       std::stringstream descriptor_range_string;
       std::stringstream descriptor_offset_string;
@@ -433,7 +426,7 @@ void DrawCallTracker::CreateDescriptorSetDeclarations(
 
           // Generate the file name.
           std::string buffer_file_name =
-              global_data_->settings.output_file_prefix;
+              global_data_->settings.Get().output_file_prefix;
           buffer_file_name.append("_").append(buffer_name).append(".bin");
 
           // Copy the buffer to a host visible memory.
@@ -624,7 +617,8 @@ void DrawCallTracker::CreateVertexBufferDeclarations(
       buffer_name.append(std::to_string(buffer_order));
 
       // Generate the file name.
-      std::string buffer_file_name = global_data_->settings.output_file_prefix;
+      std::string buffer_file_name =
+          global_data_->settings.Get().output_file_prefix;
       buffer_file_name.append("_").append(buffer_name).append(".bin");
 
       // Copy the buffer to a host visible memory.
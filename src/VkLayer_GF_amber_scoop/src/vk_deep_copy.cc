@@ -14,25 +14,29 @@
 
 #include "VkLayer_GF_amber_scoop/vk_deep_copy.h"
 
-#include <cstring>
+#include <cstdint>
+
+#include "gf_layers_layer_util/allocator.h"
 
 namespace gf_layers::amber_scoop_layer {
 
-VkBufferCreateInfo DeepCopy(const VkBufferCreateInfo& create_info) {
+VkBufferCreateInfo DeepCopy(const ObjectAllocator& allocator,
+                            const VkBufferCreateInfo& create_info) {
   VkBufferCreateInfo result = create_info;
-  result.pQueueFamilyIndices = CopyArray(create_info.pQueueFamilyIndices,
-                                         create_info.queueFamilyIndexCount);
+  result.pQueueFamilyIndices =
+      CopyArray(allocator, create_info.pQueueFamilyIndices,
+                create_info.queueFamilyIndexCount);
   return result;
 }
 
-void DeepDelete(const VkBufferCreateInfo& create_info) {
-  if (create_info.queueFamilyIndexCount > 0) {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete[] create_info.pQueueFamilyIndices;
-  }
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkBufferCreateInfo& create_info) {
+  allocator.DeleteArray(create_info.pQueueFamilyIndices,
+                        create_info.queueFamilyIndexCount);
 }
 
 VkDescriptorSetLayoutBinding DeepCopy(
+    const ObjectAllocator& allocator,
     const VkDescriptorSetLayoutBinding& descriptor_set_layout_binding) {
   VkDescriptorSetLayoutBinding result = descriptor_set_layout_binding;
 
@@ -42,74 +46,73 @@ VkDescriptorSetLayoutBinding DeepCopy(
 
   // Copy immutable sampler handles.
   result.pImmutableSamplers =
-      CopyArray(descriptor_set_layout_binding.pImmutableSamplers,
+      CopyArray(allocator, descriptor_set_layout_binding.pImmutableSamplers,
                 descriptor_set_layout_binding.descriptorCount);
 
   return result;
 }
 
-void DeepDelete(const VkDescriptorSetLayoutBinding& binding) {
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkDescriptorSetLayoutBinding& binding) {
   // Delete immutable sampler handles.
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] binding.pImmutableSamplers;
+  allocator.DeleteArray(binding.pImmutableSamplers, binding.descriptorCount);
 }
 
 VkDescriptorSetLayoutCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkDescriptorSetLayoutCreateInfo& create_info) {
   VkDescriptorSetLayoutCreateInfo result = create_info;
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  VkDescriptorSetLayoutBinding* bindings =
-      create_info.bindingCount > 0
-          ? new VkDescriptorSetLayoutBinding[create_info.bindingCount]
-          : nullptr;
+  auto* bindings = allocator.NewArray<VkDescriptorSetLayoutBinding>(
+      create_info.bindingCount);
 
   for (uint32_t i = 0; i < create_info.bindingCount; i++) {
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    bindings[i] = DeepCopy(create_info.pBindings[i]);
+    bindings[i] = DeepCopy(allocator, create_info.pBindings[i]);
   }
   result.pBindings = bindings;
   return result;
 }
 
-void DeepDelete(const VkDescriptorSetLayoutCreateInfo& create_info) {
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkDescriptorSetLayoutCreateInfo& create_info) {
   for (uint32_t i = 0; i < create_info.bindingCount; i++) {
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    DeepDelete(create_info.pBindings[i]);
+    DeepDelete(allocator, create_info.pBindings[i]);
   }
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] create_info.pBindings;
+  allocator.DeleteArray(create_info.pBindings, create_info.bindingCount);
 }
 
 VkGraphicsPipelineCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkGraphicsPipelineCreateInfo& create_info) {
   VkGraphicsPipelineCreateInfo result = create_info;
   // Copy pStages
   {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* new_stages =
-        new VkPipelineShaderStageCreateInfo[create_info.stageCount];
+    auto* new_stages = allocator.NewArray<VkPipelineShaderStageCreateInfo>(
+        create_info.stageCount);
 
     for (uint32_t i = 0; i < create_info.stageCount; i++) {
       // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-      new_stages[i] = DeepCopy(create_info.pStages[i]);
+      new_stages[i] = DeepCopy(allocator, create_info.pStages[i]);
     }
     result.pStages = new_stages;
   }
 
   // Copy pVertexInputState
   {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* vertex_input_state = new VkPipelineVertexInputStateCreateInfo();
+    auto* vertex_input_state =
+        allocator.NewArray<VkPipelineVertexInputStateCreateInfo>(1);
     *vertex_input_state = *create_info.pVertexInputState;
     // Copy pVertexBindingDescriptions
     {
-      vertex_input_state->pVertexBindingDescriptions =
-          CopyArray(create_info.pVertexInputState->pVertexBindingDescriptions,
-                    vertex_input_state->vertexBindingDescriptionCount);
+      vertex_input_state->pVertexBindingDescriptions = CopyArray(
+          allocator, create_info.pVertexInputState->pVertexBindingDescriptions,
+          vertex_input_state->vertexBindingDescriptionCount);
     }
     // Copy pVertexAttributeDescriptions
     {
       vertex_input_state->pVertexAttributeDescriptions = CopyArray(
+          allocator,
           create_info.pVertexInputState->pVertexAttributeDescriptions,
           create_info.pVertexInputState->vertexAttributeDescriptionCount);
     }
@@ -118,90 +121,82 @@ VkGraphicsPipelineCreateInfo DeepCopy(
 
   // Copy pInputAssemblyState
   {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* input_assembly_create_info =
-        new VkPipelineInputAssemblyStateCreateInfo();
-    *input_assembly_create_info = *create_info.pInputAssemblyState;
-    result.pInputAssemblyState = input_assembly_create_info;
+    result.pInputAssemblyState =
+        CopyArray(allocator, create_info.pInputAssemblyState, 1);
   }
 
   // Copy pRasterizationState
   {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* rasterization_state_create_info =
-        new VkPipelineRasterizationStateCreateInfo();
-    *rasterization_state_create_info = *create_info.pRasterizationState;
-    result.pRasterizationState = rasterization_state_create_info;
+    result.pRasterizationState =
+        CopyArray(allocator, create_info.pRasterizationState, 1);
   }
 
   // Copy pDepthStencilState
   if (create_info.pDepthStencilState != nullptr) {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* depth_stencil_state_create_info =
-        new VkPipelineDepthStencilStateCreateInfo();
-    *depth_stencil_state_create_info = *create_info.pDepthStencilState;
-    result.pDepthStencilState = depth_stencil_state_create_info;
+    result.pDepthStencilState =
+        CopyArray(allocator, create_info.pDepthStencilState, 1);
   }
 
   // TODO(ilkkasaa): handle deep copying of other fields.
   return result;
 }
 
-void DeepDelete(const VkGraphicsPipelineCreateInfo& create_info) {
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkGraphicsPipelineCreateInfo& create_info) {
   for (uint32_t i = 0; i < create_info.stageCount; i++) {
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    DeepDelete(create_info.pStages[i]);
+    DeepDelete(allocator, create_info.pStages[i]);
   }
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] create_info.pStages;
+  allocator.DeleteArray(create_info.pStages, create_info.stageCount);
 
   if (create_info.pVertexInputState != nullptr) {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete[] create_info.pVertexInputState->pVertexBindingDescriptions;
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete[] create_info.pVertexInputState->pVertexAttributeDescriptions;
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete create_info.pVertexInputState;
+    allocator.DeleteArray(
+        create_info.pVertexInputState->pVertexBindingDescriptions,
+        create_info.pVertexInputState->vertexBindingDescriptionCount);
+    allocator.DeleteArray(
+        create_info.pVertexInputState->pVertexAttributeDescriptions,
+        create_info.pVertexInputState->vertexAttributeDescriptionCount);
+    allocator.DeleteArray(create_info.pVertexInputState, 1);
   }
 
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete create_info.pInputAssemblyState;
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete create_info.pRasterizationState;
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete create_info.pDepthStencilState;
+  allocator.DeleteArray(create_info.pInputAssemblyState, 1);
+  allocator.DeleteArray(create_info.pRasterizationState, 1);
+  allocator.DeleteArray(create_info.pDepthStencilState, 1);
 }
 
 VkPipelineLayoutCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkPipelineLayoutCreateInfo& create_info) {
   VkPipelineLayoutCreateInfo result = create_info;
   result.pSetLayouts =
-      CopyArray(create_info.pSetLayouts, create_info.setLayoutCount);
-  result.pPushConstantRanges = CopyArray(create_info.pPushConstantRanges,
-                                         create_info.pushConstantRangeCount);
+      CopyArray(allocator, create_info.pSetLayouts, create_info.setLayoutCount);
+  result.pPushConstantRanges =
+      CopyArray(allocator, create_info.pPushConstantRanges,
+                create_info.pushConstantRangeCount);
   return result;
 }
 
-void DeepDelete(const VkPipelineLayoutCreateInfo& create_info) {
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] create_info.pSetLayouts;
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] create_info.pPushConstantRanges;
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkPipelineLayoutCreateInfo& create_info) {
+  allocator.DeleteArray(create_info.pSetLayouts, create_info.setLayoutCount);
+  allocator.DeleteArray(create_info.pPushConstantRanges,
+                        create_info.pushConstantRangeCount);
 }
 
 VkPipelineShaderStageCreateInfo DeepCopy(
+    const ObjectAllocator& allocator,
     const VkPipelineShaderStageCreateInfo& create_info) {
   VkPipelineShaderStageCreateInfo result = create_info;
 
   // Deep copy fields from specialization info struct.
   if (create_info.pSpecializationInfo != nullptr) {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    auto* specialization_info = new VkSpecializationInfo();
-    *specialization_info = *create_info.pSpecializationInfo;
+    auto* specialization_info =
+        CopyArray(allocator, create_info.pSpecializationInfo, 1);
     specialization_info->pMapEntries =
-        CopyArray(create_info.pSpecializationInfo->pMapEntries,
+        CopyArray(allocator, create_info.pSpecializationInfo->pMapEntries,
                   create_info.pSpecializationInfo->mapEntryCount);
     specialization_info->pData = CopyArray(
+        allocator,
         static_cast<const char*>(create_info.pSpecializationInfo->pData),
         create_info.pSpecializationInfo->dataSize);
     result.pSpecializationInfo = specialization_info;
@@ -209,42 +204,31 @@ VkPipelineShaderStageCreateInfo DeepCopy(
   return result;
 }
 
-void DeepDelete(const VkPipelineShaderStageCreateInfo& create_info) {
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkPipelineShaderStageCreateInfo& create_info) {
   if (create_info.pSpecializationInfo != nullptr) {
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete[] create_info.pSpecializationInfo->pMapEntries;
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete[] static_cast<const char*>(create_info.pSpecializationInfo->pData);
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    delete create_info.pSpecializationInfo;
+    allocator.DeleteArray(create_info.pSpecializationInfo->pMapEntries,
+                          create_info.pSpecializationInfo->mapEntryCount);
+    allocator.DeleteArray(
+        static_cast<const char*>(create_info.pSpecializationInfo->pData),
+        create_info.pSpecializationInfo->dataSize);
+    allocator.DeleteArray(create_info.pSpecializationInfo, 1);
   }
 }
 
-VkRenderPassBeginInfo DeepCopy(
-    VkRenderPassBeginInfo const* p_render_pass_begin_info) {
-  VkRenderPassBeginInfo result = *p_render_pass_begin_info;
-  result.pClearValues = CopyArray(p_render_pass_begin_info->pClearValues,
-                                  p_render_pass_begin_info->clearValueCount);
-  return result;
-}
-
-void DeepDelete(VkRenderPassBeginInfo const* p_render_pass_begin_info) {
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] p_render_pass_begin_info->pClearValues;
-}
-
-VkShaderModuleCreateInfo DeepCopy(const VkShaderModuleCreateInfo& create_info) {
+VkShaderModuleCreateInfo DeepCopy(const ObjectAllocator& allocator,
+                                  const VkShaderModuleCreateInfo& create_info) {
   VkShaderModuleCreateInfo result = create_info;
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  auto* new_code = new uint32_t[create_info.codeSize];
-  memcpy(new_code, create_info.pCode, create_info.codeSize);
-  result.pCode = new_code;
+  // |codeSize| is in bytes, and is a multiple of 4.
+  result.pCode = CopyArray(allocator, create_info.pCode,
+                           create_info.codeSize / sizeof(uint32_t));
   return result;
 }
 
-void DeepDelete(const VkShaderModuleCreateInfo& create_info) {
-  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-  delete[] create_info.pCode;
+void DeepDelete(const ObjectAllocator& allocator,
+                const VkShaderModuleCreateInfo& create_info) {
+  allocator.DeleteArray(create_info.pCode,
+                        create_info.codeSize / sizeof(uint32_t));
 }
 
 }  // namespace gf_layers::amber_scoop_layer
@@ -0,0 +1,60 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VKLAYER_GF_FRAME_COUNTER_FUSED_HOOKS_H
+#define VKLAYER_GF_FRAME_COUNTER_FUSED_HOOKS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// The hooks of the functions that this layer intercepts along with other
+// layers hosted by VkLayer_GF_fused. The fused layer looks up the device once
+// per call of these functions and calls the hooks of each enabled sub-layer
+// around a single call of the next layer's function; see fused_layer.cc. Our
+// own entry points call the same hooks.
+
+namespace gf_layers::frame_counter_layer {
+
+struct DeviceData;
+
+// Returns our data for |device|, to pass to the hooks below, or nullptr if we
+// do not intercept vkQueueSubmit for |device|.
+DeviceData* GetQueueSubmitHookDeviceData(VkDevice device);
+
+// Passed from |PreQueueSubmit| to |PostQueueSubmit|.
+struct QueueSubmitHookState {
+  uint64_t start_ns = 0;
+  // Set if the submits begin a frame whose GPU time is measured.
+  bool begins_frame = false;
+  // The submits, with the command buffers that write the frame's timestamps.
+  std::vector<VkSubmitInfo> submits;
+  std::vector<VkCommandBuffer> first_command_buffers;
+};
+
+// Called before the next layer's vkQueueSubmit. If the submits write GPU
+// timestamps, |*submitCount| and |*pSubmits| are replaced by the submits in
+// |state|.
+void PreQueueSubmit(DeviceData* device_data, VkQueue queue,
+                    uint32_t* submitCount, const VkSubmitInfo** pSubmits,
+                    QueueSubmitHookState* state);
+
+// Called after the next layer's vkQueueSubmit returned |result|.
+void PostQueueSubmit(DeviceData* device_data, VkQueue queue, VkResult result,
+                     QueueSubmitHookState* state);
+
+}  // namespace gf_layers::frame_counter_layer
+
+#endif  // VKLAYER_GF_FRAME_COUNTER_FUSED_HOOKS_H
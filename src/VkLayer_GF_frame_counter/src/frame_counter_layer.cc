@@ -15,48 +15,65 @@
 #include <vulkan/vk_layer.h>
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
-#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <ostream>
 #include <sstream>
 #include <string>
-
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "VkLayer_GF_frame_counter/dispatch.h"
+#include "VkLayer_GF_frame_counter/fused_hooks.h"
+#include "gf_layers_layer_util/clock.h"
+#include "gf_layers_layer_util/file_writer.h"
+#include "gf_layers_layer_util/frame_time_histogram.h"
+#include "gf_layers_layer_util/instrumentation.h"
+#include "gf_layers_layer_util/live_stats.h"
 #include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/proc_table.h"
 #include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/thread_pool.h"
 #include "gf_layers_layer_util/util.h"
 
 namespace gf_layers::frame_counter_layer {
 
-struct InstanceData {
-  VkInstance instance;
-
-  // Most layers must store this. Required to implement vkGetInstanceProcAddr.
-  // Should not be used otherwise; all required instance function pointers
-  // should be obtained during vkCreateInstance.
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
-
-  // Most layers must store this. Required to implement
-  // vkEnumerateDeviceExtensionProperties.
-  PFN_vkEnumerateDeviceExtensionProperties vkEnumerateDeviceExtensionProperties;
-
-  // Other instance functions: (none)
+// The instance function pointers are in InstanceDispatchTable, which is
+// generated from vulkan_functions.txt.
+struct InstanceData : InstanceDispatchTable {
+  VkInstance instance = VK_NULL_HANDLE;
 };
 
-struct DeviceData {
-  VkDevice device;
-  InstanceData* instance_data;
+// The total time that the application's threads have blocked in
+// vkWaitForFences and vkQueueWaitIdle, and spent in vkQueueSubmit, for a
+// device. Each swapchain of the device attributes the increase since its last
+// present to its frame.
+struct DeviceWaitTotals {
+  std::atomic<uint64_t> gpu_wait_ns{};
+  std::atomic<uint64_t> submit_ns{};
+};
 
-  // Most layers must store this. Required to implement vkGetDeviceProcAddr.
-  // Should not be used otherwise; all required device function pointers
-  // should be obtained during vkCreateDevice.
-  PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
+// The device function pointers are in DeviceDispatchTable, which is generated
+// from vulkan_functions.txt.
+struct DeviceData : DeviceDispatchTable {
+  VkDevice device = VK_NULL_HANDLE;
+  InstanceData* instance_data = nullptr;
 
-  // Other device functions:
+  // Shared with the device's swapchains, which may outlive the device. Null if
+  // the waits are not intercepted for this device; see
+  // |GetNeededDeviceFunctions|.
+  std::shared_ptr<DeviceWaitTotals> wait_totals;
 
-  PFN_vkQueuePresentKHR vkQueuePresentKHR;
+  // The functions provided by this layer that we intercept for this device;
+  // decided in vkCreateDevice based on the settings.
+  ProcSet needed_device_functions;
 };
 
 using InstanceMap = gf_layers::ProtectedTinyStaleMap<void*, InstanceData>;
@@ -64,28 +81,217 @@ using DeviceMap = gf_layers::ProtectedTinyStaleMap<void*, DeviceData>;
 
 namespace {
 
-// Read-only once initialized.
+// A snapshot of the settings; see |GlobalData::settings|.
 struct FrameCounterLayerSettings {
-  bool init = false;
   uint64_t start_frame = 0;
   uint64_t end_frame = 0;
   std::string output_file;
+  // If not 0, the frame times are also reported for each window of this many
+  // milliseconds.
+  uint64_t report_interval_ms = 0;
+  // If not 0, the frames are also timed on the GPU via timestamp queries, on
+  // the devices created while this is set.
+  uint64_t gpu_timestamps = 0;
 };
 
-struct GlobalData {
-  InstanceMap instance_map;
-  DeviceMap device_map;
+// The number of queues whose presents are counted for each swapchain.
+constexpr std::size_t kMaxPresentQueues = 8;
+
+// The presents of a swapchain on a queue.
+struct QueuePresents {
+  // Set (from null) when the queue first presents the swapchain.
+  std::atomic<VkQueue> queue{};
+  std::atomic<uint64_t> count{};
+};
+
+// What a frame was bound by: the application's work on the CPU (including
+// vkQueueSubmit), waiting for the GPU (in vkWaitForFences and vkQueueWaitIdle)
+// or waiting for the presentation engine (in vkAcquireNextImageKHR and
+// vkQueuePresentKHR).
+enum class FrameBound : uint32_t {
+  kCpu = 0,
+  kGpu = 1,
+  kPresent = 2,
+};
+
+constexpr std::size_t kFrameBoundCount = 3;
+
+constexpr std::array<const char*, kFrameBoundCount> kFrameBoundNames = {
+    "CPU", "GPU", "Present"};
+
+// The time of a frame spent on each |FrameBound|.
+struct FrameBreakdown {
+  std::array<uint64_t, kFrameBoundCount> time_ns{};
+  // The part of the CPU time spent in vkQueueSubmit.
+  uint64_t submit_ns = 0;
+};
+
+// The frame statistics of a swapchain. A swapchain that is created to replace
+// another (e.g. when the window is resized) shares the statistics of the old
+// swapchain, so that they are counted as one.
+struct SwapchainStats {
+  // The number of the swapchain in the output, in order of creation.
+  uint64_t index = 0;
+
   std::atomic<uint64_t> frame_counter{};
 
+  // The |ClockNowNs| time of the start frame, or 0 if it has not been reached.
   gf_layers::MutexType start_time_mutex;
-  std::chrono::steady_clock::time_point start_time;
+  uint64_t start_time_ns = 0;
+
+  // The |ClockNowNs| time of the last present.
+  std::atomic<uint64_t> last_present_time_ns{};
+
+  // The present-to-present times of the frames after the start frame, up to
+  // and including the end frame. Cleared at the start frame.
+  FrameTimeHistogram frame_times;
+
+  // The presents of the measured frames on each queue. If more queues
+  // present the swapchain, their presents are not counted by queue.
+  std::array<QueuePresents, kMaxPresentQueues> queue_presents;
+
+  // The frame times of the periodic reports' windows; see
+  // |GlobalData::current_window|.
+  std::array<FrameTimeHistogram, 2> window_frame_times;
+
+  // The time blocked in vkAcquireNextImageKHR for the swapchain since its last
+  // present.
+  std::atomic<uint64_t> acquire_wait_ns{};
+  // The wait totals of the device that created the swapchain (or null, in
+  // which case its frames are not classified), and their values at the last
+  // present.
+  std::shared_ptr<DeviceWaitTotals> device_wait_totals;
+  std::atomic<uint64_t> last_gpu_wait_ns{};
+  std::atomic<uint64_t> last_submit_ns{};
+
+  // The number of measured frames bound by each |FrameBound|, and the total
+  // time of the measured frames spent on each.
+  std::array<std::atomic<uint64_t>, kFrameBoundCount> bound_frames{};
+  std::array<std::atomic<uint64_t>, kFrameBoundCount> bound_time_ns{};
+  std::atomic<uint64_t> submit_ns{};
+
+  // The number of frames bound by each |FrameBound| in the periodic reports'
+  // windows.
+  std::array<std::array<std::atomic<uint64_t>, kFrameBoundCount>, 2>
+      window_bound_frames{};
+
+  // The GPU times of the measured frames whose timestamps have been read; see
+  // |GpuTimestamps|. Cleared at the start frame.
+  FrameTimeHistogram gpu_frame_times;
+};
 
-  // In vkCreateInstance, we initialize |settings| by reading environment
-  // variables while holding |settings_mutex|, after which |settings| is
-  // read-only. Thus, in instance or device functions (such as
-  // vkQueuePresentKHR) we can read |settings| without holding |settings_mutex|.
+struct SwapchainData {
+  std::shared_ptr<SwapchainStats> stats;
+};
+
+using SwapchainMap = ProtectedReadMostlyMap<VkSwapchainKHR, SwapchainData>;
+
+// The number of frames of a device whose GPU timestamps can be pending.
+constexpr uint32_t kGpuTimestampFrames = 8;
+
+// The timestamp queries of the frames that use the slot with index |i| are
+// 2 * i, written before the frame's first command buffer, and 2 * i + 1,
+// written after its last; each has a command buffer that resets and writes it.
+// A slot is only reused once its fence has signaled and its timestamps have
+// been read, so the resets never race with the reads.
+struct GpuTimestampSlot {
+  VkCommandBuffer begin_command_buffer = VK_NULL_HANDLE;
+  VkCommandBuffer end_command_buffer = VK_NULL_HANDLE;
+  // Set when the frame is presented, until its timestamps are read.
+  bool pending = false;
+  // The queue of the frame's timed submits, and a fence that is submitted to
+  // it after the frame is presented, so that it signals once the frame's
+  // submits have finished and its timestamps are final. The fence can only be
+  // submitted while the application is calling a function on the queue (as
+  // it must be externally synchronized), i.e. at the frame's present if the
+  // frame is presented on the same queue, or else at the queue's next submit.
+  VkQueue queue = VK_NULL_HANDLE;
+  VkFence fence = VK_NULL_HANDLE;
+  bool fence_submitted = false;
+  // The statistics of the swapchain that presented the frame (if any), and
+  // the number of the frame in its count.
+  std::shared_ptr<SwapchainStats> stats;
+  uint64_t frame = 0;
+};
+
+// Times a device's frames on the GPU: the first submit of each frame to one of
+// |queues| starts with a command buffer that writes a timestamp, and each
+// submit of the frame to the same queue ends with one that writes another, so
+// that the last one is written after the frame's last submit. The timestamps
+// are read without waiting at later presents, once the frame's fence has
+// signaled.
+struct GpuTimestamps {
+  VkQueryPool query_pool = VK_NULL_HANDLE;
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  // The queues of the timed queue family; timestamps can only be compared
+  // within a queue.
+  std::vector<VkQueue> queues;
+  // The valid bits of the timestamps, and the nanoseconds per increment.
+  uint64_t timestamp_mask = 0;
+  double timestamp_period_ns = 0.0;
+
+  // Protects the following.
+  gf_layers::MutexType mutex;
+  std::array<GpuTimestampSlot, kGpuTimestampFrames> slots;
+  // The slot of the current frame, and the queue of its first timed submit
+  // (or null, before it).
+  uint32_t current_slot = 0;
+  VkQueue frame_queue = VK_NULL_HANDLE;
+  // The slot of the oldest frame whose timestamps have not been read.
+  uint32_t read_slot = 0;
+  // The number of pending slots whose fence has not been submitted.
+  uint32_t unsubmitted_fences = 0;
+};
+
+struct GpuTimestampsData {
+  std::unique_ptr<GpuTimestamps> timestamps;
+};
+
+using GpuTimestampsMap = ProtectedReadMostlyMap<void*, GpuTimestampsData>;
+
+struct GlobalData {
+  InstanceMap instance_map;
+  DeviceMap device_map;
+
+  // Looked up for each swapchain of each present, without locking.
+  SwapchainMap swapchain_map;
+  std::atomic<uint64_t> swapchain_count{};
+
+  // The GPU timestamps of the devices that have them, by device key. Looked
+  // up for each submit and present, without locking.
+  GpuTimestampsMap gpu_timestamps_map;
+
+  // The |ClockNowNs| time of the last present of any swapchain, for the live
+  // statistics.
+  std::atomic<uint64_t> last_present_time_ns{};
+
+  // Serializes the writes of the reports to the output file, so that the first
+  // one replaces the file and the others are appended; see
+  // |WriteOutputFileAsync|.
+  gf_layers::MutexType output_file_mutex;
+  bool output_file_written = false;
+
+  // The periodic reports: the frame times of the current window are recorded
+  // in each swapchain's |window_frame_times[current_window]|. When the window
+  // ends, a present switches to the other histograms and a thread pool task
+  // reports and clears the finished ones, so that the present thread does not
+  // format or write the report.
+  std::atomic<uint32_t> current_window{};
+  // The |ClockNowNs| time at which the current window started, or 0 before
+  // the first present.
+  std::atomic<uint64_t> window_start_ns{};
+  // The number of windows that have ended.
+  std::atomic<uint64_t> window_count{};
+  // Set from the end of a window until its report has cleared its histograms;
+  // meanwhile, the current window is extended.
+  std::atomic<bool> window_report_pending{};
+
+  // In vkCreateInstance, we register and load |settings| while holding
+  // |settings_mutex|. Afterwards, |settings| can be read (and reloaded in
+  // vkQueuePresentKHR) without holding |settings_mutex|.
   gf_layers::MutexType settings_mutex;
-  FrameCounterLayerSettings settings;
+  bool settings_init = false;
+  SettingsRegistry<FrameCounterLayerSettings> settings;
 };
 
 #pragma clang diagnostic push
@@ -115,99 +321,999 @@ bool IsThisLayer(const char* pLayerName) {
           strcmp(pLayerName, kLayerProperties[0].layerName) == 0);
 }
 
+//
+// The functions provided by this layer, used by our vkGet*ProcAddr functions.
+// The lists are generated from vulkan_functions.txt.
+//
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kDeviceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_FRAME_COUNTER_DEVICE_HOOKS(HANDLE)});
+constexpr auto kInstanceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_FRAME_COUNTER_INSTANCE_HOOKS(HANDLE)});
+#undef HANDLE
+
+static_assert(kDeviceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of device functions");
+static_assert(kInstanceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of instance functions");
+
 void InitSettingsIfNeeded() {
-  gf_layers::ScopedLock lock(GetGlobalData()->settings_mutex);
+  GlobalData* global_data = GetGlobalData();
+  gf_layers::ScopedLock lock(global_data->settings_mutex);
+
+  if (!global_data->settings_init) {
+    SettingsRegistry<FrameCounterLayerSettings>& settings =
+        global_data->settings;
+    settings.Add("VkLayer_GF_frame_counter_START_FRAME",
+                 "debug.gf.fc.start_frame",
+                 &FrameCounterLayerSettings::start_frame);
+    settings.Add("VkLayer_GF_frame_counter_END_FRAME", "debug.gf.fc.end_frame",
+                 &FrameCounterLayerSettings::end_frame);
+    settings.Add("VkLayer_GF_frame_counter_OUTPUT_FILE",
+                 "debug.gf.fc.output_file",
+                 &FrameCounterLayerSettings::output_file);
+    settings.Add("VkLayer_GF_frame_counter_REPORT_INTERVAL_MS",
+                 "debug.gf.fc.report_interval_ms",
+                 &FrameCounterLayerSettings::report_interval_ms);
+    settings.Add("VkLayer_GF_frame_counter_GPU_TIMESTAMPS",
+                 "debug.gf.fc.gpu_timestamps",
+                 &FrameCounterLayerSettings::gpu_timestamps);
+    settings.Load();
+    global_data->settings_init = true;
+  }
+}
+
+// Returns the device functions that we need to intercept, given our settings.
+// For the other device functions, our vkGetDeviceProcAddr returns the next
+// layer's functions.
+ProcSet GetNeededDeviceFunctions() {
+  const FrameCounterLayerSettings& settings = GetGlobalData()->settings.Get();
+  ProcSet result;
+  result.set(kDeviceFunctionTable.IndexOf("vkGetDeviceProcAddr"));
+  result.set(kDeviceFunctionTable.IndexOf("vkDestroyDevice"));
+  // If the start and end frame are the same and there are no periodic
+  // reports, then no frames are measured.
+  bool measure_frames =
+      settings.start_frame != settings.end_frame ||
+      settings.report_interval_ms != 0;
+  // The presents are still needed for the GPU timestamps and the live
+  // statistics, and to reload the settings (which may start measuring).
+  if (measure_frames || settings.gpu_timestamps != 0 || IsLiveStatsEnabled() ||
+      CanReloadSettings()) {
+    result.set(kDeviceFunctionTable.IndexOf("vkQueuePresentKHR"));
+    // The frames are counted per swapchain.
+    result.set(kDeviceFunctionTable.IndexOf("vkCreateSwapchainKHR"));
+    result.set(kDeviceFunctionTable.IndexOf("vkDestroySwapchainKHR"));
+  }
+  // The measured frames are classified by the time spent waiting in these.
+  // This is decided for the device's lifetime: if the settings are reloaded
+  // to start measuring, the frames of the swapchains of a device created
+  // while no frames were measured are counted and timed, but not classified.
+  if (measure_frames) {
+    result.set(kDeviceFunctionTable.IndexOf("vkAcquireNextImageKHR"));
+    result.set(kDeviceFunctionTable.IndexOf("vkQueueSubmit"));
+    result.set(kDeviceFunctionTable.IndexOf("vkQueueWaitIdle"));
+    result.set(kDeviceFunctionTable.IndexOf("vkWaitForFences"));
+  }
+  // The GPU timestamps are written by the submits.
+  if (settings.gpu_timestamps != 0) {
+    result.set(kDeviceFunctionTable.IndexOf("vkQueueSubmit"));
+  }
+  return result;
+}
+
+// Writes the frame time statistics of the measured frames to |stream|.
+void WriteFrameTimeStats(const FrameTimeStats& stats, std::ostream* stream) {
+  *stream << "Frame time min: " << stats.min_ns << "ns" << std::endl;
+  *stream << "Frame time max: " << stats.max_ns << "ns" << std::endl;
+  *stream << "Frame time mean: " << stats.mean_ns << "ns" << std::endl;
+  *stream << "Frame time p50: " << stats.p50_ns << "ns" << std::endl;
+  *stream << "Frame time p90: " << stats.p90_ns << "ns" << std::endl;
+  *stream << "Frame time p99: " << stats.p99_ns << "ns" << std::endl;
+  *stream << "Frame time p99.9: " << stats.p999_ns << "ns" << std::endl;
+  *stream << "1% low FPS: " << std::fixed << std::setprecision(2)
+          << stats.one_percent_low_fps << std::endl;
+}
+
+// Writes the GPU time statistics of the measured frames whose timestamps have
+// been read to |stream|.
+void WriteGpuFrameTimeStats(const FrameTimeStats& stats,
+                            std::ostream* stream) {
+  *stream << "GPU timed frames: " << stats.count << std::endl;
+  *stream << "GPU frame time min: " << stats.min_ns << "ns" << std::endl;
+  *stream << "GPU frame time max: " << stats.max_ns << "ns" << std::endl;
+  *stream << "GPU frame time mean: " << stats.mean_ns << "ns" << std::endl;
+  *stream << "GPU frame time p50: " << stats.p50_ns << "ns" << std::endl;
+  *stream << "GPU frame time p90: " << stats.p90_ns << "ns" << std::endl;
+  *stream << "GPU frame time p99: " << stats.p99_ns << "ns" << std::endl;
+  *stream << "GPU frame time p99.9: " << stats.p999_ns << "ns" << std::endl;
+}
+
+// Returns the |FrameBound| on which |breakdown| spent the most time.
+FrameBound ClassifyFrame(const FrameBreakdown& breakdown) {
+  return static_cast<FrameBound>(
+      std::max_element(breakdown.time_ns.begin(), breakdown.time_ns.end()) -
+      breakdown.time_ns.begin());
+}
+
+// Writes what the measured frames of the swapchain with |stats| were bound by
+// to |stream|.
+void WriteFrameBoundStats(const SwapchainStats& stats, std::ostream* stream) {
+  if (!stats.device_wait_totals) {
+    *stream << "Bound by: not tracked (the device was created while no frames "
+               "were measured)"
+            << std::endl;
+    return;
+  }
+  std::array<uint64_t, kFrameBoundCount> bound_frames{};
+  for (std::size_t i = 0; i < kFrameBoundCount; ++i) {
+    bound_frames[i] = stats.bound_frames[i].load(std::memory_order_relaxed);
+  }
+  *stream << "CPU time: "
+          << stats.bound_time_ns[static_cast<std::size_t>(FrameBound::kCpu)]
+                 .load(std::memory_order_relaxed)
+          << "ns" << std::endl;
+  *stream << "vkQueueSubmit time: "
+          << stats.submit_ns.load(std::memory_order_relaxed) << "ns"
+          << std::endl;
+  *stream << "GPU wait time: "
+          << stats.bound_time_ns[static_cast<std::size_t>(FrameBound::kGpu)]
+                 .load(std::memory_order_relaxed)
+          << "ns" << std::endl;
+  *stream << "Present wait time: "
+          << stats.bound_time_ns[static_cast<std::size_t>(FrameBound::kPresent)]
+                 .load(std::memory_order_relaxed)
+          << "ns" << std::endl;
+  for (std::size_t i = 0; i < kFrameBoundCount; ++i) {
+    *stream << kFrameBoundNames[i] << "-bound frames: " << bound_frames[i]
+            << std::endl;
+  }
+  // The run is bound by what bound most of its frames.
+  *stream << "Bound by: "
+          << kFrameBoundNames[static_cast<std::size_t>(
+                 std::max_element(bound_frames.begin(), bound_frames.end()) -
+                 bound_frames.begin())]
+          << std::endl;
+}
+
+// Returns the statistics of the live swapchains, ordered by their index. A
+// swapchain that replaced another is only included once.
+std::vector<std::shared_ptr<SwapchainStats>> GetAllSwapchainStats() {
+  std::vector<std::shared_ptr<SwapchainStats>> result;
+  {
+    ScopedLock lock;
+    const SwapchainMap::InternalMapType* swapchains =
+        GetGlobalData()->swapchain_map.Access(&lock);
+    for (const auto& entry : *swapchains) {
+      result.push_back(entry.second->stats);
+    }
+  }
+  std::sort(result.begin(), result.end(),
+            [](const std::shared_ptr<SwapchainStats>& first,
+               const std::shared_ptr<SwapchainStats>& second) {
+              return first->index < second->index;
+            });
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+// Queues writing |contents| to |output_file|. The first write of the process
+// replaces the file; the others, including the reports after the settings are
+// reloaded, are appended.
+void WriteOutputFileAsync(const std::string& output_file, std::string contents,
+                          WriteCallback callback = nullptr) {
+  GlobalData* global_data = GetGlobalData();
+  ScopedLock lock(global_data->output_file_mutex);
+  if (global_data->output_file_written) {
+    AppendFileAsync(output_file, WriteBuffer(std::move(contents)),
+                    std::move(callback));
+  } else {
+    WriteFileAsync(output_file, WriteBuffer(std::move(contents)),
+                   std::move(callback));
+  }
+  global_data->output_file_written = true;
+}
+
+// Reports the frame times of the window |window_number|, which were recorded
+// in each swapchain's |window_frame_times[window]| from |start_ns| to
+// |end_ns|, and clears them. Runs on the thread pool.
+void ReportWindow(uint32_t window, uint64_t window_number, uint64_t start_ns,
+                  uint64_t end_ns, const std::string& output_file) {
+  GlobalData* global_data = GetGlobalData();
+  std::vector<std::shared_ptr<SwapchainStats>> all_swapchain_stats =
+      GetAllSwapchainStats();
+  std::vector<FrameTimeStats> window_stats;
+  std::vector<std::array<uint64_t, kFrameBoundCount>> window_bound_frames(
+      all_swapchain_stats.size());
+  window_stats.reserve(all_swapchain_stats.size());
+  for (std::size_t i = 0; i < all_swapchain_stats.size(); ++i) {
+    SwapchainStats* swapchain_stats = all_swapchain_stats[i].get();
+    FrameTimeHistogram* frame_times =
+        &swapchain_stats->window_frame_times[window];
+    window_stats.push_back(frame_times->GetStats());
+    frame_times->Clear();
+    for (std::size_t bound = 0; bound < kFrameBoundCount; ++bound) {
+      window_bound_frames[i][bound] =
+          swapchain_stats->window_bound_frames[window][bound].exchange(
+              0, std::memory_order_relaxed);
+    }
+  }
+  global_data->window_report_pending.store(false, std::memory_order_release);
+
+  uint64_t duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2);
+  for (std::size_t i = 0; i < window_stats.size(); ++i) {
+    const FrameTimeStats& stats = window_stats[i];
+    double fps = duration_ns == 0 ? 0.0
+                                  : 1e9 * static_cast<double>(stats.count) /
+                                        static_cast<double>(duration_ns);
+    ss << "Window " << window_number << ", swapchain "
+       << all_swapchain_stats[i]->index << ": duration " << duration_ns
+       << "ns, frames " << stats.count << ", FPS " << fps
+       << ", frame time min " << stats.min_ns << "ns mean " << stats.mean_ns
+       << "ns p50 " << stats.p50_ns << "ns p90 " << stats.p90_ns << "ns p99 "
+       << stats.p99_ns << "ns p99.9 " << stats.p999_ns << "ns max "
+       << stats.max_ns << "ns, 1% low FPS " << stats.one_percent_low_fps;
+    if (all_swapchain_stats[i]->device_wait_totals) {
+      for (std::size_t bound = 0; bound < kFrameBoundCount; ++bound) {
+        ss << ", " << kFrameBoundNames[bound] << "-bound frames "
+           << window_bound_frames[i][bound];
+      }
+    }
+    ss << std::endl;
+  }
+
+  std::string report = ss.str();
+  if (report.empty()) {
+    return;
+  }
+  if (output_file.empty()) {
+    std::istringstream lines(report);
+    std::string line;
+    while (std::getline(lines, line)) {
+      LOG("%s", line.c_str());
+    }
+    return;
+  }
+  WriteOutputFileAsync(output_file, std::move(report));
+}
+
+// If the current window has ended at |now_ns|, switches to the other window
+// and reports the finished one on the thread pool.
+void EndWindowIfDue(const FrameCounterLayerSettings& settings,
+                    uint64_t now_ns) {
+  GlobalData* global_data = GetGlobalData();
+  uint64_t start_ns =
+      global_data->window_start_ns.load(std::memory_order_relaxed);
+  if (start_ns == 0) {
+    global_data->window_start_ns.compare_exchange_strong(
+        start_ns, now_ns, std::memory_order_relaxed);
+    return;
+  }
+  if (now_ns < start_ns ||
+      now_ns - start_ns < settings.report_interval_ms * 1000000U) {
+    return;
+  }
+  // Only one present ends the window; the others keep recording in it.
+  if (global_data->window_report_pending.exchange(true,
+                                                  std::memory_order_acquire)) {
+    return;
+  }
+  // Another present may have ended the window since we checked.
+  uint32_t window = global_data->current_window.load(std::memory_order_relaxed);
+  start_ns = global_data->window_start_ns.load(std::memory_order_relaxed);
+  if (now_ns < start_ns ||
+      now_ns - start_ns < settings.report_interval_ms * 1000000U) {
+    global_data->window_report_pending.store(false, std::memory_order_release);
+    return;
+  }
+  global_data->current_window.store(window ^ 1U, std::memory_order_relaxed);
+  global_data->window_start_ns.store(now_ns, std::memory_order_relaxed);
+  uint64_t window_number =
+      global_data->window_count.fetch_add(1, std::memory_order_relaxed);
+  GetLayerThreadPool()->Submit(
+      [window, window_number, start_ns, now_ns,
+       output_file = settings.output_file]() {
+        ReportWindow(window, window_number, start_ns, now_ns, output_file);
+      });
+}
+
+// Counts a present of the swapchain with |stats| on |queue|, without locking.
+// The queue is only counted if it is one of the first |kMaxPresentQueues|
+// queues to present the swapchain.
+void CountQueuePresent(SwapchainStats* stats, VkQueue queue) {
+  for (QueuePresents& queue_presents : stats->queue_presents) {
+    VkQueue entry_queue = queue_presents.queue.load(std::memory_order_acquire);
+    if (entry_queue == VK_NULL_HANDLE &&
+        queue_presents.queue.compare_exchange_strong(
+            entry_queue, queue, std::memory_order_acq_rel)) {
+      entry_queue = queue;
+    }
+    if (entry_queue == queue) {
+      queue_presents.count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+// Writes the report of the swapchain with |stats|, which has reached the end
+// frame at |end_time_ns|.
+void WriteSwapchainReport(const FrameCounterLayerSettings& settings,
+                          SwapchainStats* stats, uint64_t end_time_ns) {
+  // Calculate the duration.
+  uint64_t start_time_ns = 0;
+  {
+    ScopedLock lock(stats->start_time_mutex);
+    start_time_ns = stats->start_time_ns;
+  }
+
+  uint64_t duration_ns = end_time_ns - start_time_ns;
+
+  if (start_time_ns == 0 || end_time_ns < start_time_ns) {
+    // Start time was not initialized; this is unlikely but could happen via
+    // concurrent calls to vkQueuePresentKHR. (The end time can also be
+    // slightly earlier if the two presents ran on cores whose counters are
+    // out of sync.)
+    // Set duration to 0.
+    duration_ns = 0;
+  }
+
+  // Write to a string stream first so we can log the information on failure.
+  std::ostringstream ss;
+  ss << "Swapchain: " << stats->index << std::endl;
+  ss << "Start frame: " << settings.start_frame << std::endl;
+  ss << "End frame: " << settings.end_frame << std::endl;
+  ss << "Frame count: " << (settings.end_frame - settings.start_frame)
+     << std::endl;
+  ss << "Duration: " << duration_ns << "ns" << std::endl;
+  WriteFrameTimeStats(stats->frame_times.GetStats(), &ss);
+  WriteFrameBoundStats(*stats, &ss);
+  if (settings.gpu_timestamps != 0) {
+    WriteGpuFrameTimeStats(stats->gpu_frame_times.GetStats(), &ss);
+  }
+  for (const QueuePresents& queue_presents : stats->queue_presents) {
+    VkQueue queue = queue_presents.queue.load(std::memory_order_acquire);
+    if (queue != VK_NULL_HANDLE) {
+      ss << "Presents on queue " << static_cast<const void*>(queue) << ": "
+         << queue_presents.count.load(std::memory_order_relaxed) << std::endl;
+    }
+  }
+
+  // Queue writing to the file, and log the information on failure.
+  std::string info = ss.str();
+  WriteCallback callback = [output_file = settings.output_file,
+                            info](bool success) {
+    if (!success) {
+      LOG("Failed to write the duration info to file %s. The information "
+          "was: %s",
+          output_file.c_str(), info.c_str());
+    }
+  };
+  WriteOutputFileAsync(settings.output_file, info, std::move(callback));
+}
+
+// Returns the increase of the running total |total_ns| since the previous
+// call with |last_total_ns|, and updates |last_total_ns|.
+uint64_t TakeIncrease(std::atomic<uint64_t>* last_total_ns, uint64_t total_ns) {
+  uint64_t previous_ns =
+      last_total_ns->exchange(total_ns, std::memory_order_relaxed);
+  // A concurrent present may have taken a later total.
+  return total_ns > previous_ns ? total_ns - previous_ns : 0;
+}
+
+// Splits |frame_time_ns|, the time since the previous present of the swapchain
+// with |stats|, given that the present blocked for |present_wait_ns|. The
+// waits of all threads on the swapchain's device since the previous present
+// are attributed to the frame (up to the frame time), as the frame cannot be
+// presented before the work that the application waited for.
+FrameBreakdown BreakDownFrame(SwapchainStats* stats, uint64_t frame_time_ns,
+                              uint64_t present_wait_ns) {
+  const DeviceWaitTotals& totals = *stats->device_wait_totals;
+  uint64_t present_ns =
+      stats->acquire_wait_ns.exchange(0, std::memory_order_relaxed) +
+      present_wait_ns;
+  uint64_t gpu_ns =
+      TakeIncrease(&stats->last_gpu_wait_ns,
+                   totals.gpu_wait_ns.load(std::memory_order_relaxed));
+  uint64_t submit_ns =
+      TakeIncrease(&stats->last_submit_ns,
+                   totals.submit_ns.load(std::memory_order_relaxed));
+
+  FrameBreakdown result;
+  present_ns = std::min(present_ns, frame_time_ns);
+  gpu_ns = std::min(gpu_ns, frame_time_ns - present_ns);
+  uint64_t cpu_ns = frame_time_ns - present_ns - gpu_ns;
+  result.time_ns[static_cast<std::size_t>(FrameBound::kCpu)] = cpu_ns;
+  result.time_ns[static_cast<std::size_t>(FrameBound::kGpu)] = gpu_ns;
+  result.time_ns[static_cast<std::size_t>(FrameBound::kPresent)] = present_ns;
+  result.submit_ns = std::min(submit_ns, cpu_ns);
+  return result;
+}
+
+// Counts a present of the swapchain with |stats| on |queue|, which started at
+// |present_start_ns| and returned at |now_ns|.
+void CountSwapchainPresent(const FrameCounterLayerSettings& settings,
+                           SwapchainStats* stats, VkQueue queue,
+                           uint64_t present_start_ns, uint64_t now_ns) {
+  // The time since the swapchain's previous present is the frame time.
+  uint64_t previous_ns =
+      stats->last_present_time_ns.exchange(now_ns, std::memory_order_relaxed);
+  uint64_t frame_time_ns =
+      previous_ns != 0 && now_ns > previous_ns ? now_ns - previous_ns : 0;
+
+  // The waits are taken even for the first present, so that those before it
+  // are not attributed to the next frame.
+  bool classify = stats->device_wait_totals != nullptr;
+  FrameBreakdown breakdown;
+  std::size_t bound = 0;
+  if (classify) {
+    breakdown = BreakDownFrame(
+        stats, frame_time_ns,
+        now_ns > present_start_ns ? now_ns - present_start_ns : 0);
+    bound = static_cast<std::size_t>(ClassifyFrame(breakdown));
+  }
+
+  if (settings.report_interval_ms != 0 && frame_time_ns != 0) {
+    uint32_t window =
+        GetGlobalData()->current_window.load(std::memory_order_relaxed);
+    stats->window_frame_times[window].Record(frame_time_ns);
+    if (classify) {
+      stats->window_bound_frames[window][bound].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+  }
+
+  // If the start and end frame are the same then there is nothing we can do.
+  // Return early.
+  if (settings.start_frame == settings.end_frame) {
+    return;
+  }
+
+  // Atomically increment the swapchain's frame counter.
+  uint64_t current_frame = stats->frame_counter++;
+
+  // Record the frame times and presents of the measured frames.
+  if (current_frame > settings.start_frame &&
+      current_frame <= settings.end_frame) {
+    if (frame_time_ns != 0) {
+      stats->frame_times.Record(frame_time_ns);
+      if (classify) {
+        stats->bound_frames[bound].fetch_add(1, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < kFrameBoundCount; ++i) {
+          stats->bound_time_ns[i].fetch_add(breakdown.time_ns[i],
+                                            std::memory_order_relaxed);
+        }
+        stats->submit_ns.fetch_add(breakdown.submit_ns,
+                                   std::memory_order_relaxed);
+      }
+    }
+    CountQueuePresent(stats, queue);
+  }
+
+  // If we have hit the start frame...
+  if (current_frame == settings.start_frame) {
+    // Start the timer.
+    stats->frame_times.Clear();
+    for (QueuePresents& queue_presents : stats->queue_presents) {
+      queue_presents.count.store(0, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < kFrameBoundCount; ++i) {
+      stats->bound_frames[i].store(0, std::memory_order_relaxed);
+      stats->bound_time_ns[i].store(0, std::memory_order_relaxed);
+    }
+    stats->submit_ns.store(0, std::memory_order_relaxed);
+    stats->gpu_frame_times.Clear();
+    // Although unlikely, another thread might be presenting the swapchain
+    // (via a different VkQueue) so that the "else if" block below for the
+    // end_frame is executing concurrently. Hence, we use a mutex.
+    {
+      ScopedLock lock(stats->start_time_mutex);
+      stats->start_time_ns = now_ns;
+    }
+  } else if (current_frame == settings.end_frame) {
+    // We have hit the end frame.
+    WriteSwapchainReport(settings, stats, now_ns);
+  }
+}
+
+// Re-arms the measurement after the settings are reloaded: the frames of each
+// swapchain are counted again from the next present.
+void ResetFrameCounters() {
+  for (const std::shared_ptr<SwapchainStats>& stats : GetAllSwapchainStats()) {
+    {
+      ScopedLock lock(stats->start_time_mutex);
+      stats->start_time_ns = 0;
+    }
+    stats->frame_counter.store(0, std::memory_order_relaxed);
+  }
+}
+
+// Destroys the query pool and command buffers of |timestamps|, which belong to
+// |device_data|'s device.
+void DestroyGpuTimestamps(const DeviceData& device_data,
+                          GpuTimestamps* timestamps) {
+  for (const GpuTimestampSlot& slot : timestamps->slots) {
+    if (slot.fence != VK_NULL_HANDLE) {
+      device_data.vkDestroyFence(device_data.device, slot.fence, nullptr);
+    }
+  }
+  if (timestamps->command_pool != VK_NULL_HANDLE) {
+    device_data.vkDestroyCommandPool(device_data.device,
+                                     timestamps->command_pool, nullptr);
+  }
+  if (timestamps->query_pool != VK_NULL_HANDLE) {
+    device_data.vkDestroyQueryPool(device_data.device, timestamps->query_pool,
+                                   nullptr);
+  }
+}
 
-  FrameCounterLayerSettings& settings = GetGlobalData()->settings;
+// Creates the query pool and command buffers that time |device_data|'s frames
+// on the GPU, on the queues of the first queue family in |pCreateInfo| that
+// supports graphics and timestamps. Returns null if there is no such queue
+// family, or on failure.
+std::unique_ptr<GpuTimestamps> CreateGpuTimestamps(
+    VkPhysicalDevice physical_device, const VkDeviceCreateInfo* pCreateInfo,
+    const DeviceData& device_data) {
+  const InstanceData* instance_data = device_data.instance_data;
+  VkDevice device = device_data.device;
+
+  VkPhysicalDeviceProperties properties = {};
+  instance_data->vkGetPhysicalDeviceProperties(physical_device, &properties);
+  uint32_t family_count = 0;
+  instance_data->vkGetPhysicalDeviceQueueFamilyProperties(
+      physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  instance_data->vkGetPhysicalDeviceQueueFamilyProperties(
+      physical_device, &family_count, families.data());
+
+  const VkDeviceQueueCreateInfo* queue_create_info = nullptr;
+  for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const VkDeviceQueueCreateInfo& info = pCreateInfo->pQueueCreateInfos[i];
+    // Queues created with flags are not returned by vkGetDeviceQueue.
+    if (info.flags == 0 && info.queueFamilyIndex < family_count &&
+        (families[info.queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) !=
+            0 &&
+        families[info.queueFamilyIndex].timestampValidBits != 0) {
+      queue_create_info = &info;
+      break;
+    }
+  }
+  if (queue_create_info == nullptr ||
+      !(properties.limits.timestampPeriod > 0.0F)) {
+    LOG("The device has no graphics queue that supports timestamps; its "
+        "frames will not be timed on the GPU.");
+    return nullptr;
+  }
+  uint32_t family = queue_create_info->queueFamilyIndex;
+
+  auto result = std::make_unique<GpuTimestamps>();
+  uint32_t valid_bits = families[family].timestampValidBits;
+  result->timestamp_mask =
+      valid_bits >= 64U ? ~uint64_t{0} : (uint64_t{1} << valid_bits) - 1U;
+  result->timestamp_period_ns = properties.limits.timestampPeriod;
+  for (uint32_t i = 0; i < queue_create_info->queueCount; ++i) {
+    VkQueue queue = VK_NULL_HANDLE;
+    device_data.vkGetDeviceQueue(device, family, i, &queue);
+    result->queues.push_back(queue);
+  }
 
-  if (!settings.init) {
-    GetSettingUint64("VkLayer_GF_frame_counter_START_FRAME",
-                     "debug.gf.fc.start_frame", &settings.start_frame);
-    GetSettingUint64("VkLayer_GF_frame_counter_END_FRAME",
-                     "debug.gf.fc.end_frame", &settings.end_frame);
-    GetSettingString("VkLayer_GF_frame_counter_OUTPUT_FILE",
-                     "debug.gf.fc.output_file", &settings.output_file);
-    settings.init = true;
+  VkQueryPoolCreateInfo query_pool_create_info = {};
+  query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_create_info.queryCount = 2 * kGpuTimestampFrames;
+  VkCommandPoolCreateInfo command_pool_create_info = {};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.queueFamilyIndex = family;
+  std::array<VkCommandBuffer, 2 * kGpuTimestampFrames> command_buffers{};
+  VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+  command_buffer_allocate_info.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  command_buffer_allocate_info.commandBufferCount =
+      static_cast<uint32_t>(command_buffers.size());
+
+  if (device_data.vkCreateQueryPool(device, &query_pool_create_info, nullptr,
+                                    &result->query_pool) != VK_SUCCESS ||
+      device_data.vkCreateCommandPool(device, &command_pool_create_info,
+                                      nullptr,
+                                      &result->command_pool) != VK_SUCCESS) {
+    LOG("Failed to create the query pool for the GPU timestamps.");
+    DestroyGpuTimestamps(device_data, result.get());
+    return nullptr;
+  }
+  command_buffer_allocate_info.commandPool = result->command_pool;
+  if (device_data.vkAllocateCommandBuffers(device,
+                                           &command_buffer_allocate_info,
+                                           command_buffers.data()) !=
+      VK_SUCCESS) {
+    LOG("Failed to allocate the command buffers for the GPU timestamps.");
+    DestroyGpuTimestamps(device_data, result.get());
+    return nullptr;
+  }
+
+  // Each command buffer writes the query with its index. The command buffers
+  // are submitted many times; the end of a frame's can be pending in several
+  // submits at once.
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+  for (uint32_t query = 0; query < command_buffers.size(); ++query) {
+    VkCommandBuffer command_buffer = command_buffers[query];
+    // We have created a dispatchable object, so we must set the dispatch table
+    // pointer.
+    CopyDispatchTablePointer(device, command_buffer);
+    if (device_data.vkBeginCommandBuffer(command_buffer, &begin_info) !=
+        VK_SUCCESS) {
+      LOG("Failed to record the command buffers for the GPU timestamps.");
+      DestroyGpuTimestamps(device_data, result.get());
+      return nullptr;
+    }
+    device_data.vkCmdResetQueryPool(command_buffer, result->query_pool, query,
+                                    1);
+    // Both timestamps are written once the preceding commands have completed,
+    // so that the frame's first timestamp does not include the time that its
+    // commands waited for the previous frame's.
+    device_data.vkCmdWriteTimestamp(command_buffer,
+                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                    result->query_pool, query);
+    if (device_data.vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+      LOG("Failed to record the command buffers for the GPU timestamps.");
+      DestroyGpuTimestamps(device_data, result.get());
+      return nullptr;
+    }
+  }
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (uint32_t i = 0; i < kGpuTimestampFrames; ++i) {
+    result->slots[i].begin_command_buffer = command_buffers[2 * i];
+    result->slots[i].end_command_buffer = command_buffers[2 * i + 1];
+    if (device_data.vkCreateFence(device, &fence_create_info, nullptr,
+                                  &result->slots[i].fence) != VK_SUCCESS) {
+      LOG("Failed to create the fences for the GPU timestamps.");
+      DestroyGpuTimestamps(device_data, result.get());
+      return nullptr;
+    }
+  }
+  return result;
+}
+
+// Returns whether a command buffer can be added to |submit|: device group
+// submits give a device mask per command buffer, and protected submits cannot
+// include our command buffers.
+bool CanAddCommandBuffer(const VkSubmitInfo& submit) {
+  for (const auto* next = static_cast<const VkBaseInStructure*>(submit.pNext);
+       next != nullptr; next = next->pNext) {
+    if (next->sType == VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO ||
+        next->sType == VK_STRUCTURE_TYPE_PROTECTED_SUBMIT_INFO) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Submits the fences of the presented frames of |timestamps| that were timed
+// on |queue|, which the application is calling a function on. Must be called
+// with |timestamps->mutex| held.
+void SubmitGpuTimestampsFences(DeviceData* device_data,
+                               GpuTimestamps* timestamps, VkQueue queue) {
+  for (GpuTimestampSlot& slot : timestamps->slots) {
+    if (timestamps->unsubmitted_fences == 0) {
+      return;
+    }
+    if (slot.pending && !slot.fence_submitted && slot.queue == queue) {
+      // An empty submit signals its fence once all of the work submitted to
+      // the queue before it has finished.
+      if (device_data->vkQueueSubmit(queue, 0, nullptr, slot.fence) ==
+          VK_SUCCESS) {
+        slot.fence_submitted = true;
+        --timestamps->unsubmitted_fences;
+      }
+    }
+  }
+}
+
+// If |queue| is timed, replaces |*submitCount| and |*pSubmits| with the
+// submits in |state|, with the command buffers that write the current frame's
+// timestamps of |timestamps|.
+void AddTimestampCommandBuffers(DeviceData* device_data,
+                                GpuTimestamps* timestamps, VkQueue queue,
+                                uint32_t* submitCount,
+                                const VkSubmitInfo** pSubmits,
+                                QueueSubmitHookState* state) {
+  GpuTimestampSlot* slot = nullptr;
+  bool begins_frame = false;
+  {
+    ScopedLock lock(timestamps->mutex);
+    SubmitGpuTimestampsFences(device_data, timestamps, queue);
+    if (timestamps->frame_queue == queue) {
+      slot = &timestamps->slots[timestamps->current_slot];
+    } else if (timestamps->frame_queue == VK_NULL_HANDLE &&
+               *submitCount != 0 && CanAddCommandBuffer((*pSubmits)[0]) &&
+               !timestamps->slots[timestamps->current_slot].pending &&
+               std::find(timestamps->queues.begin(), timestamps->queues.end(),
+                         queue) != timestamps->queues.end()) {
+      // If all of the slots are pending, this frame is not timed.
+      slot = &timestamps->slots[timestamps->current_slot];
+      begins_frame = true;
+      timestamps->frame_queue = queue;
+    }
+  }
+  if (slot == nullptr) {
+    return;
+  }
+
+  std::vector<VkSubmitInfo>& submits = state->submits;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  submits.assign(*pSubmits, *pSubmits + *submitCount);
+  // The first timestamp is written after the first batch's semaphore waits, so
+  // that it does not include waiting for the swapchain image.
+  if (begins_frame) {
+    std::vector<VkCommandBuffer>& first_command_buffers =
+        state->first_command_buffers;
+    first_command_buffers.reserve(submits[0].commandBufferCount + 1U);
+    first_command_buffers.push_back(slot->begin_command_buffer);
+    first_command_buffers.insert(
+        first_command_buffers.end(), submits[0].pCommandBuffers,
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        submits[0].pCommandBuffers + submits[0].commandBufferCount);
+    submits[0].commandBufferCount =
+        static_cast<uint32_t>(first_command_buffers.size());
+    submits[0].pCommandBuffers = first_command_buffers.data();
+  }
+  VkSubmitInfo end_submit = {};
+  end_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  end_submit.commandBufferCount = 1;
+  end_submit.pCommandBuffers = &slot->end_command_buffer;
+  submits.push_back(end_submit);
+
+  state->begins_frame = begins_frame;
+  *submitCount = static_cast<uint32_t>(submits.size());
+  *pSubmits = submits.data();
+}
+
+// Ends the current frame of |timestamps|, which was presented on |queue| with
+// the swapchain with |stats| (if any), and reads the timestamps of the earlier
+// frames that have finished, without waiting.
+void EndGpuTimestampsFrame(const FrameCounterLayerSettings& settings,
+                           DeviceData* device_data, GpuTimestamps* timestamps,
+                           VkQueue queue,
+                           const std::shared_ptr<SwapchainStats>& stats) {
+  ScopedLock lock(timestamps->mutex);
+  if (timestamps->frame_queue != VK_NULL_HANDLE) {
+    GpuTimestampSlot* slot = &timestamps->slots[timestamps->current_slot];
+    slot->pending = true;
+    slot->queue = timestamps->frame_queue;
+    slot->fence_submitted = false;
+    ++timestamps->unsubmitted_fences;
+    slot->stats = stats;
+    // The number that the swapchain's present of this frame counts.
+    slot->frame =
+        stats ? stats->frame_counter.load(std::memory_order_relaxed) : 0;
+    timestamps->current_slot =
+        (timestamps->current_slot + 1) % kGpuTimestampFrames;
+    timestamps->frame_queue = VK_NULL_HANDLE;
+  }
+  SubmitGpuTimestampsFences(device_data, timestamps, queue);
+
+  while (timestamps->slots[timestamps->read_slot].pending) {
+    GpuTimestampSlot* slot = &timestamps->slots[timestamps->read_slot];
+    // Until the fence has signaled, the queries may still hold the values of
+    // the slot's previous frame, or be partly reset.
+    if (!slot->fence_submitted ||
+        device_data->vkGetFenceStatus(device_data->device, slot->fence) !=
+            VK_SUCCESS) {
+      break;
+    }
+    device_data->vkResetFences(device_data->device, 1, &slot->fence);
+    std::array<uint64_t, 2> values{};
+    VkResult result = device_data->vkGetQueryPoolResults(
+        device_data->device, timestamps->query_pool, 2 * timestamps->read_slot,
+        2, sizeof(values), values.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS && slot->stats &&
+        slot->frame > settings.start_frame &&
+        slot->frame <= settings.end_frame) {
+      uint64_t ticks = (values[1] - values[0]) & timestamps->timestamp_mask;
+      slot->stats->gpu_frame_times.Record(static_cast<uint64_t>(
+          static_cast<double>(ticks) * timestamps->timestamp_period_ns));
+    }
+    slot->pending = false;
+    slot->stats.reset();
+    timestamps->read_slot = (timestamps->read_slot + 1) % kGpuTimestampFrames;
   }
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
 vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   GlobalData* global_data = GetGlobalData();
   DeviceData* device_data = global_data->device_map.Get(DeviceKey(queue));
 
-  // Call the original function.
+  // Call the original function. The time that it blocks counts as waiting for
+  // the presentation engine.
+  uint64_t present_start_ns = ClockNowNs();
   VkResult result = device_data->vkQueuePresentKHR(queue, pPresentInfo);
 
+  // The frame's work was submitted, even if the present failed.
+  if (global_data->settings.Get().gpu_timestamps != 0) {
+    GpuTimestampsData* gpu_timestamps_data =
+        global_data->gpu_timestamps_map.Get(DeviceKey(queue));
+    if (gpu_timestamps_data != nullptr) {
+      // The GPU time is counted for the first swapchain.
+      std::shared_ptr<SwapchainStats> stats;
+      for (uint32_t i = 0; i < pPresentInfo->swapchainCount && !stats; ++i) {
+        SwapchainData* swapchain_data =
+            global_data->swapchain_map.Get(pPresentInfo->pSwapchains[i]);
+        if (swapchain_data != nullptr) {
+          stats = swapchain_data->stats;
+        }
+      }
+      EndGpuTimestampsFrame(global_data->settings.Get(), device_data,
+                            gpu_timestamps_data->timestamps.get(), queue,
+                            stats);
+    }
+  }
+
   // If the function succeeded:
   if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
-    // If the start and end frame are the same then there is nothing we can do.
-    // Return early.
-    if (global_data->settings.start_frame == global_data->settings.end_frame) {
-      return result;
-    }
-
-    // Atomically increment our frame counter.
-    uint64_t current_frame = global_data->frame_counter++;
-
-    // If we have hit the start frame...
-    if (current_frame == global_data->settings.start_frame) {
-      // Start the timer.
-      auto start_time = std::chrono::steady_clock::now();
-      // Although unlikely, another thread might be calling vkQueuePresentKHR
-      // (targeting a different VkQueue) so that the "else if" block below for
-      // the end_frame is executing concurrently. Hence, we use a mutex.
-      {
-        ScopedLock lock(global_data->start_time_mutex);
-        global_data->start_time = start_time;
+    uint64_t now_ns = ClockNowNs();
+    if (IsLiveStatsEnabled()) {
+      // The live statistics count each present as a frame.
+      uint64_t previous_ns = global_data->last_present_time_ns.exchange(
+          now_ns, std::memory_order_relaxed);
+      if (previous_ns != 0 && now_ns > previous_ns) {
+        AddLiveStatsFrame(now_ns - previous_ns);
       }
-    } else if (current_frame == global_data->settings.end_frame) {
-      // We have hit the end frame.
-      // Calculate the duration.
-      auto end_time = std::chrono::steady_clock::now();
-      std::chrono::steady_clock::time_point start_time;
-      {
-        ScopedLock lock(global_data->start_time_mutex);
-        start_time = global_data->start_time;
+    }
+
+    // If the settings file changed, re-arm the measurement: the frames are
+    // counted again from this one.
+    if (global_data->settings.ReloadIfChanged()) {
+      ResetFrameCounters();
+      LOG("Reloaded the settings; counting frames from now.");
+    }
+    const FrameCounterLayerSettings& settings = global_data->settings.Get();
+
+    // Each swapchain that is presented counts the frame.
+    for (uint32_t i = 0; i < pPresentInfo->swapchainCount; ++i) {
+      SwapchainData* swapchain_data =
+          global_data->swapchain_map.Get(pPresentInfo->pSwapchains[i]);
+      // Swapchains that were not created via vkCreateSwapchainKHR (e.g. via
+      // vkCreateSharedSwapchainsKHR) are not counted.
+      if (swapchain_data != nullptr) {
+        CountSwapchainPresent(settings, swapchain_data->stats.get(), queue,
+                              present_start_ns, now_ns);
       }
+    }
 
-      auto duration = end_time - start_time;
+    if (settings.report_interval_ms != 0) {
+      EndWindowIfDue(settings, now_ns);
+    }
+  }
+  return result;
+}
 
-      if (start_time == std::chrono::steady_clock::time_point{}) {
-        // Start time was not initialized; this is unlikely but could happen via
-        // concurrent calls to vkQueuePresentKHR.
-        // Set duration to 0.
-        duration = std::chrono::steady_clock::duration{};
-      }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(
+    VkDevice device, const VkSwapchainCreateInfoKHR* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkSwapchainKHR* pSwapchain) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DEBUG_LOG("vkCreateSwapchainKHR");
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(DeviceKey(device));
 
-      // Write out the information to the output file.
-      {
-        // Write to a string stream first so we can log the information on
-        // failure.
-        std::ostringstream ss;
-        ss << "Start frame: " << global_data->settings.start_frame << std::endl;
-        ss << "End frame: " << global_data->settings.end_frame << std::endl;
-        ss << "Frame count: "
-           << (global_data->settings.end_frame -
-               global_data->settings.start_frame)
-           << std::endl;
-        ss << "Duration: " << std::chrono::nanoseconds(duration).count() << "ns"
-           << std::endl;
-
-        // Write to the file.
-        std::ofstream output_file_stream(global_data->settings.output_file);
-        output_file_stream << ss.str() << std::flush;
-        output_file_stream.close();
-
-        // Log on failure.
-        if (output_file_stream.fail()) {
-          LOG("Failed to write the duration info to file %s. The information "
-              "was: %s",
-              global_data->settings.output_file.c_str(), ss.str().c_str());
-        }
-      }
+  VkResult result = device_data->vkCreateSwapchainKHR(device, pCreateInfo,
+                                                      pAllocator, pSwapchain);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  SwapchainData swapchain_data;
+  if (pCreateInfo->oldSwapchain != VK_NULL_HANDLE) {
+    const SwapchainData* old_swapchain_data =
+        global_data->swapchain_map.Get(pCreateInfo->oldSwapchain);
+    if (old_swapchain_data != nullptr) {
+      swapchain_data.stats = old_swapchain_data->stats;
     }
   }
+  if (!swapchain_data.stats) {
+    swapchain_data.stats = std::make_shared<SwapchainStats>();
+    swapchain_data.stats->index =
+        global_data->swapchain_count.fetch_add(1, std::memory_order_relaxed);
+    swapchain_data.stats->device_wait_totals = device_data->wait_totals;
+  }
+  global_data->swapchain_map.Put(*pSwapchain, std::move(swapchain_data));
+
+  return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
+                      const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DEBUG_LOG("vkDestroySwapchainKHR");
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(DeviceKey(device));
+
+  device_data->vkDestroySwapchainKHR(device, swapchain, pAllocator);
+
+  if (swapchain != VK_NULL_HANDLE) {
+    global_data->swapchain_map.Remove(swapchain);
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain,
+                      uint64_t timeout, VkSemaphore semaphore, VkFence fence,
+                      uint32_t* pImageIndex) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(DeviceKey(device));
+
+  uint64_t start_ns = ClockNowNs();
+  VkResult result = device_data->vkAcquireNextImageKHR(
+      device, swapchain, timeout, semaphore, fence, pImageIndex);
+  uint64_t end_ns = ClockNowNs();
+
+  SwapchainData* swapchain_data = global_data->swapchain_map.Get(swapchain);
+  if (swapchain_data != nullptr && end_ns > start_ns) {
+    swapchain_data->stats->acquire_wait_ns.fetch_add(
+        end_ns - start_ns, std::memory_order_relaxed);
+  }
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
+                                             uint32_t submitCount,
+                                             const VkSubmitInfo* pSubmits,
+                                             VkFence fence) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DeviceData* device_data = GetGlobalData()->device_map.Get(DeviceKey(queue));
+
+  QueueSubmitHookState state;
+  PreQueueSubmit(device_data, queue, &submitCount, &pSubmits, &state);
+  VkResult result =
+      device_data->vkQueueSubmit(queue, submitCount, pSubmits, fence);
+  PostQueueSubmit(device_data, queue, result, &state);
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue queue) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(DeviceKey(queue));
+
+  uint64_t start_ns = ClockNowNs();
+  VkResult result = device_data->vkQueueWaitIdle(queue);
+  uint64_t end_ns = ClockNowNs();
+
+  if (end_ns > start_ns && device_data->wait_totals) {
+    device_data->wait_totals->gpu_wait_ns.fetch_add(
+        end_ns - start_ns, std::memory_order_relaxed);
+  }
+  return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device,
+                                               uint32_t fenceCount,
+                                               const VkFence* pFences,
+                                               VkBool32 waitAll,
+                                               uint64_t timeout) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(DeviceKey(device));
+
+  uint64_t start_ns = ClockNowNs();
+  VkResult result = device_data->vkWaitForFences(device, fenceCount, pFences,
+                                                 waitAll, timeout);
+  uint64_t end_ns = ClockNowNs();
+
+  if (end_ns > start_ns && device_data->wait_totals) {
+    device_data->wait_totals->gpu_wait_ns.fetch_add(
+        end_ns - start_ns, std::memory_order_relaxed);
+  }
   return result;
 }
 
@@ -219,6 +1325,7 @@ vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
 //
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
     uint32_t* pPropertyCount, VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG("vkEnumerateInstanceLayerProperties");
 
   if (pProperties == nullptr) {
@@ -243,6 +1350,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
     VkPhysicalDevice /*physicalDevice*/, uint32_t* pPropertyCount,
     VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG(
       "vkEnumerateDeviceLayerProperties (calling "
       "vkEnumerateInstanceLayerProperties)");
@@ -256,6 +1364,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
     const char* pLayerName, uint32_t* pPropertyCount,
     VkExtensionProperties* /*pProperties*/) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG("vkEnumerateInstanceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -271,6 +1380,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
     VkPhysicalDevice physicalDevice, const char* pLayerName,
     uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG("vkEnumerateDeviceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -293,6 +1403,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
     const VkInstanceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkInstance* pInstance) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG("vkCreateInstance");
 
   InitSettingsIfNeeded();
@@ -337,20 +1448,16 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 
   instance_data.instance = *pInstance;
 
-#define HANDLE(func)                                      \
-  instance_data.func = reinterpret_cast<PFN_##func>(      \
-      next_get_instance_proc_address(*pInstance, #func)); \
-  if (!instance_data.func) {                              \
-    return VK_ERROR_INITIALIZATION_FAILED;                \
+  if (!InitInstanceDispatchTable(*pInstance, next_get_instance_proc_address,
+                                 &instance_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-#undef HANDLE
-
-  instance_data.vkGetInstanceProcAddr = next_get_instance_proc_address;
-
   GetGlobalData()->instance_map.Put(InstanceKey(*pInstance), instance_data);
 
+  // The periodic reports are written on the thread pool.
+  AcquireLayerThreadPool();
+
   return result;
 }
 
@@ -360,6 +1467,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
     VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_LOG("vkCreateDevice");
 
   // Get the layer device create info, which we need so we can:
@@ -415,18 +1523,37 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
   device_data.device = *pDevice;
   device_data.instance_data = instance_data;
 
-#define HANDLE(func)                                  \
-  device_data.func = reinterpret_cast<PFN_##func>(    \
-      next_get_device_proc_address(*pDevice, #func)); \
-  if (!device_data.func) {                            \
-    return VK_ERROR_INITIALIZATION_FAILED;            \
+  if (!InitDeviceDispatchTable(*pDevice, next_get_device_proc_address,
+                               &device_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkQueuePresentKHR)
-
-#undef HANDLE
+  device_data.needed_device_functions = GetNeededDeviceFunctions();
+  if (device_data.vkQueuePresentKHR == nullptr) {
+    // VK_KHR_swapchain is not enabled, so the next layer's
+    // vkGetDeviceProcAddr must be used to return null for its functions.
+    device_data.needed_device_functions.reset(
+        kDeviceFunctionTable.IndexOf("vkQueuePresentKHR"));
+    device_data.needed_device_functions.reset(
+        kDeviceFunctionTable.IndexOf("vkCreateSwapchainKHR"));
+    device_data.needed_device_functions.reset(
+        kDeviceFunctionTable.IndexOf("vkDestroySwapchainKHR"));
+    device_data.needed_device_functions.reset(
+        kDeviceFunctionTable.IndexOf("vkAcquireNextImageKHR"));
+  }
+  if (device_data.needed_device_functions[kDeviceFunctionTable.IndexOf(
+          "vkWaitForFences")]) {
+    device_data.wait_totals = std::make_shared<DeviceWaitTotals>();
+  }
 
-  device_data.vkGetDeviceProcAddr = next_get_device_proc_address;
+  if (GetGlobalData()->settings.Get().gpu_timestamps != 0) {
+    std::unique_ptr<GpuTimestamps> timestamps =
+        CreateGpuTimestamps(physicalDevice, pCreateInfo, device_data);
+    if (timestamps) {
+      GetGlobalData()->gpu_timestamps_map.Put(
+          DeviceKey(*pDevice), GpuTimestampsData{std::move(timestamps)});
+    }
+  }
 
   GetGlobalData()->device_map.Put(DeviceKey(*pDevice), device_data);
 
@@ -434,28 +1561,92 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
 }
 
 //
-// Our vkGetDeviceProcAddr function.
+// Our vkDestroyDevice function.
 //
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
-vkGetDeviceProcAddr(VkDevice device, const char* pName) {
-  DEBUG_ASSERT(pName);
-  DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DEBUG_LOG("vkDestroyDevice");
+
+  if (device == nullptr) {
+    return;
+  }
+
+  // Get the key before the device is destroyed, as the key is read from the
+  // device object.
+  void* device_key = DeviceKey(device);
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(device_key);
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
+  GpuTimestampsData* gpu_timestamps_data =
+      global_data->gpu_timestamps_map.Get(device_key);
+  if (gpu_timestamps_data != nullptr) {
+    DestroyGpuTimestamps(*device_data, gpu_timestamps_data->timestamps.get());
+    global_data->gpu_timestamps_map.Remove(device_key);
   }
 
-  // The device functions provided by this layer:
+  device_data->vkDestroyDevice(device, pAllocator);
+
+  global_data->device_map.Remove(device_key);
 
-  // Standard device functions that most layers must implement:
-  HANDLE(vkGetDeviceProcAddr)  // Self-reference.
+  GF_LAYERS_DUMP_INSTRUMENTATION("VkLayer_GF_frame_counter");
+}
 
-  // Other device functions that this layer intercepts:
-  HANDLE(vkQueuePresentKHR)
+//
+// Our vkDestroyInstance function.
+//
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DEBUG_LOG("vkDestroyInstance");
+
+  if (instance == nullptr) {
+    return;
+  }
+
+  // Get the key before the instance is destroyed, as the key is read from the
+  // instance object.
+  void* instance_key = InstanceKey(instance);
+  GlobalData* global_data = GetGlobalData();
+  InstanceData* instance_data = global_data->instance_map.Get(instance_key);
+
+  instance_data->vkDestroyInstance(instance, pAllocator);
+
+  global_data->instance_map.Remove(instance_key);
+
+  // Waits for the periodic reports to be queued.
+  ReleaseLayerThreadPool();
+}
 
+//
+// Our vkGetDeviceProcAddr function.
+//
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetDeviceProcAddr(VkDevice device, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
+  DEBUG_ASSERT(pName);
+  DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
+
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kDeviceFunctionTable.size()>
+      kDeviceFunctions = {GF_LAYERS_FRAME_COUNTER_DEVICE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  std::size_t index = kDeviceFunctionTable.Find(pName);
+  if (index != kDeviceFunctionTable.size()) {
+    if (device == nullptr) {
+      return kDeviceFunctions[index];
+    }
+    const DeviceData* device_data =
+        GetGlobalData()->device_map.Get(DeviceKey(device));
+    if (device_data->needed_device_functions[index]) {
+      return kDeviceFunctions[index];
+    }
+    // Otherwise, we do not need to intercept the function for this device, so
+    // we return the next layer's function (below) so that we add no overhead
+    // to calls of the function.
+  }
+
   if (device == nullptr) {
     return nullptr;
   }
@@ -474,33 +1665,22 @@ vkGetDeviceProcAddr(VkDevice device, const char* pName) {
 //
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
 vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_frame_counter");
   DEBUG_ASSERT(pName);
 
   DEBUG_LOG("vkGetInstanceProcAddr: %s", pName);
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
-  }
-
-  // The global and instance functions provided by this layer:
-
-  // The standard introspection functions.
-  HANDLE(vkEnumerateInstanceLayerProperties)
-  HANDLE(vkEnumerateDeviceLayerProperties)
-  HANDLE(vkEnumerateInstanceExtensionProperties)
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-
-  // Standard functions that most layers must implement:
-  HANDLE(vkCreateInstance)
-  HANDLE(vkCreateDevice)
-  HANDLE(vkGetInstanceProcAddr)  // Self-reference.
-  HANDLE(vkGetDeviceProcAddr)
-
-  // Other instance functions that this layer intercepts: (none)
-
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kInstanceFunctionTable.size()>
+      kInstanceFunctions = {GF_LAYERS_FRAME_COUNTER_INSTANCE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  PFN_vkVoidFunction result =
+      kInstanceFunctionTable.Lookup(pName, kInstanceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
   // We could move this up, as instance must be non-null in all but a few cases.
   // But it is not the job of this layer to detect invalid calls, so we can just
   // leave this check until the last possible moment.
@@ -519,6 +1699,57 @@ vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
 }
 
 }  // namespace
+
+//
+// The hooks called by VkLayer_GF_fused; see fused_hooks.h.
+//
+
+DeviceData* GetQueueSubmitHookDeviceData(VkDevice device) {
+  DeviceData* device_data = GetGlobalData()->device_map.Get(DeviceKey(device));
+  return device_data->needed_device_functions[kDeviceFunctionTable.IndexOf(
+             "vkQueueSubmit")]
+             ? device_data
+             : nullptr;
+}
+
+void PreQueueSubmit(DeviceData* device_data, VkQueue queue,
+                    uint32_t* submitCount, const VkSubmitInfo** pSubmits,
+                    QueueSubmitHookState* state) {
+  GlobalData* global_data = GetGlobalData();
+  GpuTimestampsData* gpu_timestamps_data =
+      global_data->settings.Get().gpu_timestamps != 0
+          ? global_data->gpu_timestamps_map.Get(DeviceKey(queue))
+          : nullptr;
+
+  state->start_ns = ClockNowNs();
+  if (gpu_timestamps_data != nullptr) {
+    AddTimestampCommandBuffers(device_data,
+                               gpu_timestamps_data->timestamps.get(), queue,
+                               submitCount, pSubmits, state);
+  }
+}
+
+void PostQueueSubmit(DeviceData* device_data, VkQueue queue, VkResult result,
+                     QueueSubmitHookState* state) {
+  uint64_t end_ns = ClockNowNs();
+
+  if (result != VK_SUCCESS && state->begins_frame) {
+    // The first timestamp was not written; a later submit begins the frame.
+    GpuTimestamps* timestamps = GetGlobalData()
+                                    ->gpu_timestamps_map.Get(DeviceKey(queue))
+                                    ->timestamps.get();
+    ScopedLock lock(timestamps->mutex);
+    if (timestamps->frame_queue == queue) {
+      timestamps->frame_queue = VK_NULL_HANDLE;
+    }
+  }
+
+  if (end_ns > state->start_ns && device_data->wait_totals) {
+    device_data->wait_totals->submit_ns.fetch_add(end_ns - state->start_ns,
+                                                  std::memory_order_relaxed);
+  }
+}
+
 }  // namespace gf_layers::frame_counter_layer
 
 //
@@ -571,7 +1802,7 @@ VkLayer_GF_frame_counterGetDeviceProcAddr(VkDevice device, const char* pName) {
   return gf_layers::frame_counter_layer::vkGetDeviceProcAddr(device, pName);
 }
 
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) && !defined(GF_LAYERS_FUSED_LAYER)
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount,
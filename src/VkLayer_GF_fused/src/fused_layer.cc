@@ -0,0 +1,843 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "VkLayer_GF_amber_scoop/fused_hooks.h"
+#include "VkLayer_GF_frame_counter/fused_hooks.h"
+#include "VkLayer_GF_fused/dispatch.h"
+#include "VkLayer_GF_shader_fuzzer/fused_hooks.h"
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/proc_table.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/util.h"
+
+// The fused layer hosts the other GF layers (the "sub-layers") in a single
+// library, so that enabling several of them only loads one library. The
+// sub-layers are compiled into this library unchanged and are chained
+// in-process: in vkCreateInstance and vkCreateDevice, we insert a layer link
+// for each enabled sub-layer into the layer info linked list before calling
+// the first sub-layer. Thus, each sub-layer sees the next sub-layer (or the
+// next real layer) as its next layer.
+//
+// For most functions, our vkGet*ProcAddr functions return the first
+// sub-layer's functions, which are resolved in-process down the chain. Since
+// each sub-layer returns the next layer's function for the functions that it
+// does not need, such a call goes directly to the only sub-layer that
+// intercepts it (e.g. vkQueuePresentKHR goes to frame_counter), or straight to
+// the next real layer.
+//
+// The functions that are intercepted by more than one sub-layer (vkQueueSubmit
+// and vkCreateShaderModule) are dispatched by this layer instead: we look up
+// our device data once, which holds each enabled sub-layer's device data, call
+// the sub-layers' pre-call hooks in chain order, call the next real layer's
+// function once, and then call the sub-layers' post-call hooks. Thus, the call
+// does not go through each sub-layer's entry point and device data lookup, as
+// it does when the layers are stacked by the loader. The LayerChain benchmarks
+// in gf_layers_bench measure both.
+
+// The exported entry points of the sub-layers. These are not exported from the
+// fused library.
+extern "C" {
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_frame_counterGetInstanceProcAddr(VkInstance instance,
+                                            const char* pName);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_frame_counterGetDeviceProcAddr(VkDevice device, const char* pName);
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_amber_scoopGetInstanceProcAddr(VkInstance instance,
+                                          const char* pName);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_amber_scoopGetDeviceProcAddr(VkDevice device, const char* pName);
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_shader_fuzzerGetInstanceProcAddr(VkInstance instance,
+                                            const char* pName);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_shader_fuzzerGetDeviceProcAddr(VkDevice device, const char* pName);
+
+}  // extern "C"
+
+namespace gf_layers::fused_layer {
+
+// The instance function pointers are in InstanceDispatchTable, which is
+// generated from vulkan_functions.txt. The "next" functions are those of the
+// first enabled sub-layer.
+struct InstanceData : InstanceDispatchTable {
+  VkInstance instance = VK_NULL_HANDLE;
+};
+
+// The device function pointers are in DeviceDispatchTable, which is generated
+// from vulkan_functions.txt. The "next" functions are those of the first
+// enabled sub-layer, except for the functions that we dispatch ourselves
+// (vkQueueSubmit and vkCreateShaderModule), which are those of the next real
+// layer.
+struct DeviceData : DeviceDispatchTable {
+  VkDevice device = VK_NULL_HANDLE;
+  InstanceData* instance_data = nullptr;
+
+  // The device data of the enabled sub-layers that intercept the functions
+  // that we dispatch ourselves, or nullptr. |frame_counter| is nullptr if
+  // frame_counter does not intercept vkQueueSubmit for this device.
+  frame_counter_layer::DeviceData* frame_counter = nullptr;
+  amber_scoop_layer::DeviceData* amber_scoop = nullptr;
+  bool shader_fuzzer = false;
+
+  // The order of the sub-layers in the chain, which is the order in which their
+  // pre-call hooks are called.
+  bool frame_counter_before_amber_scoop = false;
+  bool amber_scoop_before_shader_fuzzer = false;
+
+  // The intercepted functions (indices in kDeviceFunctionTable) that
+  // vkGetDeviceProcAddr returns for this device.
+  ProcSet needed_device_functions;
+};
+
+using InstanceMap = gf_layers::ProtectedTinyStaleMap<void*, InstanceData>;
+using DeviceMap = gf_layers::ProtectedTinyStaleMap<void*, DeviceData>;
+
+namespace {
+
+struct SubLayer {
+  // The name used in the VkLayer_GF_fused_LAYERS setting.
+  std::string_view name;
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+  PFN_vkGetDeviceProcAddr get_device_proc_addr;
+};
+
+const std::array<SubLayer, 3> kSubLayers{{
+    {"frame_counter", VkLayer_GF_frame_counterGetInstanceProcAddr,
+     VkLayer_GF_frame_counterGetDeviceProcAddr},
+    {"amber_scoop", VkLayer_GF_amber_scoopGetInstanceProcAddr,
+     VkLayer_GF_amber_scoopGetDeviceProcAddr},
+    {"shader_fuzzer", VkLayer_GF_shader_fuzzerGetInstanceProcAddr,
+     VkLayer_GF_shader_fuzzerGetDeviceProcAddr},
+}};
+
+// Returns the position of the sub-layer called |name| in |sub_layers|, or
+// |sub_layers.size()| if it is not enabled.
+std::size_t GetSubLayerPosition(const std::vector<const SubLayer*>& sub_layers,
+                                std::string_view name) {
+  std::size_t position = 0;
+  while (position < sub_layers.size() && sub_layers[position]->name != name) {
+    ++position;
+  }
+  return position;
+}
+
+// Read-only once initialized.
+struct FusedLayerSettings {
+  bool init = false;
+  // The enabled sub-layers, from the first (closest to the application) to the
+  // last.
+  std::vector<const SubLayer*> sub_layers;
+};
+
+struct GlobalData {
+  InstanceMap instance_map;
+  DeviceMap device_map;
+
+  // In vkCreateInstance, we initialize |settings| by reading environment
+  // variables while holding |settings_mutex|, after which |settings| is
+  // read-only.
+  gf_layers::MutexType settings_mutex;
+  FusedLayerSettings settings;
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+
+// Global variables (that are not constinit) are strongly discouraged.
+// However, we should be fine as long as all global data is stored in this
+// struct.
+GlobalData global_data_;  // NOLINT(cert-err58-cpp)
+#pragma clang diagnostic pop
+
+GlobalData* GetGlobalData() { return &global_data_; }
+
+const std::array<VkLayerProperties, 1> kLayerProperties{{{
+    "VkLayer_GF_fused",             // layerName
+    VK_MAKE_VERSION(1U, 1U, 130U),  // specVersion
+    1,                              // implementationVersion
+    "Fused GF layers.",             // description
+}}};
+
+bool IsThisLayer(const char* pLayerName) {
+  return ((pLayerName != nullptr) &&
+          strcmp(pLayerName, kLayerProperties[0].layerName) == 0);
+}
+
+//
+// The functions provided by this layer, used by our vkGet*ProcAddr functions.
+// The lists are generated from vulkan_functions.txt.
+//
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kDeviceFunctionTable =
+    MakeProcNameTable(std::array{GF_LAYERS_FUSED_DEVICE_HOOKS(HANDLE)});
+constexpr auto kInstanceFunctionTable =
+    MakeProcNameTable(std::array{GF_LAYERS_FUSED_INSTANCE_HOOKS(HANDLE)});
+#undef HANDLE
+
+static_assert(kDeviceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of device functions");
+static_assert(kInstanceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of instance functions");
+
+void InitSettingsIfNeeded() {
+  gf_layers::ScopedLock lock(GetGlobalData()->settings_mutex);
+
+  FusedLayerSettings& settings = GetGlobalData()->settings;
+
+  if (settings.init) {
+    return;
+  }
+  settings.init = true;
+
+  // A comma-separated list of sub-layers, in order. All sub-layers are enabled
+  // by default.
+  std::string sub_layer_names;
+  if (!GetSettingString("VkLayer_GF_fused_LAYERS", "debug.gf.fused.layers",
+                        &sub_layer_names)) {
+    for (const SubLayer& sub_layer : kSubLayers) {
+      settings.sub_layers.push_back(&sub_layer);
+    }
+    return;
+  }
+
+  std::string_view remaining(sub_layer_names);
+  while (!remaining.empty()) {
+    std::size_t comma = remaining.find(',');
+    std::string_view name = remaining.substr(0, comma);
+    remaining.remove_prefix(comma == std::string_view::npos ? remaining.size()
+                                                            : comma + 1);
+    if (name.empty()) {
+      continue;
+    }
+    const SubLayer* sub_layer = nullptr;
+    for (const SubLayer& candidate : kSubLayers) {
+      if (candidate.name == name) {
+        sub_layer = &candidate;
+        break;
+      }
+    }
+    if (sub_layer == nullptr) {
+      LOG_WARNING("Ignoring unknown sub-layer: %.*s",
+                  static_cast<int>(name.size()), name.data());
+      continue;
+    }
+    bool already_enabled = false;
+    for (const SubLayer* enabled : settings.sub_layers) {
+      already_enabled |= enabled == sub_layer;
+    }
+    if (already_enabled) {
+      LOG_WARNING("Ignoring repeated sub-layer: %.*s",
+                  static_cast<int>(name.size()), name.data());
+      continue;
+    }
+    settings.sub_layers.push_back(sub_layer);
+  }
+}
+
+// The following functions are standard Vulkan functions that most Vulkan layers
+// must implement.
+
+//
+// Our vkEnumerateInstanceLayerProperties function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
+    uint32_t* pPropertyCount, VkLayerProperties* pProperties) {
+  DEBUG_LOG("vkEnumerateInstanceLayerProperties");
+
+  if (pProperties == nullptr) {
+    *pPropertyCount = 1;
+    return VK_SUCCESS;
+  }
+
+  if (*pPropertyCount == 0) {
+    return VK_INCOMPLETE;
+  }
+
+  *pPropertyCount = 1;
+
+  *pProperties = kLayerProperties[0];
+
+  return VK_SUCCESS;
+}
+
+//
+// Our vkEnumerateDeviceLayerProperties function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
+    VkPhysicalDevice /*physicalDevice*/, uint32_t* pPropertyCount,
+    VkLayerProperties* pProperties) {
+  DEBUG_LOG(
+      "vkEnumerateDeviceLayerProperties (calling "
+      "vkEnumerateInstanceLayerProperties)");
+
+  return vkEnumerateInstanceLayerProperties(pPropertyCount, pProperties);
+}
+
+//
+// Our vkEnumerateInstanceExtensionProperties function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
+    const char* pLayerName, uint32_t* pPropertyCount,
+    VkExtensionProperties* /*pProperties*/) {
+  DEBUG_LOG("vkEnumerateInstanceExtensionProperties");
+
+  if (!IsThisLayer(pLayerName)) {
+    return VK_ERROR_LAYER_NOT_PRESENT;
+  }
+  *pPropertyCount = 0;
+  return VK_SUCCESS;
+}
+
+//
+// Our vkEnumerateDeviceExtensionProperties function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
+    VkPhysicalDevice physicalDevice, const char* pLayerName,
+    uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+  DEBUG_LOG("vkEnumerateDeviceExtensionProperties");
+
+  if (!IsThisLayer(pLayerName)) {
+    DEBUG_ASSERT(physicalDevice);
+
+    InstanceData* instance_data =
+        GetGlobalData()->instance_map.Get(InstanceKey(physicalDevice));
+
+    return instance_data->vkEnumerateDeviceExtensionProperties(
+        physicalDevice, pLayerName, pPropertyCount, pProperties);
+  }
+
+  *pPropertyCount = 0;
+  return VK_SUCCESS;
+}
+
+//
+// Our vkCreateInstance function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
+    const VkInstanceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkInstance* pInstance) {
+  DEBUG_LOG("vkCreateInstance");
+
+  InitSettingsIfNeeded();
+
+  const std::vector<const SubLayer*>& sub_layers =
+      GetGlobalData()->settings.sub_layers;
+
+  // Get the layer instance create info, which we need so we can:
+  // (a) obtain the next GetInstanceProcAddr function and;
+  // (b) replace the "layer info" linked list so that the sub-layers and then
+  //     the next layer will be able to get their layer info.
+
+  VkLayerInstanceCreateInfo* layer_instance_create_info =
+      GetLayerInstanceCreateInfo(pCreateInfo);
+
+  DEBUG_ASSERT(layer_instance_create_info);
+  DEBUG_ASSERT(layer_instance_create_info->u.pLayerInfo);
+
+  VkLayerInstanceLink* our_link = layer_instance_create_info->u.pLayerInfo;
+
+  // Insert a link for each sub-layer, working backwards from the next layer.
+  // The links only need to live until vkCreateInstance returns.
+  std::array<VkLayerInstanceLink, kSubLayers.size()> sub_layer_links{};
+  VkLayerInstanceLink* next_link = our_link->pNext;
+  PFN_vkGetInstanceProcAddr next_get_instance_proc_address =
+      our_link->pfnNextGetInstanceProcAddr;
+  for (std::size_t i = sub_layers.size(); i-- > 0;) {
+    VkLayerInstanceLink& link = sub_layer_links.at(i);
+    link.pNext = next_link;
+    link.pfnNextGetInstanceProcAddr = next_get_instance_proc_address;
+    if (next_link == our_link->pNext) {
+      link.pfnNextGetPhysicalDeviceProcAddr =
+          our_link->pfnNextGetPhysicalDeviceProcAddr;
+    }
+    next_link = &link;
+    next_get_instance_proc_address = sub_layers[i]->get_instance_proc_addr;
+  }
+
+  // From now on, the "next" layer is the first sub-layer (if any).
+
+  // Use it to get vkCreateInstance.
+  auto vkCreateInstance = reinterpret_cast<PFN_vkCreateInstance>(
+      next_get_instance_proc_address(nullptr, "vkCreateInstance"));
+
+  if (vkCreateInstance == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  // Replace the layer info before calling the next vkCreateInstance.
+  layer_instance_create_info->u.pLayerInfo = next_link;
+
+  VkResult result = vkCreateInstance(pCreateInfo, pAllocator, pInstance);
+
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  // Initialize our InstanceData, including all instance function pointers that
+  // we will need.
+
+  InstanceData instance_data{};
+
+  instance_data.instance = *pInstance;
+
+  if (!InitInstanceDispatchTable(*pInstance, next_get_instance_proc_address,
+                                 &instance_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  GetGlobalData()->instance_map.Put(InstanceKey(*pInstance), instance_data);
+
+  return result;
+}
+
+//
+// Our vkCreateDevice function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
+    VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  DEBUG_LOG("vkCreateDevice");
+
+  const std::vector<const SubLayer*>& sub_layers =
+      GetGlobalData()->settings.sub_layers;
+
+  // Get the layer device create info, which we need so we can:
+  // (a) obtain the next Get{Instance,Device}ProcAddr functions and;
+  // (b) replace the "layer info" linked list so that the sub-layers and then
+  //     the next layer will be able to get their layer info.
+
+  VkLayerDeviceCreateInfo* layer_device_create_info =
+      GetLayerDeviceCreateInfo(pCreateInfo);
+
+  DEBUG_ASSERT(layer_device_create_info);
+  DEBUG_ASSERT(layer_device_create_info->u.pLayerInfo);
+
+  VkLayerDeviceLink* our_link = layer_device_create_info->u.pLayerInfo;
+
+  // Insert a link for each sub-layer, as in vkCreateInstance.
+  std::array<VkLayerDeviceLink, kSubLayers.size()> sub_layer_links{};
+  VkLayerDeviceLink* next_link = our_link->pNext;
+  PFN_vkGetInstanceProcAddr next_get_instance_proc_address =
+      our_link->pfnNextGetInstanceProcAddr;
+  PFN_vkGetDeviceProcAddr next_get_device_proc_address =
+      our_link->pfnNextGetDeviceProcAddr;
+  // The next real layer's vkGetDeviceProcAddr, for the functions that we
+  // dispatch ourselves.
+  PFN_vkGetDeviceProcAddr next_layer_get_device_proc_address =
+      our_link->pfnNextGetDeviceProcAddr;
+  for (std::size_t i = sub_layers.size(); i-- > 0;) {
+    VkLayerDeviceLink& link = sub_layer_links.at(i);
+    link.pNext = next_link;
+    link.pfnNextGetInstanceProcAddr = next_get_instance_proc_address;
+    link.pfnNextGetDeviceProcAddr = next_get_device_proc_address;
+    next_link = &link;
+    next_get_instance_proc_address = sub_layers[i]->get_instance_proc_addr;
+    next_get_device_proc_address = sub_layers[i]->get_device_proc_addr;
+  }
+
+  // Warning: most guides suggest calling vkGetInstanceProcAddr here with a NULL
+  // instance but this appears to be invalid and so the next layer could fail.
+  // Thus, we get the instance_data associated with the physicalDevice so that
+  // we can pass the correct VkInstance.
+
+  InstanceData* instance_data =
+      GetGlobalData()->instance_map.Get(InstanceKey(physicalDevice));
+
+  // Use next_get_instance_proc_address to get vkCreateDevice.
+  auto vkCreateDevice =
+      reinterpret_cast<PFN_vkCreateDevice>(next_get_instance_proc_address(
+          instance_data->instance, "vkCreateDevice"));
+
+  if (vkCreateDevice == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  // Replace the layer info before calling the next vkCreateDevice.
+  layer_device_create_info->u.pLayerInfo = next_link;
+
+  // Call the next layer.
+  VkResult result =
+      vkCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  // Initialize our DeviceData, including all device function pointers that
+  // we will need.
+
+  DeviceData device_data{};
+  device_data.device = *pDevice;
+  device_data.instance_data = instance_data;
+
+  if (!InitDeviceDispatchTable(*pDevice, next_get_device_proc_address,
+                               &device_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  // The functions that we dispatch ourselves call the sub-layers' hooks and
+  // then the next real layer's function.
+  device_data.vkQueueSubmit = reinterpret_cast<PFN_vkQueueSubmit>(
+      next_layer_get_device_proc_address(*pDevice, "vkQueueSubmit"));
+  device_data.vkCreateShaderModule =
+      reinterpret_cast<PFN_vkCreateShaderModule>(
+          next_layer_get_device_proc_address(*pDevice,
+                                             "vkCreateShaderModule"));
+  if (device_data.vkQueueSubmit == nullptr ||
+      device_data.vkCreateShaderModule == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  std::size_t frame_counter_position =
+      GetSubLayerPosition(sub_layers, "frame_counter");
+  std::size_t amber_scoop_position =
+      GetSubLayerPosition(sub_layers, "amber_scoop");
+  std::size_t shader_fuzzer_position =
+      GetSubLayerPosition(sub_layers, "shader_fuzzer");
+
+  if (frame_counter_position != sub_layers.size()) {
+    device_data.frame_counter =
+        frame_counter_layer::GetQueueSubmitHookDeviceData(*pDevice);
+  }
+  if (amber_scoop_position != sub_layers.size()) {
+    device_data.amber_scoop = amber_scoop_layer::GetHookDeviceData(*pDevice);
+  }
+  device_data.shader_fuzzer = shader_fuzzer_position != sub_layers.size();
+  device_data.frame_counter_before_amber_scoop =
+      frame_counter_position < amber_scoop_position;
+  device_data.amber_scoop_before_shader_fuzzer =
+      amber_scoop_position < shader_fuzzer_position;
+
+  device_data.needed_device_functions.set(
+      kDeviceFunctionTable.IndexOf("vkGetDeviceProcAddr"));
+  device_data.needed_device_functions.set(
+      kDeviceFunctionTable.IndexOf("vkDestroyDevice"));
+  if (device_data.frame_counter != nullptr ||
+      device_data.amber_scoop != nullptr) {
+    device_data.needed_device_functions.set(
+        kDeviceFunctionTable.IndexOf("vkQueueSubmit"));
+  }
+  if (device_data.amber_scoop != nullptr || device_data.shader_fuzzer) {
+    device_data.needed_device_functions.set(
+        kDeviceFunctionTable.IndexOf("vkCreateShaderModule"));
+  }
+
+  GetGlobalData()->device_map.Put(DeviceKey(*pDevice), device_data);
+
+  return result;
+}
+
+//
+// Our vkDestroyDevice function.
+//
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+  DEBUG_LOG("vkDestroyDevice");
+
+  if (device == nullptr) {
+    return;
+  }
+
+  // Get the key before the device is destroyed, as the key is read from the
+  // device object.
+  void* device_key = DeviceKey(device);
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(device_key);
+
+  device_data->vkDestroyDevice(device, pAllocator);
+
+  global_data->device_map.Remove(device_key);
+}
+
+//
+// Our vkDestroyInstance function.
+//
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+  DEBUG_LOG("vkDestroyInstance");
+
+  if (instance == nullptr) {
+    return;
+  }
+
+  // Get the key before the instance is destroyed, as the key is read from the
+  // instance object.
+  void* instance_key = InstanceKey(instance);
+  GlobalData* global_data = GetGlobalData();
+  InstanceData* instance_data = global_data->instance_map.Get(instance_key);
+
+  instance_data->vkDestroyInstance(instance, pAllocator);
+
+  global_data->instance_map.Remove(instance_key);
+}
+
+//
+// Our vkQueueSubmit function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
+                                             uint32_t submitCount,
+                                             const VkSubmitInfo* pSubmits,
+                                             VkFence fence) {
+  DeviceData* device_data = GetGlobalData()->device_map.Get(DeviceKey(queue));
+
+  frame_counter_layer::QueueSubmitHookState frame_counter_state;
+  if (device_data->frame_counter != nullptr &&
+      device_data->frame_counter_before_amber_scoop) {
+    frame_counter_layer::PreQueueSubmit(device_data->frame_counter, queue,
+                                        &submitCount, &pSubmits,
+                                        &frame_counter_state);
+  }
+  if (device_data->amber_scoop != nullptr) {
+    amber_scoop_layer::PreQueueSubmit(device_data->amber_scoop, queue,
+                                      submitCount, pSubmits);
+  }
+  if (device_data->frame_counter != nullptr &&
+      !device_data->frame_counter_before_amber_scoop) {
+    frame_counter_layer::PreQueueSubmit(device_data->frame_counter, queue,
+                                        &submitCount, &pSubmits,
+                                        &frame_counter_state);
+  }
+
+  VkResult result =
+      device_data->vkQueueSubmit(queue, submitCount, pSubmits, fence);
+
+  if (device_data->frame_counter != nullptr) {
+    frame_counter_layer::PostQueueSubmit(device_data->frame_counter, queue,
+                                         result, &frame_counter_state);
+  }
+
+  return result;
+}
+
+//
+// Our vkCreateShaderModule function.
+//
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(
+    VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule) {
+  DeviceData* device_data = GetGlobalData()->device_map.Get(DeviceKey(device));
+
+  // amber_scoop records the create info that it was passed, which is the fuzzed
+  // shader if shader_fuzzer comes first in the chain.
+  const VkShaderModuleCreateInfo* amber_scoop_create_info = pCreateInfo;
+  shader_fuzzer_layer::CreateShaderModuleHookState shader_fuzzer_state;
+  if (device_data->shader_fuzzer) {
+    shader_fuzzer_layer::PreCreateShaderModule(&pCreateInfo,
+                                               &shader_fuzzer_state);
+    if (!device_data->amber_scoop_before_shader_fuzzer) {
+      amber_scoop_create_info = pCreateInfo;
+    }
+  }
+
+  VkResult result = device_data->vkCreateShaderModule(
+      device, pCreateInfo, pAllocator, pShaderModule);
+
+  if (result == VK_SUCCESS && device_data->amber_scoop != nullptr) {
+    amber_scoop_layer::PostCreateShaderModule(
+        device_data->amber_scoop, amber_scoop_create_info, *pShaderModule);
+  }
+
+  return result;
+}
+
+//
+// Our vkGetDeviceProcAddr function.
+//
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetDeviceProcAddr(VkDevice device, const char* pName) {
+  DEBUG_ASSERT(pName);
+
+  DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
+
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kDeviceFunctionTable.size()>
+      kDeviceFunctions = {GF_LAYERS_FUSED_DEVICE_HOOKS(HANDLE)};
+#undef HANDLE
+
+  std::size_t index = kDeviceFunctionTable.Find(pName);
+  if (index != kDeviceFunctionTable.size()) {
+    if (device == nullptr) {
+      return kDeviceFunctions[index];
+    }
+    const DeviceData* device_data =
+        GetGlobalData()->device_map.Get(DeviceKey(device));
+    if (device_data->needed_device_functions[index]) {
+      return kDeviceFunctions[index];
+    }
+    // Otherwise, no enabled sub-layer intercepts the function for this device,
+    // so we return the next layer's function (below).
+  }
+
+  if (device == nullptr) {
+    return nullptr;
+  }
+
+  // At this point, the function must be a device function that we are not
+  // intercepting, so we return the first sub-layer's function (which may be
+  // the next layer's function).
+  return GetGlobalData()
+      ->device_map.Get(DeviceKey(device))
+      ->vkGetDeviceProcAddr(device, pName);
+}
+
+//
+// Our vkGetInstanceProcAddr function.
+//
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
+  DEBUG_ASSERT(pName);
+
+  DEBUG_LOG("vkGetInstanceProcAddr: %s", pName);
+
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kInstanceFunctionTable.size()>
+      kInstanceFunctions = {GF_LAYERS_FUSED_INSTANCE_HOOKS(HANDLE)};
+#undef HANDLE
+
+  PFN_vkVoidFunction result =
+      kInstanceFunctionTable.Lookup(pName, kInstanceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
+  // We could move this up, as instance must be non-null in all but a few cases.
+  // But it is not the job of this layer to detect invalid calls, so we can just
+  // leave this check until the last possible moment.
+  if (instance == nullptr) {
+    return nullptr;
+  }
+
+  // At this point, the function must really be an instance function (as opposed
+  // to a global function) that we are not intercepting, so we return the first
+  // sub-layer's function (which may be the next layer's function).
+  return GetGlobalData()
+      ->instance_map.Get(InstanceKey(instance))
+      ->vkGetInstanceProcAddr(instance, pName);
+}
+
+}  // namespace
+}  // namespace gf_layers::fused_layer
+
+//
+// Exported functions.
+//
+
+extern "C" {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wmissing-prototypes"
+#pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+VkLayer_GF_fusedNegotiateLoaderLayerInterfaceVersion(
+    VkNegotiateLayerInterface* pVersionStruct) {
+  DEBUG_LOG(
+      "Entry point: VkLayer_GF_fusedNegotiateLoaderLayerInterfaceVersion");
+
+  DEBUG_ASSERT(pVersionStruct);
+  DEBUG_ASSERT(pVersionStruct->sType == LAYER_NEGOTIATE_INTERFACE_STRUCT);
+
+  pVersionStruct->pfnGetInstanceProcAddr =
+      gf_layers::fused_layer::vkGetInstanceProcAddr;
+  pVersionStruct->pfnGetDeviceProcAddr =
+      gf_layers::fused_layer::vkGetDeviceProcAddr;
+  pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+
+  if (pVersionStruct->loaderLayerInterfaceVersion >
+      CURRENT_LOADER_LAYER_INTERFACE_VERSION) {
+    pVersionStruct->loaderLayerInterfaceVersion =
+        CURRENT_LOADER_LAYER_INTERFACE_VERSION;
+  }
+
+  return VK_SUCCESS;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_fusedGetInstanceProcAddr(VkInstance instance, const char* pName) {
+  DEBUG_LOG("Entry point: VkLayer_GF_fusedGetInstanceProcAddr");
+
+  return gf_layers::fused_layer::vkGetInstanceProcAddr(instance, pName);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+VkLayer_GF_fusedGetDeviceProcAddr(VkDevice device, const char* pName) {
+  DEBUG_LOG("Entry point: VkLayer_GF_fusedGetDeviceProcAddr");
+
+  return gf_layers::fused_layer::vkGetDeviceProcAddr(device, pName);
+}
+
+// On Android, the loader looks up the enumerate functions by name, so the
+// sub-layers do not define them when GF_LAYERS_FUSED_LAYER is defined.
+#if defined(__ANDROID__)
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount,
+                                   VkLayerProperties* pProperties) {
+  DEBUG_LOG("Entry point: vkEnumerateInstanceLayerProperties");
+
+  return gf_layers::fused_layer::vkEnumerateInstanceLayerProperties(
+      pPropertyCount, pProperties);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
+    VkPhysicalDevice physicalDevice, uint32_t* pPropertyCount,
+    VkLayerProperties* pProperties) {
+  DEBUG_LOG("Entry point: vkEnumerateDeviceLayerProperties");
+
+  return gf_layers::fused_layer::vkEnumerateDeviceLayerProperties(
+      physicalDevice, pPropertyCount, pProperties);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateInstanceExtensionProperties(const char* pLayerName,
+                                       uint32_t* pPropertyCount,
+                                       VkExtensionProperties* pProperties) {
+  DEBUG_LOG("Entry point: vkEnumerateInstanceExtensionProperties");
+
+  return gf_layers::fused_layer::vkEnumerateInstanceExtensionProperties(
+      pLayerName, pPropertyCount, pProperties);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice,
+                                     const char* pLayerName,
+                                     uint32_t* pPropertyCount,
+                                     VkExtensionProperties* pProperties) {
+  DEBUG_LOG("Entry point: vkEnumerateDeviceExtensionProperties");
+
+  return gf_layers::fused_layer::vkEnumerateDeviceExtensionProperties(
+      physicalDevice, pLayerName, pPropertyCount, pProperties);
+}
+
+#endif
+
+#pragma clang diagnostic pop
+
+}  // extern "C"
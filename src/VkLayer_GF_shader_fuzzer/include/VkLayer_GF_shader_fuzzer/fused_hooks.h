@@ -0,0 +1,44 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VKLAYER_GF_SHADER_FUZZER_FUSED_HOOKS_H
+#define VKLAYER_GF_SHADER_FUZZER_FUSED_HOOKS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// The hooks of the functions that this layer intercepts along with other
+// layers hosted by VkLayer_GF_fused, which calls them after looking up the
+// device once per call; see fused_layer.cc. Our own entry points call the same
+// hooks.
+
+namespace gf_layers::shader_fuzzer_layer {
+
+// Holds the fuzzed shader that |PreCreateShaderModule| passes on.
+struct CreateShaderModuleHookState {
+  std::vector<uint32_t> fuzzed;
+  VkShaderModuleCreateInfo create_info = {};
+};
+
+// Called before the next layer's vkCreateShaderModule. If the shader could be
+// fuzzed, |*pCreateInfo| is replaced by a create info in |state| that is
+// identical except for the fuzzed shader.
+void PreCreateShaderModule(const VkShaderModuleCreateInfo** pCreateInfo,
+                           CreateShaderModuleHookState* state);
+
+}  // namespace gf_layers::shader_fuzzer_layer
+
+#endif  // VKLAYER_GF_SHADER_FUZZER_FUSED_HOOKS_H
@@ -18,100 +18,40 @@
 #include <array>
 #include <atomic>
 #include <cinttypes>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
-#include <functional>  // IWYU pragma: keep
 #include <iomanip>
-#include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "VkLayer_GF_shader_fuzzer/dispatch.h"
+#include "VkLayer_GF_shader_fuzzer/fused_hooks.h"
 #include "absl/types/span.h"
+#include "gf_layers_layer_util/file_writer.h"
+#include "gf_layers_layer_util/instrumentation.h"
+#include "gf_layers_layer_util/live_stats.h"
 #include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/proc_table.h"
 #include "gf_layers_layer_util/settings.h"
-#include "gf_layers_layer_util/spirv.h"
+#include "gf_layers_layer_util/spirv_tools.h"
 #include "gf_layers_layer_util/util.h"
 
-#pragma GCC diagnostic push  // Clang, GCC.
-#pragma warning(push, 1)     // MSVC: also reduces warning level to W1.
-
-#if defined(__GNUC__)
-#pragma GCC diagnostic ignored "-Wpragmas"
-#endif
-
-// TODO(paulthomson): These are protobuf warning suppressions that could be
-//  moved upstream to SPIRV-Tools or fixed in protobuf.
-#pragma GCC diagnostic ignored "-Wreserved-id-macro"
-#pragma GCC diagnostic ignored "-Wdeprecated-dynamic-exception-spec"
-#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
-#pragma GCC diagnostic ignored "-Wsign-conversion"
-#pragma GCC diagnostic ignored "-Wextra-semi-stmt"
-#pragma GCC diagnostic ignored "-Winconsistent-missing-destructor-override"
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-
-// TODO(paulthomson): SPIRV-Tools warning suppressions.
-#pragma GCC diagnostic ignored "-Wnewline-eof"
-#pragma GCC diagnostic ignored "-Wswitch-enum"
-#pragma GCC diagnostic ignored "-Wold-style-cast"
-#pragma GCC diagnostic ignored "-Wweak-vtables"
-
-// behavior change:
-// __is_pod(google::protobuf::internal::AuxiliaryParseTableField) has different
-// value in previous versions
-#pragma warning(disable : 4647)
-
-// reinterpret_cast used between related classes:
-// 'google::protobuf::SourceContext' and 'google::protobuf::MessageLite'
-#pragma warning(disable : 4946)
-
-// 'initializing': conversion from '_Ty' to '_Ty1', signed/unsigned mismatch
-#pragma warning(disable : 4365)
-
-#include "google/protobuf/stubs/status.h"
-#include "google/protobuf/util/json_util.h"
-#include "source/fuzz/fuzzer.h"
-#include "source/fuzz/fuzzer_util.h"
-#include "source/fuzz/protobufs/spvtoolsfuzz.pb.h"
-#include "source/fuzz/pseudo_random_generator.h"
-#include "source/fuzz/random_generator.h"
-#include "spirv-tools/libspirv.h"
-#include "spirv-tools/libspirv.hpp"
-#include "tools/io.h"
-
-#pragma warning(pop)
-#pragma GCC diagnostic pop
-
 namespace gf_layers::shader_fuzzer_layer {
 
-struct InstanceData {
-  VkInstance instance;
-
-  // Most layers must store this. Required to implement vkGetInstanceProcAddr.
-  // Should not be used otherwise; all required instance function pointers
-  // should be obtained during vkCreateInstance.
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
-
-  // Most layers must store this. Required to implement
-  // vkEnumerateDeviceExtensionProperties.
-  PFN_vkEnumerateDeviceExtensionProperties vkEnumerateDeviceExtensionProperties;
-
-  // Other instance functions: (none)
+// The instance function pointers are in InstanceDispatchTable, which is
+// generated from vulkan_functions.txt.
+struct InstanceData : InstanceDispatchTable {
+  VkInstance instance = VK_NULL_HANDLE;
 };
 
-struct DeviceData {
-  VkDevice device;
-  InstanceData* instance_data;
-
-  // Most layers must store this. Required to implement vkGetDeviceProcAddr.
-  // Should not be used otherwise; all required device function pointers
-  // should be obtained during vkCreateDevice.
-  PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
-
-  // Other device functions:
-
-  PFN_vkCreateShaderModule vkCreateShaderModule;
+// The device function pointers are in DeviceDispatchTable, which is generated
+// from vulkan_functions.txt.
+struct DeviceData : DeviceDispatchTable {
+  VkDevice device = VK_NULL_HANDLE;
+  InstanceData* instance_data = nullptr;
 };
 
 using InstanceMap = gf_layers::ProtectedTinyStaleMap<void*, InstanceData>;
@@ -204,102 +144,6 @@ std::vector<uint32_t> TryFuzzingShader(
   absl::Span<const uint32_t> code =
       absl::MakeConstSpan(pCreateInfo->pCode, pCreateInfo->codeSize / 4);
 
-  uint32_t version_word = code[1];
-
-  uint8_t major_version = GetSpirvVersionMajorPart(version_word);
-  uint8_t minor_version = GetSpirvVersionMinorPart(version_word);
-
-  if (major_version != 1) {
-    LOG("Unknown SPIR-V major version %u; shader %" PRIu64
-        " will not be fuzzed.",
-        major_version, shader_module_number);
-    return {};
-  }
-
-  spv_target_env target_env;  // NOLINT(cppcoreguidelines-init-variables)
-
-  switch (minor_version) {
-    case 0:
-      target_env = SPV_ENV_UNIVERSAL_1_0;
-      break;
-    case 1:
-      target_env = SPV_ENV_UNIVERSAL_1_1;
-      break;
-    case 2:
-      target_env = SPV_ENV_UNIVERSAL_1_2;
-      break;
-    case 3:
-      target_env = SPV_ENV_UNIVERSAL_1_3;
-      break;
-    case 4:
-      target_env = SPV_ENV_UNIVERSAL_1_4;
-      break;
-    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    case 5:
-      target_env = SPV_ENV_UNIVERSAL_1_5;
-      break;
-    default:
-      LOG("Unknown SPIR-V minor version %u; shader %" PRIu64
-          " will not be fuzzed.",
-          minor_version, shader_module_number);
-      return std::vector<uint32_t>();
-  }
-
-  spvtools::SpirvTools tools(target_env);
-
-  if (!tools.IsValid()) {
-    LOG("Did not manage to create a SPIRV-Tools instance; shaders will not be "
-        "fuzzed.");
-    return {};
-  }
-
-  // Create a fuzzer and the various parameters required for fuzzing.
-  spvtools::ValidatorOptions validator_options;
-  std::vector<uint32_t> binary_in(code.begin(), code.end());
-
-  spvtools::fuzz::protobufs::FactSequence no_facts;
-  std::vector<spvtools::fuzz::fuzzerutil::ModuleSupplier> no_donors;
-
-  spvtools::MessageConsumer message_consumer =
-      [](spv_message_level_t level, const char* source,
-         const spv_position_t& position, const char* message) {
-        (void)source;  // This parameter is deliberately unused.
-        switch (level) {
-          case SPV_MSG_FATAL:
-          case SPV_MSG_INTERNAL_ERROR:
-          case SPV_MSG_ERROR:
-            LOG("error: line %zu: %s", position.index, message);
-            break;
-          case SPV_MSG_WARNING:
-            LOG("warning: line %zu: %s", position.index, message);
-            break;
-          case SPV_MSG_INFO:
-            LOG("info: line %zu: %s", position.index, message);
-            break;
-          case SPV_MSG_DEBUG:
-            LOG("debug: line %zu: %s", position.index, message);
-            break;
-        }
-      };
-
-  // Fuzz the shader.
-  auto fuzzer_result =
-      spvtools::fuzz::Fuzzer(
-          target_env, message_consumer, binary_in, no_facts, no_donors,
-          std::make_unique<spvtools::fuzz::PseudoRandomGenerator>(
-              static_cast<uint32_t>(shader_module_number)),
-          false,
-          spvtools::fuzz::Fuzzer::RepeatedPassStrategy::
-              kLoopedWithRecommendations,
-          true, validator_options)
-          .Run();
-
-  if (fuzzer_result.status !=
-      spvtools::fuzz::Fuzzer::FuzzerResultStatus::kComplete) {
-    LOG("Fuzzing failed.");
-    return {};
-  }
-
   // Get the shader module number as a string.
   std::string shader_module_number_padded;
   {
@@ -310,93 +154,43 @@ std::vector<uint32_t> TryFuzzingShader(
     shader_module_number_padded = shader_module_number_stream.str();
   }
 
-  // Write out the original shader module.
-  {
-    std::stringstream original_shader_binary_name;
-    original_shader_binary_name << global_data->settings.output_prefix << "_"
-                                << shader_module_number_padded
-                                << "_original.spv";
-    WriteFile<uint32_t>(original_shader_binary_name.str().c_str(), "wb",
-                        code.data(), code.size());
-  }
+  std::string output_prefix = global_data->settings.output_prefix + "_" +
+                              shader_module_number_padded;
 
-  // Write out the fuzzed shader module
-  {
-    std::stringstream fuzzed_shader_binary_name;
-    fuzzed_shader_binary_name << global_data->settings.output_prefix << "_"
-                              << shader_module_number_padded << "_fuzzed.spv";
-    WriteFile<uint32_t>(fuzzed_shader_binary_name.str().c_str(), "wb",
-                        fuzzer_result.transformed_binary.data(),
-                        fuzzer_result.transformed_binary.size());
+  // Fuzz the shader. This loads the gf_layers_spirv_tools library on first
+  // use; the applied transformations are written out by the library.
+  std::vector<uint32_t> fuzzed;
+  if (!FuzzSpirv(code.data(), code.size(),
+                 static_cast<uint32_t>(shader_module_number),
+                 output_prefix + "_fuzzed", &fuzzed)) {
+    LOG("Shader %" PRIu64 " was not fuzzed.", shader_module_number);
+    return {};
   }
 
-  // Write out the transformations
-  {
-    std::stringstream transformations_name;
-    transformations_name << global_data->settings.output_prefix << "_"
-                         << shader_module_number_padded
-                         << "_fuzzed.transformations";
-    std::ofstream transformations_file(transformations_name.str(),
-                                       std::ios::out | std::ios::binary);
-    fuzzer_result.applied_transformations.SerializeToOstream(
-        &transformations_file);
-  }
+  // Write out the original shader module. The application owns |code|, so
+  // it is copied.
+  WriteFileAsync(output_prefix + "_original.spv",
+                 WriteBuffer(std::vector<uint32_t>(code.begin(), code.end())));
 
-  // Write out the transformations in JSON format
-  {
-    std::stringstream transformations_json_name;
-    transformations_json_name << global_data->settings.output_prefix << "_"
-                              << shader_module_number_padded
-                              << "_fuzzed.transformations_json";
-
-    std::string json_string;
-    auto json_options = google::protobuf::util::JsonPrintOptions();
-    json_options.add_whitespace = true;
-
-    auto json_generation_status = google::protobuf::util::MessageToJsonString(
-        fuzzer_result.applied_transformations, &json_string, json_options);
-
-    if (json_generation_status == google::protobuf::util::Status::OK) {
-      std::ofstream transformations_json_file(transformations_json_name.str());
-      transformations_json_file << json_string;
-    }
-  }
+  // Write out the fuzzed shader module
+  WriteFileAsync(output_prefix + "_fuzzed.spv", WriteBuffer(fuzzed));
+
+  AddLiveStat(LiveStatsValue::kFuzzedShaders, 1);
 
-  return fuzzer_result.transformed_binary;
+  return fuzzed;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(
     VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule) {
-  GlobalData* global_data = GetGlobalData();
-  DeviceData* device_data = global_data->device_map.Get(DeviceKey(device));
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
+  DeviceData* device_data = GetGlobalData()->device_map.Get(DeviceKey(device));
 
-  // Fuzzing the provided shader will either yield an empty vector - if
-  // something went wrong - or a vector whose contents is the fuzzed shader
-  // binary.
-  std::vector<uint32_t> fuzzed = TryFuzzingShader(pCreateInfo, global_data);
-
-  // If we did not succeed in fuzzing the shader, just call the original
-  // function.
-  if (fuzzed.empty()) {
-    return device_data->vkCreateShaderModule(device, pCreateInfo, pAllocator,
-                                             pShaderModule);
-  }
+  CreateShaderModuleHookState state;
+  PreCreateShaderModule(&pCreateInfo, &state);
 
-  // We succeeded in fuzzing the shader, so pass on a pointer to a new
-  // VkShaderModuleCreateInfo object identical to the original, except with
-  // the fuzzed shader data.
-  VkShaderModuleCreateInfo fuzzed_shader_module_create_info{
-      pCreateInfo->sType,  // sType
-      pCreateInfo->pNext,  // pNext
-      pCreateInfo->flags,  // flags
-      fuzzed.size() * 4,   // codeSize
-      fuzzed.data(),       // pCode
-  };
-
-  // Call the original function with our create info.
-  return device_data->vkCreateShaderModule(
-      device, &fuzzed_shader_module_create_info, pAllocator, pShaderModule);
+  return device_data->vkCreateShaderModule(device, pCreateInfo, pAllocator,
+                                           pShaderModule);
 }
 
 // The following functions are standard Vulkan functions that most Vulkan layers
@@ -407,6 +201,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(
 //
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
     uint32_t* pPropertyCount, VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG("vkEnumerateInstanceLayerProperties");
 
   if (pProperties == nullptr) {
@@ -431,6 +226,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
     VkPhysicalDevice /*physicalDevice*/, uint32_t* pPropertyCount,
     VkLayerProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG(
       "vkEnumerateDeviceLayerProperties (calling "
       "vkEnumerateInstanceLayerProperties)");
@@ -444,6 +240,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
     const char* pLayerName, uint32_t* pPropertyCount,
     VkExtensionProperties* /*pProperties*/) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG("vkEnumerateInstanceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -459,6 +256,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
     VkPhysicalDevice physicalDevice, const char* pLayerName,
     uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG("vkEnumerateDeviceExtensionProperties");
 
   if (!IsThisLayer(pLayerName)) {
@@ -481,6 +279,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
     const VkInstanceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkInstance* pInstance) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG("vkCreateInstance");
 
   InitSettingsIfNeeded();
@@ -525,18 +324,11 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 
   instance_data.instance = *pInstance;
 
-#define HANDLE(func)                                      \
-  instance_data.func = reinterpret_cast<PFN_##func>(      \
-      next_get_instance_proc_address(*pInstance, #func)); \
-  if (!instance_data.func) {                              \
-    return VK_ERROR_INITIALIZATION_FAILED;                \
+  if (!InitInstanceDispatchTable(*pInstance, next_get_instance_proc_address,
+                                 &instance_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-#undef HANDLE
-
-  instance_data.vkGetInstanceProcAddr = next_get_instance_proc_address;
-
   GetGlobalData()->instance_map.Put(InstanceKey(*pInstance), instance_data);
 
   return result;
@@ -548,6 +340,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
     VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_LOG("vkCreateDevice");
 
   // Get the layer device create info, which we need so we can:
@@ -603,47 +396,101 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
   device_data.device = *pDevice;
   device_data.instance_data = instance_data;
 
-#define HANDLE(func)                                  \
-  device_data.func = reinterpret_cast<PFN_##func>(    \
-      next_get_device_proc_address(*pDevice, #func)); \
-  if (!device_data.func) {                            \
-    return VK_ERROR_INITIALIZATION_FAILED;            \
+  if (!InitDeviceDispatchTable(*pDevice, next_get_device_proc_address,
+                               &device_data)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
   }
 
-  HANDLE(vkCreateShaderModule)
+  GetGlobalData()->device_map.Put(DeviceKey(*pDevice), device_data);
 
-#undef HANDLE
+  return result;
+}
 
-  device_data.vkGetDeviceProcAddr = next_get_device_proc_address;
+//
+// Our vkDestroyDevice function.
+//
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
+  DEBUG_LOG("vkDestroyDevice");
 
-  GetGlobalData()->device_map.Put(DeviceKey(*pDevice), device_data);
+  if (device == nullptr) {
+    return;
+  }
 
-  return result;
+  // Get the key before the device is destroyed, as the key is read from the
+  // device object.
+  void* device_key = DeviceKey(device);
+  GlobalData* global_data = GetGlobalData();
+  DeviceData* device_data = global_data->device_map.Get(device_key);
+
+  device_data->vkDestroyDevice(device, pAllocator);
+
+  global_data->device_map.Remove(device_key);
+
+  GF_LAYERS_DUMP_INSTRUMENTATION("VkLayer_GF_shader_fuzzer");
 }
 
 //
-// Our vkGetDeviceProcAddr function.
+// Our vkDestroyInstance function.
 //
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
-vkGetDeviceProcAddr(VkDevice device, const char* pName) {
-  DEBUG_ASSERT(pName);
-  DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
+  DEBUG_LOG("vkDestroyInstance");
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
+  if (instance == nullptr) {
+    return;
   }
 
-  // The device functions provided by this layer:
+  // Get the key before the instance is destroyed, as the key is read from the
+  // instance object.
+  void* instance_key = InstanceKey(instance);
+  GlobalData* global_data = GetGlobalData();
+  InstanceData* instance_data = global_data->instance_map.Get(instance_key);
 
-  // Standard device functions that most layers must implement:
-  HANDLE(vkGetDeviceProcAddr)  // Self-reference.
+  instance_data->vkDestroyInstance(instance, pAllocator);
 
-  // Other device functions that this layer intercepts:
-  HANDLE(vkCreateShaderModule)
+  global_data->instance_map.Remove(instance_key);
+}
+
+//
+// The functions provided by this layer, used by our vkGet*ProcAddr functions.
+// The lists are generated from vulkan_functions.txt.
+//
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kDeviceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_SHADER_FUZZER_DEVICE_HOOKS(HANDLE)});
+constexpr auto kInstanceFunctionTable = MakeProcNameTable(
+    std::array{GF_LAYERS_SHADER_FUZZER_INSTANCE_HOOKS(HANDLE)});
+#undef HANDLE
+
+static_assert(kDeviceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of device functions");
+static_assert(kInstanceFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of instance functions");
+
+//
+// Our vkGetDeviceProcAddr function.
+//
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetDeviceProcAddr(VkDevice device, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
+  DEBUG_ASSERT(pName);
+  DEBUG_LOG("vkGetDeviceProcAddr: %s", pName);
 
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kDeviceFunctionTable.size()>
+      kDeviceFunctions = {GF_LAYERS_SHADER_FUZZER_DEVICE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  PFN_vkVoidFunction result =
+      kDeviceFunctionTable.Lookup(pName, kDeviceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
   if (device == nullptr) {
     return nullptr;
   }
@@ -662,33 +509,22 @@ vkGetDeviceProcAddr(VkDevice device, const char* pName) {
 //
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
 vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
+  GF_LAYERS_SCOPED_TIMER("VkLayer_GF_shader_fuzzer");
   DEBUG_ASSERT(pName);
 
   DEBUG_LOG("vkGetInstanceProcAddr: %s", pName);
 
-#define HANDLE(func)                                   \
-  if (strcmp(pName, #func) == 0) {                     \
-    return reinterpret_cast<PFN_vkVoidFunction>(func); \
-  }
-
-  // The global and instance functions provided by this layer:
-
-  // The standard introspection functions.
-  HANDLE(vkEnumerateInstanceLayerProperties)
-  HANDLE(vkEnumerateDeviceLayerProperties)
-  HANDLE(vkEnumerateInstanceExtensionProperties)
-  HANDLE(vkEnumerateDeviceExtensionProperties)
-
-  // Standard functions that most layers must implement:
-  HANDLE(vkCreateInstance)
-  HANDLE(vkCreateDevice)
-  HANDLE(vkGetInstanceProcAddr)  // Self-reference.
-  HANDLE(vkGetDeviceProcAddr)
-
-  // Other instance functions that this layer intercepts: (none)
-
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kInstanceFunctionTable.size()>
+      kInstanceFunctions = {GF_LAYERS_SHADER_FUZZER_INSTANCE_HOOKS(HANDLE)};
 #undef HANDLE
 
+  PFN_vkVoidFunction result =
+      kInstanceFunctionTable.Lookup(pName, kInstanceFunctions);
+  if (result != nullptr) {
+    return result;
+  }
+
   // We could move this up, as instance must be non-null in all but a few cases.
   // But it is not the job of this layer to detect invalid calls, so we can just
   // leave this check until the last possible moment.
@@ -707,6 +543,39 @@ vkGetInstanceProcAddr(VkInstance instance, const char* pName) {
 }
 
 }  // namespace
+
+//
+// The hooks called by VkLayer_GF_fused; see fused_hooks.h.
+//
+
+void PreCreateShaderModule(const VkShaderModuleCreateInfo** pCreateInfo,
+                           CreateShaderModuleHookState* state) {
+  LayerCpuTimer layer_cpu_timer;
+
+  // Fuzzing the provided shader will either yield an empty vector - if
+  // something went wrong - or a vector whose contents is the fuzzed shader
+  // binary.
+  state->fuzzed = TryFuzzingShader(*pCreateInfo, GetGlobalData());
+
+  // If we did not succeed in fuzzing the shader, the original create info is
+  // passed on.
+  if (state->fuzzed.empty()) {
+    return;
+  }
+
+  // We succeeded in fuzzing the shader, so pass on a pointer to a new
+  // VkShaderModuleCreateInfo object identical to the original, except with
+  // the fuzzed shader data.
+  state->create_info = {
+      (*pCreateInfo)->sType,     // sType
+      (*pCreateInfo)->pNext,     // pNext
+      (*pCreateInfo)->flags,     // flags
+      state->fuzzed.size() * 4,  // codeSize
+      state->fuzzed.data(),      // pCode
+  };
+  *pCreateInfo = &state->create_info;
+}
+
 }  // namespace gf_layers::shader_fuzzer_layer
 
 //
@@ -759,7 +628,7 @@ VkLayer_GF_shader_fuzzerGetDeviceProcAddr(VkDevice device, const char* pName) {
   return gf_layers::shader_fuzzer_layer::vkGetDeviceProcAddr(device, pName);
 }
 
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) && !defined(GF_LAYERS_FUSED_LAYER)
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount,
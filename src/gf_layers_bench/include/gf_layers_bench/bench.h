@@ -0,0 +1,104 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_BENCH_BENCH_H
+#define GF_LAYERS_BENCH_BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A minimal benchmark harness. We avoid depending on a benchmark library so
+// that the benchmarks build wherever the layers build (including Android).
+
+namespace gf_layers::bench {
+
+struct BenchmarkResult {
+  std::string name;
+  std::size_t threads = 0;
+  // Total number of operations performed across all threads.
+  std::uint64_t operations = 0;
+  // Wall-clock time for all threads to complete their operations.
+  std::uint64_t elapsed_ns = 0;
+};
+
+class Reporter {
+ public:
+  // Only benchmarks whose name contains |filter| are run.
+  explicit Reporter(std::string filter);
+
+  bool ShouldRun(const std::string& name) const;
+
+  // Prints |result|: the time per operation on each thread (which stays flat
+  // when a benchmark scales linearly) and the aggregate throughput.
+  void Report(const BenchmarkResult& result);
+
+  // Writes all reported results to |file_path| as JSON, so that results can
+  // be compared across commits. Returns false if the file could not be
+  // written.
+  bool WriteJson(const std::string& file_path) const;
+
+ private:
+  std::string filter_;
+  std::vector<BenchmarkResult> results_;
+};
+
+// Runs |body(thread_index)| on |num_threads| threads that are released
+// together, and returns the wall-clock time in nanoseconds from their release
+// until the last thread has finished.
+std::uint64_t RunOnThreads(
+    std::size_t num_threads,
+    const std::function<void(std::size_t thread_index)>& body);
+
+// Returns the thread counts to benchmark: powers of two up to (and including)
+// the number of hardware threads.
+std::vector<std::size_t> GetThreadCounts();
+
+// Prevents the compiler from optimizing away the computation of |value|.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(_MSC_VER)
+  static_cast<void>(*static_cast<const volatile char*>(
+      static_cast<const volatile void*>(&value)));
+#else
+  asm volatile("" : : "r,m"(value) : "memory");  // NOLINT
+#endif
+}
+
+// Benchmark suites; each is implemented in its own file.
+
+void RunMapBenchmarks(Reporter* reporter);
+
+void RunClockBenchmarks(Reporter* reporter);
+
+void RunThreadPoolBenchmarks(Reporter* reporter);
+
+void RunFileWriterBenchmarks(Reporter* reporter);
+
+void RunDispatchKeyBenchmarks(Reporter* reporter);
+
+void RunProcTableBenchmarks(Reporter* reporter);
+
+void RunLayerChainBenchmarks(Reporter* reporter);
+
+void RunWorkloadBenchmarks(Reporter* reporter);
+
+// Must run before any benchmark that loads the layer libraries.
+void RunStartupBenchmarks(Reporter* reporter);
+
+}  // namespace gf_layers::bench
+
+#endif  // GF_LAYERS_BENCH_BENCH_H
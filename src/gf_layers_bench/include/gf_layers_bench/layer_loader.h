@@ -0,0 +1,85 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_BENCH_LAYER_LOADER_H
+#define GF_LAYERS_BENCH_LAYER_LOADER_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A minimal Vulkan loader for benchmarking the layers: it loads layer
+// libraries, chains them in front of the null driver (see
+// gf_layers_null_driver/null_driver.h), and creates an instance and device
+// through the chain. Not available on Windows.
+
+namespace gf_layers::bench {
+
+struct LayerEntryPoints {
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr = nullptr;
+  PFN_vkGetDeviceProcAddr get_device_proc_addr = nullptr;
+};
+
+// Returns the path of the shared library |library_name| (e.g.
+// "VkLayer_GF_frame_counter") in the directory given by
+// GF_LAYERS_BENCH_LAYER_DIR, which is the current directory by default.
+std::string GetLibraryPath(const std::string& library_name);
+
+// Loads the layer library for |layer_name| and negotiates the loader-layer
+// interface. The library is never unloaded. Returns false (and prints a
+// message) if the library could not be loaded.
+//
+// The layers are configured so that they do their usual work on every call but
+// have no visible effect: frame_counter counts frames but never logs, and
+// amber_scoop tracks commands but never captures a draw call.
+bool LoadLayer(const std::string& layer_name, LayerEntryPoints* result);
+
+// An instance and device created through a chain of layers. With no layers,
+// calls go straight to the null driver.
+class LayerChain {
+ public:
+  explicit LayerChain(std::vector<LayerEntryPoints> layers);
+
+  LayerChain(const LayerChain&) = delete;
+  LayerChain& operator=(const LayerChain&) = delete;
+
+  // Destroys the device and instance, if they were created.
+  ~LayerChain();
+
+  bool CreateInstance();
+
+  // Creates a device with |queue_count| queues (in a single queue family). Must
+  // be called after |CreateInstance|.
+  bool CreateDevice(std::uint32_t queue_count = 1);
+
+  PFN_vkVoidFunction GetInstanceProcAddr(const char* name) const;
+
+  PFN_vkVoidFunction GetDeviceProcAddr(const char* name) const;
+
+  // Returns queue |queue_index| of the device, obtained through the chain.
+  VkQueue GetQueue(std::uint32_t queue_index) const;
+
+  VkDevice device() const { return device_; }
+
+ private:
+  std::vector<LayerEntryPoints> layers_;
+  VkInstance instance_ = VK_NULL_HANDLE;
+  VkDevice device_ = VK_NULL_HANDLE;
+};
+
+}  // namespace gf_layers::bench
+
+#endif  // GF_LAYERS_BENCH_LAYER_LOADER_H
@@ -0,0 +1,179 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_bench/bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gf_layers::bench {
+
+namespace {
+
+double GetNsPerOperationPerThread(const BenchmarkResult& result) {
+  return result.operations == 0
+             ? 0.0
+             : static_cast<double>(result.elapsed_ns) *
+                   static_cast<double>(result.threads) /
+                   static_cast<double>(result.operations);
+}
+
+double GetMillionOperationsPerSecond(const BenchmarkResult& result) {
+  return result.elapsed_ns == 0 ? 0.0
+                                : static_cast<double>(result.operations) *
+                                      1e3 /
+                                      static_cast<double>(result.elapsed_ns);
+}
+
+std::string EscapeJsonString(const std::string& value) {
+  std::string result;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
+}
+
+}  // namespace
+
+Reporter::Reporter(std::string filter) : filter_(std::move(filter)) {}
+
+bool Reporter::ShouldRun(const std::string& name) const {
+  return name.find(filter_) != std::string::npos;
+}
+
+void Reporter::Report(const BenchmarkResult& result) {
+  std::printf("%-48s threads: %3zu %12.2f ns/op %12.2f Mop/s\n",
+              result.name.c_str(), result.threads,
+              GetNsPerOperationPerThread(result),
+              GetMillionOperationsPerSecond(result));
+  std::fflush(stdout);
+  results_.push_back(result);
+}
+
+bool Reporter::WriteJson(const std::string& file_path) const {
+  std::FILE* file = std::fopen(file_path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fprintf(file, "{\n  \"context\": {\"hardware_threads\": %u},\n",
+               std::thread::hardware_concurrency());
+  std::fprintf(file, "  \"benchmarks\": [");
+  for (std::size_t i = 0; i < results_.size(); ++i) {
+    const BenchmarkResult& result = results_[i];
+    std::fprintf(file,
+                 "%s\n    {\"name\": \"%s\", \"threads\": %zu, "
+                 "\"operations\": %" PRIu64 ", \"elapsed_ns\": %" PRIu64
+                 ", \"ns_per_op\": %.3f, \"mops_per_second\": %.3f}",
+                 i == 0 ? "" : ",", EscapeJsonString(result.name).c_str(),
+                 result.threads, result.operations, result.elapsed_ns,
+                 GetNsPerOperationPerThread(result),
+                 GetMillionOperationsPerSecond(result));
+  }
+  std::fprintf(file, "\n  ]\n}\n");
+  return std::fclose(file) == 0;
+}
+
+std::uint64_t RunOnThreads(
+    std::size_t num_threads,
+    const std::function<void(std::size_t thread_index)>& body) {
+  std::atomic<std::size_t> ready_threads{0};
+  std::atomic<bool> start{false};
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (std::size_t thread_index = 0; thread_index < num_threads;
+       ++thread_index) {
+    threads.emplace_back([&, thread_index]() {
+      ready_threads.fetch_add(1);
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      body(thread_index);
+    });
+  }
+
+  while (ready_threads.load() != num_threads) {
+    std::this_thread::yield();
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto end_time = std::chrono::steady_clock::now();
+
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                           start_time)
+          .count());
+}
+
+std::vector<std::size_t> GetThreadCounts() {
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+  std::vector<std::size_t> result;
+  for (std::size_t threads = 1; threads < max_threads; threads *= 2) {
+    result.push_back(threads);
+  }
+  result.push_back(max_threads);
+  return result;
+}
+
+}  // namespace gf_layers::bench
+
+int main(int argc, const char** argv) {
+  // Usage: gf_layers_bench [--json=<file>] [filter]
+  std::string json_file_path;
+  std::string filter;
+  const std::string json_flag = "--json=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, json_flag.size(), json_flag) == 0) {
+      json_file_path = arg.substr(json_flag.size());
+    } else {
+      filter = arg;
+    }
+  }
+
+  gf_layers::bench::Reporter reporter(filter);
+
+  gf_layers::bench::RunStartupBenchmarks(&reporter);
+  gf_layers::bench::RunMapBenchmarks(&reporter);
+  gf_layers::bench::RunClockBenchmarks(&reporter);
+  gf_layers::bench::RunThreadPoolBenchmarks(&reporter);
+  gf_layers::bench::RunFileWriterBenchmarks(&reporter);
+  gf_layers::bench::RunDispatchKeyBenchmarks(&reporter);
+  gf_layers::bench::RunProcTableBenchmarks(&reporter);
+  gf_layers::bench::RunLayerChainBenchmarks(&reporter);
+  gf_layers::bench::RunWorkloadBenchmarks(&reporter);
+
+  if (!json_file_path.empty() && !reporter.WriteJson(json_file_path)) {
+    std::fprintf(stderr, "Failed to write %s\n", json_file_path.c_str());
+    return 1;
+  }
+
+  return 0;
+}
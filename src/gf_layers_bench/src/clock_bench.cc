@@ -0,0 +1,105 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/clock.h"
+
+// Benchmarks for reading the time, which the instrumentation, the trace spans
+// and frame_counter do on every call or frame: the cost of a read with
+// std::chrono::steady_clock, the reference clock and |ClockNowNs|, and how far
+// |ClockNowNs| drifts from std::chrono::steady_clock.
+
+namespace gf_layers::bench {
+namespace {
+
+constexpr std::uint64_t kReadsPerThread = 1U << 22U;
+
+// The drift is measured at the end of each interval.
+constexpr std::chrono::milliseconds kDriftInterval{250};
+constexpr int kDriftIntervals = 4;
+
+std::uint64_t SteadyClockNowNs() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+template <typename Body>
+void RunClockReadBenchmark(const std::string& name, Body body,
+                           Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  for (std::size_t threads : GetThreadCounts()) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&body](std::size_t /*thread_index*/) {
+          for (std::uint64_t i = 0; i < kReadsPerThread; ++i) {
+            DoNotOptimize(body());
+          }
+        });
+    reporter->Report({name, threads, threads * kReadsPerThread, elapsed_ns});
+  }
+}
+
+// Prints the difference between the time elapsed according to |ClockNowNs|
+// and according to std::chrono::steady_clock after each interval. Not
+// reported as a result, as it is not a time per operation.
+void RunClockDriftBenchmark(Reporter* reporter) {
+  const std::string name = "Clock/Drift";
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  std::uint64_t clock_start_ns = ClockNowNs();
+  std::uint64_t steady_start_ns = SteadyClockNowNs();
+  for (int interval = 1; interval <= kDriftIntervals; ++interval) {
+    std::this_thread::sleep_for(kDriftInterval);
+    std::uint64_t clock_elapsed_ns = ClockNowNs() - clock_start_ns;
+    std::uint64_t steady_elapsed_ns = SteadyClockNowNs() - steady_start_ns;
+    double drift_ns = static_cast<double>(clock_elapsed_ns) -
+                      static_cast<double>(steady_elapsed_ns);
+    std::printf("%-48s after %10.3fms: %+10.0f ns (%+.2f ppm)\n", name.c_str(),
+                static_cast<double>(steady_elapsed_ns) / 1e6, drift_ns,
+                drift_ns * 1e6 / static_cast<double>(steady_elapsed_ns));
+  }
+}
+
+}  // namespace
+
+void RunClockBenchmarks(Reporter* reporter) {
+  if (reporter->ShouldRun("Clock/")) {
+    std::printf("ClockNowNs reads the %s.\n",
+                GetClockSource() == ClockSource::kCpuCounter
+                    ? "CPU counter"
+                    : "reference clock");
+  }
+
+  RunClockReadBenchmark("Clock/SteadyClock", SteadyClockNowNs, reporter);
+
+  RunClockReadBenchmark("Clock/ReferenceClock",
+                        internal::ReadReferenceClockNs, reporter);
+
+  RunClockReadBenchmark("Clock/ClockNowNs", ClockNowNs, reporter);
+
+  RunClockDriftBenchmark(reporter);
+}
+
+}  // namespace gf_layers::bench
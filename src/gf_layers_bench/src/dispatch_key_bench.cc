@@ -0,0 +1,101 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/util.h"
+
+// Benchmarks for getting the dispatch key of a handle, which nearly every
+// intercepted call does before looking up its instance or device data.
+
+namespace gf_layers::bench {
+namespace {
+
+constexpr std::uint64_t kLookupsPerThread = 1U << 22U;
+
+// Handles of dispatchable objects point to an object whose first word is the
+// dispatch table pointer. Child objects share the pointer of their parent.
+struct FakeDispatchableObject {
+  void* dispatch = nullptr;
+};
+
+FakeDispatchableObject fake_instance_dispatch;
+FakeDispatchableObject fake_device_dispatch;
+
+FakeDispatchableObject fake_physical_device{&fake_instance_dispatch};
+std::array<FakeDispatchableObject, 4> fake_command_buffers{
+    {{&fake_device_dispatch},
+     {&fake_device_dispatch},
+     {&fake_device_dispatch},
+     {&fake_device_dispatch}}};
+
+struct DeviceData {
+  std::uint64_t calls = 0;
+};
+
+template <typename Body>
+void RunDispatchKeyBenchmark(const std::string& name, Body body,
+                             Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  for (std::size_t threads : GetThreadCounts()) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&body](std::size_t /*thread_index*/) {
+          for (std::uint64_t i = 0; i < kLookupsPerThread; ++i) {
+            DoNotOptimize(body(i));
+          }
+        });
+    reporter->Report({name, threads, threads * kLookupsPerThread, elapsed_ns});
+  }
+}
+
+}  // namespace
+
+void RunDispatchKeyBenchmarks(Reporter* reporter) {
+  RunDispatchKeyBenchmark(
+      "DispatchKey/InstanceKey",
+      [](std::uint64_t /*i*/) {
+        return InstanceKey(
+            reinterpret_cast<VkPhysicalDevice>(&fake_physical_device));
+      },
+      reporter);
+
+  RunDispatchKeyBenchmark(
+      "DispatchKey/DeviceKey",
+      [](std::uint64_t i) {
+        return DeviceKey(reinterpret_cast<VkCommandBuffer>(
+            &fake_command_buffers[i % fake_command_buffers.size()]));
+      },
+      reporter);
+
+  // The full lookup at the start of an intercepted vkCmd* call.
+  static ProtectedTinyStaleMap<void*, DeviceData> device_map;
+  device_map.Put(&fake_device_dispatch, DeviceData());
+  RunDispatchKeyBenchmark(
+      "DispatchKey/DeviceKeyThenGet",
+      [](std::uint64_t i) {
+        return device_map.Get(DeviceKey(reinterpret_cast<VkCommandBuffer>(
+            &fake_command_buffers[i % fake_command_buffers.size()])));
+      },
+      reporter);
+}
+
+}  // namespace gf_layers::bench
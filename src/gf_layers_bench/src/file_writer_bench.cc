@@ -0,0 +1,136 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/file_writer.h"
+
+// Benchmarks for writing the layers' output files (Amber files, buffers,
+// shaders): the time that the calling thread spends writing a file with
+// std::ofstream, and queueing it with |WriteFileAsync| (which blocks once the
+// queue is full), with and without waiting for the queued files to be
+// written.
+
+namespace gf_layers::bench {
+namespace {
+
+constexpr std::uint64_t kFilesPerThread = 256;
+
+constexpr std::size_t kFileSize = 64U << 10U;
+
+// Each thread writes its files in turn, so that the directory does not fill
+// up.
+constexpr std::uint64_t kFileNamesPerThread = 16;
+
+std::string GetFilePath(const std::filesystem::path& directory,
+                        std::size_t thread_index, std::uint64_t file_index) {
+  return (directory / ("gf_layers_bench_" + std::to_string(thread_index) + "_" +
+                       std::to_string(file_index % kFileNamesPerThread) +
+                       ".bin"))
+      .string();
+}
+
+// If |flush| is true, each thread waits for the queued files to be written.
+template <typename WriteFunction>
+void RunFileWriteBenchmark(const std::string& name,
+                           const std::filesystem::path& directory,
+                           WriteFunction write_function, bool flush,
+                           Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  for (std::size_t threads : GetThreadCounts()) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&directory, &write_function,
+                               flush](std::size_t thread_index) {
+          for (std::uint64_t i = 0; i < kFilesPerThread; ++i) {
+            write_function(GetFilePath(directory, thread_index, i),
+                           std::vector<char>(kFileSize, 'x'));
+          }
+          if (flush) {
+            FlushFileWrites();
+          }
+        });
+    // The files of this run are not written during the next one.
+    FlushFileWrites();
+    reporter->Report({name, threads, threads * kFilesPerThread, elapsed_ns});
+  }
+  for (std::size_t thread_index = 0; thread_index < GetThreadCounts().back();
+       ++thread_index) {
+    for (std::uint64_t i = 0; i < kFileNamesPerThread; ++i) {
+      std::error_code error;
+      std::filesystem::remove(GetFilePath(directory, thread_index, i), error);
+    }
+  }
+}
+
+}  // namespace
+
+void RunFileWriterBenchmarks(Reporter* reporter) {
+  if (!reporter->ShouldRun("FileWriter/")) {
+    return;
+  }
+  std::error_code error;
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path(error);
+  if (error) {
+    std::printf("Skipping the FileWriter benchmarks: no temp directory.\n");
+    return;
+  }
+
+  const char* backend = "synchronous writes";
+  switch (GetFileWriterBackend()) {
+    case FileWriterBackend::kSynchronous:
+      break;
+    case FileWriterBackend::kPwrite:
+      backend = "pwrite";
+      break;
+    case FileWriterBackend::kIoUring:
+      backend = "io_uring";
+      break;
+  }
+  std::printf("WriteFileAsync uses %s.\n", backend);
+
+  RunFileWriteBenchmark(
+      "FileWriter/Ofstream", directory,
+      [](const std::string& file_path, const std::vector<char>& data) {
+        std::ofstream file_stream(
+            file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        file_stream.write(data.data(),
+                          static_cast<std::streamsize>(data.size()));
+      },
+      false, reporter);
+
+  auto write_async = [](const std::string& file_path,
+                        std::vector<char> data) {
+    WriteFileAsync(file_path, WriteBuffer(std::move(data)));
+  };
+
+  RunFileWriteBenchmark("FileWriter/WriteFileAsync", directory, write_async,
+                        false, reporter);
+
+  RunFileWriteBenchmark("FileWriter/WriteFileAsyncAndFlush", directory,
+                        write_async, true, reporter);
+}
+
+}  // namespace gf_layers::bench
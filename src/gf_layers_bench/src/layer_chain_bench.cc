@@ -0,0 +1,147 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_bench/layer_loader.h"
+
+// Benchmarks for the per-call overhead of the layers when several are enabled:
+// the separate layer libraries stacked by the loader versus VkLayer_GF_fused.
+// We chain the layers in front of the null driver (see layer_loader.h) and
+// measure vkQueuePresentKHR calls, which only frame_counter intercepts, and
+// vkQueueSubmit calls, which frame_counter and amber_scoop both intercept (and
+// so VkLayer_GF_fused dispatches itself), through the chain.
+
+namespace gf_layers::bench {
+
+#if defined(_WIN32)
+
+void RunLayerChainBenchmarks(Reporter* /*reporter*/) {
+  std::printf("Skipping layer chain benchmarks on Windows.\n");
+}
+
+#else
+
+namespace {
+
+constexpr std::uint64_t kCalls = 1U << 22U;
+
+// Measures |kCalls| calls of the function returned by |get_call|, which is
+// given the chain of |layers| in front of the null driver.
+template <typename GetCall>
+void RunLayerChainBenchmark(const std::string& name,
+                            std::vector<LayerEntryPoints> layers,
+                            GetCall get_call, Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  LayerChain chain(std::move(layers));
+  if (!chain.CreateInstance() || !chain.CreateDevice()) {
+    std::printf("Could not create a device for %s; skipping.\n", name.c_str());
+    return;
+  }
+  auto call = get_call(chain);
+
+  std::uint64_t elapsed_ns = RunOnThreads(1, [&](std::size_t) {
+    for (std::uint64_t i = 0; i < kCalls; ++i) {
+      DoNotOptimize(call());
+    }
+  });
+  reporter->Report({name, 1, kCalls, elapsed_ns});
+}
+
+// Runs the benchmarks of each function through the chain of |layers|, named
+// "LayerChain/<function>/<chain_name>".
+void RunChainBenchmarks(const std::string& chain_name,
+                        const std::vector<LayerEntryPoints>& layers,
+                        Reporter* reporter) {
+  RunLayerChainBenchmark(
+      "LayerChain/QueuePresent/" + chain_name, layers,
+      [](const LayerChain& chain) {
+        auto queue_present = reinterpret_cast<PFN_vkQueuePresentKHR>(
+            chain.GetDeviceProcAddr("vkQueuePresentKHR"));
+        VkQueue queue = chain.GetQueue(0);
+        VkPresentInfoKHR present_info{};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        return [queue_present, queue, present_info]() {
+          return queue_present(queue, &present_info);
+        };
+      },
+      reporter);
+
+  // An empty submit, so that amber_scoop has no command buffers to go
+  // through and the benchmark measures the dispatch to each layer.
+  RunLayerChainBenchmark(
+      "LayerChain/QueueSubmit/" + chain_name, layers,
+      [](const LayerChain& chain) {
+        auto queue_submit = reinterpret_cast<PFN_vkQueueSubmit>(
+            chain.GetDeviceProcAddr("vkQueueSubmit"));
+        VkQueue queue = chain.GetQueue(0);
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        return [queue_submit, queue, submit_info]() {
+          return queue_submit(queue, 1, &submit_info, VK_NULL_HANDLE);
+        };
+      },
+      reporter);
+}
+
+// Returns whether any of the benchmarks through the chain named |chain_name|
+// will be run.
+bool ShouldRunChain(const std::string& chain_name, const Reporter& reporter) {
+  return reporter.ShouldRun("LayerChain/QueuePresent/" + chain_name) ||
+         reporter.ShouldRun("LayerChain/QueueSubmit/" + chain_name);
+}
+
+}  // namespace
+
+void RunLayerChainBenchmarks(Reporter* reporter) {
+  RunChainBenchmarks("NoLayers", {}, reporter);
+
+  // Only load the layers if they will be used.
+  if (!ShouldRunChain("Stacked", *reporter) &&
+      !ShouldRunChain("Fused", *reporter)) {
+    return;
+  }
+
+  std::vector<LayerEntryPoints> stacked_layers;
+  for (const char* layer_name :
+       {"VkLayer_GF_frame_counter", "VkLayer_GF_amber_scoop",
+        "VkLayer_GF_shader_fuzzer"}) {
+    LayerEntryPoints layer;
+    if (!LoadLayer(layer_name, &layer)) {
+      return;
+    }
+    stacked_layers.push_back(layer);
+  }
+  RunChainBenchmarks("Stacked", stacked_layers, reporter);
+
+  LayerEntryPoints fused_layer;
+  if (!LoadLayer("VkLayer_GF_fused", &fused_layer)) {
+    return;
+  }
+  RunChainBenchmarks("Fused", {fused_layer}, reporter);
+}
+
+#endif
+
+}  // namespace gf_layers::bench
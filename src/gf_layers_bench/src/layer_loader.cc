@@ -0,0 +1,216 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_bench/layer_loader.h"
+
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_null_driver/null_driver.h"
+
+// The benchmarks that use the loader are skipped on Windows.
+#if !defined(_WIN32)
+
+#include <dlfcn.h>
+
+namespace gf_layers::bench {
+
+namespace {
+
+// Sets the layer settings for the benchmarks, unless they are set already. The
+// layers read their settings once, so this must happen before the first layer
+// is used.
+void SetLayerSettings() {
+  // Make frame_counter intercept vkQueuePresentKHR (it passes the call through
+  // when the start and end frames are equal) without ever reaching the start
+  // frame, so that it never logs.
+  setenv("VkLayer_GF_frame_counter_START_FRAME", "1000000000000", 0);
+  setenv("VkLayer_GF_frame_counter_END_FRAME", "2000000000000", 0);
+  // Similarly, make amber_scoop track commands and objects (it tracks nothing
+  // when it would capture no draw calls) without ever capturing a draw call.
+  setenv("VkLayer_GF_amber_scoop_START_DRAW_CALL", "1000000000000", 0);
+  setenv("VkLayer_GF_amber_scoop_DRAW_CALL_COUNT", "1", 0);
+}
+
+}  // namespace
+
+std::string GetLibraryPath(const std::string& library_name) {
+  const char* layer_dir = std::getenv("GF_LAYERS_BENCH_LAYER_DIR");
+#if defined(__APPLE__)
+  const char* library_suffix = ".dylib";
+#else
+  const char* library_suffix = ".so";
+#endif
+  return std::string(layer_dir != nullptr ? layer_dir : ".") + "/lib" +
+         library_name + library_suffix;
+}
+
+bool LoadLayer(const std::string& layer_name, LayerEntryPoints* result) {
+  SetLayerSettings();
+
+  std::string library_path = GetLibraryPath(layer_name);
+  void* library = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    std::printf("Could not load %s; skipping.\n", library_path.c_str());
+    return false;
+  }
+
+  auto negotiate = reinterpret_cast<PFN_vkNegotiateLoaderLayerInterfaceVersion>(
+      dlsym(library,
+            (layer_name + "NegotiateLoaderLayerInterfaceVersion").c_str()));
+  if (negotiate == nullptr) {
+    std::printf("Could not find the entry point of %s; skipping.\n",
+                layer_name.c_str());
+    return false;
+  }
+
+  VkNegotiateLayerInterface negotiate_interface{};
+  negotiate_interface.sType = LAYER_NEGOTIATE_INTERFACE_STRUCT;
+  negotiate_interface.loaderLayerInterfaceVersion =
+      CURRENT_LOADER_LAYER_INTERFACE_VERSION;
+  if (negotiate(&negotiate_interface) != VK_SUCCESS) {
+    return false;
+  }
+
+  result->get_instance_proc_addr = negotiate_interface.pfnGetInstanceProcAddr;
+  result->get_device_proc_addr = negotiate_interface.pfnGetDeviceProcAddr;
+  return true;
+}
+
+LayerChain::LayerChain(std::vector<LayerEntryPoints> layers)
+    : layers_(std::move(layers)) {}
+
+LayerChain::~LayerChain() {
+  if (device_ != VK_NULL_HANDLE) {
+    reinterpret_cast<PFN_vkDestroyDevice>(GetDeviceProcAddr("vkDestroyDevice"))(
+        device_, nullptr);
+  }
+  if (instance_ != VK_NULL_HANDLE) {
+    reinterpret_cast<PFN_vkDestroyInstance>(
+        GetInstanceProcAddr("vkDestroyInstance"))(instance_, nullptr);
+  }
+}
+
+bool LayerChain::CreateInstance() {
+  // Each layer's link points at the next layer, and the last layer's link
+  // points at the null driver.
+  std::vector<VkLayerInstanceLink> links(layers_.size());
+  for (std::size_t i = 0; i < layers_.size(); ++i) {
+    bool is_last = i + 1 == layers_.size();
+    links[i].pNext = is_last ? nullptr : &links[i + 1];
+    links[i].pfnNextGetInstanceProcAddr =
+        is_last ? null_driver::GetInstanceProcAddr
+                : layers_[i + 1].get_instance_proc_addr;
+  }
+
+  VkLayerInstanceCreateInfo layer_instance_create_info{};
+  layer_instance_create_info.sType =
+      VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO;
+  layer_instance_create_info.function = VK_LAYER_LINK_INFO;
+  layer_instance_create_info.u.pLayerInfo =
+      links.empty() ? nullptr : links.data();
+
+  VkInstanceCreateInfo instance_create_info{};
+  instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_create_info.pNext = &layer_instance_create_info;
+
+  if (reinterpret_cast<PFN_vkCreateInstance>(GetInstanceProcAddr(
+          "vkCreateInstance"))(&instance_create_info, nullptr, &instance_) !=
+      VK_SUCCESS) {
+    instance_ = VK_NULL_HANDLE;
+    return false;
+  }
+  return true;
+}
+
+bool LayerChain::CreateDevice(std::uint32_t queue_count) {
+  VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+  std::uint32_t physical_device_count = 1;
+  if (reinterpret_cast<PFN_vkEnumeratePhysicalDevices>(
+          GetInstanceProcAddr("vkEnumeratePhysicalDevices"))(
+          instance_, &physical_device_count, &physical_device) < 0 ||
+      physical_device_count == 0) {
+    return false;
+  }
+
+  std::vector<VkLayerDeviceLink> links(layers_.size());
+  for (std::size_t i = 0; i < layers_.size(); ++i) {
+    bool is_last = i + 1 == layers_.size();
+    links[i].pNext = is_last ? nullptr : &links[i + 1];
+    links[i].pfnNextGetInstanceProcAddr =
+        is_last ? null_driver::GetInstanceProcAddr
+                : layers_[i + 1].get_instance_proc_addr;
+    links[i].pfnNextGetDeviceProcAddr =
+        is_last ? null_driver::GetDeviceProcAddr
+                : layers_[i + 1].get_device_proc_addr;
+  }
+
+  VkLayerDeviceCreateInfo layer_device_create_info{};
+  layer_device_create_info.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO;
+  layer_device_create_info.function = VK_LAYER_LINK_INFO;
+  layer_device_create_info.u.pLayerInfo =
+      links.empty() ? nullptr : links.data();
+
+  std::vector<float> queue_priorities(queue_count, 1.0F);
+  VkDeviceQueueCreateInfo queue_create_info{};
+  queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_create_info.queueFamilyIndex = 0;
+  queue_create_info.queueCount = queue_count;
+  queue_create_info.pQueuePriorities = queue_priorities.data();
+
+  VkDeviceCreateInfo device_create_info{};
+  device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_create_info.pNext = &layer_device_create_info;
+  device_create_info.queueCreateInfoCount = 1;
+  device_create_info.pQueueCreateInfos = &queue_create_info;
+
+  if (reinterpret_cast<PFN_vkCreateDevice>(
+          GetInstanceProcAddr("vkCreateDevice"))(
+          physical_device, &device_create_info, nullptr, &device_) !=
+      VK_SUCCESS) {
+    device_ = VK_NULL_HANDLE;
+    return false;
+  }
+  return true;
+}
+
+PFN_vkVoidFunction LayerChain::GetInstanceProcAddr(const char* name) const {
+  return layers_.empty()
+             ? null_driver::GetInstanceProcAddr(instance_, name)
+             : layers_[0].get_instance_proc_addr(instance_, name);
+}
+
+PFN_vkVoidFunction LayerChain::GetDeviceProcAddr(const char* name) const {
+  return layers_.empty() ? null_driver::GetDeviceProcAddr(device_, name)
+                         : layers_[0].get_device_proc_addr(device_, name);
+}
+
+VkQueue LayerChain::GetQueue(std::uint32_t queue_index) const {
+  VkQueue queue = VK_NULL_HANDLE;
+  reinterpret_cast<PFN_vkGetDeviceQueue>(GetDeviceProcAddr("vkGetDeviceQueue"))(
+      device_, 0, queue_index, &queue);
+  return queue;
+}
+
+}  // namespace gf_layers::bench
+
+#endif  // !defined(_WIN32)
@@ -0,0 +1,290 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/slot_map.h"
+#include "gf_layers_layer_util/util.h"
+
+// Benchmarks for the maps used to track Vulkan objects. The access pattern
+// mimics command buffer recording in amber_scoop: each thread records into its
+// own command buffers and looks up the command buffer's data on every vkCmd*
+// call.
+
+namespace gf_layers::bench {
+namespace {
+
+// Command buffers recorded by each thread.
+constexpr std::size_t kCommandBuffersPerThread = 64;
+// Command buffers per thread for the large working set, which does not fit in
+// the CPU caches (a power of two).
+constexpr std::size_t kLargeCommandBuffersPerThread = 1U << 15U;
+constexpr std::uint64_t kLookupsPerThread = 1U << 21U;
+constexpr std::uint64_t kPutRemovesPerThread = 1U << 16U;
+
+struct CommandBufferData {
+  std::uint64_t commands = 0;
+};
+
+VkCommandBuffer FakeCommandBuffer(std::size_t index) {
+  // Handles of dispatchable objects are pointers to (aligned) driver objects.
+  return reinterpret_cast<VkCommandBuffer>(  // NOLINT
+      static_cast<std::uintptr_t>(index + 1) * 64U);
+}
+
+// |MapTemplate| without a lock, as a baseline for the protected maps. Not
+// thread-safe.
+template <typename KeyType, typename ValueType>
+class UnprotectedMap {
+ public:
+  ValueType* Get(const KeyType& key) {
+    auto it = map_.find(key);
+    return it == map_.end() ? nullptr : &it->second;
+  }
+
+  bool Put(const KeyType& key, ValueType value) {
+    return map_.emplace(key, std::move(value)).second;
+  }
+
+  bool Remove(const KeyType& key) { return map_.erase(key) != 0; }
+
+ private:
+  MapTemplate<KeyType, ValueType> map_;
+};
+
+enum class KeyPattern {
+  // Each thread looks up a few entries, which stay in the CPU caches.
+  kHot,
+  // Each thread looks up many entries in a scattered order, so that most
+  // lookups miss in the CPU caches.
+  kLargeWorkingSet,
+  // Each thread looks up keys that are not in the map.
+  kAbsent,
+};
+
+// Returns the keys that |thread_index| looks up, in order; the size is a power
+// of two.
+std::vector<VkCommandBuffer> GetLookupKeys(KeyPattern pattern,
+                                           std::size_t keys_per_thread,
+                                           std::size_t threads,
+                                           std::size_t thread_index) {
+  std::size_t first = thread_index * keys_per_thread;
+  if (pattern == KeyPattern::kAbsent) {
+    // Past the keys of all threads and the churn thread.
+    first += (threads + 1) * keys_per_thread;
+  }
+  std::vector<VkCommandBuffer> result;
+  result.reserve(keys_per_thread);
+  for (std::size_t i = 0; i < keys_per_thread; ++i) {
+    result.push_back(FakeCommandBuffer(first + i));
+  }
+  if (pattern == KeyPattern::kLargeWorkingSet) {
+    std::shuffle(result.begin(), result.end(),
+                 std::mt19937_64(thread_index));  // NOLINT(cert-msc51-cpp)
+  }
+  return result;
+}
+
+template <typename MapType>
+void RunGetBenchmark(const std::string& name, KeyPattern pattern,
+                     bool with_churn,
+                     const std::vector<std::size_t>& thread_counts,
+                     Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  std::size_t keys_per_thread = pattern == KeyPattern::kLargeWorkingSet
+                                    ? kLargeCommandBuffersPerThread
+                                    : kCommandBuffersPerThread;
+  for (std::size_t threads : thread_counts) {
+    MapType map;
+    for (std::size_t i = 0; i < threads * keys_per_thread; ++i) {
+      map.Put(FakeCommandBuffer(i), CommandBufferData());
+    }
+
+    std::vector<std::vector<VkCommandBuffer>> lookup_keys;
+    for (std::size_t thread_index = 0; thread_index < threads;
+         ++thread_index) {
+      lookup_keys.push_back(
+          GetLookupKeys(pattern, keys_per_thread, threads, thread_index));
+    }
+
+    // Optionally, add and remove other entries concurrently, as happens when
+    // other threads allocate and free command buffers.
+    std::atomic<bool> done{false};
+    std::thread churn_thread;
+    if (with_churn) {
+      churn_thread = std::thread([&map, &done, threads, keys_per_thread]() {
+        std::size_t first = threads * keys_per_thread;
+        std::size_t i = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          map.Put(FakeCommandBuffer(first + i % 256), CommandBufferData());
+          map.Remove(FakeCommandBuffer(first + (i + 128) % 256));
+          ++i;
+        }
+      });
+    }
+
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&map, &lookup_keys](std::size_t thread_index) {
+          const std::vector<VkCommandBuffer>& keys = lookup_keys[thread_index];
+          std::size_t mask = keys.size() - 1;
+          for (std::uint64_t i = 0; i < kLookupsPerThread; ++i) {
+            CommandBufferData* data = map.Get(keys[i & mask]);
+            DoNotOptimize(data);
+          }
+        });
+
+    done.store(true, std::memory_order_relaxed);
+    if (churn_thread.joinable()) {
+      churn_thread.join();
+    }
+
+    reporter->Report({name, threads, threads * kLookupsPerThread, elapsed_ns});
+  }
+}
+
+// Each thread adds and removes entries for its own command buffers, as when
+// command buffers are allocated and freed. Each operation is a |Put| and a
+// |Remove|.
+template <typename MapType>
+void RunPutRemoveBenchmark(const std::string& name,
+                           const std::vector<std::size_t>& thread_counts,
+                           Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  // A single map for all runs, which is empty after each run. See
+  // |RunTinyStaleMapBenchmark|.
+  MapType map;
+  for (std::size_t threads : thread_counts) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&map](std::size_t thread_index) {
+          std::size_t first = thread_index * kCommandBuffersPerThread;
+          for (std::uint64_t i = 0; i < kPutRemovesPerThread; ++i) {
+            VkCommandBuffer key =
+                FakeCommandBuffer(first + i % kCommandBuffersPerThread);
+            map.Put(key, CommandBufferData());
+            map.Remove(key);
+          }
+        });
+    reporter->Report(
+        {name, threads, threads * kPutRemovesPerThread, elapsed_ns});
+  }
+}
+
+// Looks up |num_devices| device keys in turn on each thread, as an application
+// that interleaves calls on several devices does. With one device, every lookup
+// hits the first entry of the thread-local cache; with more devices than cache
+// entries, every lookup misses the cache and locks the map.
+void RunTinyStaleMapBenchmark(const std::string& name, std::size_t num_devices,
+                              Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+
+  struct DeviceData {
+    std::uint64_t calls = 0;
+  };
+  // The thread-local cache is shared by all maps of the same type, so we use a
+  // single map (and keys that outlive it) for all runs.
+  static std::array<void*, 8> device_keys{};
+  static ProtectedTinyStaleMap<void*, DeviceData>* map = []() {
+    auto* result = new ProtectedTinyStaleMap<void*, DeviceData>();
+    for (void*& key : device_keys) {
+      key = &key;
+      result->Put(key, DeviceData());
+    }
+    return result;
+  }();
+
+  for (std::size_t threads : GetThreadCounts()) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [num_devices](std::size_t /*thread_index*/) {
+          for (std::uint64_t i = 0; i < kLookupsPerThread; ++i) {
+            DeviceData* data = map->Get(device_keys[i % num_devices]);
+            DoNotOptimize(data);
+          }
+        });
+    reporter->Report({name, threads, threads * kLookupsPerThread, elapsed_ns});
+  }
+}
+
+}  // namespace
+
+void RunMapBenchmarks(Reporter* reporter) {
+  using BaselineMap = UnprotectedMap<VkCommandBuffer, CommandBufferData>;
+  using LockedMap = ProtectedMap<VkCommandBuffer, CommandBufferData>;
+  using ReadMostlyMap =
+      ProtectedReadMostlyMap<VkCommandBuffer, CommandBufferData>;
+  using SlotMap = ProtectedSlotMap<VkCommandBuffer, CommandBufferData>;
+  using TinyStaleMap =
+      ProtectedTinyStaleMap<VkCommandBuffer, CommandBufferData>;
+
+  const std::vector<std::size_t> thread_counts = GetThreadCounts();
+  const std::vector<std::size_t> single_thread = {1};
+
+  for (auto [suffix, pattern] :
+       {std::make_pair("Get", KeyPattern::kHot),
+        std::make_pair("GetLargeWorkingSet", KeyPattern::kLargeWorkingSet),
+        std::make_pair("GetAbsent", KeyPattern::kAbsent)}) {
+    RunGetBenchmark<BaselineMap>(std::string("MapTemplate/") + suffix,
+                                 pattern, false, single_thread, reporter);
+    RunGetBenchmark<LockedMap>(std::string("ProtectedMap/") + suffix, pattern,
+                               false, thread_counts, reporter);
+    RunGetBenchmark<ReadMostlyMap>(
+        std::string("ProtectedReadMostlyMap/") + suffix, pattern, false,
+        thread_counts, reporter);
+    RunGetBenchmark<SlotMap>(std::string("ProtectedSlotMap/") + suffix,
+                             pattern, false, thread_counts, reporter);
+  }
+  RunGetBenchmark<LockedMap>("ProtectedMap/GetWithChurn", KeyPattern::kHot,
+                             true, thread_counts, reporter);
+  RunGetBenchmark<ReadMostlyMap>("ProtectedReadMostlyMap/GetWithChurn",
+                                 KeyPattern::kHot, true, thread_counts,
+                                 reporter);
+  RunGetBenchmark<SlotMap>("ProtectedSlotMap/GetWithChurn", KeyPattern::kHot,
+                           true, thread_counts, reporter);
+
+  RunPutRemoveBenchmark<BaselineMap>("MapTemplate/PutRemove", single_thread,
+                                     reporter);
+  RunPutRemoveBenchmark<LockedMap>("ProtectedMap/PutRemove", thread_counts,
+                                   reporter);
+  RunPutRemoveBenchmark<ReadMostlyMap>("ProtectedReadMostlyMap/PutRemove",
+                                       thread_counts, reporter);
+  RunPutRemoveBenchmark<SlotMap>("ProtectedSlotMap/PutRemove", thread_counts,
+                                 reporter);
+  RunPutRemoveBenchmark<TinyStaleMap>("ProtectedTinyStaleMap/PutRemove",
+                                      thread_counts, reporter);
+
+  RunTinyStaleMapBenchmark("ProtectedTinyStaleMap/Get/1Device", 1, reporter);
+  RunTinyStaleMapBenchmark("ProtectedTinyStaleMap/Get/3DevicesInterleaved", 3,
+                           reporter);
+  RunTinyStaleMapBenchmark("ProtectedTinyStaleMap/Get/8DevicesInterleaved", 8,
+                           reporter);
+}
+
+}  // namespace gf_layers::bench
@@ -0,0 +1,272 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/proc_table.h"
+
+// Benchmarks for resolving function pointers at startup. Loaders like volk
+// call vkGetDeviceProcAddr for every function in the API, most of which a
+// layer does not intercept.
+
+namespace gf_layers::bench {
+namespace {
+
+// The device functions intercepted by amber_scoop.
+#define INTERCEPTED_FUNCTIONS(HANDLE)  \
+  HANDLE(vkGetDeviceProcAddr)          \
+  HANDLE(vkDestroyDevice)              \
+  HANDLE(vkAllocateCommandBuffers)     \
+  HANDLE(vkFreeCommandBuffers)         \
+  HANDLE(vkAllocateDescriptorSets)     \
+  HANDLE(vkFreeDescriptorSets)         \
+  HANDLE(vkCreateBuffer)               \
+  HANDLE(vkDestroyBuffer)              \
+  HANDLE(vkCreateDescriptorSetLayout)  \
+  HANDLE(vkDestroyDescriptorSetLayout) \
+  HANDLE(vkCreateGraphicsPipelines)    \
+  HANDLE(vkCreatePipelineLayout)       \
+  HANDLE(vkDestroyPipelineLayout)      \
+  HANDLE(vkCreateShaderModule)         \
+  HANDLE(vkDestroyShaderModule)        \
+  HANDLE(vkQueueSubmit)                \
+  HANDLE(vkUpdateDescriptorSets)       \
+  HANDLE(vkCmdBeginRenderPass)         \
+  HANDLE(vkCmdBindDescriptorSets)      \
+  HANDLE(vkCmdBindIndexBuffer)         \
+  HANDLE(vkCmdBindPipeline)            \
+  HANDLE(vkCmdBindVertexBuffers)       \
+  HANDLE(vkCmdDraw)                    \
+  HANDLE(vkCmdDrawIndexed)             \
+  HANDLE(vkCmdPipelineBarrier)
+
+// The device functions of Vulkan 1.0, plus a few common extension functions,
+// in the order that a loader might query them.
+constexpr std::array kQueriedFunctions{
+    "vkDestroyDevice",
+    "vkGetDeviceQueue",
+    "vkQueueSubmit",
+    "vkQueueWaitIdle",
+    "vkDeviceWaitIdle",
+    "vkAllocateMemory",
+    "vkFreeMemory",
+    "vkMapMemory",
+    "vkUnmapMemory",
+    "vkFlushMappedMemoryRanges",
+    "vkInvalidateMappedMemoryRanges",
+    "vkGetDeviceMemoryCommitment",
+    "vkBindBufferMemory",
+    "vkBindImageMemory",
+    "vkGetBufferMemoryRequirements",
+    "vkGetImageMemoryRequirements",
+    "vkGetImageSparseMemoryRequirements",
+    "vkQueueBindSparse",
+    "vkCreateFence",
+    "vkDestroyFence",
+    "vkResetFences",
+    "vkGetFenceStatus",
+    "vkWaitForFences",
+    "vkCreateSemaphore",
+    "vkDestroySemaphore",
+    "vkCreateEvent",
+    "vkDestroyEvent",
+    "vkGetEventStatus",
+    "vkSetEvent",
+    "vkResetEvent",
+    "vkCreateQueryPool",
+    "vkDestroyQueryPool",
+    "vkGetQueryPoolResults",
+    "vkCreateBuffer",
+    "vkDestroyBuffer",
+    "vkCreateBufferView",
+    "vkDestroyBufferView",
+    "vkCreateImage",
+    "vkDestroyImage",
+    "vkGetImageSubresourceLayout",
+    "vkCreateImageView",
+    "vkDestroyImageView",
+    "vkCreateShaderModule",
+    "vkDestroyShaderModule",
+    "vkCreatePipelineCache",
+    "vkDestroyPipelineCache",
+    "vkGetPipelineCacheData",
+    "vkMergePipelineCaches",
+    "vkCreateGraphicsPipelines",
+    "vkCreateComputePipelines",
+    "vkDestroyPipeline",
+    "vkCreatePipelineLayout",
+    "vkDestroyPipelineLayout",
+    "vkCreateSampler",
+    "vkDestroySampler",
+    "vkCreateDescriptorSetLayout",
+    "vkDestroyDescriptorSetLayout",
+    "vkCreateDescriptorPool",
+    "vkDestroyDescriptorPool",
+    "vkResetDescriptorPool",
+    "vkAllocateDescriptorSets",
+    "vkFreeDescriptorSets",
+    "vkUpdateDescriptorSets",
+    "vkCreateFramebuffer",
+    "vkDestroyFramebuffer",
+    "vkCreateRenderPass",
+    "vkDestroyRenderPass",
+    "vkGetRenderAreaGranularity",
+    "vkCreateCommandPool",
+    "vkDestroyCommandPool",
+    "vkResetCommandPool",
+    "vkAllocateCommandBuffers",
+    "vkFreeCommandBuffers",
+    "vkBeginCommandBuffer",
+    "vkEndCommandBuffer",
+    "vkResetCommandBuffer",
+    "vkCmdBindPipeline",
+    "vkCmdSetViewport",
+    "vkCmdSetScissor",
+    "vkCmdSetLineWidth",
+    "vkCmdSetDepthBias",
+    "vkCmdSetBlendConstants",
+    "vkCmdSetDepthBounds",
+    "vkCmdSetStencilCompareMask",
+    "vkCmdSetStencilWriteMask",
+    "vkCmdSetStencilReference",
+    "vkCmdBindDescriptorSets",
+    "vkCmdBindIndexBuffer",
+    "vkCmdBindVertexBuffers",
+    "vkCmdDraw",
+    "vkCmdDrawIndexed",
+    "vkCmdDrawIndirect",
+    "vkCmdDrawIndexedIndirect",
+    "vkCmdDispatch",
+    "vkCmdDispatchIndirect",
+    "vkCmdCopyBuffer",
+    "vkCmdCopyImage",
+    "vkCmdBlitImage",
+    "vkCmdCopyBufferToImage",
+    "vkCmdCopyImageToBuffer",
+    "vkCmdUpdateBuffer",
+    "vkCmdFillBuffer",
+    "vkCmdClearColorImage",
+    "vkCmdClearDepthStencilImage",
+    "vkCmdClearAttachments",
+    "vkCmdResolveImage",
+    "vkCmdSetEvent",
+    "vkCmdResetEvent",
+    "vkCmdWaitEvents",
+    "vkCmdPipelineBarrier",
+    "vkCmdBeginQuery",
+    "vkCmdEndQuery",
+    "vkCmdResetQueryPool",
+    "vkCmdWriteTimestamp",
+    "vkCmdCopyQueryPoolResults",
+    "vkCmdPushConstants",
+    "vkCmdBeginRenderPass",
+    "vkCmdNextSubpass",
+    "vkCmdEndRenderPass",
+    "vkCmdExecuteCommands",
+    "vkCreateSwapchainKHR",
+    "vkDestroySwapchainKHR",
+    "vkGetSwapchainImagesKHR",
+    "vkAcquireNextImageKHR",
+    "vkQueuePresentKHR",
+    "vkCmdPushDescriptorSetKHR",
+    "vkCmdBeginRenderPass2KHR",
+    "vkCmdDrawIndirectCountKHR",
+};
+
+// Returns a distinct non-null value for each intercepted function, standing in
+// for its function pointer.
+template <std::size_t N>
+constexpr std::array<std::uintptr_t, N> MakeFakeFunctions() {
+  std::array<std::uintptr_t, N> result{};
+  for (std::size_t i = 0; i < N; ++i) {
+    result[i] = i + 1;
+  }
+  return result;
+}
+
+// The lookup that our vkGetDeviceProcAddr functions used to do: a chain of
+// |strcmp| calls.
+std::uintptr_t LookupWithStrcmp(const char* pName) {
+  std::uintptr_t result = 0;
+#define HANDLE(func)               \
+  ++result;                        \
+  if (strcmp(pName, #func) == 0) { \
+    return result;                 \
+  }
+  INTERCEPTED_FUNCTIONS(HANDLE)
+#undef HANDLE
+  return 0;
+}
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kInterceptedFunctionTable =
+    MakeProcNameTable(std::array{INTERCEPTED_FUNCTIONS(HANDLE)});
+#undef HANDLE
+
+static_assert(kInterceptedFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of functions");
+
+std::uintptr_t LookupWithProcNameTable(const char* pName) {
+  static constexpr auto kFunctions =
+      MakeFakeFunctions<kInterceptedFunctionTable.size()>();
+  return kInterceptedFunctionTable.Lookup(pName, kFunctions);
+}
+
+// The number of times the whole API is resolved; e.g. once per device by each
+// of several libraries in the process.
+constexpr std::uint64_t kResolutions = 1U << 14U;
+
+template <typename LookupFunction>
+void RunResolveBenchmark(const std::string& name, LookupFunction lookup,
+                         Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  std::uint64_t elapsed_ns = RunOnThreads(1, [lookup](std::size_t) {
+    for (std::uint64_t i = 0; i < kResolutions; ++i) {
+      for (const char* function_name : kQueriedFunctions) {
+        DoNotOptimize(lookup(function_name));
+      }
+    }
+  });
+  reporter->Report(
+      {name, 1, kResolutions * kQueriedFunctions.size(), elapsed_ns});
+}
+
+}  // namespace
+
+void RunProcTableBenchmarks(Reporter* reporter) {
+  // Both lookups must agree before we compare their speed.
+  for (const char* function_name : kQueriedFunctions) {
+    if (LookupWithStrcmp(function_name) !=
+        LookupWithProcNameTable(function_name)) {
+      std::printf("Lookup mismatch for %s\n", function_name);
+      return;
+    }
+  }
+
+  RunResolveBenchmark("ProcAddr/ResolveAll/StrcmpChain", LookupWithStrcmp,
+                      reporter);
+  RunResolveBenchmark("ProcAddr/ResolveAll/ProcNameTable",
+                      LookupWithProcNameTable, reporter);
+}
+
+}  // namespace gf_layers::bench
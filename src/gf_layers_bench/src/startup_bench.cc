@@ -0,0 +1,145 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_bench/layer_loader.h"
+
+// Benchmarks for the time to load a layer library and create an instance
+// through it, which every application that enables the layer pays at startup.
+// The layers load the gf_layers_spirv_tools library lazily; we compare against
+// loading it up front, as when the layers linked SPIRV-Tools statically. Each
+// run is in a new child process, so that no library is already loaded.
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace gf_layers::bench {
+
+#if defined(_WIN32)
+
+void RunStartupBenchmarks(Reporter* /*reporter*/) {
+  std::printf("Skipping startup benchmarks on Windows.\n");
+}
+
+#else
+
+namespace {
+
+constexpr std::uint64_t kStartupRuns = 20;
+
+// Returns the time in nanoseconds to load |layer_name| (after the
+// gf_layers_spirv_tools library, if |load_spirv_tools|) and create an instance
+// through it, or 0 on failure.
+std::uint64_t MeasureStartup(const std::string& layer_name,
+                             bool load_spirv_tools) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  if (load_spirv_tools) {
+    std::string library_path = GetLibraryPath("gf_layers_spirv_tools");
+    if (dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL) == nullptr) {
+      std::printf("Could not load %s; skipping.\n", library_path.c_str());
+      return 0;
+    }
+  }
+
+  LayerEntryPoints layer;
+  if (!LoadLayer(layer_name, &layer)) {
+    return 0;
+  }
+  LayerChain chain({layer});
+  if (!chain.CreateInstance()) {
+    return 0;
+  }
+
+  auto end_time = std::chrono::steady_clock::now();
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end_time -
+                                                           start_time)
+          .count());
+}
+
+// Runs |MeasureStartup| in a child process. Returns 0 on failure.
+std::uint64_t MeasureStartupInChildProcess(const std::string& layer_name,
+                                           bool load_spirv_tools) {
+  std::array<int, 2> pipe_fds{};
+  if (pipe(pipe_fds.data()) != 0) {
+    return 0;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(pipe_fds[0]);
+    std::uint64_t elapsed_ns = MeasureStartup(layer_name, load_spirv_tools);
+    std::fflush(stdout);
+    ssize_t written = write(pipe_fds[1], &elapsed_ns, sizeof(elapsed_ns));
+    // Skip the destructors of the loaded libraries.
+    _exit(written == sizeof(elapsed_ns) ? 0 : 1);
+  }
+  close(pipe_fds[1]);
+
+  std::uint64_t elapsed_ns = 0;
+  if (pid < 0 || read(pipe_fds[0], &elapsed_ns, sizeof(elapsed_ns)) !=
+                     sizeof(elapsed_ns)) {
+    elapsed_ns = 0;
+  }
+  close(pipe_fds[0]);
+  if (pid > 0) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+  }
+  return elapsed_ns;
+}
+
+void RunStartupBenchmark(const std::string& name, const std::string& layer_name,
+                         bool load_spirv_tools, Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  std::uint64_t total_elapsed_ns = 0;
+  for (std::uint64_t run = 0; run < kStartupRuns; ++run) {
+    std::uint64_t elapsed_ns =
+        MeasureStartupInChildProcess(layer_name, load_spirv_tools);
+    if (elapsed_ns == 0) {
+      return;
+    }
+    total_elapsed_ns += elapsed_ns;
+  }
+  reporter->Report({name, 1, kStartupRuns, total_elapsed_ns});
+}
+
+}  // namespace
+
+void RunStartupBenchmarks(Reporter* reporter) {
+  for (const char* layer_name :
+       {"VkLayer_GF_shader_fuzzer", "VkLayer_GF_amber_scoop"}) {
+    std::string prefix = std::string("Startup/") + layer_name;
+    RunStartupBenchmark(prefix + "/Lazy", layer_name, false, reporter);
+    RunStartupBenchmark(prefix + "/WithSpirvTools", layer_name, true,
+                        reporter);
+  }
+}
+
+#endif
+
+}  // namespace gf_layers::bench
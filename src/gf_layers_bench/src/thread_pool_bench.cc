@@ -0,0 +1,127 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_layer_util/thread_pool.h"
+
+// Benchmarks for the thread pool that the layers move their heavy work to:
+// the cost of submitting small tasks (and continuations) from several
+// application threads and waiting for them, and of tasks that submit and wait
+// for subtasks on the workers.
+
+namespace gf_layers::bench {
+namespace {
+
+constexpr std::uint64_t kTasksPerThread = 1U << 14U;
+
+// Each task of the fork-join benchmark computes Fib(n) by submitting
+// Fib(n - 1) and computing Fib(n - 2) itself, below a cut-off.
+constexpr int kForkJoinN = 24;
+constexpr int kForkJoinCutOff = 12;
+
+ThreadPoolOptions GetBenchmarkOptions() {
+  ThreadPoolOptions options;
+  options.worker_count = std::max(1U, std::thread::hardware_concurrency());
+  return options;
+}
+
+std::uint64_t Fib(int n) {
+  return n < 2 ? static_cast<std::uint64_t>(n) : Fib(n - 1) + Fib(n - 2);
+}
+
+std::uint64_t ForkJoinFib(ThreadPool* pool, int n, std::uint64_t* tasks) {
+  if (n < kForkJoinCutOff) {
+    return Fib(n);
+  }
+  std::uint64_t subtasks = 0;
+  auto first = pool->Submit([pool, n, &subtasks]() {
+    return ForkJoinFib(pool, n - 1, &subtasks);
+  });
+  std::uint64_t second = ForkJoinFib(pool, n - 2, tasks);
+  std::uint64_t result = first.Get() + second;
+  *tasks += subtasks + 1;
+  return result;
+}
+
+// Each thread submits |kTasksPerThread| tasks, chaining |continuations|
+// continuations to each, and then waits for them all.
+void RunSubmitBenchmark(const std::string& name, int continuations,
+                        Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  ThreadPool pool(GetBenchmarkOptions());
+  for (std::size_t threads : GetThreadCounts()) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(threads, [&pool, continuations](std::size_t thread_index) {
+          std::vector<TaskFuture<std::uint64_t>> futures;
+          futures.reserve(kTasksPerThread);
+          for (std::uint64_t i = 0; i < kTasksPerThread; ++i) {
+            auto future = pool.Submit([thread_index, i]() {
+              return static_cast<std::uint64_t>(thread_index) + i;
+            });
+            for (int c = 0; c < continuations; ++c) {
+              future = future.Then(
+                  [](const std::uint64_t& value) { return ~value; });
+            }
+            futures.push_back(future);
+          }
+          for (const TaskFuture<std::uint64_t>& future : futures) {
+            DoNotOptimize(future.Get());
+          }
+        });
+    reporter->Report({name, threads,
+                      threads * kTasksPerThread *
+                          static_cast<std::uint64_t>(continuations + 1),
+                      elapsed_ns});
+  }
+}
+
+// Reported as a single thread (the submitting thread); the operations are the
+// tasks run on the workers.
+void RunForkJoinBenchmark(Reporter* reporter) {
+  const std::string name = "ThreadPool/ForkJoin";
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  ThreadPool pool(GetBenchmarkOptions());
+  std::uint64_t tasks = 0;
+  std::uint64_t elapsed_ns =
+      RunOnThreads(1, [&pool, &tasks](std::size_t /*thread_index*/) {
+        auto root = pool.Submit([&pool, &tasks]() {
+          return ForkJoinFib(&pool, kForkJoinN, &tasks);
+        });
+        DoNotOptimize(root.Get());
+      });
+  reporter->Report({name, 1, tasks, elapsed_ns});
+}
+
+}  // namespace
+
+void RunThreadPoolBenchmarks(Reporter* reporter) {
+  RunSubmitBenchmark("ThreadPool/Submit", 0, reporter);
+
+  RunSubmitBenchmark("ThreadPool/SubmitThen", 1, reporter);
+
+  RunForkJoinBenchmark(reporter);
+}
+
+}  // namespace gf_layers::bench
@@ -0,0 +1,665 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_bench/bench.h"
+#include "gf_layers_bench/layer_loader.h"
+
+// End-to-end benchmarks for the overhead of the layers on a rendering workload.
+// Each thread records command buffers full of draw calls, submits them to its
+// own queue, waits for its fence and presents, through a chain of layers in
+// front of the null driver (see layer_loader.h). We report the time per Vulkan
+// call made by the workload; the difference from "Workload/NoLayers" is the
+// average overhead that the layers add to each call.
+
+namespace gf_layers::bench {
+
+#if defined(_WIN32)
+
+void RunWorkloadBenchmarks(Reporter* /*reporter*/) {
+  std::printf("Skipping workload benchmarks on Windows.\n");
+}
+
+#else
+
+namespace {
+
+constexpr std::uint64_t kFramesPerThread = 256;
+constexpr std::uint32_t kCommandBuffersPerFrame = 8;
+constexpr std::uint32_t kDrawsPerCommandBuffer = 64;
+
+constexpr VkDeviceSize kBufferSize = 4096;
+
+// The Vulkan calls made to record each command buffer (see
+// |Workload::RecordCommandBuffer|), and for each frame: acquire, recording,
+// then submit, wait for the fence, reset the fence and present.
+constexpr std::uint64_t kCallsPerCommandBuffer = 8 + kDrawsPerCommandBuffer;
+constexpr std::uint64_t kCallsPerFrame =
+    kCommandBuffersPerFrame * kCallsPerCommandBuffer + 5;
+
+// A SPIR-V module that is just a header. The null driver and the layers (as
+// configured) do not look inside.
+constexpr std::array<std::uint32_t, 5> kShaderCode = {0x07230203U, 0x00010000U,
+                                                      0U, 1U, 0U};
+
+// The device functions called by the workload.
+#define GF_LAYERS_WORKLOAD_FUNCTIONS(HANDLE) \
+  HANDLE(vkAcquireNextImageKHR)              \
+  HANDLE(vkAllocateCommandBuffers)           \
+  HANDLE(vkAllocateDescriptorSets)           \
+  HANDLE(vkAllocateMemory)                   \
+  HANDLE(vkBeginCommandBuffer)               \
+  HANDLE(vkBindBufferMemory)                 \
+  HANDLE(vkCmdBeginRenderPass)               \
+  HANDLE(vkCmdBindDescriptorSets)            \
+  HANDLE(vkCmdBindIndexBuffer)               \
+  HANDLE(vkCmdBindPipeline)                  \
+  HANDLE(vkCmdBindVertexBuffers)             \
+  HANDLE(vkCmdDrawIndexed)                   \
+  HANDLE(vkCmdEndRenderPass)                 \
+  HANDLE(vkCreateBuffer)                     \
+  HANDLE(vkCreateCommandPool)                \
+  HANDLE(vkCreateDescriptorPool)             \
+  HANDLE(vkCreateDescriptorSetLayout)        \
+  HANDLE(vkCreateFence)                      \
+  HANDLE(vkCreateFramebuffer)                \
+  HANDLE(vkCreateGraphicsPipelines)          \
+  HANDLE(vkCreatePipelineLayout)             \
+  HANDLE(vkCreateRenderPass)                 \
+  HANDLE(vkCreateShaderModule)               \
+  HANDLE(vkCreateSwapchainKHR)               \
+  HANDLE(vkDestroyBuffer)                    \
+  HANDLE(vkDestroyCommandPool)               \
+  HANDLE(vkDestroyDescriptorPool)            \
+  HANDLE(vkDestroyDescriptorSetLayout)       \
+  HANDLE(vkDestroyFence)                     \
+  HANDLE(vkDestroyFramebuffer)               \
+  HANDLE(vkDestroyPipeline)                  \
+  HANDLE(vkDestroyPipelineLayout)            \
+  HANDLE(vkDestroyRenderPass)                \
+  HANDLE(vkDestroyShaderModule)              \
+  HANDLE(vkDestroySwapchainKHR)              \
+  HANDLE(vkDeviceWaitIdle)                   \
+  HANDLE(vkEndCommandBuffer)                 \
+  HANDLE(vkFreeCommandBuffers)               \
+  HANDLE(vkFreeDescriptorSets)               \
+  HANDLE(vkFreeMemory)                       \
+  HANDLE(vkGetBufferMemoryRequirements)      \
+  HANDLE(vkQueuePresentKHR)                  \
+  HANDLE(vkQueueSubmit)                      \
+  HANDLE(vkResetFences)                      \
+  HANDLE(vkUpdateDescriptorSets)             \
+  HANDLE(vkWaitForFences)
+
+struct DeviceFunctions {
+#define HANDLE(func) PFN_##func func = nullptr;
+  GF_LAYERS_WORKLOAD_FUNCTIONS(HANDLE)
+#undef HANDLE
+};
+
+// The objects used by one thread, which has its own queue.
+struct ThreadObjects {
+  VkQueue queue = VK_NULL_HANDLE;
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  std::vector<VkCommandBuffer> command_buffers;
+  VkFence fence = VK_NULL_HANDLE;
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+};
+
+// A device created through a chain of layers, with the objects needed to draw
+// using a graphics pipeline that has a vertex buffer, an index buffer and a
+// uniform buffer.
+class Workload {
+ public:
+  explicit Workload(std::vector<LayerEntryPoints> layers)
+      : chain_(std::move(layers)) {}
+
+  Workload(const Workload&) = delete;
+  Workload& operator=(const Workload&) = delete;
+
+  ~Workload();
+
+  // Creates the device and objects for up to |max_threads| threads. Returns
+  // false on failure.
+  bool Init(std::uint32_t max_threads);
+
+  // Renders |kFramesPerThread| frames using the objects of |thread_index|.
+  void RenderFrames(std::size_t thread_index);
+
+ private:
+  bool CreateBuffers();
+  bool CreateDescriptorSet();
+  bool CreatePipeline();
+  bool CreateThreadObjects(std::uint32_t thread_index);
+
+  void RecordCommandBuffer(VkCommandBuffer command_buffer) const;
+
+  LayerChain chain_;
+  DeviceFunctions vk_;
+  VkDevice device_ = VK_NULL_HANDLE;
+
+  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
+  VkBuffer index_buffer_ = VK_NULL_HANDLE;
+  VkBuffer uniform_buffer_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkShaderModule shader_module_ = VK_NULL_HANDLE;
+  VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  std::vector<ThreadObjects> thread_objects_;
+};
+
+Workload::~Workload() {
+  if (device_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vk_.vkDeviceWaitIdle(device_);
+  for (ThreadObjects& objects : thread_objects_) {
+    if (!objects.command_buffers.empty()) {
+      vk_.vkFreeCommandBuffers(
+          device_, objects.command_pool,
+          static_cast<std::uint32_t>(objects.command_buffers.size()),
+          objects.command_buffers.data());
+    }
+    if (objects.command_pool != VK_NULL_HANDLE) {
+      vk_.vkDestroyCommandPool(device_, objects.command_pool, nullptr);
+    }
+    if (objects.fence != VK_NULL_HANDLE) {
+      vk_.vkDestroyFence(device_, objects.fence, nullptr);
+    }
+    if (objects.swapchain != VK_NULL_HANDLE) {
+      vk_.vkDestroySwapchainKHR(device_, objects.swapchain, nullptr);
+    }
+  }
+  if (pipeline_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyPipeline(device_, pipeline_, nullptr);
+  }
+  if (framebuffer_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyFramebuffer(device_, framebuffer_, nullptr);
+  }
+  if (render_pass_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyRenderPass(device_, render_pass_, nullptr);
+  }
+  if (shader_module_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyShaderModule(device_, shader_module_, nullptr);
+  }
+  if (pipeline_layout_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+  }
+  if (descriptor_set_ != VK_NULL_HANDLE) {
+    vk_.vkFreeDescriptorSets(device_, descriptor_pool_, 1, &descriptor_set_);
+  }
+  if (descriptor_pool_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+  }
+  if (descriptor_set_layout_ != VK_NULL_HANDLE) {
+    vk_.vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
+  }
+  for (VkBuffer buffer : {vertex_buffer_, index_buffer_, uniform_buffer_}) {
+    if (buffer != VK_NULL_HANDLE) {
+      vk_.vkDestroyBuffer(device_, buffer, nullptr);
+    }
+  }
+  if (memory_ != VK_NULL_HANDLE) {
+    vk_.vkFreeMemory(device_, memory_, nullptr);
+  }
+  // |chain_| destroys the device.
+}
+
+bool Workload::Init(std::uint32_t max_threads) {
+  if (!chain_.CreateInstance() || !chain_.CreateDevice(max_threads)) {
+    return false;
+  }
+
+#define HANDLE(func)                                                         \
+  vk_.func = reinterpret_cast<PFN_##func>(chain_.GetDeviceProcAddr(#func)); \
+  if (vk_.func == nullptr) {                                                 \
+    return false;                                                            \
+  }
+  GF_LAYERS_WORKLOAD_FUNCTIONS(HANDLE)
+#undef HANDLE
+
+  device_ = chain_.device();
+
+  if (!CreateBuffers() || !CreateDescriptorSet() || !CreatePipeline()) {
+    return false;
+  }
+  thread_objects_.resize(max_threads);
+  for (std::uint32_t thread_index = 0; thread_index < max_threads;
+       ++thread_index) {
+    if (!CreateThreadObjects(thread_index)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Workload::CreateBuffers() {
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = kBufferSize;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  buffer_create_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  if (vk_.vkCreateBuffer(device_, &buffer_create_info, nullptr,
+                         &vertex_buffer_) != VK_SUCCESS) {
+    return false;
+  }
+  buffer_create_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+  if (vk_.vkCreateBuffer(device_, &buffer_create_info, nullptr,
+                         &index_buffer_) != VK_SUCCESS) {
+    return false;
+  }
+  buffer_create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  if (vk_.vkCreateBuffer(device_, &buffer_create_info, nullptr,
+                         &uniform_buffer_) != VK_SUCCESS) {
+    return false;
+  }
+
+  // The buffers share one allocation, in the first memory type (which the null
+  // driver makes suitable for everything).
+  VkMemoryRequirements memory_requirements{};
+  vk_.vkGetBufferMemoryRequirements(device_, vertex_buffer_,
+                                    &memory_requirements);
+  VkDeviceSize stride =
+      (memory_requirements.size + memory_requirements.alignment - 1) /
+      memory_requirements.alignment * memory_requirements.alignment;
+
+  VkMemoryAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocate_info.allocationSize = 3 * stride;
+  allocate_info.memoryTypeIndex = 0;
+  if (vk_.vkAllocateMemory(device_, &allocate_info, nullptr, &memory_) !=
+      VK_SUCCESS) {
+    return false;
+  }
+
+  return vk_.vkBindBufferMemory(device_, vertex_buffer_, memory_, 0) ==
+             VK_SUCCESS &&
+         vk_.vkBindBufferMemory(device_, index_buffer_, memory_, stride) ==
+             VK_SUCCESS &&
+         vk_.vkBindBufferMemory(device_, uniform_buffer_, memory_,
+                                2 * stride) == VK_SUCCESS;
+}
+
+bool Workload::CreateDescriptorSet() {
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_create_info{};
+  layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_create_info.bindingCount = 1;
+  layout_create_info.pBindings = &binding;
+  if (vk_.vkCreateDescriptorSetLayout(device_, &layout_create_info, nullptr,
+                                      &descriptor_set_layout_) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkDescriptorPoolSize pool_size{};
+  pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  pool_size.descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo pool_create_info{};
+  pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  pool_create_info.maxSets = 1;
+  pool_create_info.poolSizeCount = 1;
+  pool_create_info.pPoolSizes = &pool_size;
+  if (vk_.vkCreateDescriptorPool(device_, &pool_create_info, nullptr,
+                                 &descriptor_pool_) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkDescriptorSetAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorPool = descriptor_pool_;
+  allocate_info.descriptorSetCount = 1;
+  allocate_info.pSetLayouts = &descriptor_set_layout_;
+  if (vk_.vkAllocateDescriptorSets(device_, &allocate_info,
+                                   &descriptor_set_) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkDescriptorBufferInfo buffer_info{};
+  buffer_info.buffer = uniform_buffer_;
+  buffer_info.offset = 0;
+  buffer_info.range = kBufferSize;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptor_set_;
+  write.dstBinding = 0;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  write.pBufferInfo = &buffer_info;
+  vk_.vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+  return true;
+}
+
+bool Workload::CreatePipeline() {
+  VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+  pipeline_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_create_info.setLayoutCount = 1;
+  pipeline_layout_create_info.pSetLayouts = &descriptor_set_layout_;
+  if (vk_.vkCreatePipelineLayout(device_, &pipeline_layout_create_info,
+                                 nullptr, &pipeline_layout_) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkShaderModuleCreateInfo shader_module_create_info{};
+  shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  shader_module_create_info.codeSize = sizeof(kShaderCode);
+  shader_module_create_info.pCode = kShaderCode.data();
+  if (vk_.vkCreateShaderModule(device_, &shader_module_create_info, nullptr,
+                               &shader_module_) != VK_SUCCESS) {
+    return false;
+  }
+
+  // A render pass and framebuffer without attachments.
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+  VkRenderPassCreateInfo render_pass_create_info{};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.subpassCount = 1;
+  render_pass_create_info.pSubpasses = &subpass;
+  if (vk_.vkCreateRenderPass(device_, &render_pass_create_info, nullptr,
+                             &render_pass_) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkFramebufferCreateInfo framebuffer_create_info{};
+  framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebuffer_create_info.renderPass = render_pass_;
+  framebuffer_create_info.width = 64;
+  framebuffer_create_info.height = 64;
+  framebuffer_create_info.layers = 1;
+  if (vk_.vkCreateFramebuffer(device_, &framebuffer_create_info, nullptr,
+                              &framebuffer_) != VK_SUCCESS) {
+    return false;
+  }
+
+  std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = shader_module_;
+  stages[0].pName = "main";
+  stages[1] = stages[0];
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkVertexInputBindingDescription vertex_binding{};
+  vertex_binding.binding = 0;
+  vertex_binding.stride = 16;
+  vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  VkVertexInputAttributeDescription vertex_attribute{};
+  vertex_attribute.location = 0;
+  vertex_attribute.binding = 0;
+  vertex_attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  vertex_attribute.offset = 0;
+
+  VkPipelineVertexInputStateCreateInfo vertex_input_state{};
+  vertex_input_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input_state.vertexBindingDescriptionCount = 1;
+  vertex_input_state.pVertexBindingDescriptions = &vertex_binding;
+  vertex_input_state.vertexAttributeDescriptionCount = 1;
+  vertex_input_state.pVertexAttributeDescriptions = &vertex_attribute;
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly_state{};
+  input_assembly_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkViewport viewport{0.0F, 0.0F, 64.0F, 64.0F, 0.0F, 1.0F};
+  VkRect2D scissor{{0, 0}, {64, 64}};
+
+  VkPipelineViewportStateCreateInfo viewport_state{};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.pViewports = &viewport;
+  viewport_state.scissorCount = 1;
+  viewport_state.pScissors = &scissor;
+
+  VkPipelineRasterizationStateCreateInfo rasterization_state{};
+  rasterization_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization_state.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterization_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterization_state.lineWidth = 1.0F;
+
+  VkPipelineMultisampleStateCreateInfo multisample_state{};
+  multisample_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample_state.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineColorBlendStateCreateInfo color_blend_state{};
+  color_blend_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+  VkGraphicsPipelineCreateInfo pipeline_create_info{};
+  pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_create_info.stageCount = static_cast<std::uint32_t>(stages.size());
+  pipeline_create_info.pStages = stages.data();
+  pipeline_create_info.pVertexInputState = &vertex_input_state;
+  pipeline_create_info.pInputAssemblyState = &input_assembly_state;
+  pipeline_create_info.pViewportState = &viewport_state;
+  pipeline_create_info.pRasterizationState = &rasterization_state;
+  pipeline_create_info.pMultisampleState = &multisample_state;
+  pipeline_create_info.pColorBlendState = &color_blend_state;
+  pipeline_create_info.layout = pipeline_layout_;
+  pipeline_create_info.renderPass = render_pass_;
+  pipeline_create_info.subpass = 0;
+  pipeline_create_info.basePipelineIndex = -1;
+  return vk_.vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1,
+                                       &pipeline_create_info, nullptr,
+                                       &pipeline_) == VK_SUCCESS;
+}
+
+bool Workload::CreateThreadObjects(std::uint32_t thread_index) {
+  ThreadObjects& objects = thread_objects_[thread_index];
+  objects.queue = chain_.GetQueue(thread_index);
+
+  VkCommandPoolCreateInfo command_pool_create_info{};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.flags =
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  command_pool_create_info.queueFamilyIndex = 0;
+  if (vk_.vkCreateCommandPool(device_, &command_pool_create_info, nullptr,
+                              &objects.command_pool) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkCommandBufferAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool = objects.command_pool;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = kCommandBuffersPerFrame;
+  objects.command_buffers.resize(kCommandBuffersPerFrame);
+  if (vk_.vkAllocateCommandBuffers(device_, &allocate_info,
+                                   objects.command_buffers.data()) !=
+      VK_SUCCESS) {
+    objects.command_buffers.clear();
+    return false;
+  }
+
+  VkFenceCreateInfo fence_create_info{};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vk_.vkCreateFence(device_, &fence_create_info, nullptr,
+                        &objects.fence) != VK_SUCCESS) {
+    return false;
+  }
+
+  // The null driver does not need a surface.
+  VkSwapchainCreateInfoKHR swapchain_create_info{};
+  swapchain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  swapchain_create_info.minImageCount = 2;
+  swapchain_create_info.imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  swapchain_create_info.imageExtent = {64, 64};
+  swapchain_create_info.imageArrayLayers = 1;
+  swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  swapchain_create_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  swapchain_create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  return vk_.vkCreateSwapchainKHR(device_, &swapchain_create_info, nullptr,
+                                  &objects.swapchain) == VK_SUCCESS;
+}
+
+void Workload::RecordCommandBuffer(VkCommandBuffer command_buffer) const {
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VkRenderPassBeginInfo render_pass_begin_info{};
+  render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  render_pass_begin_info.renderPass = render_pass_;
+  render_pass_begin_info.framebuffer = framebuffer_;
+  render_pass_begin_info.renderArea = {{0, 0}, {64, 64}};
+
+  const VkDeviceSize vertex_buffer_offset = 0;
+
+  // Must match |kCallsPerCommandBuffer|.
+  vk_.vkBeginCommandBuffer(command_buffer, &begin_info);
+  vk_.vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info,
+                           VK_SUBPASS_CONTENTS_INLINE);
+  vk_.vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline_);
+  vk_.vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              pipeline_layout_, 0, 1, &descriptor_set_, 0,
+                              nullptr);
+  vk_.vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer_,
+                             &vertex_buffer_offset);
+  vk_.vkCmdBindIndexBuffer(command_buffer, index_buffer_, 0,
+                           VK_INDEX_TYPE_UINT16);
+  for (std::uint32_t draw = 0; draw < kDrawsPerCommandBuffer; ++draw) {
+    vk_.vkCmdDrawIndexed(command_buffer, 3, 1, 0, 0, 0);
+  }
+  vk_.vkCmdEndRenderPass(command_buffer);
+  vk_.vkEndCommandBuffer(command_buffer);
+}
+
+void Workload::RenderFrames(std::size_t thread_index) {
+  const ThreadObjects& objects = thread_objects_[thread_index];
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount =
+      static_cast<std::uint32_t>(objects.command_buffers.size());
+  submit_info.pCommandBuffers = objects.command_buffers.data();
+
+  // Each thread presents its own swapchain.
+  std::uint32_t image_index = 0;
+  VkPresentInfoKHR present_info{};
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  present_info.swapchainCount = 1;
+  present_info.pSwapchains = &objects.swapchain;
+  present_info.pImageIndices = &image_index;
+
+  // Must match |kCallsPerFrame|.
+  for (std::uint64_t frame = 0; frame < kFramesPerThread; ++frame) {
+    vk_.vkAcquireNextImageKHR(device_, objects.swapchain, UINT64_MAX,
+                              VK_NULL_HANDLE, VK_NULL_HANDLE, &image_index);
+    for (VkCommandBuffer command_buffer : objects.command_buffers) {
+      RecordCommandBuffer(command_buffer);
+    }
+    vk_.vkQueueSubmit(objects.queue, 1, &submit_info, objects.fence);
+    vk_.vkWaitForFences(device_, 1, &objects.fence, VK_TRUE, UINT64_MAX);
+    vk_.vkResetFences(device_, 1, &objects.fence);
+    vk_.vkQueuePresentKHR(objects.queue, &present_info);
+  }
+}
+
+void RunWorkloadBenchmark(const std::string& name,
+                          std::vector<LayerEntryPoints> layers,
+                          Reporter* reporter) {
+  if (!reporter->ShouldRun(name)) {
+    return;
+  }
+  std::vector<std::size_t> thread_counts = GetThreadCounts();
+  Workload workload(std::move(layers));
+  if (!workload.Init(static_cast<std::uint32_t>(thread_counts.back()))) {
+    std::printf("Could not create the objects for %s; skipping.\n",
+                name.c_str());
+    return;
+  }
+
+  for (std::size_t num_threads : thread_counts) {
+    std::uint64_t elapsed_ns =
+        RunOnThreads(num_threads, [&workload](std::size_t thread_index) {
+          workload.RenderFrames(thread_index);
+        });
+    reporter->Report(
+        {name, num_threads, num_threads * kFramesPerThread * kCallsPerFrame,
+         elapsed_ns});
+  }
+}
+
+}  // namespace
+
+void RunWorkloadBenchmarks(Reporter* reporter) {
+  RunWorkloadBenchmark("Workload/NoLayers", {}, reporter);
+
+  std::vector<LayerEntryPoints> stacked_layers;
+  for (const char* layer_name :
+       {"VkLayer_GF_frame_counter", "VkLayer_GF_amber_scoop",
+        "VkLayer_GF_shader_fuzzer"}) {
+    std::string name = std::string("Workload/") + layer_name;
+    // Only load the layers if they will be used.
+    if (!reporter->ShouldRun(name) &&
+        !reporter->ShouldRun("Workload/Stacked")) {
+      continue;
+    }
+    LayerEntryPoints layer;
+    if (!LoadLayer(layer_name, &layer)) {
+      return;
+    }
+    RunWorkloadBenchmark(name, {layer}, reporter);
+    stacked_layers.push_back(layer);
+  }
+  if (stacked_layers.size() == 3) {
+    RunWorkloadBenchmark("Workload/Stacked", std::move(stacked_layers),
+                         reporter);
+  }
+
+  if (!reporter->ShouldRun("Workload/Fused")) {
+    return;
+  }
+  LayerEntryPoints fused_layer;
+  if (!LoadLayer("VkLayer_GF_fused", &fused_layer)) {
+    return;
+  }
+  RunWorkloadBenchmark("Workload/Fused", {fused_layer}, reporter);
+}
+
+#endif
+
+}  // namespace gf_layers::bench
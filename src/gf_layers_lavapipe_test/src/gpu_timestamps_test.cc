@@ -0,0 +1,504 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Renders frames through VkLayer_GF_frame_counter with GPU timestamps enabled,
+// on a Vulkan implementation that runs the frames' work asynchronously, such as
+// lavapipe, and checks the GPU frame times that the layer reports. (The null
+// driver used by the benchmarks finishes all work at submit time and reports
+// every query as available with the value 0, so it cannot catch timestamps
+// that are read before the frame's work has finished.)
+//
+// The frames are rendered in a child process, so that the layer has written
+// its report when the child exits.
+
+namespace gf_layers::lavapipe_test {
+
+namespace {
+
+constexpr const char* kOutputFile = "gpu_timestamps_test_output.txt";
+constexpr uint32_t kStartFrame = 10;
+constexpr uint32_t kEndFrame = 110;
+// More frames than the end frame, so that the layer reports at the end frame.
+constexpr uint32_t kFrameCount = kEndFrame + 10;
+constexpr uint32_t kFramesInFlight = 2;
+// Each frame fills a buffer of this size, so that its work takes a while.
+constexpr VkDeviceSize kFillSize = 64 * 1024 * 1024;
+
+#define GF_LAYERS_INSTANCE_FUNCTIONS(HANDLE)        \
+  HANDLE(vkCreateDevice)                            \
+  HANDLE(vkCreateHeadlessSurfaceEXT)                \
+  HANDLE(vkDestroyInstance)                         \
+  HANDLE(vkDestroySurfaceKHR)                       \
+  HANDLE(vkEnumeratePhysicalDevices)                \
+  HANDLE(vkGetDeviceProcAddr)                       \
+  HANDLE(vkGetPhysicalDeviceMemoryProperties)       \
+  HANDLE(vkGetPhysicalDeviceQueueFamilyProperties)  \
+  HANDLE(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+  HANDLE(vkGetPhysicalDeviceSurfaceFormatsKHR)      \
+  HANDLE(vkGetPhysicalDeviceSurfaceSupportKHR)
+
+#define GF_LAYERS_DEVICE_FUNCTIONS(HANDLE) \
+  HANDLE(vkAcquireNextImageKHR)            \
+  HANDLE(vkAllocateCommandBuffers)         \
+  HANDLE(vkAllocateMemory)                 \
+  HANDLE(vkBeginCommandBuffer)             \
+  HANDLE(vkBindBufferMemory)               \
+  HANDLE(vkCmdFillBuffer)                  \
+  HANDLE(vkCmdPipelineBarrier)             \
+  HANDLE(vkCreateBuffer)                   \
+  HANDLE(vkCreateCommandPool)              \
+  HANDLE(vkCreateFence)                    \
+  HANDLE(vkCreateSemaphore)                \
+  HANDLE(vkCreateSwapchainKHR)             \
+  HANDLE(vkDestroyBuffer)                  \
+  HANDLE(vkDestroyCommandPool)             \
+  HANDLE(vkDestroyDevice)                  \
+  HANDLE(vkDestroyFence)                   \
+  HANDLE(vkDestroySemaphore)               \
+  HANDLE(vkDestroySwapchainKHR)            \
+  HANDLE(vkDeviceWaitIdle)                 \
+  HANDLE(vkEndCommandBuffer)               \
+  HANDLE(vkFreeMemory)                     \
+  HANDLE(vkGetBufferMemoryRequirements)    \
+  HANDLE(vkGetDeviceQueue)                 \
+  HANDLE(vkGetSwapchainImagesKHR)          \
+  HANDLE(vkQueuePresentKHR)                \
+  HANDLE(vkQueueSubmit)                    \
+  HANDLE(vkResetCommandBuffer)             \
+  HANDLE(vkResetFences)                    \
+  HANDLE(vkWaitForFences)
+
+struct Functions {
+#define GF_LAYERS_DECLARE_FUNCTION(func) PFN_##func func = nullptr;
+  GF_LAYERS_INSTANCE_FUNCTIONS(GF_LAYERS_DECLARE_FUNCTION)
+  GF_LAYERS_DEVICE_FUNCTIONS(GF_LAYERS_DECLARE_FUNCTION)
+#undef GF_LAYERS_DECLARE_FUNCTION
+};
+
+// Logs and returns false from the calling function if |call| fails.
+#define GF_LAYERS_CHECK_VK(call)                           \
+  do {                                                     \
+    VkResult check_result = (call);                        \
+    if (check_result != VK_SUCCESS) {                      \
+      std::printf("%s failed: %d\n", #call, check_result); \
+      return false;                                        \
+    }                                                      \
+  } while (false)
+
+// Renders kFrameCount frames to a headless swapchain, each filling a buffer
+// and presenting an image, with kFramesInFlight frames in flight.
+bool RenderFrames() {
+  void* library = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    std::printf("Could not load libvulkan.so.1.\n");
+    return false;
+  }
+  auto get_instance_proc_addr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+      dlsym(library, "vkGetInstanceProcAddr"));
+  if (get_instance_proc_addr == nullptr) {
+    std::printf("Could not find vkGetInstanceProcAddr.\n");
+    return false;
+  }
+  auto create_instance = reinterpret_cast<PFN_vkCreateInstance>(
+      get_instance_proc_addr(nullptr, "vkCreateInstance"));
+
+  std::array<const char*, 1> layers = {"VkLayer_GF_frame_counter"};
+  std::array<const char*, 2> instance_extensions = {
+      VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+  VkApplicationInfo application_info = {};
+  application_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  application_info.pApplicationName = "gf_layers_lavapipe_test";
+  application_info.apiVersion = VK_API_VERSION_1_0;
+  VkInstanceCreateInfo instance_create_info = {};
+  instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_create_info.pApplicationInfo = &application_info;
+  instance_create_info.enabledLayerCount = static_cast<uint32_t>(layers.size());
+  instance_create_info.ppEnabledLayerNames = layers.data();
+  instance_create_info.enabledExtensionCount =
+      static_cast<uint32_t>(instance_extensions.size());
+  instance_create_info.ppEnabledExtensionNames = instance_extensions.data();
+  VkInstance instance = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(
+      create_instance(&instance_create_info, nullptr, &instance));
+
+  Functions vk;
+#define GF_LAYERS_GET_INSTANCE_FUNCTION(func) \
+  vk.func =                                   \
+      reinterpret_cast<PFN_##func>(get_instance_proc_addr(instance, #func));
+  GF_LAYERS_INSTANCE_FUNCTIONS(GF_LAYERS_GET_INSTANCE_FUNCTION)
+#undef GF_LAYERS_GET_INSTANCE_FUNCTION
+
+  VkHeadlessSurfaceCreateInfoEXT surface_create_info = {};
+  surface_create_info.sType =
+      VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(vk.vkCreateHeadlessSurfaceEXT(
+      instance, &surface_create_info, nullptr, &surface));
+
+  uint32_t physical_device_count = 1;
+  VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+  VkResult result = vk.vkEnumeratePhysicalDevices(
+      instance, &physical_device_count, &physical_device);
+  if ((result != VK_SUCCESS && result != VK_INCOMPLETE) ||
+      physical_device_count == 0) {
+    std::printf("Could not find a physical device.\n");
+    return false;
+  }
+
+  // The layer only times queues that support graphics and timestamps.
+  uint32_t queue_family_count = 0;
+  vk.vkGetPhysicalDeviceQueueFamilyProperties(physical_device,
+                                              &queue_family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+  vk.vkGetPhysicalDeviceQueueFamilyProperties(
+      physical_device, &queue_family_count, queue_families.data());
+  uint32_t queue_family = queue_family_count;
+  for (uint32_t i = 0; i < queue_family_count; ++i) {
+    VkBool32 supports_present = VK_FALSE;
+    GF_LAYERS_CHECK_VK(vk.vkGetPhysicalDeviceSurfaceSupportKHR(
+        physical_device, i, surface, &supports_present));
+    if ((queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0 &&
+        queue_families[i].timestampValidBits != 0 &&
+        supports_present == VK_TRUE) {
+      queue_family = i;
+      break;
+    }
+  }
+  if (queue_family == queue_family_count) {
+    std::printf("Could not find a queue family that supports graphics, "
+                "timestamps and presenting.\n");
+    return false;
+  }
+
+  float queue_priority = 1.0F;
+  VkDeviceQueueCreateInfo queue_create_info = {};
+  queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_create_info.queueFamilyIndex = queue_family;
+  queue_create_info.queueCount = 1;
+  queue_create_info.pQueuePriorities = &queue_priority;
+  std::array<const char*, 1> device_extensions = {
+      VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  VkDeviceCreateInfo device_create_info = {};
+  device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_create_info.queueCreateInfoCount = 1;
+  device_create_info.pQueueCreateInfos = &queue_create_info;
+  device_create_info.enabledExtensionCount =
+      static_cast<uint32_t>(device_extensions.size());
+  device_create_info.ppEnabledExtensionNames = device_extensions.data();
+  VkDevice device = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(vk.vkCreateDevice(physical_device, &device_create_info,
+                                       nullptr, &device));
+
+#define GF_LAYERS_GET_DEVICE_FUNCTION(func) \
+  vk.func = reinterpret_cast<PFN_##func>(vk.vkGetDeviceProcAddr(device, #func));
+  GF_LAYERS_DEVICE_FUNCTIONS(GF_LAYERS_GET_DEVICE_FUNCTION)
+#undef GF_LAYERS_GET_DEVICE_FUNCTION
+
+  VkQueue queue = VK_NULL_HANDLE;
+  vk.vkGetDeviceQueue(device, queue_family, 0, &queue);
+
+  VkSurfaceCapabilitiesKHR surface_capabilities = {};
+  GF_LAYERS_CHECK_VK(vk.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+      physical_device, surface, &surface_capabilities));
+  uint32_t surface_format_count = 1;
+  VkSurfaceFormatKHR surface_format = {};
+  result = vk.vkGetPhysicalDeviceSurfaceFormatsKHR(
+      physical_device, surface, &surface_format_count, &surface_format);
+  if ((result != VK_SUCCESS && result != VK_INCOMPLETE) ||
+      surface_format_count == 0) {
+    std::printf("Could not find a surface format.\n");
+    return false;
+  }
+
+  VkSwapchainCreateInfoKHR swapchain_create_info = {};
+  swapchain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  swapchain_create_info.surface = surface;
+  swapchain_create_info.minImageCount =
+      std::max(surface_capabilities.minImageCount, kFramesInFlight + 1);
+  if (surface_capabilities.maxImageCount != 0) {
+    swapchain_create_info.minImageCount =
+        std::min(swapchain_create_info.minImageCount,
+                 surface_capabilities.maxImageCount);
+  }
+  swapchain_create_info.imageFormat = surface_format.format;
+  swapchain_create_info.imageColorSpace = surface_format.colorSpace;
+  // Headless surfaces have no current extent.
+  swapchain_create_info.imageExtent =
+      surface_capabilities.currentExtent.width != UINT32_MAX
+          ? surface_capabilities.currentExtent
+          : VkExtent2D{
+                std::clamp(256U, surface_capabilities.minImageExtent.width,
+                           surface_capabilities.maxImageExtent.width),
+                std::clamp(256U, surface_capabilities.minImageExtent.height,
+                           surface_capabilities.maxImageExtent.height)};
+  swapchain_create_info.imageArrayLayers = 1;
+  swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  swapchain_create_info.preTransform = surface_capabilities.currentTransform;
+  // The lowest supported composite alpha mode.
+  swapchain_create_info.compositeAlpha =
+      static_cast<VkCompositeAlphaFlagBitsKHR>(
+          surface_capabilities.supportedCompositeAlpha &
+          ~(surface_capabilities.supportedCompositeAlpha - 1));
+  swapchain_create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  swapchain_create_info.clipped = VK_TRUE;
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(vk.vkCreateSwapchainKHR(device, &swapchain_create_info,
+                                             nullptr, &swapchain));
+  uint32_t image_count = 0;
+  GF_LAYERS_CHECK_VK(
+      vk.vkGetSwapchainImagesKHR(device, swapchain, &image_count, nullptr));
+  std::vector<VkImage> images(image_count);
+  GF_LAYERS_CHECK_VK(vk.vkGetSwapchainImagesKHR(device, swapchain,
+                                                &image_count, images.data()));
+
+  // Each frame in flight fills its own part of the buffer.
+  VkBufferCreateInfo buffer_create_info = {};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = kFillSize * kFramesInFlight;
+  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(
+      vk.vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer));
+  VkMemoryRequirements memory_requirements = {};
+  vk.vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
+  VkPhysicalDeviceMemoryProperties memory_properties = {};
+  vk.vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+  VkMemoryAllocateInfo memory_allocate_info = {};
+  memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  memory_allocate_info.allocationSize = memory_requirements.size;
+  while (memory_allocate_info.memoryTypeIndex <
+             memory_properties.memoryTypeCount &&
+         (memory_requirements.memoryTypeBits &
+          (1U << memory_allocate_info.memoryTypeIndex)) == 0) {
+    ++memory_allocate_info.memoryTypeIndex;
+  }
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(
+      vk.vkAllocateMemory(device, &memory_allocate_info, nullptr, &memory));
+  GF_LAYERS_CHECK_VK(vk.vkBindBufferMemory(device, buffer, memory, 0));
+
+  VkCommandPoolCreateInfo command_pool_create_info = {};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.flags =
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  command_pool_create_info.queueFamilyIndex = queue_family;
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  GF_LAYERS_CHECK_VK(vk.vkCreateCommandPool(device, &command_pool_create_info,
+                                            nullptr, &command_pool));
+  std::array<VkCommandBuffer, kFramesInFlight> command_buffers = {};
+  VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+  command_buffer_allocate_info.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  command_buffer_allocate_info.commandPool = command_pool;
+  command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  command_buffer_allocate_info.commandBufferCount = kFramesInFlight;
+  GF_LAYERS_CHECK_VK(vk.vkAllocateCommandBuffers(
+      device, &command_buffer_allocate_info, command_buffers.data()));
+
+  // The semaphores signaled by the submits are per image, as each is only
+  // known to be unused again once its image is acquired again.
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  std::array<VkSemaphore, kFramesInFlight> acquired_semaphores = {};
+  std::array<VkFence, kFramesInFlight> fences = {};
+  for (uint32_t i = 0; i < kFramesInFlight; ++i) {
+    GF_LAYERS_CHECK_VK(vk.vkCreateSemaphore(device, &semaphore_create_info,
+                                            nullptr, &acquired_semaphores[i]));
+    GF_LAYERS_CHECK_VK(
+        vk.vkCreateFence(device, &fence_create_info, nullptr, &fences[i]));
+  }
+  std::vector<VkSemaphore> rendered_semaphores(image_count);
+  for (VkSemaphore& semaphore : rendered_semaphores) {
+    GF_LAYERS_CHECK_VK(vk.vkCreateSemaphore(device, &semaphore_create_info,
+                                            nullptr, &semaphore));
+  }
+
+  for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+    uint32_t frame_in_flight = frame % kFramesInFlight;
+    GF_LAYERS_CHECK_VK(vk.vkWaitForFences(
+        device, 1, &fences[frame_in_flight], VK_TRUE, UINT64_MAX));
+    GF_LAYERS_CHECK_VK(vk.vkResetFences(device, 1, &fences[frame_in_flight]));
+    uint32_t image_index = 0;
+    GF_LAYERS_CHECK_VK(vk.vkAcquireNextImageKHR(
+        device, swapchain, UINT64_MAX, acquired_semaphores[frame_in_flight],
+        VK_NULL_HANDLE, &image_index));
+
+    VkCommandBuffer command_buffer = command_buffers[frame_in_flight];
+    GF_LAYERS_CHECK_VK(vk.vkResetCommandBuffer(command_buffer, 0));
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    GF_LAYERS_CHECK_VK(vk.vkBeginCommandBuffer(command_buffer, &begin_info));
+    vk.vkCmdFillBuffer(command_buffer, buffer, kFillSize * frame_in_flight,
+                       kFillSize, frame);
+    VkImageMemoryBarrier image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = images[image_index];
+    image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_barrier.subresourceRange.levelCount = 1;
+    image_barrier.subresourceRange.layerCount = 1;
+    vk.vkCmdPipelineBarrier(command_buffer,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                            0, nullptr, 1, &image_barrier);
+    GF_LAYERS_CHECK_VK(vk.vkEndCommandBuffer(command_buffer));
+
+    VkPipelineStageFlags wait_stage =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &acquired_semaphores[frame_in_flight];
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &rendered_semaphores[image_index];
+    GF_LAYERS_CHECK_VK(
+        vk.vkQueueSubmit(queue, 1, &submit_info, fences[frame_in_flight]));
+
+    VkPresentInfoKHR present_info = {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &rendered_semaphores[image_index];
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &swapchain;
+    present_info.pImageIndices = &image_index;
+    GF_LAYERS_CHECK_VK(vk.vkQueuePresentKHR(queue, &present_info));
+  }
+
+  GF_LAYERS_CHECK_VK(vk.vkDeviceWaitIdle(device));
+  for (VkSemaphore semaphore : rendered_semaphores) {
+    vk.vkDestroySemaphore(device, semaphore, nullptr);
+  }
+  for (uint32_t i = 0; i < kFramesInFlight; ++i) {
+    vk.vkDestroySemaphore(device, acquired_semaphores[i], nullptr);
+    vk.vkDestroyFence(device, fences[i], nullptr);
+  }
+  vk.vkDestroyCommandPool(device, command_pool, nullptr);
+  vk.vkDestroyBuffer(device, buffer, nullptr);
+  vk.vkFreeMemory(device, memory, nullptr);
+  vk.vkDestroySwapchainKHR(device, swapchain, nullptr);
+  vk.vkDestroyDevice(device, nullptr);
+  vk.vkDestroySurfaceKHR(instance, surface, nullptr);
+  vk.vkDestroyInstance(instance, nullptr);
+  return true;
+}
+
+// Checks the GPU frame times in the layer's report: some frames must have been
+// timed, each must have taken some time, and none can have taken longer than
+// the whole run, |elapsed_ns|. Timestamps read before the frame's work had
+// finished would hold zeros or the values of an earlier frame, which can make
+// the end timestamp earlier than the begin timestamp, or both the same.
+bool CheckReport(uint64_t elapsed_ns) {
+  std::ifstream report(kOutputFile);
+  if (!report) {
+    std::printf("Could not open %s.\n", kOutputFile);
+    return false;
+  }
+  uint64_t timed_frames = 0;
+  uint64_t min_ns = 0;
+  uint64_t max_ns = 0;
+  std::string line;
+  while (std::getline(report, line)) {
+    std::printf("%s\n", line.c_str());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    std::sscanf(line.c_str(), "GPU timed frames: %" SCNu64, &timed_frames);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    std::sscanf(line.c_str(), "GPU frame time min: %" SCNu64, &min_ns);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    std::sscanf(line.c_str(), "GPU frame time max: %" SCNu64, &max_ns);
+  }
+  if (timed_frames == 0) {
+    std::printf("FAIL: no frames were timed.\n");
+    return false;
+  }
+  if (min_ns == 0) {
+    std::printf("FAIL: a frame took no GPU time.\n");
+    return false;
+  }
+  if (max_ns >= elapsed_ns) {
+    std::printf("FAIL: a frame took longer on the GPU (%" PRIu64
+                "ns) than the whole run (%" PRIu64 "ns).\n",
+                max_ns, elapsed_ns);
+    return false;
+  }
+  std::printf("PASS\n");
+  return true;
+}
+
+}  // namespace
+
+}  // namespace gf_layers::lavapipe_test
+
+int main() {
+  using gf_layers::lavapipe_test::CheckReport;
+  using gf_layers::lavapipe_test::kEndFrame;
+  using gf_layers::lavapipe_test::kOutputFile;
+  using gf_layers::lavapipe_test::kStartFrame;
+  using gf_layers::lavapipe_test::RenderFrames;
+
+  setenv("VkLayer_GF_frame_counter_GPU_TIMESTAMPS", "1", 1);
+  setenv("VkLayer_GF_frame_counter_START_FRAME",
+         std::to_string(kStartFrame).c_str(), 1);
+  setenv("VkLayer_GF_frame_counter_END_FRAME",
+         std::to_string(kEndFrame).c_str(), 1);
+  setenv("VkLayer_GF_frame_counter_OUTPUT_FILE", kOutputFile, 1);
+  std::remove(kOutputFile);
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Exit normally, so that the layer's output file is written.
+    std::exit(RenderFrames() ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != EXIT_SUCCESS) {
+    std::printf("FAIL: the frames could not be rendered.\n");
+    return EXIT_FAILURE;
+  }
+  auto elapsed_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+
+  return CheckReport(elapsed_ns) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
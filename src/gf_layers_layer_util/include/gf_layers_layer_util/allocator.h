@@ -0,0 +1,306 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_ALLOCATOR_H
+#define GF_LAYERS_LAYER_UTIL_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "gf_layers_layer_util/util.h"
+
+// Allocators for the layers' own bookkeeping of Vulkan objects (deep copies of
+// create infos, recorded commands, etc.), so that the host memory used by the
+// layers can be budgeted by applications that route all Vulkan host memory
+// through VkAllocationCallbacks.
+//
+// A |LayerAllocator| belongs to a device. Memory for an object is allocated
+// with the VkAllocationCallbacks given when the object was created, if any;
+// otherwise, with the callbacks given to vkCreateDevice, if any; otherwise,
+// from the allocator's arena. The arena serves small allocations from
+// per-size-class free lists carved out of large blocks, which are only
+// returned to the system when the device is destroyed.
+//
+// Data that is allocated often and freed all at once, such as the commands
+// recorded to a command buffer, can instead use a |LinearAllocator|, which
+// bump-allocates from blocks obtained from a |LayerAllocator| without locking.
+
+namespace gf_layers {
+
+// A snapshot of the statistics of a |LayerAllocator|.
+struct AllocatorStats {
+  // The number of allocations ever made.
+  std::uint64_t allocation_count = 0;
+  // The number of allocations that have not been freed yet.
+  std::uint64_t live_allocation_count = 0;
+  // The bytes requested by the allocations that have not been freed yet.
+  std::uint64_t live_bytes = 0;
+  // The maximum of |live_bytes|.
+  std::uint64_t peak_live_bytes = 0;
+  // The number of allocations ever made via the application's callbacks.
+  std::uint64_t callback_allocation_count = 0;
+  // The bytes of the blocks reserved by the arena.
+  std::uint64_t arena_block_bytes = 0;
+};
+
+class LayerAllocator {
+ public:
+  // |device_callbacks| is the pAllocator given to vkCreateDevice, or nullptr;
+  // it is copied.
+  explicit LayerAllocator(const VkAllocationCallbacks* device_callbacks);
+
+  // All allocations must have been freed.
+  ~LayerAllocator();
+
+  LayerAllocator(const LayerAllocator&) = delete;
+  LayerAllocator& operator=(const LayerAllocator&) = delete;
+  LayerAllocator(LayerAllocator&&) = delete;
+  LayerAllocator& operator=(LayerAllocator&&) = delete;
+
+  // Returns memory for |size| bytes aligned to |alignment| (a power of two),
+  // or nullptr if |size| is 0. |object_callbacks| is the pAllocator given when
+  // creating the object that owns the memory, or nullptr. Aborts if the
+  // application's callbacks fail.
+  void* Allocate(std::size_t size, std::size_t alignment,
+                 const VkAllocationCallbacks* object_callbacks);
+
+  // Frees |memory|, which must have been returned by |Allocate| with the same
+  // |size|, |alignment| and |object_callbacks|.
+  void Free(void* memory, std::size_t size, std::size_t alignment,
+            const VkAllocationCallbacks* object_callbacks);
+
+  [[nodiscard]] AllocatorStats GetStats() const;
+
+ private:
+  // The arena's size classes are powers of two from |kMinChunkSize| to
+  // |kMaxChunkSize|; larger (or more aligned) allocations use operator new.
+  static constexpr std::size_t kMinChunkSize = 16;
+  static constexpr std::size_t kMaxChunkSize = 2048;
+  static constexpr std::size_t kSizeClassCount = 8;
+  static constexpr std::size_t kBlockSize = 32 * 1024;
+  static_assert(kMinChunkSize << (kSizeClassCount - 1) == kMaxChunkSize);
+
+  struct SizeClass {
+    mutable MutexType mutex;
+    // Freed chunks, linked through their first bytes.
+    void* free_list = nullptr;
+    // The part of the newest block that has not been handed out yet.
+    char* next = nullptr;
+    char* end = nullptr;
+    // Counted under |mutex|, which is cheaper than updating shared atomic
+    // counters on every allocation.
+    std::uint64_t allocation_count = 0;
+    std::uint64_t live_allocation_count = 0;
+  };
+
+  // Returns the callbacks to use, or nullptr to use the arena.
+  [[nodiscard]] const VkAllocationCallbacks* GetCallbacks(
+      const VkAllocationCallbacks* object_callbacks) const;
+
+  void* AllocateFromArena(std::size_t size, std::size_t alignment);
+
+  void FreeToArena(void* memory, std::size_t size, std::size_t alignment);
+
+  // Counts an allocation that is not from a size class.
+  void CountOtherAllocation();
+
+  const VkAllocationCallbacks device_callbacks_;
+  const bool has_device_callbacks_;
+
+  std::array<SizeClass, kSizeClassCount> size_classes_;
+  MutexType blocks_mutex_;
+  std::vector<void*> blocks_;
+
+  // Counts of the allocations that are not from a size class.
+  std::atomic<std::uint64_t> other_allocation_count_{};
+  std::atomic<std::uint64_t> other_live_allocation_count_{};
+  std::atomic<std::uint64_t> live_bytes_{};
+  std::atomic<std::uint64_t> peak_live_bytes_{};
+  std::atomic<std::uint64_t> callback_allocation_count_{};
+  std::atomic<std::uint64_t> arena_block_bytes_{};
+};
+
+// Allocates the memory of one Vulkan object from a |LayerAllocator|, using the
+// VkAllocationCallbacks given when the object was created, which are copied.
+// Only for trivially destructible types, such as Vulkan structs.
+class ObjectAllocator {
+ public:
+  explicit ObjectAllocator(LayerAllocator* allocator)
+      : ObjectAllocator(allocator, nullptr) {}
+
+  ObjectAllocator(LayerAllocator* allocator,
+                  const VkAllocationCallbacks* object_callbacks)
+      : allocator_(allocator),
+        object_callbacks_(object_callbacks == nullptr
+                              ? VkAllocationCallbacks{}
+                              : *object_callbacks) {}
+
+  // Returns an array of |count| value-initialized elements, or nullptr if
+  // |count| is 0.
+  template <typename T>
+  T* NewArray(std::size_t count) const {
+    static_assert(std::is_trivially_destructible_v<T>);
+    auto* array = static_cast<T*>(allocator_->Allocate(
+        count * sizeof(T), alignof(T), GetObjectCallbacks()));
+    std::uninitialized_value_construct_n(array, count);
+    return array;
+  }
+
+  // Frees |array|, which must have been returned by |NewArray| with |count|.
+  template <typename T>
+  void DeleteArray(const T* array, std::size_t count) const {
+    static_assert(std::is_trivially_destructible_v<T>);
+    if (array != nullptr) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      allocator_->Free(const_cast<T*>(array), count * sizeof(T), alignof(T),
+                       GetObjectCallbacks());
+    }
+  }
+
+  [[nodiscard]] LayerAllocator* GetLayerAllocator() const { return allocator_; }
+
+ private:
+  [[nodiscard]] const VkAllocationCallbacks* GetObjectCallbacks() const {
+    return object_callbacks_.pfnAllocation == nullptr ? nullptr
+                                                      : &object_callbacks_;
+  }
+
+  LayerAllocator* allocator_;
+  VkAllocationCallbacks object_callbacks_;
+};
+
+// Allocates from blocks obtained from a |LayerAllocator| by bumping a pointer.
+// Individual allocations are not freed; |Reset| frees all of them at once but
+// keeps the blocks for reuse, and the destructor returns the blocks. Not
+// thread-safe.
+class LinearAllocator {
+ public:
+  explicit LinearAllocator(LayerAllocator* allocator) : allocator_(allocator) {}
+
+  ~LinearAllocator();
+
+  LinearAllocator(LinearAllocator&& other) noexcept;
+  LinearAllocator& operator=(LinearAllocator&&) = delete;
+  LinearAllocator(const LinearAllocator&) = delete;
+  LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+  // Returns memory for |size| bytes aligned to |alignment| (a power of two).
+  void* Allocate(std::size_t size, std::size_t alignment) {
+    void* result = AllocateFromCurrentBlock(size, alignment);
+    return result != nullptr ? result : AllocateSlow(size, alignment);
+  }
+
+  // Returns a copy of the |count| elements of |data|, or nullptr if |count|
+  // is 0.
+  template <typename T>
+  T* CopyArray(const T* data, std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (count == 0) {
+      return nullptr;
+    }
+    auto* result = static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    std::uninitialized_copy_n(data, count, result);
+    return result;
+  }
+
+  // Frees all allocations.
+  void Reset();
+
+ private:
+  // At the start of each block.
+  struct alignas(std::max_align_t) Block {
+    Block* next;
+    std::size_t size;
+  };
+
+  static constexpr std::size_t kBlockSize = 4096;
+
+  // Returns nullptr if the current block does not have enough space left.
+  void* AllocateFromCurrentBlock(std::size_t size, std::size_t alignment) {
+    auto address = reinterpret_cast<std::uintptr_t>(next_);
+    std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+    if (next_ == nullptr || aligned + size > end_) {
+      return nullptr;
+    }
+    next_ = reinterpret_cast<char*>(aligned + size);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  void* AllocateSlow(std::size_t size, std::size_t alignment);
+
+  // Makes |block| the current block.
+  void UseBlock(Block* block);
+
+  LayerAllocator* allocator_;
+  Block* first_block_ = nullptr;
+  Block* current_block_ = nullptr;
+  // The unused part of the current block.
+  char* next_ = nullptr;
+  std::uintptr_t end_ = 0;
+};
+
+// An allocator for standard containers that allocates from a |LayerAllocator|
+// (with the device's callbacks, if any).
+template <typename T>
+class StlAllocator {
+ public:
+  using value_type = T;
+
+  explicit StlAllocator(LayerAllocator* allocator) : allocator_(allocator) {}
+
+  template <typename U>
+  // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+  StlAllocator(const StlAllocator<U>& other) : allocator_(other.allocator_) {}
+
+  T* allocate(std::size_t count) {
+    return static_cast<T*>(
+        allocator_->Allocate(count * sizeof(T), alignof(T), nullptr));
+  }
+
+  void deallocate(T* memory, std::size_t count) {
+    allocator_->Free(memory, count * sizeof(T), alignof(T), nullptr);
+  }
+
+  [[nodiscard]] LayerAllocator* GetLayerAllocator() const { return allocator_; }
+
+  template <typename U>
+  bool operator==(const StlAllocator<U>& other) const {
+    return allocator_ == other.allocator_;
+  }
+
+  template <typename U>
+  bool operator!=(const StlAllocator<U>& other) const {
+    return allocator_ != other.allocator_;
+  }
+
+ private:
+  template <typename U>
+  friend class StlAllocator;
+
+  LayerAllocator* allocator_;
+};
+
+template <typename T>
+using LayerVector = std::vector<T, StlAllocator<T>>;
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_ALLOCATOR_H
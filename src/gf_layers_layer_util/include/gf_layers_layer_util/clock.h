@@ -0,0 +1,114 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_CLOCK_H
+#define GF_LAYERS_LAYER_UTIL_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// A cheap monotonic clock for timing the layers' hot paths (per-call
+// instrumentation, trace spans, frame times), where std::chrono::steady_clock
+// (a clock_gettime call) is a noticeable part of the cost.
+//
+// On x86 with an invariant TSC, and on AArch64, the clock reads the CPU's
+// counter (rdtsc or cntvct_el0) and converts it to nanoseconds. The
+// conversion is calibrated once, on first use, against the reference clock
+// (CLOCK_MONOTONIC_RAW where available), which takes a few milliseconds on
+// x86; the AArch64 counter frequency is read from cntfrq_el0 instead.
+// Otherwise, the clock reads the reference clock.
+//
+// The times are in nanoseconds since an unspecified epoch, so they are only
+// comparable with each other, not with std::chrono::steady_clock.
+
+namespace gf_layers {
+
+enum class ClockSource : std::int32_t {
+  kReferenceClock = 0,
+  kCpuCounter = 1,
+};
+
+namespace internal {
+
+// The conversion from counter ticks to nanoseconds:
+// ns = base_ns + (ticks - base_ticks) * ns_per_tick.
+struct ClockCalibration {
+  std::uint64_t base_ticks;
+  std::uint64_t base_ns;
+  double ns_per_tick;
+};
+
+// A |ClockSource|, or negative until the clock is calibrated.
+extern std::atomic<std::int32_t> clock_state;
+
+// Written before |clock_state| is set; read-only afterwards.
+extern ClockCalibration clock_calibration;
+
+// Calibrates the clock, if needed, and returns the |clock_state|.
+std::int32_t InitClock();
+
+std::uint64_t ReadReferenceClockNs();
+
+// Returns the CPU's counter, or 0 if there is none.
+inline std::uint64_t ReadCpuCounter() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t result = 0;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(result));  // NOLINT
+  return result;
+#else
+  return 0;
+#endif
+}
+
+}  // namespace internal
+
+// Returns the source that |ClockNowNs| reads, calibrating the clock if needed.
+inline ClockSource GetClockSource() {
+  std::int32_t state = internal::clock_state.load(std::memory_order_acquire);
+  if (state < 0) {
+    state = internal::InitClock();
+  }
+  return static_cast<ClockSource>(state);
+}
+
+// Returns the current time in nanoseconds.
+inline std::uint64_t ClockNowNs() {
+  if (GetClockSource() == ClockSource::kReferenceClock) {
+    return internal::ReadReferenceClockNs();
+  }
+  // The counters of different cores may be slightly out of sync, so a thread
+  // that migrated could read a counter just before |base_ticks|.
+  auto elapsed_ticks = static_cast<std::int64_t>(
+      internal::ReadCpuCounter() - internal::clock_calibration.base_ticks);
+  if (elapsed_ticks < 0) {
+    elapsed_ticks = 0;
+  }
+  return internal::clock_calibration.base_ns +
+         static_cast<std::uint64_t>(static_cast<double>(elapsed_ticks) *
+                                    internal::clock_calibration.ns_per_tick);
+}
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_CLOCK_H
@@ -0,0 +1,112 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_EPOCH_H
+#define GF_LAYERS_LAYER_UTIL_EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/base/optimization.h"
+
+// Epoch-based reclamation of memory that is read without locks.
+//
+// Readers wrap their lock-free accesses in an |EpochGuard|. Writers that
+// unlink an object that readers might still be looking at must pass it to
+// |RetireInEpoch| instead of freeing it directly; the object is then freed
+// once every |EpochGuard| that was alive when it was retired has been
+// destroyed.
+//
+// Entering and leaving an |EpochGuard| only writes to a record owned by the
+// calling thread, so readers never contend with each other. Retiring an
+// object takes a mutex and scans the records of all threads, so it should be
+// rare compared to reads (e.g. when a hash table is resized).
+
+namespace gf_layers {
+
+namespace internal {
+
+// Epoch value that indicates that a thread is not in a read-side critical
+// section. The global epoch starts at 1 and only increases.
+constexpr std::uint64_t kEpochInactive = 0;
+
+// Per-thread record. Records are never freed; they are reused by new threads
+// once their owning thread exits. Cache-line aligned so that threads entering
+// and leaving critical sections do not cause false sharing.
+struct ABSL_CACHELINE_ALIGNED EpochThreadRecord {
+  // The global epoch observed when the thread entered its outermost critical
+  // section, or |kEpochInactive|.
+  std::atomic<std::uint64_t> epoch{kEpochInactive};
+  // Nesting depth of |EpochGuard|s; only accessed by the owning thread.
+  std::uint32_t depth = 0;
+  // Whether a thread currently owns this record.
+  std::atomic<bool> in_use{false};
+  // Next record in the global list of records.
+  EpochThreadRecord* next = nullptr;
+};
+
+extern std::atomic<std::uint64_t> global_epoch;
+
+// Returns the record of the calling thread, acquiring a record if needed.
+EpochThreadRecord* AcquireEpochThreadRecord();
+
+inline thread_local EpochThreadRecord* epoch_thread_record = nullptr;
+
+}  // namespace internal
+
+// Marks the lifetime of a read-side critical section. Any object reachable
+// via lock-free reads within the critical section will not be freed until
+// the guard is destroyed. Guards can be nested.
+class EpochGuard {
+ public:
+  EpochGuard() : record_(internal::epoch_thread_record) {
+    if (ABSL_PREDICT_FALSE(record_ == nullptr)) {
+      record_ = internal::AcquireEpochThreadRecord();
+    }
+    if (record_->depth++ == 0) {
+      record_->epoch.store(
+          internal::global_epoch.load(std::memory_order_acquire),
+          std::memory_order_relaxed);
+      // Our epoch must be visible to writers before we read any shared
+      // pointers; pairs with the fence in the reclamation scan.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  ~EpochGuard() {
+    if (--record_->depth == 0) {
+      record_->epoch.store(internal::kEpochInactive, std::memory_order_release);
+    }
+  }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+  EpochGuard(EpochGuard&&) = delete;
+  EpochGuard& operator=(EpochGuard&&) = delete;
+
+ private:
+  internal::EpochThreadRecord* record_;
+};
+
+// Schedules |deleter(object)| to be called once no reader can still hold a
+// reference to |object|. |object| must already be unreachable for new readers.
+// Also frees any previously retired objects that have become safe to free.
+void RetireInEpoch(void* object, void (*deleter)(void*));
+
+// Frees all retired objects that have become safe to free.
+void ReclaimRetiredObjects();
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_EPOCH_H
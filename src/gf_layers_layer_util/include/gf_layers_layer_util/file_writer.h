@@ -0,0 +1,116 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_FILE_WRITER_H
+#define GF_LAYERS_LAYER_UTIL_FILE_WRITER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Asynchronous writing of whole files (or appending to files), so that the
+// layers do not block the thread that made the Vulkan call on file I/O.
+//
+// Each layer library has one writer thread, which writes the queued files in
+// order: it opens a batch of files and writes them through io_uring on Linux,
+// or with pwrite where io_uring is unavailable (or on Android, where it is
+// blocked for applications). The setting "VkLayer_GF_FILE_WRITER_IO_URING"
+// (Android property "debug.gf.file_writer_io_uring") can be set to 0 to
+// always use pwrite.
+//
+// The queue is bounded; |WriteFileAsync| blocks while it is full. The writer
+// thread writes all queued files before it stops at exit, or when the layer
+// library is unloaded. On Windows, where the writer thread could not be
+// joined while the library is being unloaded, the files are written
+// synchronously.
+
+namespace gf_layers {
+
+// Bytes to write, which the writer keeps alive until they are written.
+class WriteBuffer {
+ public:
+  WriteBuffer() = default;
+
+  // Takes ownership of |data|.
+  explicit WriteBuffer(std::string data) {
+    auto owner = std::make_shared<std::string>(std::move(data));
+    data_ = owner->data();
+    size_ = owner->size();
+    owner_ = std::move(owner);
+  }
+
+  // Takes ownership of |data|.
+  template <typename T>
+  explicit WriteBuffer(std::vector<T> data) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "The elements must be written as bytes.");
+    auto owner = std::make_shared<std::vector<T>>(std::move(data));
+    data_ = reinterpret_cast<const char*>(owner->data());
+    size_ = owner->size() * sizeof(T);
+    owner_ = std::move(owner);
+  }
+
+  // Shares ownership of |owner|, which must keep the |size| bytes at |data|
+  // alive and unchanged.
+  WriteBuffer(std::shared_ptr<const void> owner, const void* data,
+              std::size_t size)
+      : owner_(std::move(owner)),
+        data_(static_cast<const char*>(data)),
+        size_(size) {}
+
+  [[nodiscard]] const char* GetData() const { return data_; }
+
+  [[nodiscard]] std::size_t GetSize() const { return size_; }
+
+ private:
+  std::shared_ptr<const void> owner_;
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Called on the writer thread once a file is written (|success| is false if
+// the file could not be opened or written), in the order in which the files
+// were queued. Must not queue more files.
+using WriteCallback = std::function<void(bool success)>;
+
+// Queues writing |buffer| to the file |file_path|, replacing the file. Files
+// that fail to be written are logged. Blocks while too many files (or bytes)
+// are queued.
+void WriteFileAsync(std::string file_path, WriteBuffer buffer,
+                    WriteCallback callback = nullptr);
+
+// Like |WriteFileAsync|, but appends |buffer| to the file |file_path|,
+// creating the file if needed.
+void AppendFileAsync(std::string file_path, WriteBuffer buffer,
+                     WriteCallback callback = nullptr);
+
+// Waits until all queued files have been written.
+void FlushFileWrites();
+
+enum class FileWriterBackend {
+  kSynchronous,
+  kPwrite,
+  kIoUring,
+};
+
+// Returns how the files are written, starting the writer if needed.
+FileWriterBackend GetFileWriterBackend();
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_FILE_WRITER_H
@@ -0,0 +1,91 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_FRAME_TIME_HISTOGRAM_H
+#define GF_LAYERS_LAYER_UTIL_FRAME_TIME_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// A histogram of frame times, so that the distribution of the frame times
+// (and so the hitches) can be reported, not just the average.
+//
+// The buckets are log-linear: each power of two of nanoseconds is split into
+// 32 buckets, so a frame time is known to within about 3%, from 1ns up to
+// 2^37ns (about 137s); longer frame times are counted in the last bucket.
+// Recording takes no locks and does not allocate, so it can be done on every
+// present.
+
+namespace gf_layers {
+
+// The statistics of the recorded frame times. All zero if none were recorded.
+struct FrameTimeStats {
+  std::uint64_t count = 0;
+  std::uint64_t min_ns = 0;
+  std::uint64_t max_ns = 0;
+  std::uint64_t mean_ns = 0;
+  // The percentiles are the middle of their bucket.
+  std::uint64_t p50_ns = 0;
+  std::uint64_t p90_ns = 0;
+  std::uint64_t p99_ns = 0;
+  std::uint64_t p999_ns = 0;
+  // The frame rate of the slowest 1% of frames (at least one frame).
+  double one_percent_low_fps = 0.0;
+};
+
+class FrameTimeHistogram {
+ public:
+  static constexpr std::uint32_t kSubBucketBits = 5;
+  static constexpr std::uint64_t kSubBucketCount = 1U << kSubBucketBits;
+  // The largest power of two that is split into buckets.
+  static constexpr std::uint32_t kMaxExponent = 36;
+  static constexpr std::size_t kBucketCount =
+      (kMaxExponent - kSubBucketBits + 2) * kSubBucketCount;
+
+  FrameTimeHistogram() = default;
+
+  FrameTimeHistogram(const FrameTimeHistogram&) = delete;
+  FrameTimeHistogram& operator=(const FrameTimeHistogram&) = delete;
+  FrameTimeHistogram(FrameTimeHistogram&&) = delete;
+  FrameTimeHistogram& operator=(FrameTimeHistogram&&) = delete;
+
+  // Thread-safe.
+  void Record(std::uint64_t frame_time_ns);
+
+  // Frame times that are recorded concurrently may be lost.
+  void Clear();
+
+  // May be called concurrently with |Record|, in which case the statistics
+  // may not include all concurrently recorded frame times.
+  [[nodiscard]] FrameTimeStats GetStats() const;
+
+  static std::size_t GetBucketIndex(std::uint64_t frame_time_ns);
+
+  // Returns the smallest frame time counted in bucket |index|.
+  static std::uint64_t GetBucketLowerBound(std::size_t index);
+
+ private:
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets_{};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> total_ns_{0};
+  std::atomic<std::uint64_t> min_ns_{std::numeric_limits<std::uint64_t>::max()};
+  std::atomic<std::uint64_t> max_ns_{0};
+};
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_FRAME_TIME_HISTOGRAM_H
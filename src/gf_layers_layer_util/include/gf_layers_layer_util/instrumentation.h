@@ -0,0 +1,123 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_INSTRUMENTATION_H
+#define GF_LAYERS_LAYER_UTIL_INSTRUMENTATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "gf_layers_layer_util/clock.h"
+
+// Opt-in instrumentation of the layers' functions: call counts and latency
+// histograms for each function, to see what a layer costs per call in a real
+// application. Enabled by defining GF_LAYERS_INSTRUMENTATION (see the CMake
+// option of the same name); otherwise, the macros at the end of this file
+// compile to nothing.
+//
+// Each thread records into its own counters, so recording takes no locks and
+// threads do not share cache lines. The counters of all threads are summed
+// when the results are logged: by GF_LAYERS_DUMP_INSTRUMENTATION (which the
+// layers call in vkDestroyDevice) and at process exit.
+
+namespace gf_layers::instrumentation {
+
+// The maximum number of instrumented functions. Calls to any further
+// functions are not recorded.
+constexpr std::uint32_t kMaxEntryPoints = 128;
+
+// Bucket 0 counts calls that took 0ns, and bucket i > 0 counts calls that took
+// [2^(i-1), 2^i) ns. The last bucket also counts all longer calls.
+constexpr std::size_t kHistogramBuckets = 32;
+
+constexpr std::uint32_t kUnregisteredIndex = ~0U;
+
+// An instrumented function. Declared as a static local variable by
+// GF_LAYERS_SCOPED_TIMER; it is constant-initialized, so it adds no
+// initialization guard. It is registered on first use.
+struct EntryPoint {
+  const char* layer_name;
+  const char* function_name;
+  std::atomic<std::uint32_t> index{kUnregisteredIndex};
+};
+
+namespace internal {
+
+// Registers |entry_point|, if needed, and returns its index, or
+// |kUnregisteredIndex| if there are too many entry points.
+std::uint32_t RegisterEntryPoint(EntryPoint* entry_point);
+
+// Records a call to entry point |index| that took |elapsed_ns|.
+void RecordCall(std::uint32_t index, std::uint64_t elapsed_ns);
+
+}  // namespace internal
+
+// Records the duration of its scope as a call to |entry_point|.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(EntryPoint* entry_point)
+      : index_(GetIndex(entry_point)), start_ns_(ClockNowNs()) {}
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ScopedTimer(ScopedTimer&&) = delete;
+  ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+  ~ScopedTimer() {
+    std::uint64_t end_ns = ClockNowNs();
+    internal::RecordCall(index_, end_ns > start_ns_ ? end_ns - start_ns_ : 0);
+  }
+
+ private:
+  static std::uint32_t GetIndex(EntryPoint* entry_point) {
+    std::uint32_t index = entry_point->index.load(std::memory_order_acquire);
+    return index != kUnregisteredIndex
+               ? index
+               : internal::RegisterEntryPoint(entry_point);
+  }
+
+  std::uint32_t index_;
+  std::uint64_t start_ns_;
+};
+
+// Logs the call count and latency histogram of each function of |layer_name|
+// (or of all layers, if nullptr) that has been called, summed over all
+// threads. The counts are cumulative; they are not reset.
+void Dump(const char* layer_name);
+
+}  // namespace gf_layers::instrumentation
+
+#if defined(GF_LAYERS_INSTRUMENTATION)
+
+// Records each call to the enclosing function as a call to function __func__
+// of |layer_name|, which must be a string literal.
+#define GF_LAYERS_SCOPED_TIMER(layer_name)                                   \
+  static gf_layers::instrumentation::EntryPoint gf_layers_entry_point{       \
+      layer_name, __func__};                                                 \
+  const gf_layers::instrumentation::ScopedTimer gf_layers_scoped_timer(      \
+      &gf_layers_entry_point)
+
+#define GF_LAYERS_DUMP_INSTRUMENTATION(layer_name) \
+  gf_layers::instrumentation::Dump(layer_name)
+
+#else
+
+#define GF_LAYERS_SCOPED_TIMER(layer_name) static_cast<void>(0)
+
+#define GF_LAYERS_DUMP_INSTRUMENTATION(layer_name) static_cast<void>(0)
+
+#endif
+
+#endif  // GF_LAYERS_LAYER_UTIL_INSTRUMENTATION_H
@@ -0,0 +1,193 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_LIVE_STATS_H
+#define GF_LAYERS_LAYER_UTIL_LIVE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "gf_layers_layer_util/clock.h"
+
+// Live statistics of the layers, in a memory-mapped file that the layers
+// update in place, so that an external monitor (such as the
+// gf_layers_live_stats tool) can display them while the application runs.
+//
+// Enabled by the "VkLayer_GF_LIVE_STATS_FILE_PREFIX" setting (Android property
+// "debug.gf.live_stats_file_prefix"). Each layer library maps its own file,
+// "<prefix>_<layer library>_<pid>.stats", which is left in place at exit.
+// Not supported on Windows.
+//
+// The file has the fixed layout of |LiveStatsFile|, which is versioned so that
+// readers can reject files they do not understand. Updates are published under
+// a sequence lock: the sequence number is odd while an update is in progress,
+// and a reader retries if the number is odd or changes while it copies the
+// values (see |ReadLiveStats|). Thus, readers never block the layers.
+
+namespace gf_layers {
+
+constexpr std::uint32_t kLiveStatsMagic = 0x534C4647;  // "GFLS"
+
+// Incremented whenever the layout of |LiveStatsFile| changes.
+constexpr std::uint32_t kLiveStatsVersion = 1;
+
+enum class LiveStatsValue : std::uint32_t {
+  // The number of frames (calls to vkQueuePresentKHR) and the time between
+  // consecutive presents.
+  kFrameCount = 0,
+  kLastFrameTimeNs = 1,
+  kMinFrameTimeNs = 2,
+  kMaxFrameTimeNs = 3,
+  kTotalFrameTimeNs = 4,
+  // Draw calls captured by amber_scoop.
+  kCapturedDrawCalls = 5,
+  // Shaders fuzzed by shader_fuzzer.
+  kFuzzedShaders = 6,
+  // Bytes written to files by the layers.
+  kBytesWritten = 7,
+  // Time spent in the layers' expensive processing (amber_scoop's processing
+  // of submitted command buffers and shader_fuzzer's fuzzing), excluding the
+  // time spent in the next layer or driver.
+  kLayerCpuTimeNs = 8,
+  // The steady clock time of the last update.
+  kUpdateTimeNs = 9,
+};
+
+constexpr std::size_t kLiveStatsValueCount = 10;
+
+using LiveStatsValues = std::array<std::uint64_t, kLiveStatsValueCount>;
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free &&
+                  std::atomic<std::uint64_t>::is_always_lock_free,
+              "Live statistics are shared between processes, so their atomics "
+              "must be lock-free.");
+
+struct LiveStatsFile {
+  // |kLiveStatsMagic|; written last, when the file is initialized.
+  std::atomic<std::uint32_t> magic;
+  std::uint32_t version;
+  // sizeof(LiveStatsFile).
+  std::uint32_t size;
+  std::uint32_t process_id;
+  std::atomic<std::uint32_t> sequence;
+  std::uint32_t reserved;
+  // Indexed by |LiveStatsValue|.
+  std::array<std::atomic<std::uint64_t>, kLiveStatsValueCount> values;
+};
+
+// Copies the values of |file| into |values|, retrying while an update is in
+// progress. Returns false if the file is not initialized, has a different
+// version, or was updated continuously.
+inline bool ReadLiveStats(const LiveStatsFile& file, LiveStatsValues* values) {
+  if (file.magic.load(std::memory_order_acquire) != kLiveStatsMagic ||
+      file.version != kLiveStatsVersion || file.size != sizeof(file)) {
+    return false;
+  }
+  constexpr int kMaxAttempts = 1000;
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    std::uint32_t sequence = file.sequence.load(std::memory_order_acquire);
+    if ((sequence & 1U) != 0) {
+      continue;
+    }
+    for (std::size_t i = 0; i < kLiveStatsValueCount; ++i) {
+      (*values)[i] = file.values[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (file.sequence.load(std::memory_order_relaxed) == sequence) {
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace internal {
+
+// Zero if live statistics are disabled and positive if they are enabled.
+// Negative until initialized from the "VkLayer_GF_LIVE_STATS_FILE_PREFIX"
+// setting.
+extern std::atomic<std::int32_t> live_stats_state;
+
+bool InitLiveStatsState();
+
+void AddLiveStatsFrame(std::uint64_t frame_time_ns);
+
+void AddLiveStat(LiveStatsValue value, std::uint64_t amount);
+
+}  // namespace internal
+
+// Returns whether live statistics are enabled. Cheap enough to call for every
+// frame.
+inline bool IsLiveStatsEnabled() {
+  std::int32_t state =
+      internal::live_stats_state.load(std::memory_order_relaxed);
+  if (state < 0) {
+    return internal::InitLiveStatsState();
+  }
+  return state > 0;
+}
+
+// Counts a frame that took |frame_time_ns|.
+inline void AddLiveStatsFrame(std::uint64_t frame_time_ns) {
+  if (IsLiveStatsEnabled()) {
+    internal::AddLiveStatsFrame(frame_time_ns);
+  }
+}
+
+// Adds |amount| to the counter |value|, which must be one of
+// |kCapturedDrawCalls|, |kFuzzedShaders|, |kBytesWritten| and
+// |kLayerCpuTimeNs|.
+inline void AddLiveStat(LiveStatsValue value, std::uint64_t amount) {
+  if (IsLiveStatsEnabled()) {
+    internal::AddLiveStat(value, amount);
+  }
+}
+
+// Adds the time from its construction until |Stop| (or its destruction) to
+// |LiveStatsValue::kLayerCpuTimeNs|. Call |Stop| before calling the next layer.
+class LayerCpuTimer {
+ public:
+  LayerCpuTimer() {
+    if (IsLiveStatsEnabled()) {
+      start_ns_ = ClockNowNs();
+    }
+  }
+
+  LayerCpuTimer(const LayerCpuTimer&) = delete;
+  LayerCpuTimer& operator=(const LayerCpuTimer&) = delete;
+  LayerCpuTimer(LayerCpuTimer&&) = delete;
+  LayerCpuTimer& operator=(LayerCpuTimer&&) = delete;
+
+  ~LayerCpuTimer() { Stop(); }
+
+  void Stop() {
+    if (start_ns_ == 0) {
+      return;
+    }
+    std::uint64_t end_ns = ClockNowNs();
+    if (end_ns > start_ns_) {
+      internal::AddLiveStat(LiveStatsValue::kLayerCpuTimeNs,
+                            end_ns - start_ns_);
+    }
+    start_ns_ = 0;
+  }
+
+ private:
+  std::uint64_t start_ns_ = 0;
+};
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_LIVE_STATS_H
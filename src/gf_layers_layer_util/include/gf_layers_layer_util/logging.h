@@ -15,9 +15,66 @@
 #ifndef GF_LAYERS_LAYER_UTIL_LOGGING_H
 #define GF_LAYERS_LAYER_UTIL_LOGGING_H
 
+#include <atomic>
+#include <cstdint>
+
 namespace gf_layers {
 
-void Log(const char* format_string, ...);
+enum class LogLevel : std::int32_t {
+  kDebug = 0,
+  kInfo = 1,
+  kWarning = 2,
+  kError = 3,
+  // Used for assertion failures. Fatal messages are never rate-limited or
+  // dropped, and are written synchronously after flushing pending messages.
+  kFatal = 4,
+};
+
+// Rate-limiting state for a single LOG call site. Declared as a static local
+// variable by the logging macros; it is constant-initialized, so it adds no
+// initialization guard.
+struct LogCallSite {
+  // Start of the current rate-limiting window, in nanoseconds.
+  std::atomic<std::uint64_t> window_start_ns{0};
+  // Number of messages logged in the current window.
+  std::atomic<std::uint32_t> count{0};
+  // Number of messages suppressed since the last logged message.
+  std::atomic<std::uint32_t> suppressed{0};
+};
+
+namespace internal {
+
+// Messages below this level are discarded. Negative until initialized from
+// the "VkLayer_GF_LOG_LEVEL" setting.
+extern std::atomic<std::int32_t> log_level_threshold;
+
+std::int32_t InitLogLevelThreshold();
+
+}  // namespace internal
+
+// Returns whether messages at |level| should be logged. Cheap enough to call
+// before formatting every message.
+inline bool IsLogLevelEnabled(LogLevel level) {
+  std::int32_t threshold =
+      internal::log_level_threshold.load(std::memory_order_relaxed);
+  if (threshold < 0) {
+    threshold = internal::InitLogLevelThreshold();
+  }
+  return static_cast<std::int32_t>(level) >= threshold;
+}
+
+// Formats and logs a message. By default, the message is formatted on the
+// calling thread into a lock-free ring buffer and written to stderr (or logcat
+// on Android) by a background thread, so that logging does not stall the
+// calling thread. If the ring buffer is full, the message is dropped and
+// counted (errors are instead written synchronously); the number of dropped
+// messages is logged later. Messages from |call_site| beyond the per-call-site
+// rate limit are also counted and dropped.
+void LogAt(LogLevel level, LogCallSite* call_site, const char* format_string,
+           ...);
+
+// Blocks until all messages logged before the call have been written.
+void FlushLog();
 
 }  // namespace gf_layers
 
@@ -30,42 +87,54 @@ void Log(const char* format_string, ...);
 #define GF_LAYERS_STRINGIFY(X) GF_LAYERS_STRINGIFY_HELPER(X)
 #define GF_LAYERS_STRINGIFY_HELPER(X) #X
 
-// Logs to stderr, or logcat on Android.
-// The first argument must be a string literal because we add adjacent string
-// literals.
+// Logs at |level| to stderr, or logcat on Android.
+// The first argument after |level| must be a string literal because we add
+// adjacent string literals.
 // Pretends to call fprintf directly, which ensures static checks of the format
 // string on most compilers, without any compiler-specific annotations.
-#define LOG(...)                                                        \
+#define GF_LAYERS_LOG_AT(level, ...)                                    \
   do {                                                                  \
-    gf_layers::Log(__FILE__                                             \
-                   ":" GF_LAYERS_STRINGIFY(__LINE__) ": " __VA_ARGS__); \
+    static gf_layers::LogCallSite gf_layers_log_call_site;              \
+    if (gf_layers::IsLogLevelEnabled(level)) {                          \
+      gf_layers::LogAt(                                                 \
+          level, &gf_layers_log_call_site,                              \
+          __FILE__ ":" GF_LAYERS_STRINGIFY(__LINE__) ": " __VA_ARGS__); \
+    }                                                                   \
     if (false) {                                                        \
       std::fprintf(stderr, __VA_ARGS__);                                \
     }                                                                   \
   } while (false)
 
-#define RUNTIME_ASSERT(x)           \
-  do {                              \
-    if (!(x)) {                     \
-      LOG("Assertion failed: " #x); \
-      abort();                      \
-    }                               \
+#define LOG(...) GF_LAYERS_LOG_AT(gf_layers::LogLevel::kInfo, __VA_ARGS__)
+
+#define LOG_WARNING(...) \
+  GF_LAYERS_LOG_AT(gf_layers::LogLevel::kWarning, __VA_ARGS__)
+
+#define LOG_ERROR(...) \
+  GF_LAYERS_LOG_AT(gf_layers::LogLevel::kError, __VA_ARGS__)
+
+#define RUNTIME_ASSERT(x)                                                     \
+  do {                                                                        \
+    if (!(x)) {                                                               \
+      GF_LAYERS_LOG_AT(gf_layers::LogLevel::kFatal, "Assertion failed: " #x); \
+      abort();                                                                \
+    }                                                                         \
   } while (false)
 
-#define RUNTIME_ASSERT_MSG(x, ...)  \
-  do {                              \
-    if (!(x)) {                     \
-      LOG("Assertion failed: " #x); \
-      LOG("Message: " __VA_ARGS__); \
-      abort();                      \
-    }                               \
+#define RUNTIME_ASSERT_MSG(x, ...)                                            \
+  do {                                                                        \
+    if (!(x)) {                                                               \
+      GF_LAYERS_LOG_AT(gf_layers::LogLevel::kFatal, "Assertion failed: " #x); \
+      GF_LAYERS_LOG_AT(gf_layers::LogLevel::kFatal, "Message: " __VA_ARGS__); \
+      abort();                                                                \
+    }                                                                         \
   } while (false)
 
-#define DEBUG_LOG(...)     \
-  do {                     \
-    if (GF_LAYERS_DEBUG) { \
-      LOG(__VA_ARGS__);    \
-    }                      \
+#define DEBUG_LOG(...)                                            \
+  do {                                                            \
+    if (GF_LAYERS_DEBUG) {                                        \
+      GF_LAYERS_LOG_AT(gf_layers::LogLevel::kDebug, __VA_ARGS__); \
+    }                                                             \
   } while (false)
 
 #define DEBUG_ASSERT(x)    \
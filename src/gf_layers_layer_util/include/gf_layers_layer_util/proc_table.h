@@ -0,0 +1,177 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_PROC_TABLE_H
+#define GF_LAYERS_LAYER_UTIL_PROC_TABLE_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace gf_layers {
+
+constexpr std::size_t kMaxProcNames = 128;
+
+// A set of functions, identified by their index in a |ProcNameTable|. Used by
+// layers to record which of their functions are needed for a given device;
+// vkGetDeviceProcAddr returns the next layer's function for the others, so
+// that the layer adds no overhead to those calls.
+using ProcSet = std::bitset<kMaxProcNames>;
+
+// A perfect hash table from the names of the functions provided by a layer to
+// their index in the list of names, built at compile time. Used by
+// vkGet{Instance,Device}ProcAddr so that each lookup costs one hash of the
+// name and at most one string comparison, instead of a |strcmp| per function.
+//
+// Usage:
+//
+//   constexpr auto kTable = MakeProcNameTable(
+//       std::array{std::string_view("vkFoo"), std::string_view("vkBar")});
+//   static_assert(kTable.IsPerfect(), "...");
+//   ...
+//   static const std::array<PFN_vkVoidFunction, kTable.size()> functions = {
+//       reinterpret_cast<PFN_vkVoidFunction>(vkFoo),
+//       reinterpret_cast<PFN_vkVoidFunction>(vkBar)};
+//   return kTable.Lookup(pName, functions);
+template <std::size_t N>
+class ProcNameTable {
+ public:
+  constexpr explicit ProcNameTable(
+      const std::array<std::string_view, N>& names)
+      : names_(names) {
+    std::array<std::uint64_t, N> hashes{};
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = HashName(names_[i]);
+      for (std::size_t j = 0; j < i; ++j) {
+        if (hashes[j] == hashes[i]) {
+          // A repeated name (or, very unlikely, a full hash collision).
+          return;
+        }
+      }
+    }
+
+    // Try seeds until no two names map to the same slot. With a load factor of
+    // at most 1/8, a few hundred attempts suffice even for large tables.
+    for (std::uint64_t seed = 0; seed < kMaxSeedAttempts; ++seed) {
+      if (TrySeed(hashes, seed)) {
+        seed_ = seed;
+        perfect_ = true;
+        return;
+      }
+    }
+  }
+
+  // Returns false if no collision-free seed was found (or a name is repeated),
+  // in which case lookups must not be used. Intended for a static_assert.
+  constexpr bool IsPerfect() const { return perfect_; }
+
+  static constexpr std::size_t size() { return N; }
+
+  // Returns the index of |name| in the names, or |N| if it is not present.
+  std::size_t Find(const char* name) const {
+    std::string_view name_view(name);
+    std::uint16_t index = slots_[SlotFor(HashName(name_view), seed_)];
+    if (index == kEmptySlot || names_[index] != name_view) {
+      return N;
+    }
+    return index;
+  }
+
+  // Like |Find|, but usable in constant expressions.
+  constexpr std::size_t IndexOf(std::string_view name) const {
+    for (std::size_t i = 0; i < N; ++i) {
+      if (names_[i] == name) {
+        return i;
+      }
+    }
+    return N;
+  }
+
+  // Returns the element of |values| at the index of |name|, or a
+  // value-initialized |T| (e.g. nullptr) if |name| is not present.
+  template <typename T>
+  T Lookup(const char* name, const std::array<T, N>& values) const {
+    std::size_t index = Find(name);
+    return index == N ? T{} : values[index];
+  }
+
+ private:
+  static_assert(N > 0 && N <= kMaxProcNames, "Unsupported number of names");
+
+  static constexpr std::size_t ComputeNumSlots() {
+    std::size_t result = 8;
+    while (result < N * 8) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  static constexpr std::size_t kNumSlots = ComputeNumSlots();
+  static constexpr std::uint16_t kEmptySlot = 0xffffU;
+  static constexpr std::uint64_t kMaxSeedAttempts = 1U << 16U;
+
+  // FNV-1a.
+  static constexpr std::uint64_t HashName(std::string_view name) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : name) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  // The MurmurHash3 finalizer, so that every bit of |seed| affects the slot.
+  static constexpr std::size_t SlotFor(std::uint64_t hash,
+                                       std::uint64_t seed) {
+    std::uint64_t x = hash ^ (seed * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 33U;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33U;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33U;
+    return static_cast<std::size_t>(x & (kNumSlots - 1));
+  }
+
+  constexpr bool TrySeed(const std::array<std::uint64_t, N>& hashes,
+                         std::uint64_t seed) {
+    for (std::uint16_t& slot : slots_) {
+      slot = kEmptySlot;
+    }
+    for (std::size_t i = 0; i < N; ++i) {
+      std::uint16_t& slot = slots_[SlotFor(hashes[i], seed)];
+      if (slot != kEmptySlot) {
+        return false;
+      }
+      slot = static_cast<std::uint16_t>(i);
+    }
+    return true;
+  }
+
+  std::array<std::string_view, N> names_;
+  std::array<std::uint16_t, kNumSlots> slots_{};
+  std::uint64_t seed_ = 0;
+  bool perfect_ = false;
+};
+
+template <std::size_t N>
+constexpr ProcNameTable<N> MakeProcNameTable(
+    const std::array<std::string_view, N>& names) {
+  return ProcNameTable<N>(names);
+}
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_PROC_TABLE_H
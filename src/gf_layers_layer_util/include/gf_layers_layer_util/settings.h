@@ -15,17 +15,152 @@
 #ifndef GF_LAYERS_LAYER_UTIL_SETTINGS_H
 #define GF_LAYERS_LAYER_UTIL_SETTINGS_H
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_layer_util/util.h"
+
+// Settings are read from, in order of precedence:
+//
+// - the settings file: "gf_layers_settings.txt" in the current directory, or
+//   the file given by the "VkLayer_GF_SETTINGS_FILE" environment variable
+//   (Android property "debug.gf.settings_file"), which contains
+//   "<environment variable name>=<value>" lines; empty lines and lines that
+//   start with '#' are ignored;
+// - environment variables;
+// - Android properties.
+//
+// Layers that keep their settings in a |SettingsRegistry| can reload them at
+// runtime when the settings file changes (e.g. to re-arm a capture window
+// without restarting the application). The file must exist when the layer
+// starts for this to work.
 
 namespace gf_layers {
 
 bool GetSettingString(const char* env_var, const char* android_prop,
                       std::string* value);
 
+// Like |GetSettingString|, but does not log if the setting is not found. Used
+// by the logger itself.
+bool TryGetSettingString(const char* env_var, const char* android_prop,
+                         std::string* value);
+
 bool GetSettingUint64(const char* env_var, const char* android_prop,
                       std::uint64_t* value);
 
+// Parses |text|, which must only contain decimal digits, into |value|.
+bool ParseSettingUint64(const std::string& text, std::uint64_t* value);
+
+// Returns whether the settings file existed when it was first read, and so
+// whether settings can be reloaded.
+bool CanReloadSettings();
+
+namespace internal {
+
+// Rereads the settings file if its size or modification time changed, at most
+// once a second. Cheap when no check is due. Returns the file's version, which
+// is incremented whenever its contents change.
+std::uint64_t CheckSettingsFile();
+
+}  // namespace internal
+
+// Reads the settings of a layer into a |SettingsType| struct, whose members
+// are registered via |Add| and whose defaults are its initial values. The
+// struct is published as an immutable snapshot, so that |Get| is wait-free;
+// |ReloadIfChanged| publishes a new snapshot when the settings file changes.
+// Old snapshots are kept until the registry is destroyed, as readers may
+// still use them; settings only change when someone edits the file, so there
+// are few of them.
+template <typename SettingsType>
+class SettingsRegistry {
+ public:
+  SettingsRegistry() = default;
+
+  ~SettingsRegistry() = default;
+
+  SettingsRegistry(const SettingsRegistry&) = delete;
+  SettingsRegistry& operator=(const SettingsRegistry&) = delete;
+  SettingsRegistry(SettingsRegistry&&) = delete;
+  SettingsRegistry& operator=(SettingsRegistry&&) = delete;
+
+  // Registers a setting. Must be called before |Load|.
+  void Add(const char* env_var, const char* android_prop,
+           std::uint64_t SettingsType::*member) {
+    settings_.push_back(
+        {env_var, android_prop,
+         [member](const char* env_var_in, const char* android_prop_in,
+                  SettingsType* settings) {
+           GetSettingUint64(env_var_in, android_prop_in, &(settings->*member));
+         }});
+  }
+
+  void Add(const char* env_var, const char* android_prop,
+           std::string SettingsType::*member) {
+    settings_.push_back(
+        {env_var, android_prop,
+         [member](const char* env_var_in, const char* android_prop_in,
+                  SettingsType* settings) {
+           GetSettingString(env_var_in, android_prop_in, &(settings->*member));
+         }});
+  }
+
+  // Reads the settings and publishes them.
+  void Load() {
+    ScopedLock lock(mutex_);
+    LoadLocked(internal::CheckSettingsFile());
+  }
+
+  // Returns the current settings. |Load| must have been called.
+  [[nodiscard]] const SettingsType& Get() const {
+    return *snapshot_.load(std::memory_order_acquire);
+  }
+
+  // Rereads the settings if the settings file changed. Returns true if new
+  // settings were published. Cheap when the file was checked recently.
+  bool ReloadIfChanged() {
+    std::uint64_t version = internal::CheckSettingsFile();
+    if (version == version_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    ScopedLock lock(mutex_);
+    if (version == version_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    LoadLocked(version);
+    return true;
+  }
+
+ private:
+  struct Setting {
+    const char* env_var;
+    const char* android_prop;
+    std::function<void(const char*, const char*, SettingsType*)> read;
+  };
+
+  // Requires |mutex_|.
+  void LoadLocked(std::uint64_t version) {
+    auto snapshot = std::make_unique<SettingsType>();
+    for (const Setting& setting : settings_) {
+      setting.read(setting.env_var, setting.android_prop, snapshot.get());
+    }
+    snapshot_.store(snapshot.get(), std::memory_order_release);
+    snapshots_.push_back(std::move(snapshot));
+    version_.store(version, std::memory_order_release);
+  }
+
+  std::vector<Setting> settings_;
+  std::atomic<const SettingsType*> snapshot_{};
+  // The settings file version that |snapshot_| was read from.
+  std::atomic<std::uint64_t> version_{};
+  MutexType mutex_;
+  std::vector<std::unique_ptr<SettingsType>> snapshots_;
+};
+
 }  // namespace gf_layers
 
 #endif  // GF_LAYERS_LAYER_UTIL_SETTINGS_H
@@ -0,0 +1,357 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_SLOT_MAP_H
+#define GF_LAYERS_LAYER_UTIL_SLOT_MAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_layer_util/epoch.h"
+#include "gf_layers_layer_util/util.h"
+
+namespace gf_layers {
+
+// A map from Vulkan handles to per-object data with the same interface and
+// concurrency guarantees as |ProtectedReadMostlyMap|: |Get| is wait-free, and
+// |Put| and |Remove| are serialized by a mutex.
+//
+// The values are stored densely, in place, in "slots" within fixed-size chunks
+// that are never moved or freed until the map is destroyed; freed slots are
+// reused by later |Put|s. Thus, values have pointer stability, and tracking
+// an object does not need a heap allocation of its own. A side index maps
+// each key to a slot id (the slot's index and generation), using the same
+// open-addressing scheme as |ProtectedReadMostlyMap|. Each slot's generation
+// is incremented whenever its value is destroyed or replaced, so a stale slot
+// id (e.g. read by a concurrent |Get| from an index that is being rebuilt)
+// never yields the value of a different object.
+//
+// Non-dispatchable handles are not guaranteed to be unique, and a driver may
+// reuse the handle of a destroyed object. If the layer did not see the
+// destruction (e.g. the destroy function is not intercepted), |Put| for the
+// reused handle replaces the stale value instead of keeping it.
+//
+// The default value of |KeyType| (e.g. VK_NULL_HANDLE) cannot be used as a
+// key. |KeyType| must be a pointer or integer type.
+template <typename KeyType, typename ValueType>
+class ProtectedSlotMap {
+ public:
+  ProtectedSlotMap()
+      : index_(new Index(kMinIndexCapacity)),
+        chunks_(new ChunkTable(kMinChunkTableCapacity)) {}
+
+  ~ProtectedSlotMap() {
+    Index* index = index_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i <= index->mask; ++i) {
+      std::uint64_t slot_id = index->entries[i].slot_id.load(
+          std::memory_order_relaxed);
+      if (slot_id != kNoSlot) {
+        GetSlot(GetSlotIndex(slot_id))->GetValue()->~ValueType();
+      }
+    }
+    for (Slot* chunk : owned_chunks_) {
+      delete[] chunk;
+    }
+    delete chunks_.load(std::memory_order_relaxed);
+    delete index;
+  }
+
+  ProtectedSlotMap(const ProtectedSlotMap&) = delete;
+  ProtectedSlotMap& operator=(const ProtectedSlotMap&) = delete;
+  ProtectedSlotMap(ProtectedSlotMap&&) = delete;
+  ProtectedSlotMap& operator=(ProtectedSlotMap&&) = delete;
+
+  ValueType* Get(const KeyType& key) const {
+    EpochGuard epoch_guard;
+    const Index* index = index_.load(std::memory_order_acquire);
+    const std::size_t mask = index->mask;
+    std::size_t i = internal::HashHandle(key) & mask;
+    // Bounded by the index size, although the load factor keeps probe
+    // sequences short.
+    for (std::size_t probe = 0; probe <= mask; ++probe) {
+      const Entry& entry = index->entries[i];
+      KeyType entry_key = entry.key.load(std::memory_order_acquire);
+      if (entry_key == key) {
+        return GetValue(entry.slot_id.load(std::memory_order_acquire));
+      }
+      if (entry_key == KeyType()) {
+        break;
+      }
+      i = (i + 1) & mask;
+    }
+    return nullptr;
+  }
+
+  // Returns false if |key| already had a value, which has been replaced.
+  bool Put(const KeyType& key, ValueType value) {
+    ScopedLock lock(mutex_);
+    Index* index = index_.load(std::memory_order_relaxed);
+    Entry* entry = FindLiveEntry(index, key);
+    if (entry != nullptr) {
+      // A reused handle: destroy the stale value and reuse its slot.
+      std::uint64_t slot_id = entry->slot_id.load(std::memory_order_relaxed);
+      Slot* slot = GetSlot(GetSlotIndex(slot_id));
+      DestroyValue(slot);
+      entry->slot_id.store(ConstructValue(GetSlotIndex(slot_id), slot,
+                                          std::move(value)),
+                           std::memory_order_release);
+      return false;
+    }
+
+    if ((used_entries_ + 1) * 4 > (index->mask + 1) * 3) {
+      index = Rebuild();
+    }
+
+    std::uint32_t slot_index = AllocateSlot();
+    std::uint64_t slot_id =
+        ConstructValue(slot_index, GetSlot(slot_index), std::move(value));
+    if (Insert(index, key, slot_id)) {
+      ++used_entries_;
+    }
+    ++live_entries_;
+    return true;
+  }
+
+  bool Remove(const KeyType& key) {
+    ScopedLock lock(mutex_);
+    Entry* entry = FindLiveEntry(index_.load(std::memory_order_relaxed), key);
+    if (entry == nullptr) {
+      return false;
+    }
+    std::uint64_t slot_id = entry->slot_id.load(std::memory_order_relaxed);
+    entry->slot_id.store(kNoSlot, std::memory_order_release);
+    DestroyValue(GetSlot(GetSlotIndex(slot_id)));
+    free_slots_.push_back(GetSlotIndex(slot_id));
+    --live_entries_;
+    return true;
+  }
+
+ private:
+  struct Slot {
+    // Odd while the slot holds a value.
+    std::atomic<std::uint32_t> generation{0};
+    std::aligned_storage_t<sizeof(ValueType), alignof(ValueType)> storage;
+
+    ValueType* GetValue() {
+      return std::launder(reinterpret_cast<ValueType*>(&storage));
+    }
+  };
+
+  struct ChunkTable {
+    explicit ChunkTable(std::size_t capacity_in)
+        : capacity(capacity_in),
+          chunks(new std::atomic<Slot*>[capacity_in]()) {}
+
+    const std::size_t capacity;
+    const std::unique_ptr<std::atomic<Slot*>[]> chunks;
+  };
+
+  // A slot id is the slot's generation in the high 32 bits and its index in
+  // the low 32 bits. Generations of live slots are odd, so a slot id is never
+  // |kNoSlot|, which marks index entries whose value was removed.
+  struct Entry {
+    std::atomic<KeyType> key{};
+    std::atomic<std::uint64_t> slot_id{};
+  };
+
+  struct Index {
+    explicit Index(std::size_t capacity)
+        : mask(capacity - 1), entries(new Entry[capacity]) {}
+
+    const std::size_t mask;
+    const std::unique_ptr<Entry[]> entries;
+  };
+
+  static constexpr std::uint64_t kNoSlot = 0;
+  // Must be powers of two.
+  static constexpr std::size_t kMinIndexCapacity = 16;
+  static constexpr std::size_t kChunkSize = 64;
+  static constexpr std::size_t kMinChunkTableCapacity = 16;
+
+  static std::uint32_t GetSlotIndex(std::uint64_t slot_id) {
+    return static_cast<std::uint32_t>(slot_id);
+  }
+
+  static std::uint32_t GetGeneration(std::uint64_t slot_id) {
+    return static_cast<std::uint32_t>(slot_id >> 32U);
+  }
+
+  // Returns the value of |slot_id|, or nullptr if it is |kNoSlot| or stale.
+  ValueType* GetValue(std::uint64_t slot_id) const {
+    if (slot_id == kNoSlot) {
+      return nullptr;
+    }
+    Slot* slot = GetSlot(GetSlotIndex(slot_id));
+    if (slot->generation.load(std::memory_order_acquire) !=
+        GetGeneration(slot_id)) {
+      return nullptr;
+    }
+    return slot->GetValue();
+  }
+
+  // Requires |mutex_|. Returns the entry for |key| that has a value.
+  static Entry* FindLiveEntry(Index* index, const KeyType& key) {
+    std::size_t i = internal::HashHandle(key) & index->mask;
+    for (std::size_t probe = 0; probe <= index->mask; ++probe) {
+      Entry& entry = index->entries[i];
+      KeyType entry_key = entry.key.load(std::memory_order_relaxed);
+      if (entry_key == KeyType()) {
+        break;
+      }
+      if (entry_key == key &&
+          entry.slot_id.load(std::memory_order_relaxed) != kNoSlot) {
+        return &entry;
+      }
+      i = (i + 1) & index->mask;
+    }
+    return nullptr;
+  }
+
+  // Requires |mutex_| and that |key| has no value in |index|. Stores |slot_id|
+  // in the first empty or removed entry for |key|. Returns true if a
+  // previously empty entry was used.
+  static bool Insert(Index* index, const KeyType& key, std::uint64_t slot_id) {
+    std::size_t i = internal::HashHandle(key) & index->mask;
+    while (true) {
+      Entry& entry = index->entries[i];
+      KeyType entry_key = entry.key.load(std::memory_order_relaxed);
+      if (entry_key == KeyType()) {
+        // Publish the slot id before the key so readers that find the key
+        // also find the slot id.
+        entry.slot_id.store(slot_id, std::memory_order_relaxed);
+        entry.key.store(key, std::memory_order_release);
+        return true;
+      }
+      if (entry.slot_id.load(std::memory_order_relaxed) == kNoSlot) {
+        // A concurrent reader looking for |key| may briefly see the key
+        // without the slot id, which is equivalent to the entry not yet being
+        // present.
+        entry.key.store(key, std::memory_order_relaxed);
+        entry.slot_id.store(slot_id, std::memory_order_release);
+        return false;
+      }
+      i = (i + 1) & index->mask;
+    }
+  }
+
+  Slot* GetSlot(std::uint32_t slot_index) const {
+    const ChunkTable* chunks = chunks_.load(std::memory_order_acquire);
+    Slot* chunk = chunks->chunks[slot_index / kChunkSize].load(
+        std::memory_order_acquire);
+    return &chunk[slot_index % kChunkSize];
+  }
+
+  // Requires |mutex_|. Returns the index of a slot without a value, preferring
+  // recently freed slots so that the values stay dense.
+  std::uint32_t AllocateSlot() {
+    if (!free_slots_.empty()) {
+      std::uint32_t result = free_slots_.back();
+      free_slots_.pop_back();
+      return result;
+    }
+    std::size_t slot_count = owned_chunks_.size() * kChunkSize;
+    if (next_slot_ == slot_count) {
+      AddChunk();
+    }
+    return next_slot_++;
+  }
+
+  // Requires |mutex_|.
+  void AddChunk() {
+    ChunkTable* chunks = chunks_.load(std::memory_order_relaxed);
+    if (owned_chunks_.size() == chunks->capacity) {
+      auto* new_chunks = new ChunkTable(chunks->capacity * 2);
+      for (std::size_t i = 0; i < chunks->capacity; ++i) {
+        new_chunks->chunks[i].store(
+            chunks->chunks[i].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+      }
+      chunks_.store(new_chunks, std::memory_order_release);
+      RetireInEpoch(chunks, [](void* object) {
+        delete static_cast<ChunkTable*>(object);
+      });
+      chunks = new_chunks;
+    }
+    auto* chunk = new Slot[kChunkSize];
+    chunks->chunks[owned_chunks_.size()].store(chunk,
+                                               std::memory_order_release);
+    owned_chunks_.push_back(chunk);
+  }
+
+  // Requires |mutex_|. Constructs |value| in |slot|, which has no value, and
+  // returns its new slot id.
+  static std::uint64_t ConstructValue(std::uint32_t slot_index, Slot* slot,
+                                      ValueType value) {
+    new (&slot->storage) ValueType(std::move(value));
+    std::uint32_t generation =
+        slot->generation.load(std::memory_order_relaxed) + 1;
+    slot->generation.store(generation, std::memory_order_release);
+    return (static_cast<std::uint64_t>(generation) << 32U) | slot_index;
+  }
+
+  // Requires |mutex_|. Invalidates the slot ids of |slot| before destroying
+  // its value.
+  static void DestroyValue(Slot* slot) {
+    slot->generation.store(
+        slot->generation.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+    slot->GetValue()->~ValueType();
+  }
+
+  // Requires |mutex_|. Replaces the index with one sized for the live entries
+  // (plus one, for the entry about to be added) with room to grow, dropping all
+  // removed entries.
+  Index* Rebuild() {
+    std::size_t capacity = kMinIndexCapacity;
+    while (capacity < (live_entries_ + 1) * 2) {
+      capacity *= 2;
+    }
+    Index* old_index = index_.load(std::memory_order_relaxed);
+    auto* index = new Index(capacity);
+    used_entries_ = 0;
+    for (std::size_t i = 0; i <= old_index->mask; ++i) {
+      const Entry& entry = old_index->entries[i];
+      std::uint64_t slot_id = entry.slot_id.load(std::memory_order_relaxed);
+      if (slot_id != kNoSlot) {
+        Insert(index, entry.key.load(std::memory_order_relaxed), slot_id);
+        ++used_entries_;
+      }
+    }
+    index_.store(index, std::memory_order_release);
+    RetireInEpoch(old_index,
+                  [](void* object) { delete static_cast<Index*>(object); });
+    return index;
+  }
+
+  std::atomic<Index*> index_;
+  std::atomic<ChunkTable*> chunks_;
+  // Number of entries in |index_| that are not empty (live or removed).
+  std::size_t used_entries_ = 0;
+  std::size_t live_entries_ = 0;
+  // The slots from |next_slot_| onwards have never been used.
+  std::uint32_t next_slot_ = 0;
+  std::vector<std::uint32_t> free_slots_;
+  std::vector<Slot*> owned_chunks_;
+  mutable MutexType mutex_;
+};
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_SLOT_MAP_H
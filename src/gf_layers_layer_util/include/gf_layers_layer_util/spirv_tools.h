@@ -0,0 +1,50 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_H
+#define GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gf_layers {
+
+// These functions use the gf_layers_spirv_tools library, which is loaded the
+// first time one of them is called. The library is looked for next to the
+// library containing the calling layer, and then via the usual library search
+// path. All functions return false (and log an error, once) if the library
+// could not be loaded.
+
+// Returns true if the gf_layers_spirv_tools library is loaded, loading it if
+// needed.
+bool LoadSpirvTools();
+
+// Sets |result| to the disassembly of the |word_count| words of SPIR-V at
+// |code|. Returns false on failure.
+bool DisassembleSpirv(const uint32_t* code, size_t word_count,
+                      std::string* result);
+
+// Sets |result| to a fuzzed version of the |word_count| words of SPIR-V at
+// |code|, using |seed| for the random generator. The applied transformations
+// are written to "<transformations_prefix>.transformations" and
+// "<transformations_prefix>.transformations_json". Returns false on failure.
+bool FuzzSpirv(const uint32_t* code, size_t word_count, uint32_t seed,
+               const std::string& transformations_prefix,
+               std::vector<uint32_t>* result);
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_H
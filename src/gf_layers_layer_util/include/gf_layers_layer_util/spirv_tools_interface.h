@@ -0,0 +1,79 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_INTERFACE_H
+#define GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_INTERFACE_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// The interface between the layers and the gf_layers_spirv_tools library,
+// which contains everything that needs SPIRV-Tools, spirv-fuzz or protobuf.
+// The layers load the library on first use (see spirv_tools.h) so that these
+// dependencies do not add to the size and load time of the layers.
+//
+// Like the Vulkan loader-layer interface, only C types cross the interface, so
+// the library and the layers do not need to share a C++ standard library.
+
+extern "C" {
+
+// Incremented when the interface changes.
+#define GF_LAYERS_SPIRV_TOOLS_INTERFACE_VERSION 1U
+
+enum GfLayersSpirvToolsMessageLevel {
+  GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR = 0,
+  GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_WARNING = 1,
+  GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_INFO = 2,
+  GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_DEBUG = 3,
+};
+
+// Passed to each function of the interface.
+struct GfLayersSpirvToolsCallbacks {
+  void* user_data;
+  // Called for each message from SPIRV-Tools and for errors.
+  void (*log)(void* user_data, GfLayersSpirvToolsMessageLevel level,
+              const char* message);
+  // Called (possibly several times) to append |size| bytes to the output.
+  void (*append_output)(void* user_data, const void* data, size_t size);
+};
+
+struct GfLayersSpirvToolsInterface {
+  // Set by the caller to GF_LAYERS_SPIRV_TOOLS_INTERFACE_VERSION.
+  uint32_t version;
+
+  // Outputs the disassembly of the |word_count| words of SPIR-V at |code|.
+  // Returns false on failure.
+  bool (*disassemble)(const uint32_t* code, size_t word_count,
+                      const GfLayersSpirvToolsCallbacks* callbacks);
+
+  // Outputs the words of a fuzzed version of the SPIR-V at |code|, using
+  // |seed| for the random generator. The applied transformations are written
+  // to "<transformations_prefix>.transformations" (binary protobuf) and
+  // "<transformations_prefix>.transformations_json". Returns false on failure.
+  bool (*fuzz)(const uint32_t* code, size_t word_count, uint32_t seed,
+               const char* transformations_prefix,
+               const GfLayersSpirvToolsCallbacks* callbacks);
+};
+
+// Exported by the library as "GfLayersSpirvToolsNegotiateInterface". Fills in
+// the functions of |pInterface|. Returns false if |pInterface->version| is not
+// supported.
+typedef bool(VKAPI_PTR* PFN_GfLayersSpirvToolsNegotiateInterface)(
+    GfLayersSpirvToolsInterface* pInterface);
+
+}  // extern "C"
+
+#endif  // GF_LAYERS_LAYER_UTIL_SPIRV_TOOLS_INTERFACE_H
@@ -0,0 +1,321 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_THREAD_POOL_H
+#define GF_LAYERS_LAYER_UTIL_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_layer_util/util.h"
+
+// A work-stealing thread pool for the layers' heavy work (disassembling
+// shaders, writing files, etc.), so that it does not run on the application
+// thread that made the Vulkan call.
+//
+// Each worker has its own queue of tasks. A worker runs the newest task of its
+// own queue first and, when its queue is empty, steals the oldest task of
+// another worker's queue. Tasks submitted from a worker go to its own queue;
+// other tasks are spread over the queues.
+//
+// Each layer library has one pool (see |AcquireLayerThreadPool|), configured
+// by the settings:
+//
+// - "VkLayer_GF_THREAD_POOL_WORKERS" (Android property
+//   "debug.gf.thread_pool_workers"): the number of workers; by default, a
+//   quarter of the hardware threads, at most 2. If 0, tasks run on the thread
+//   that submits them.
+// - "VkLayer_GF_THREAD_POOL_CPUS" ("debug.gf.thread_pool_cpus"): the CPUs that
+//   the workers may run on, such as "0,1,6-7"; by default, any CPU.
+// - "VkLayer_GF_THREAD_POOL_NICE" ("debug.gf.thread_pool_nice"): the nice
+//   level of the workers, from 0 to 19; by default, 10, so that the workers
+//   yield to the application's threads.
+//
+// The CPUs and nice level are only supported on Linux and Android.
+
+namespace gf_layers {
+
+struct ThreadPoolOptions {
+  std::uint32_t worker_count = 0;
+  // If empty, any CPU.
+  std::vector<std::uint32_t> cpus;
+  std::uint32_t nice_level = 0;
+};
+
+// Returns the options given by the settings above.
+ThreadPoolOptions GetThreadPoolOptionsFromSettings();
+
+class ThreadPool;
+
+namespace internal {
+
+// The result of a task that returns void.
+struct NoResult {};
+
+template <typename T>
+using TaskResult = std::conditional_t<std::is_void_v<T>, NoResult, T>;
+
+// The shared state of a task and its futures.
+template <typename ResultType>
+class TaskState {
+ public:
+  [[nodiscard]] bool IsReady() const {
+    return ready_.load(std::memory_order_acquire);
+  }
+
+  void Wait() {
+    if (IsReady()) {
+      return;
+    }
+    ScopedLock lock(mutex_);
+    ready_condition_.wait(lock, [this]() { return IsReady(); });
+  }
+
+  // Must be ready.
+  [[nodiscard]] const ResultType& GetResult() const { return *result_; }
+
+  // Stores |result| and runs the continuations.
+  void SetResult(ResultType result) {
+    std::vector<std::function<void()>> continuations;
+    {
+      ScopedLock lock(mutex_);
+      result_.emplace(std::move(result));
+      ready_.store(true, std::memory_order_release);
+      continuations.swap(continuations_);
+    }
+    ready_condition_.notify_all();
+    for (std::function<void()>& continuation : continuations) {
+      continuation();
+    }
+  }
+
+  // Runs |continuation| when the result is set, or now if it is already set.
+  void OnReady(std::function<void()> continuation) {
+    {
+      ScopedLock lock(mutex_);
+      if (!IsReady()) {
+        continuations_.push_back(std::move(continuation));
+        return;
+      }
+    }
+    continuation();
+  }
+
+ private:
+  MutexType mutex_;
+  std::condition_variable ready_condition_;
+  std::atomic<bool> ready_{false};
+  std::optional<ResultType> result_;
+  std::vector<std::function<void()>> continuations_;
+};
+
+// Calls |function| with |args|, returning |NoResult| if it returns void.
+template <typename Function, typename... Args>
+auto InvokeForResult(Function& function, Args&&... args) {
+  if constexpr (std::is_void_v<std::invoke_result_t<Function&, Args...>>) {
+    std::invoke(function, std::forward<Args>(args)...);
+    return NoResult{};
+  } else {
+    return std::invoke(function, std::forward<Args>(args)...);
+  }
+}
+
+// The result type of a continuation |Function| of a task that returns |T|.
+template <typename T, typename Function>
+struct ContinuationResult {
+  using type = std::invoke_result_t<Function&, const T&>;
+};
+
+template <typename Function>
+struct ContinuationResult<void, Function> {
+  using type = std::invoke_result_t<Function&>;
+};
+
+}  // namespace internal
+
+// The eventual result of a task submitted to a |ThreadPool|.
+template <typename T>
+class TaskFuture {
+ public:
+  TaskFuture() = default;
+
+  // Returns whether the future refers to a task; false if default-constructed.
+  [[nodiscard]] bool IsValid() const { return state_ != nullptr; }
+
+  [[nodiscard]] bool IsReady() const { return state_->IsReady(); }
+
+  // Waits for the task to finish. On a worker of the pool, runs other tasks
+  // while waiting, so that waiting on a worker cannot deadlock the pool.
+  void Wait() const;
+
+  // Waits for the task to finish and returns its result.
+  template <typename U = T>
+  [[nodiscard]] std::enable_if_t<!std::is_void_v<U>, const U&> Get() const {
+    Wait();
+    return state_->GetResult();
+  }
+
+  // Submits |function| to the pool when the task finishes. |function| is
+  // called with the task's result (as a const reference), or with no
+  // arguments if the task returns void. Returns the future of |function|.
+  template <typename Function>
+  auto Then(Function&& function) const;
+
+ private:
+  friend class ThreadPool;
+  template <typename U>
+  friend class TaskFuture;
+
+  using StateType = internal::TaskState<internal::TaskResult<T>>;
+
+  TaskFuture(ThreadPool* pool, std::shared_ptr<StateType> state)
+      : pool_(pool), state_(std::move(state)) {}
+
+  ThreadPool* pool_ = nullptr;
+  std::shared_ptr<StateType> state_;
+};
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(const ThreadPoolOptions& options);
+
+  // Calls |Shutdown|.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // Submits |function|, a copyable callable with no arguments, to run on a
+  // worker. Tasks must not throw.
+  template <typename Function>
+  auto Submit(Function&& function) {
+    using ResultType = std::invoke_result_t<std::decay_t<Function>&>;
+    auto state = std::make_shared<
+        internal::TaskState<internal::TaskResult<ResultType>>>();
+    Schedule([state, function = std::forward<Function>(function)]() mutable {
+      state->SetResult(internal::InvokeForResult(function));
+    });
+    return TaskFuture<ResultType>(this, std::move(state));
+  }
+
+  // Runs all submitted tasks (including tasks submitted by them) and stops
+  // the workers. Tasks submitted afterwards run on the thread that submits
+  // them.
+  void Shutdown();
+
+  [[nodiscard]] std::size_t GetWorkerCount() const { return workers_.size(); }
+
+  // Returns whether the calling thread is one of the pool's workers.
+  [[nodiscard]] bool IsWorkerThread() const;
+
+  // Runs one queued task on the calling thread, which must be a worker.
+  // Returns false if there were no queued tasks.
+  bool RunPendingTask();
+
+  // Queues |task|, or runs it now if the pool has no running workers.
+  void Schedule(std::function<void()> task);
+
+ private:
+  struct Worker {
+    MutexType mutex;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+  };
+
+  void WorkerMain(std::size_t worker_index);
+
+  // Pops the newest task of worker |worker_index|'s queue or steals the
+  // oldest task of another queue, and runs it. Returns false if all queues
+  // were empty.
+  bool RunTask(std::size_t worker_index);
+
+  const ThreadPoolOptions options_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Set once the workers have been joined.
+  std::atomic<bool> stopped_{false};
+  // Spreads the tasks submitted from other threads over the queues.
+  std::atomic<std::size_t> next_worker_index_{0};
+  // The number of queued tasks that have not been started.
+  std::atomic<std::uint64_t> queued_task_count_{0};
+
+  // Idle workers wait on |wake_condition_|.
+  MutexType wake_mutex_;
+  std::condition_variable wake_condition_;
+  std::atomic<std::uint32_t> sleeping_worker_count_{0};
+  // Guarded by |wake_mutex_|.
+  bool stopping_ = false;
+};
+
+template <typename T>
+void TaskFuture<T>::Wait() const {
+  if (pool_->IsWorkerThread()) {
+    while (!state_->IsReady() && pool_->RunPendingTask()) {
+    }
+  }
+  state_->Wait();
+}
+
+template <typename T>
+template <typename Function>
+auto TaskFuture<T>::Then(Function&& function) const {
+  using ResultType =
+      typename internal::ContinuationResult<T, std::decay_t<Function>>::type;
+  auto next_state =
+      std::make_shared<internal::TaskState<internal::TaskResult<ResultType>>>();
+  ThreadPool* pool = pool_;
+  std::shared_ptr<StateType> state = state_;
+  state_->OnReady([pool, state, next_state,
+                   function = std::forward<Function>(function)]() {
+    pool->Schedule([state, next_state, function]() mutable {
+      if constexpr (std::is_void_v<T>) {
+        next_state->SetResult(internal::InvokeForResult(function));
+      } else {
+        next_state->SetResult(
+            internal::InvokeForResult(function, state->GetResult()));
+      }
+    });
+  });
+  return TaskFuture<ResultType>(pool, std::move(next_state));
+}
+
+// Counts an instance that may use the layer library's pool. Call in
+// vkCreateInstance.
+void AcquireLayerThreadPool();
+
+// When called for the last instance, shuts down and destroys the layer
+// library's pool (if it was created), after running all submitted tasks. Call
+// in vkDestroyInstance.
+void ReleaseLayerThreadPool();
+
+// Returns the layer library's pool, creating it from the settings on first
+// use. Must be called between |AcquireLayerThreadPool| and
+// |ReleaseLayerThreadPool|.
+ThreadPool* GetLayerThreadPool();
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_THREAD_POOL_H
@@ -0,0 +1,109 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_LAYER_UTIL_TRACE_H
+#define GF_LAYERS_LAYER_UTIL_TRACE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "gf_layers_layer_util/clock.h"
+
+// A timeline of the slow work done by the layers (processing submits, fuzzing
+// and disassembling shaders, reading back buffers, writing files), in the
+// Chrome trace event format, which can be opened in Perfetto
+// (https://ui.perfetto.dev) or chrome://tracing.
+//
+// Tracing is enabled by the "VkLayer_GF_TRACE_FILE_PREFIX" setting (Android
+// property "debug.gf.trace_file_prefix"). Each thread records its spans into
+// its own buffer. At exit (or when the layer library is unloaded), the spans
+// are written to "<prefix>_<layer library>_<pid>.json". Timestamps are from
+// the same monotonic clock in every layer library, so the traces of several
+// layers can be combined by concatenating their "traceEvents" arrays.
+
+namespace gf_layers {
+
+// The maximum number of arguments of a span.
+constexpr std::size_t kMaxTraceArgs = 2;
+
+namespace internal {
+
+// Zero if tracing is disabled and positive if it is enabled. Negative until
+// initialized from the "VkLayer_GF_TRACE_FILE_PREFIX" setting.
+extern std::atomic<std::int32_t> trace_state;
+
+bool InitTraceState();
+
+struct TraceArg {
+  const char* name;
+  std::uint64_t value;
+};
+
+void RecordTraceSpan(const char* name, std::uint64_t start_ns,
+                     std::uint64_t end_ns,
+                     const std::array<TraceArg, kMaxTraceArgs>& args,
+                     std::size_t arg_count);
+
+}  // namespace internal
+
+// Returns whether tracing is enabled. Cheap enough to call for every span.
+inline bool IsTraceEnabled() {
+  std::int32_t state = internal::trace_state.load(std::memory_order_relaxed);
+  if (state < 0) {
+    return internal::InitTraceState();
+  }
+  return state > 0;
+}
+
+// Records a span from its construction to its destruction, if tracing is
+// enabled. |name| and argument names must be string literals that do not need
+// escaping in JSON.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name)
+      : name_(IsTraceEnabled() ? name : nullptr),
+        start_ns_(name_ != nullptr ? ClockNowNs() : 0) {}
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  TraceSpan(TraceSpan&&) = delete;
+  TraceSpan& operator=(TraceSpan&&) = delete;
+
+  ~TraceSpan() {
+    if (name_ != nullptr) {
+      internal::RecordTraceSpan(name_, start_ns_, ClockNowNs(), args_,
+                                arg_count_);
+    }
+  }
+
+  // Adds an argument, such as a draw call number or a buffer size, that is
+  // shown with the span. Arguments beyond |kMaxTraceArgs| are ignored.
+  void AddArg(const char* name, std::uint64_t value) {
+    if (name_ != nullptr && arg_count_ < kMaxTraceArgs) {
+      args_[arg_count_++] = {name, value};
+    }
+  }
+
+ private:
+  const char* name_;
+  std::uint64_t start_ns_;
+  std::array<internal::TraceArg, kMaxTraceArgs> args_{};
+  std::size_t arg_count_ = 0;
+};
+
+}  // namespace gf_layers
+
+#endif  // GF_LAYERS_LAYER_UTIL_TRACE_H
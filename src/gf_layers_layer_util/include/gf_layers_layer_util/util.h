@@ -18,11 +18,20 @@
 #include <vulkan/vk_layer.h>
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "gf_layers_layer_util/epoch.h"
 
 namespace gf_layers {
 using MutexType = std::mutex;
@@ -34,63 +43,82 @@ using MapTemplate = std::unordered_map<K, V>;
 
 using ScopedLock = std::unique_lock<MutexType>;
 
+namespace internal {
+
+// Hashes a Vulkan handle (a pointer or integer) for the lock-free maps.
+template <typename KeyType>
+std::size_t HashHandle(const KeyType& key) {
+  std::uint64_t bits;
+  if constexpr (std::is_pointer_v<KeyType>) {
+    bits = reinterpret_cast<std::uintptr_t>(key);
+  } else {
+    bits = static_cast<std::uint64_t>(key);
+  }
+  // Handles are often aligned pointers, so mix the bits (this is the
+  // finalizer from MurmurHash3).
+  bits ^= bits >> 33U;
+  bits *= 0xff51afd7ed558ccdULL;
+  bits ^= bits >> 33U;
+  return static_cast<std::size_t>(bits);
+}
+
+}  // namespace internal
+
 // A "tiny" map that should typically only be used to map from the dispatch
-// table for VkInstance and VkDevice. Entries cannot be deleted from this map
-// and so it is generally only suitable for VkInstance and VkDevice data under
-// the assumption that applications will only create a few of these objects
-// (typically just one of each) throughout the lifetime of the application.
-// A thread-local cache of size 1 is used to enable fast lookup and so locking
-// the mutex will usually be avoided.
+// table for VkInstance and VkDevice, under the assumption that applications
+// will only have a few of these objects alive at once (typically just one of
+// each).
+// A small thread-local cache of |kCacheEntries| entries is used to enable fast
+// lookup and so locking the mutex will usually be avoided, even when an
+// application interleaves calls on a few devices from the same thread. The
+// cache is kept in most-recently-used order, so the common case of a single
+// device only ever checks the first entry.
+// Entries can be removed (e.g. in vkDestroyDevice); each thread-local cache is
+// tagged with the map's generation, which is incremented on every removal, so
+// that stale cached entries are never returned.
+// The thread-local cache is shared by all maps with the same template
+// arguments, so there must be at most one such map.
 // See the comment in the implementation of |get| for more details.
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType, std::size_t kCacheEntries = 4>
 class ProtectedTinyStaleMap {
  public:
   // Warning: we currently require the values to have pointer stability.
   // This is guaranteed for std::unordered_map.
   using InternalMapType = MapTemplate<KeyType, ValueType>;
-  using ThreadLocalCacheType = std::pair<KeyType, ValueType*>;
+
+  // Keys and values are stored in separate arrays so that the generation, the
+  // first key and value (the fast path), and all keys (the slow path) share a
+  // cache line.
+  struct ThreadLocalCacheType {
+    std::uint64_t generation = 0;
+    std::array<KeyType, kCacheEntries> keys{};
+    std::array<ValueType*, kCacheEntries> values{};
+  };
+
+  static_assert(kCacheEntries > 0, "The cache must have at least one entry.");
 
   ValueType* Get(const KeyType& key) {
-    // If we allowed removal from the map then this method could return stale
-    // values due to its thread-local cache. E.g. if one thread removed an entry
-    // from the map, then another thread might still see the cached entry. This
-    // would normally be fine for most situations in Vulkan, as applications
-    // must not access destroyed Vulkan objects. However, there would still be a
-    // risk of returning stale data, albeit extremely unlikely in practice: a
-    // thread destroys a Vulkan object, then creates a new object that gets the
-    // same handle as the old object. Other threads may have cached the
-    // key-value pair for the old object, and so would get a value related to
-    // the old object when validly using the new Vulkan handle as the key. To
-    // workaround this, we disallow deletion from this map. Thus, if an old
-    // Vulkan handle is re-used, the value is simply updated. One might think
-    // there is still a potential for data races on the value when it is being
-    // updated, as the reader thread(s) won't be holding the mutex. However, if
-    // a thread validly uses the new Vulkan object (causing a map lookup) then
-    // the new object must have been created in this thread or there must have
-    // been some synchronization between the creating thread where the handle
-    // was returned and this thread, otherwise this thread is using a
-    // potentially invalid handle (racing on the handle creation itself).
+    // Removing an entry destroys its value immediately, while other threads
+    // may still have the entry in their thread-local caches. This is fine as
+    // long as those threads do not use the cached value: applications must not
+    // use destroyed Vulkan objects, and so a thread that looks up a key whose
+    // entry is being removed is racing on the destruction of the Vulkan object
+    // itself. However, the Vulkan handle (and thus the key) may be reused for a
+    // new object, e.g. a thread destroys a device and then creates a new one
+    // that gets the same dispatch table pointer. A thread that validly uses the
+    // new object must have synchronized with the thread that created it (or be
+    // that thread), and so must see the incremented generation from the
+    // removal of the old entry (the creation happened after the removal); the
+    // thread then discards its cache instead of returning the stale value.
 
     // Use thread-local cache to avoid mutex and map lookup in most cases.
     ThreadLocalCacheType& thread_local_cache = GetThreadLocalCache();
-    if (ABSL_PREDICT_TRUE(thread_local_cache.first == key)) {
-      return thread_local_cache.second;
-    }
-
-    // Otherwise, lock and lookup.
-    ScopedLock lock(mutex_);
-
-    ValueType* result = nullptr;
-    auto it = map_.find(key);
-    if (it != map_.end()) {
-      result = &it->second;
+    if (ABSL_PREDICT_TRUE(thread_local_cache.keys[0] == key &&
+                          thread_local_cache.generation ==
+                              generation_.load(std::memory_order_acquire))) {
+      return thread_local_cache.values[0];
     }
-
-    // Update cache.
-    thread_local_cache.first = key;
-    thread_local_cache.second = result;
-
-    return result;
+    return GetSlow(key, &thread_local_cache);
   }
 
   void Put(const KeyType& key, ValueType value) {
@@ -98,6 +126,21 @@ class ProtectedTinyStaleMap {
     map_[key] = std::move(value);
   }
 
+  // Removes and destroys the value for |key|, if present. Returns whether an
+  // entry was removed. The caller must ensure no other thread is using the
+  // value.
+  bool Remove(const KeyType& key) {
+    ScopedLock lock(mutex_);
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return false;
+    }
+    // Invalidate all thread-local caches before the value is destroyed.
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    map_.erase(it);
+    return true;
+  }
+
  private:
   ThreadLocalCacheType& GetThreadLocalCache() {
     ABSL_CACHELINE_ALIGNED static thread_local ThreadLocalCacheType
@@ -105,8 +148,60 @@ class ProtectedTinyStaleMap {
     return thread_local_cache;
   }
 
+  // Inserts |key| and |value| at the front of |cache|, shifting the entries
+  // from |index| onwards back by one. Thus, if |index| is a valid entry, that
+  // entry is overwritten; otherwise, the last entry is dropped.
+  static void InsertAtFront(ThreadLocalCacheType* cache, std::size_t index,
+                            KeyType key, ValueType* value) {
+    for (std::size_t i = std::min(index, kCacheEntries - 1); i > 0; --i) {
+      cache->keys[i] = cache->keys[i - 1];
+      cache->values[i] = cache->values[i - 1];
+    }
+    cache->keys[0] = key;
+    cache->values[0] = value;
+  }
+
+  ValueType* GetSlow(const KeyType& key,
+                     ThreadLocalCacheType* thread_local_cache) {
+    // Discard the cache if entries have been removed since it was filled.
+    std::uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (thread_local_cache->generation != generation) {
+      *thread_local_cache = ThreadLocalCacheType();
+      thread_local_cache->generation = generation;
+    }
+
+    // Check the rest of the cache.
+    for (std::size_t i = 1; i < kCacheEntries; ++i) {
+      if (thread_local_cache->keys[i] == key) {
+        ValueType* result = thread_local_cache->values[i];
+        InsertAtFront(thread_local_cache, i, key, result);
+        return result;
+      }
+    }
+
+    // Otherwise, lock and lookup.
+    ValueType* result = nullptr;
+    {
+      ScopedLock lock(mutex_);
+      auto it = map_.find(key);
+      if (it != map_.end()) {
+        result = &it->second;
+      }
+    }
+
+    // Update cache, evicting the least recently used entry. Misses are not
+    // cached so that a later |Put| of the key is seen.
+    if (result != nullptr) {
+      InsertAtFront(thread_local_cache, kCacheEntries, key, result);
+    }
+
+    return result;
+  }
+
   InternalMapType map_;
   MutexType mutex_;
+  // Incremented whenever an entry is removed.
+  std::atomic<std::uint64_t> generation_{};
 };
 
 template <typename KeyType, typename ValueType>
@@ -147,6 +242,198 @@ class ProtectedMap {
   mutable MutexType mutex_;
 };
 
+// A map with the same interface as |ProtectedMap| that is optimized for
+// concurrent lookups, such as mapping Vulkan handles to data that is looked up
+// on nearly every intercepted call. |Get| is wait-free: it does not lock a
+// mutex and does not write to any memory shared with other threads. |Put| and
+// |Remove| are serialized by a mutex and are expected to be much less frequent
+// than |Get|.
+//
+// The values are heap-allocated and so have pointer stability. Lookups use an
+// open-addressing hash table of (key, value pointer) slots with linear
+// probing. Removing an entry clears the value pointer but leaves the key in
+// its slot as a tombstone, so that concurrent probes are not cut short; a
+// later |Put| may reuse the slot. When too few empty slots remain, a new table
+// is built and published, and the old table is retired using epoch-based
+// reclamation (see epoch.h) as readers may still be probing it.
+//
+// As with |ProtectedMap|, a value is destroyed as soon as it is removed. This
+// is fine for Vulkan objects, as applications must not use an object while
+// (or after) it is being destroyed.
+//
+// The default value of |KeyType| (e.g. VK_NULL_HANDLE) marks empty slots and
+// so cannot be used as a key. |KeyType| must be a pointer or integer type.
+template <typename KeyType, typename ValueType>
+class ProtectedReadMostlyMap {
+ public:
+  // Owns the values; only accessed while holding the mutex.
+  using InternalMapType = MapTemplate<KeyType, std::unique_ptr<ValueType>>;
+
+  ProtectedReadMostlyMap() : table_(new Table(kMinCapacity)) {}
+
+  ~ProtectedReadMostlyMap() { delete table_.load(std::memory_order_relaxed); }
+
+  ProtectedReadMostlyMap(const ProtectedReadMostlyMap&) = delete;
+  ProtectedReadMostlyMap& operator=(const ProtectedReadMostlyMap&) = delete;
+  ProtectedReadMostlyMap(ProtectedReadMostlyMap&&) = delete;
+  ProtectedReadMostlyMap& operator=(ProtectedReadMostlyMap&&) = delete;
+
+  ValueType* Get(const KeyType& key) const {
+    EpochGuard epoch_guard;
+    const Table* table = table_.load(std::memory_order_acquire);
+    const std::size_t mask = table->mask;
+    std::size_t index = HashKey(key) & mask;
+    // Bounded by the table size, although the load factor keeps probe
+    // sequences short.
+    for (std::size_t probe = 0; probe <= mask; ++probe) {
+      const Slot& slot = table->slots[index];
+      KeyType slot_key = slot.key.load(std::memory_order_acquire);
+      if (slot_key == key) {
+        return slot.value.load(std::memory_order_acquire);
+      }
+      if (slot_key == KeyType()) {
+        break;
+      }
+      index = (index + 1) & mask;
+    }
+    return nullptr;
+  }
+
+  bool Put(const KeyType& key, ValueType value) {
+    ScopedLock lock(mutex_);
+    if (map_.find(key) != map_.end()) {
+      return false;
+    }
+
+    Table* table = table_.load(std::memory_order_relaxed);
+    if ((used_slots_ + 1) * 4 > (table->mask + 1) * 3) {
+      table = Rebuild();
+    }
+
+    std::unique_ptr<ValueType>& owned_value = map_[key];
+    owned_value = std::make_unique<ValueType>(std::move(value));
+    if (Insert(table, key, owned_value.get())) {
+      ++used_slots_;
+    }
+    return true;
+  }
+
+  bool Remove(const KeyType& key) {
+    ScopedLock lock(mutex_);
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return false;
+    }
+    Slot* slot = FindLiveSlot(table_.load(std::memory_order_relaxed), key);
+    if (slot != nullptr) {
+      slot->value.store(nullptr, std::memory_order_release);
+    }
+    map_.erase(it);
+    return true;
+  }
+
+  // Unlike |ProtectedMap|, entries must only be added and removed via |Put|
+  // and |Remove|, and so the returned map is const. The values themselves can
+  // still be modified.
+  const InternalMapType* Access(ScopedLock* lock) const {
+    ScopedLock local_lock(mutex_);
+    lock->swap(local_lock);
+    return &map_;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<KeyType> key{};
+    std::atomic<ValueType*> value{};
+  };
+
+  struct Table {
+    explicit Table(std::size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]) {}
+
+    const std::size_t mask;
+    const std::unique_ptr<Slot[]> slots;
+  };
+
+  // Must be a power of two.
+  static constexpr std::size_t kMinCapacity = 16;
+
+  static std::size_t HashKey(const KeyType& key) {
+    return internal::HashHandle(key);
+  }
+
+  // Requires |mutex_|. Returns the first slot for |key| that has a value.
+  static Slot* FindLiveSlot(Table* table, const KeyType& key) {
+    std::size_t index = HashKey(key) & table->mask;
+    for (std::size_t probe = 0; probe <= table->mask; ++probe) {
+      Slot& slot = table->slots[index];
+      KeyType slot_key = slot.key.load(std::memory_order_relaxed);
+      if (slot_key == KeyType()) {
+        break;
+      }
+      if (slot_key == key &&
+          slot.value.load(std::memory_order_relaxed) != nullptr) {
+        return &slot;
+      }
+      index = (index + 1) & table->mask;
+    }
+    return nullptr;
+  }
+
+  // Requires |mutex_| and that |key| is not already live in |table|. Stores
+  // |value| in the first empty or tombstone slot for |key|. Returns true if a
+  // previously empty slot was used.
+  static bool Insert(Table* table, const KeyType& key, ValueType* value) {
+    std::size_t index = HashKey(key) & table->mask;
+    while (true) {
+      Slot& slot = table->slots[index];
+      KeyType slot_key = slot.key.load(std::memory_order_relaxed);
+      if (slot_key == KeyType()) {
+        // Publish the value before the key so readers that find the key also
+        // find the value.
+        slot.value.store(value, std::memory_order_relaxed);
+        slot.key.store(key, std::memory_order_release);
+        return true;
+      }
+      if (slot.value.load(std::memory_order_relaxed) == nullptr) {
+        // A tombstone. A concurrent reader looking for |key| may briefly see
+        // the key without the value, which is equivalent to the entry not yet
+        // being present.
+        slot.key.store(key, std::memory_order_relaxed);
+        slot.value.store(value, std::memory_order_release);
+        return false;
+      }
+      index = (index + 1) & table->mask;
+    }
+  }
+
+  // Requires |mutex_|. Replaces the table with one sized for the live entries
+  // (plus one, for the entry about to be added) with room to grow, dropping all
+  // tombstones.
+  Table* Rebuild() {
+    std::size_t capacity = kMinCapacity;
+    while (capacity < (map_.size() + 1) * 2) {
+      capacity *= 2;
+    }
+    auto* table = new Table(capacity);
+    used_slots_ = 0;
+    for (const auto& entry : map_) {
+      Insert(table, entry.first, entry.second.get());
+      ++used_slots_;
+    }
+    Table* old_table = table_.exchange(table, std::memory_order_acq_rel);
+    RetireInEpoch(old_table,
+                  [](void* object) { delete static_cast<Table*>(object); });
+    return table;
+  }
+
+  std::atomic<Table*> table_;
+  // Number of slots in |table_| that are not empty (live or tombstone).
+  std::size_t used_slots_ = 0;
+  InternalMapType map_;
+  mutable MutexType mutex_;
+};
+
 // The following are dispatchable handles:
 //
 // - VkInstance
@@ -205,6 +492,15 @@ VkLayerInstanceCreateInfo* GetLayerInstanceCreateInfo(
 VkLayerDeviceCreateInfo* GetLayerDeviceCreateInfo(
     const VkDeviceCreateInfo* pCreateInfo);
 
+// Returns the path of the library that contains this function (i.e. the
+// layer), or an empty string if it is unknown.
+std::string GetThisLibraryPath();
+
+// Returns the file name of the library that contains this function, without
+// its extension (e.g. "libVkLayer_GF_frame_counter"), or "gf_layers" if it is
+// unknown. Used to name the files written by each layer library.
+std::string GetThisLibraryStem();
+
 }  // namespace gf_layers
 
 #endif  // GF_LAYERS_LAYER_UTIL_UTIL_H
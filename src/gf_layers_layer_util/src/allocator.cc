@@ -0,0 +1,252 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/util.h"
+
+namespace gf_layers {
+
+namespace {
+
+// The alignment of the arena's blocks and so of all its chunks, which are
+// multiples of this size.
+constexpr std::size_t kArenaAlignment = 16;
+
+// Returns the index of the smallest size class that fits |size|.
+std::size_t GetSizeClassIndex(std::size_t size, std::size_t min_chunk_size) {
+  std::size_t index = 0;
+  for (std::size_t chunk_size = min_chunk_size; chunk_size < size;
+       chunk_size *= 2) {
+    ++index;
+  }
+  return index;
+}
+
+}  // namespace
+
+LayerAllocator::LayerAllocator(const VkAllocationCallbacks* device_callbacks)
+    : device_callbacks_(device_callbacks == nullptr ? VkAllocationCallbacks{}
+                                                    : *device_callbacks),
+      has_device_callbacks_(device_callbacks != nullptr) {}
+
+LayerAllocator::~LayerAllocator() {
+  std::uint64_t live_allocation_count = GetStats().live_allocation_count;
+  if (live_allocation_count > 0) {
+    LOG_WARNING(
+        "%llu layer allocations were not freed before the device was "
+        "destroyed.",
+        static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+            live_allocation_count));
+  }
+  for (void* block : blocks_) {
+    ::operator delete(block, std::align_val_t(kArenaAlignment));
+  }
+}
+
+void* LayerAllocator::Allocate(std::size_t size, std::size_t alignment,
+                               const VkAllocationCallbacks* object_callbacks) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  const VkAllocationCallbacks* callbacks = GetCallbacks(object_callbacks);
+  void* result = nullptr;
+  if (callbacks != nullptr) {
+    result = callbacks->pfnAllocation(callbacks->pUserData, size, alignment,
+                                      VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    RUNTIME_ASSERT_MSG(result != nullptr,
+                       "The application's pfnAllocation failed.");
+    callback_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+    CountOtherAllocation();
+  } else {
+    result = AllocateFromArena(size, alignment);
+  }
+
+  std::uint64_t live_bytes =
+      live_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+  std::uint64_t peak_live_bytes =
+      peak_live_bytes_.load(std::memory_order_relaxed);
+  while (live_bytes > peak_live_bytes &&
+         !peak_live_bytes_.compare_exchange_weak(peak_live_bytes, live_bytes,
+                                                 std::memory_order_relaxed)) {
+  }
+  return result;
+}
+
+void LayerAllocator::Free(void* memory, std::size_t size,
+                          std::size_t alignment,
+                          const VkAllocationCallbacks* object_callbacks) {
+  if (memory == nullptr) {
+    return;
+  }
+
+  live_bytes_.fetch_sub(size, std::memory_order_relaxed);
+
+  const VkAllocationCallbacks* callbacks = GetCallbacks(object_callbacks);
+  if (callbacks != nullptr) {
+    callbacks->pfnFree(callbacks->pUserData, memory);
+    other_live_allocation_count_.fetch_sub(1, std::memory_order_relaxed);
+  } else {
+    FreeToArena(memory, size, alignment);
+  }
+}
+
+AllocatorStats LayerAllocator::GetStats() const {
+  AllocatorStats result;
+  result.allocation_count =
+      other_allocation_count_.load(std::memory_order_relaxed);
+  result.live_allocation_count =
+      other_live_allocation_count_.load(std::memory_order_relaxed);
+  for (const SizeClass& size_class : size_classes_) {
+    ScopedLock lock(size_class.mutex);
+    result.allocation_count += size_class.allocation_count;
+    result.live_allocation_count += size_class.live_allocation_count;
+  }
+  result.live_bytes = live_bytes_.load(std::memory_order_relaxed);
+  result.peak_live_bytes = peak_live_bytes_.load(std::memory_order_relaxed);
+  result.callback_allocation_count =
+      callback_allocation_count_.load(std::memory_order_relaxed);
+  result.arena_block_bytes = arena_block_bytes_.load(std::memory_order_relaxed);
+  return result;
+}
+
+const VkAllocationCallbacks* LayerAllocator::GetCallbacks(
+    const VkAllocationCallbacks* object_callbacks) const {
+  if (object_callbacks != nullptr) {
+    return object_callbacks;
+  }
+  return has_device_callbacks_ ? &device_callbacks_ : nullptr;
+}
+
+void* LayerAllocator::AllocateFromArena(std::size_t size,
+                                        std::size_t alignment) {
+  if (size > kMaxChunkSize || alignment > kArenaAlignment) {
+    CountOtherAllocation();
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+
+  std::size_t index = GetSizeClassIndex(size, kMinChunkSize);
+  std::size_t chunk_size = kMinChunkSize << index;
+  SizeClass& size_class = size_classes_[index];
+
+  ScopedLock lock(size_class.mutex);
+  ++size_class.allocation_count;
+  ++size_class.live_allocation_count;
+  if (size_class.free_list != nullptr) {
+    void* result = size_class.free_list;
+    size_class.free_list = *static_cast<void**>(result);
+    return result;
+  }
+  if (size_class.next == size_class.end) {
+    auto* block = static_cast<char*>(
+        ::operator new(kBlockSize, std::align_val_t(kArenaAlignment)));
+    {
+      ScopedLock blocks_lock(blocks_mutex_);
+      blocks_.push_back(block);
+    }
+    arena_block_bytes_.fetch_add(kBlockSize, std::memory_order_relaxed);
+    size_class.next = block;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    size_class.end = block + kBlockSize;
+  }
+  void* result = size_class.next;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  size_class.next += chunk_size;
+  return result;
+}
+
+void LayerAllocator::FreeToArena(void* memory, std::size_t size,
+                                 std::size_t alignment) {
+  if (size > kMaxChunkSize || alignment > kArenaAlignment) {
+    ::operator delete(memory, std::align_val_t(alignment));
+    other_live_allocation_count_.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+
+  SizeClass& size_class = size_classes_[GetSizeClassIndex(size, kMinChunkSize)];
+  ScopedLock lock(size_class.mutex);
+  --size_class.live_allocation_count;
+  *static_cast<void**>(memory) = size_class.free_list;
+  size_class.free_list = memory;
+}
+
+void LayerAllocator::CountOtherAllocation() {
+  other_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+  other_live_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+LinearAllocator::~LinearAllocator() {
+  Block* block = first_block_;
+  while (block != nullptr) {
+    Block* next = block->next;
+    allocator_->Free(block, block->size, alignof(Block), nullptr);
+    block = next;
+  }
+}
+
+LinearAllocator::LinearAllocator(LinearAllocator&& other) noexcept
+    : allocator_(other.allocator_),
+      first_block_(std::exchange(other.first_block_, nullptr)),
+      current_block_(std::exchange(other.current_block_, nullptr)),
+      next_(std::exchange(other.next_, nullptr)),
+      end_(std::exchange(other.end_, 0)) {}
+
+void LinearAllocator::Reset() {
+  if (first_block_ != nullptr) {
+    UseBlock(first_block_);
+  }
+}
+
+void* LinearAllocator::AllocateSlow(std::size_t size, std::size_t alignment) {
+  // Try the blocks kept by |Reset|, which may be too small for |size|.
+  while (current_block_ != nullptr && current_block_->next != nullptr) {
+    UseBlock(current_block_->next);
+    void* result = AllocateFromCurrentBlock(size, alignment);
+    if (result != nullptr) {
+      return result;
+    }
+  }
+
+  std::size_t block_size =
+      std::max(kBlockSize, sizeof(Block) + size + alignment);
+  auto* block = static_cast<Block*>(
+      allocator_->Allocate(block_size, alignof(Block), nullptr));
+  block->next = nullptr;
+  block->size = block_size;
+  if (current_block_ == nullptr) {
+    first_block_ = block;
+  } else {
+    current_block_->next = block;
+  }
+  UseBlock(block);
+  return AllocateFromCurrentBlock(size, alignment);
+}
+
+void LinearAllocator::UseBlock(Block* block) {
+  current_block_ = block;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  next_ = reinterpret_cast<char*>(block + 1);
+  end_ = reinterpret_cast<std::uintptr_t>(block) + block->size;
+}
+
+}  // namespace gf_layers
@@ -0,0 +1,156 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+#if !defined(_MSC_VER) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace gf_layers {
+
+namespace {
+
+// How long the x86 counter is compared against the reference clock. With the
+// samples below, the error of the calibration is a few parts per million.
+constexpr std::chrono::milliseconds kCalibrationTime{5};
+
+constexpr int kSampleAttempts = 16;
+
+// A reading of the counter and the reference clock at (nearly) the same time.
+struct ClockSample {
+  std::uint64_t ticks;
+  std::uint64_t ns;
+};
+
+// Returns whether the CPU's counter ticks at a constant rate (regardless of
+// frequency scaling and sleep states), and so can be used as a clock.
+bool HasInvariantCpuCounter() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int registers[4] = {};
+  __cpuid(registers, 0x80000000);
+  if (static_cast<unsigned int>(registers[0]) < 0x80000007U) {
+    return false;
+  }
+  __cpuid(registers, 0x80000007);
+  return (static_cast<unsigned int>(registers[3]) & (1U << 8U)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1U << 8U)) != 0;
+#elif defined(__aarch64__)
+  // The generic timer's virtual counter is always constant-rate.
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Takes the sample whose reference clock read was the fastest out of several
+// attempts, as the reference time is then the closest to the counter value.
+ClockSample TakeClockSample() {
+  ClockSample result{};
+  std::uint64_t best_read_ticks = std::numeric_limits<std::uint64_t>::max();
+  for (int attempt = 0; attempt < kSampleAttempts; ++attempt) {
+    std::uint64_t before = internal::ReadCpuCounter();
+    std::uint64_t ns = internal::ReadReferenceClockNs();
+    std::uint64_t after = internal::ReadCpuCounter();
+    if (after - before < best_read_ticks) {
+      best_read_ticks = after - before;
+      result = {before + (after - before) / 2, ns};
+    }
+  }
+  return result;
+}
+
+// Does not log, as the logger reads its settings via the settings file, which
+// reads the clock.
+ClockSource CalibrateClock() {
+  if (!HasInvariantCpuCounter()) {
+    return ClockSource::kReferenceClock;
+  }
+  ClockSample start = TakeClockSample();
+  double ns_per_tick = 0.0;
+#if defined(__aarch64__)
+  std::uint64_t frequency = 0;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));  // NOLINT
+  if (frequency == 0) {
+    return ClockSource::kReferenceClock;
+  }
+  ns_per_tick = 1e9 / static_cast<double>(frequency);
+#else
+  std::this_thread::sleep_for(kCalibrationTime);
+  ClockSample end = TakeClockSample();
+  if (end.ticks <= start.ticks || end.ns <= start.ns) {
+    return ClockSource::kReferenceClock;
+  }
+  ns_per_tick = static_cast<double>(end.ns - start.ns) /
+                static_cast<double>(end.ticks - start.ticks);
+#endif
+  internal::clock_calibration = {start.ticks, start.ns, ns_per_tick};
+  return ClockSource::kCpuCounter;
+}
+
+}  // namespace
+
+namespace internal {
+
+std::atomic<std::int32_t> clock_state{-1};
+
+ClockCalibration clock_calibration{};
+
+std::int32_t InitClock() {
+  // Thread-safe; only one thread calibrates.
+  static const auto state = static_cast<std::int32_t>(CalibrateClock());
+  clock_state.store(state, std::memory_order_release);
+  return state;
+}
+
+std::uint64_t ReadReferenceClockNs() {
+#if defined(_WIN32)
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#else
+#if defined(CLOCK_MONOTONIC_RAW)
+  constexpr clockid_t kReferenceClock = CLOCK_MONOTONIC_RAW;
+#else
+  constexpr clockid_t kReferenceClock = CLOCK_MONOTONIC;
+#endif
+  timespec time{};
+  clock_gettime(kReferenceClock, &time);
+  return static_cast<std::uint64_t>(time.tv_sec) * 1000000000U +
+         static_cast<std::uint64_t>(time.tv_nsec);
+#endif
+}
+
+}  // namespace internal
+
+}  // namespace gf_layers
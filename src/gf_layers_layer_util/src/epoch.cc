@@ -0,0 +1,170 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/epoch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "gf_layers_layer_util/util.h"
+
+namespace gf_layers {
+
+namespace internal {
+
+std::atomic<std::uint64_t> global_epoch{1};
+
+}  // namespace internal
+
+namespace {
+
+struct RetiredObject {
+  void* object;
+  void (*deleter)(void*);
+  // The global epoch at the time the object was retired. Readers that entered
+  // their critical section at this epoch or earlier may still see the object.
+  std::uint64_t epoch;
+};
+
+struct EpochState {
+  // Head of the list of all thread records; records are only ever prepended.
+  std::atomic<internal::EpochThreadRecord*> records{nullptr};
+
+  MutexType retired_mutex;
+  std::vector<RetiredObject> retired;
+};
+
+EpochState* GetEpochState() {
+  // Intentionally leaked: thread records may be released by threads that exit
+  // after static destructors have run.
+  static auto* epoch_state = new EpochState();
+  return epoch_state;
+}
+
+// Releases the calling thread's record when the thread exits.
+struct EpochThreadRecordReleaser {
+  internal::EpochThreadRecord* record = nullptr;
+
+  EpochThreadRecordReleaser() = default;
+  EpochThreadRecordReleaser(const EpochThreadRecordReleaser&) = delete;
+  EpochThreadRecordReleaser& operator=(const EpochThreadRecordReleaser&) =
+      delete;
+  EpochThreadRecordReleaser(EpochThreadRecordReleaser&&) = delete;
+  EpochThreadRecordReleaser& operator=(EpochThreadRecordReleaser&&) = delete;
+
+  ~EpochThreadRecordReleaser() {
+    if (record != nullptr) {
+      record->epoch.store(internal::kEpochInactive, std::memory_order_release);
+      record->depth = 0;
+      record->in_use.store(false, std::memory_order_release);
+      internal::epoch_thread_record = nullptr;
+    }
+  }
+};
+
+void ReclaimRetiredObjectsLocked(EpochState* epoch_state) {
+  if (epoch_state->retired.empty()) {
+    return;
+  }
+
+  // Pairs with the fence in |EpochGuard|: either we see a reader's epoch, or
+  // the reader sees the writes that made retired objects unreachable.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  std::uint64_t min_active_epoch = std::numeric_limits<std::uint64_t>::max();
+  for (internal::EpochThreadRecord* record =
+           epoch_state->records.load(std::memory_order_acquire);
+       record != nullptr; record = record->next) {
+    std::uint64_t epoch = record->epoch.load(std::memory_order_acquire);
+    if (epoch != internal::kEpochInactive) {
+      min_active_epoch = std::min(min_active_epoch, epoch);
+    }
+  }
+
+  auto safe_end = std::partition(
+      epoch_state->retired.begin(), epoch_state->retired.end(),
+      [min_active_epoch](const RetiredObject& retired_object) {
+        return retired_object.epoch >= min_active_epoch;
+      });
+  for (auto it = safe_end; it != epoch_state->retired.end(); ++it) {
+    it->deleter(it->object);
+  }
+  epoch_state->retired.erase(safe_end, epoch_state->retired.end());
+}
+
+}  // namespace
+
+namespace internal {
+
+EpochThreadRecord* AcquireEpochThreadRecord() {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+  static thread_local EpochThreadRecordReleaser releaser;
+#pragma clang diagnostic pop
+
+  EpochState* epoch_state = GetEpochState();
+
+  // Try to reuse a record released by a thread that has exited.
+  EpochThreadRecord* record = nullptr;
+  for (EpochThreadRecord* it =
+           epoch_state->records.load(std::memory_order_acquire);
+       it != nullptr; it = it->next) {
+    bool expected = false;
+    if (!it->in_use.load(std::memory_order_relaxed) &&
+        it->in_use.compare_exchange_strong(expected, true,
+                                           std::memory_order_acquire)) {
+      record = it;
+      break;
+    }
+  }
+
+  if (record == nullptr) {
+    record = new EpochThreadRecord();
+    record->in_use.store(true, std::memory_order_relaxed);
+    EpochThreadRecord* head =
+        epoch_state->records.load(std::memory_order_relaxed);
+    do {
+      record->next = head;
+    } while (!epoch_state->records.compare_exchange_weak(
+        head, record, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  releaser.record = record;
+  epoch_thread_record = record;
+  return record;
+}
+
+}  // namespace internal
+
+void RetireInEpoch(void* object, void (*deleter)(void*)) {
+  EpochState* epoch_state = GetEpochState();
+  ScopedLock lock(epoch_state->retired_mutex);
+  // Readers that enter after this increment will observe the global epoch
+  // value after it and cannot see |object|.
+  std::uint64_t epoch =
+      internal::global_epoch.fetch_add(1, std::memory_order_seq_cst);
+  epoch_state->retired.push_back({object, deleter, epoch});
+  ReclaimRetiredObjectsLocked(epoch_state);
+}
+
+void ReclaimRetiredObjects() {
+  EpochState* epoch_state = GetEpochState();
+  ScopedLock lock(epoch_state->retired_mutex);
+  ReclaimRetiredObjectsLocked(epoch_state);
+}
+
+}  // namespace gf_layers
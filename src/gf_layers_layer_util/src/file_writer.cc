@@ -0,0 +1,665 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/file_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_layer_util/live_stats.h"
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/trace.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+// io_uring is used via its system calls, as liburing is not a dependency.
+// Android's seccomp filter blocks it for applications.
+#if defined(__linux__) && !defined(__ANDROID__) && \
+    __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define GF_LAYERS_HAS_IO_URING 1
+#endif
+#endif
+
+#if !defined(GF_LAYERS_HAS_IO_URING)
+#define GF_LAYERS_HAS_IO_URING 0
+#endif
+
+namespace gf_layers {
+
+namespace {
+
+// The queue is full when either limit is reached; a single larger file is
+// still accepted when the queue is empty.
+constexpr std::size_t kMaxQueuedFiles = 256;
+constexpr std::size_t kMaxQueuedBytes = 64U << 20U;
+
+// The number of files that are written together.
+constexpr std::size_t kMaxBatchFiles = 32;
+
+// The number of io_uring entries, and so of writes in flight.
+constexpr std::uint32_t kIoUringEntries = 32;
+
+// Files are written in chunks of at most this size.
+constexpr std::size_t kMaxChunkSize = 1U << 20U;
+
+struct WriteRequest {
+  std::string file_path;
+  WriteBuffer buffer;
+  WriteCallback callback;
+  // If true, |buffer| is appended to the file, rather than replacing it.
+  bool append = false;
+};
+
+#if !defined(_WIN32)
+
+// Writes all |size| bytes at |data| to |fd| at |offset|.
+bool WriteAll(int fd, const char* data, std::size_t size,
+              std::uint64_t offset) {
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    auto written_size = static_cast<std::size_t>(written);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    data += written_size;
+    size -= written_size;
+    offset += written_size;
+  }
+  return true;
+}
+
+#endif
+
+#if GF_LAYERS_HAS_IO_URING
+
+// A minimal io_uring for writes, with a single submitting thread.
+class IoUring {
+ public:
+  IoUring() = default;
+
+  ~IoUring() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+  IoUring(IoUring&&) = delete;
+  IoUring& operator=(IoUring&&) = delete;
+
+  // Returns false if io_uring is not available.
+  bool Init(std::uint32_t entries) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      return false;
+    }
+    entry_count_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(__u32);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      return false;
+    }
+    if (single_mmap) {
+      cq_ring_ = sq_ring_;
+    } else {
+      cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ring_ == MAP_FAILED) {
+        return false;
+      }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+      return false;
+    }
+
+    sq_tail_ = RingField(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *RingField(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = RingField(sq_ring_, params.sq_off.array);
+    cq_head_ = RingField(cq_ring_, params.cq_off.head);
+    cq_tail_ = RingField(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *RingField(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(RingField(
+        cq_ring_, params.cq_off.cqes));
+    return true;
+  }
+
+  [[nodiscard]] std::uint32_t GetEntryCount() const { return entry_count_; }
+
+  // Queues a write; at most |GetEntryCount| writes may be in flight.
+  void QueueWrite(int fd, const char* data, std::uint32_t size,
+                  std::uint64_t offset, std::uint64_t user_data) {
+    // We are the only producer, so the tail is only written by us.
+    __u32 tail = *sq_tail_;
+    __u32 index = tail & sq_mask_;
+    io_uring_sqe* sqe = &static_cast<io_uring_sqe*>(sqes_)[index];
+    *sqe = {};
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(data);
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_count_;
+  }
+
+  // Submits the queued writes and waits for at least one completion. Returns
+  // false on failure.
+  bool SubmitAndWait() {
+    while (true) {
+      long submitted =  // NOLINT(google-runtime-int)
+          syscall(__NR_io_uring_enter, fd_, unsubmitted_count_, 1,
+                  IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (submitted < 0 && errno == EINTR) {
+        continue;
+      }
+      if (submitted < 0) {
+        return false;
+      }
+      unsubmitted_count_ -= static_cast<std::uint32_t>(submitted);
+      return true;
+    }
+  }
+
+  // Pops a completion; returns false if there are none.
+  bool PopCompletion(std::uint64_t* user_data, std::int32_t* result) {
+    __u32 head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    *user_data = cqe.user_data;
+    *result = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  static __u32* RingField(void* ring, __u32 offset) {
+    return reinterpret_cast<__u32*>(static_cast<char*>(ring) + offset);
+  }
+
+  int fd_ = -1;
+  std::uint32_t entry_count_ = 0;
+  std::uint32_t unsubmitted_count_ = 0;
+
+  void* sq_ring_ = MAP_FAILED;
+  std::size_t sq_ring_size_ = 0;
+  void* cq_ring_ = MAP_FAILED;
+  std::size_t cq_ring_size_ = 0;
+  void* sqes_ = MAP_FAILED;
+  std::size_t sqes_size_ = 0;
+
+  __u32* sq_tail_ = nullptr;
+  __u32 sq_mask_ = 0;
+  __u32* sq_array_ = nullptr;
+  __u32* cq_head_ = nullptr;
+  __u32* cq_tail_ = nullptr;
+  __u32 cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif  // GF_LAYERS_HAS_IO_URING
+
+class FileWriter {
+ public:
+  FileWriter() {
+    // On Windows, the writer thread could not be joined while the layer is
+    // being unloaded (under the loader lock), so we write synchronously.
+#if !defined(_WIN32)
+#if GF_LAYERS_HAS_IO_URING
+    std::string use_io_uring;
+    if (!TryGetSettingString("VkLayer_GF_FILE_WRITER_IO_URING",
+                             "debug.gf.file_writer_io_uring",
+                             &use_io_uring) ||
+        use_io_uring != "0") {
+      io_uring_ = std::make_unique<IoUring>();
+      use_io_uring_.store(io_uring_->Init(kIoUringEntries),
+                          std::memory_order_relaxed);
+    }
+#endif
+    try {
+      writer_ = std::thread([this]() { WriterMain(); });
+      async_ = true;
+    } catch (const std::system_error&) {
+      LOG_WARNING("Failed to create the file writer thread.");
+    }
+#endif
+  }
+
+  FileWriter(const FileWriter&) = delete;
+  FileWriter& operator=(const FileWriter&) = delete;
+  FileWriter(FileWriter&&) = delete;
+  FileWriter& operator=(FileWriter&&) = delete;
+  ~FileWriter() = delete;
+
+  FileWriterBackend GetBackend() {
+    ScopedLock lock(mutex_);
+    if (!async_) {
+      return FileWriterBackend::kSynchronous;
+    }
+#if GF_LAYERS_HAS_IO_URING
+    if (use_io_uring_.load(std::memory_order_relaxed)) {
+      return FileWriterBackend::kIoUring;
+    }
+#endif
+    return FileWriterBackend::kPwrite;
+  }
+
+  void Write(WriteRequest request) {
+    ScopedLock lock(mutex_);
+    if (!async_) {
+      // Written under the lock, so that the files are written in order.
+      std::vector<WriteRequest> batch;
+      batch.push_back(std::move(request));
+      WriteBatch(&batch);
+      return;
+    }
+    std::size_t size = request.buffer.GetSize();
+    not_full_condition_.wait(lock, [this, size]() {
+      return queue_.empty() || (queue_.size() < kMaxQueuedFiles &&
+                                queued_bytes_ + size <= kMaxQueuedBytes);
+    });
+    queue_.push_back(std::move(request));
+    queued_bytes_ += size;
+    ++queued_count_;
+    lock.unlock();
+    work_condition_.notify_one();
+  }
+
+  void Flush() {
+    ScopedLock lock(mutex_);
+    std::uint64_t target = queued_count_;
+    written_condition_.wait(
+        lock, [this, target]() { return written_count_ >= target; });
+  }
+
+  // Writes all queued files and stops the writer thread. Later files are
+  // written synchronously.
+  void Shutdown() {
+    {
+      ScopedLock lock(mutex_);
+      if (!async_) {
+        return;
+      }
+      stopping_ = true;
+    }
+    work_condition_.notify_one();
+    writer_.join();
+    ScopedLock lock(mutex_);
+    async_ = false;
+  }
+
+ private:
+  void WriterMain() {
+    ScopedLock lock(mutex_);
+    while (true) {
+      work_condition_.wait(lock,
+                           [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;
+      }
+
+      // A file is not written twice in a batch, as the writes to it could
+      // then be reordered.
+      std::vector<WriteRequest> batch;
+      std::unordered_set<std::string> file_paths;
+      while (!queue_.empty() && batch.size() < kMaxBatchFiles &&
+             file_paths.insert(queue_.front().file_path).second) {
+        queued_bytes_ -= queue_.front().buffer.GetSize();
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+      lock.unlock();
+      not_full_condition_.notify_all();
+
+      WriteBatch(&batch);
+      // Frees the buffers outside the lock.
+      std::size_t batch_size = batch.size();
+      batch.clear();
+
+      lock.lock();
+      written_count_ += batch_size;
+      written_condition_.notify_all();
+    }
+  }
+
+  // Writes the files of |batch| and calls their callbacks in order.
+  void WriteBatch(std::vector<WriteRequest>* batch) {
+    TraceSpan trace_span("WriteFiles");
+    trace_span.AddArg("files", batch->size());
+
+    std::vector<bool> written(batch->size(), false);
+#if defined(_WIN32)
+    for (std::size_t i = 0; i < batch->size(); ++i) {
+      const WriteRequest& request = (*batch)[i];
+      std::ofstream file_stream(
+          request.file_path,
+          std::ios::out | std::ios::binary |
+              (request.append ? std::ios::app : std::ios::trunc));
+      file_stream.write(request.buffer.GetData(),
+                        static_cast<std::streamsize>(request.buffer.GetSize()));
+      file_stream.close();
+      written[i] = !file_stream.fail();
+    }
+#else
+    // The files are written at explicit offsets, so appended files are
+    // written from their end (rather than opened with O_APPEND).
+    std::vector<int> fds(batch->size(), -1);
+    std::vector<std::uint64_t> file_offsets(batch->size(), 0);
+    for (std::size_t i = 0; i < batch->size(); ++i) {
+      const WriteRequest& request = (*batch)[i];
+      fds[i] = open(request.file_path.c_str(),
+                    O_WRONLY | O_CREAT | O_CLOEXEC |
+                        (request.append ? 0 : O_TRUNC),
+                    0666);
+      written[i] = fds[i] >= 0;
+      if (written[i] && request.append) {
+        off_t end = lseek(fds[i], 0, SEEK_END);
+        if (end >= 0) {
+          file_offsets[i] = static_cast<std::uint64_t>(end);
+        } else {
+          written[i] = false;
+        }
+      }
+    }
+#if GF_LAYERS_HAS_IO_URING
+    if (use_io_uring_.load(std::memory_order_relaxed)) {
+      WriteWithIoUring(*batch, fds, file_offsets, &written);
+    } else {
+      WriteWithPwrite(*batch, fds, file_offsets, &written);
+    }
+#else
+    WriteWithPwrite(*batch, fds, file_offsets, &written);
+#endif
+    for (std::size_t i = 0; i < batch->size(); ++i) {
+      if (fds[i] >= 0 && close(fds[i]) != 0) {
+        written[i] = false;
+      }
+    }
+#endif
+
+    std::uint64_t bytes_written = 0;
+    for (std::size_t i = 0; i < batch->size(); ++i) {
+      WriteRequest& request = (*batch)[i];
+      if (written[i]) {
+        bytes_written += request.buffer.GetSize();
+      } else {
+        LOG("Failed to write file: %s", request.file_path.c_str());
+      }
+      if (request.callback) {
+        request.callback(written[i]);
+      }
+    }
+    trace_span.AddArg("size", bytes_written);
+    AddLiveStat(LiveStatsValue::kBytesWritten, bytes_written);
+  }
+
+#if !defined(_WIN32)
+  static void WriteWithPwrite(const std::vector<WriteRequest>& batch,
+                              const std::vector<int>& fds,
+                              const std::vector<std::uint64_t>& file_offsets,
+                              std::vector<bool>* written) {
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      if ((*written)[i]) {
+        (*written)[i] = WriteAll(fds[i], batch[i].buffer.GetData(),
+                                 batch[i].buffer.GetSize(), file_offsets[i]);
+      }
+    }
+  }
+#endif
+
+#if GF_LAYERS_HAS_IO_URING
+  // A part of a file, written by one io_uring entry. |offset| is from the
+  // start of the buffer.
+  struct Chunk {
+    std::size_t request;
+    std::uint64_t offset;
+    std::uint32_t size;
+  };
+
+  // Keeps up to |GetEntryCount| chunks of the files in flight. If io_uring
+  // does not support writes (before Linux 5.6) or fails, the remaining chunks
+  // are written with pwrite, and so are later files.
+  void WriteWithIoUring(const std::vector<WriteRequest>& batch,
+                        const std::vector<int>& fds,
+                        const std::vector<std::uint64_t>& file_offsets,
+                        std::vector<bool>* written) {
+    std::deque<Chunk> pending;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      if (!(*written)[i]) {
+        continue;
+      }
+      std::size_t size = batch[i].buffer.GetSize();
+      for (std::size_t offset = 0; offset < size; offset += kMaxChunkSize) {
+        pending.push_back({i, offset,
+                           static_cast<std::uint32_t>(
+                               std::min(kMaxChunkSize, size - offset))});
+      }
+    }
+
+    std::vector<Chunk> in_flight(io_uring_->GetEntryCount());
+    std::vector<bool> slot_used(in_flight.size(), false);
+    std::vector<std::size_t> free_slots;
+    for (std::size_t slot = in_flight.size(); slot > 0; --slot) {
+      free_slots.push_back(slot - 1);
+    }
+    // Chunks to write with pwrite.
+    std::vector<Chunk> fallback;
+
+    while (!pending.empty() || free_slots.size() < in_flight.size()) {
+      while (!pending.empty() && !free_slots.empty() &&
+             use_io_uring_.load(std::memory_order_relaxed)) {
+        std::size_t slot = free_slots.back();
+        free_slots.pop_back();
+        slot_used[slot] = true;
+        in_flight[slot] = pending.front();
+        pending.pop_front();
+        const Chunk& chunk = in_flight[slot];
+        io_uring_->QueueWrite(
+            fds[chunk.request],
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            batch[chunk.request].buffer.GetData() + chunk.offset, chunk.size,
+            file_offsets[chunk.request] + chunk.offset, slot);
+      }
+      if (free_slots.size() == in_flight.size()) {
+        // Nothing in flight, as io_uring was found not to support writes.
+        break;
+      }
+      if (!io_uring_->SubmitAndWait()) {
+        // The writes in flight (if any were submitted) may still complete,
+        // so their buffers are kept alive; rewriting the same bytes with
+        // pwrite is harmless.
+        use_io_uring_.store(false, std::memory_order_relaxed);
+        for (std::size_t slot = 0; slot < in_flight.size(); ++slot) {
+          if (slot_used[slot]) {
+            fallback.push_back(in_flight[slot]);
+            abandoned_buffers_.push_back(batch[in_flight[slot].request].buffer);
+          }
+        }
+        break;
+      }
+      std::uint64_t slot = 0;
+      std::int32_t result = 0;
+      while (io_uring_->PopCompletion(&slot, &result)) {
+        Chunk chunk = in_flight[slot];
+        slot_used[slot] = false;
+        free_slots.push_back(static_cast<std::size_t>(slot));
+        if (result == -EINTR || result == -EAGAIN) {
+          pending.push_front(chunk);
+        } else if (result == -EINVAL || result == -EOPNOTSUPP) {
+          use_io_uring_.store(false, std::memory_order_relaxed);
+          fallback.push_back(chunk);
+        } else if (result <= 0) {
+          (*written)[chunk.request] = false;
+        } else if (static_cast<std::uint32_t>(result) < chunk.size) {
+          auto size = static_cast<std::uint32_t>(result);
+          pending.push_front(
+              {chunk.request, chunk.offset + size, chunk.size - size});
+        }
+      }
+    }
+
+    if (use_io_uring_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    LOG_WARNING("Writing files with pwrite, as io_uring failed.");
+    fallback.insert(fallback.end(), pending.begin(), pending.end());
+    for (const Chunk& chunk : fallback) {
+      if ((*written)[chunk.request]) {
+        (*written)[chunk.request] = WriteAll(
+            fds[chunk.request],
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            batch[chunk.request].buffer.GetData() + chunk.offset, chunk.size,
+            file_offsets[chunk.request] + chunk.offset);
+      }
+    }
+  }
+#endif
+
+  // Guards the queue and the counts.
+  MutexType mutex_;
+  std::condition_variable not_full_condition_;
+  std::condition_variable work_condition_;
+  std::condition_variable written_condition_;
+  std::deque<WriteRequest> queue_;
+  std::size_t queued_bytes_ = 0;
+  std::uint64_t queued_count_ = 0;
+  std::uint64_t written_count_ = 0;
+  bool stopping_ = false;
+  bool async_ = false;
+
+  std::thread writer_;
+#if GF_LAYERS_HAS_IO_URING
+  // Only used by one thread at a time: the writer thread or, once it has
+  // stopped, the threads writing synchronously (under |mutex_|).
+  std::unique_ptr<IoUring> io_uring_;
+  std::atomic<bool> use_io_uring_{false};
+  // The buffers of writes that were in flight when io_uring failed.
+  std::vector<WriteBuffer> abandoned_buffers_;
+#endif
+};
+
+std::atomic<FileWriter*> file_writer_instance{nullptr};
+
+FileWriter* GetFileWriter() {
+  // Intentionally leaked, so that files can be written during static
+  // destruction.
+  static FileWriter* file_writer = []() {
+    auto* result = new FileWriter();
+    file_writer_instance.store(result, std::memory_order_release);
+    return result;
+  }();
+  return file_writer;
+}
+
+// Writes the queued files and stops the writer thread at exit, or when the
+// layer library is unloaded.
+struct FileWriterShutdown {
+  FileWriterShutdown() = default;
+  FileWriterShutdown(const FileWriterShutdown&) = delete;
+  FileWriterShutdown& operator=(const FileWriterShutdown&) = delete;
+  FileWriterShutdown(FileWriterShutdown&&) = delete;
+  FileWriterShutdown& operator=(FileWriterShutdown&&) = delete;
+
+  ~FileWriterShutdown() {
+    FileWriter* file_writer =
+        file_writer_instance.load(std::memory_order_acquire);
+    if (file_writer != nullptr) {
+      file_writer->Shutdown();
+    }
+  }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+FileWriterShutdown file_writer_shutdown_;  // NOLINT(cert-err58-cpp)
+#pragma clang diagnostic pop
+
+}  // namespace
+
+void WriteFileAsync(std::string file_path, WriteBuffer buffer,
+                    WriteCallback callback) {
+  GetFileWriter()->Write(
+      {std::move(file_path), std::move(buffer), std::move(callback), false});
+}
+
+void AppendFileAsync(std::string file_path, WriteBuffer buffer,
+                     WriteCallback callback) {
+  GetFileWriter()->Write(
+      {std::move(file_path), std::move(buffer), std::move(callback), true});
+}
+
+void FlushFileWrites() { GetFileWriter()->Flush(); }
+
+FileWriterBackend GetFileWriterBackend() {
+  return GetFileWriter()->GetBackend();
+}
+
+}  // namespace gf_layers
@@ -0,0 +1,173 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/frame_time_histogram.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace gf_layers {
+
+namespace {
+
+// Returns the middle of bucket |index|, clamped to [min_ns, max_ns].
+std::uint64_t GetBucketValue(std::size_t index, std::uint64_t min_ns,
+                             std::uint64_t max_ns) {
+  std::uint64_t lower = FrameTimeHistogram::GetBucketLowerBound(index);
+  std::uint64_t upper =
+      index + 1 < FrameTimeHistogram::kBucketCount
+          ? FrameTimeHistogram::GetBucketLowerBound(index + 1)
+          : max_ns + 1;
+  return std::clamp(lower + (upper - 1 - lower) / 2, min_ns, max_ns);
+}
+
+// Returns the value of the frame with |rank| (from 1) in |counts|.
+std::uint64_t GetRankValue(
+    const std::array<std::uint64_t, FrameTimeHistogram::kBucketCount>& counts,
+    std::uint64_t rank, std::uint64_t min_ns, std::uint64_t max_ns) {
+  std::uint64_t frames = 0;
+  for (std::size_t index = 0; index < counts.size(); ++index) {
+    frames += counts[index];
+    if (frames >= rank) {
+      return GetBucketValue(index, min_ns, max_ns);
+    }
+  }
+  return max_ns;
+}
+
+// Returns the frame with rank ceil(|count| * |per_mille| / 1000).
+std::uint64_t GetPercentileValue(
+    const std::array<std::uint64_t, FrameTimeHistogram::kBucketCount>& counts,
+    std::uint64_t count, std::uint64_t per_mille, std::uint64_t min_ns,
+    std::uint64_t max_ns) {
+  std::uint64_t rank = std::max<std::uint64_t>(
+      1, (count * per_mille + 999) / 1000);
+  return GetRankValue(counts, rank, min_ns, max_ns);
+}
+
+void UpdateMin(std::atomic<std::uint64_t>* min, std::uint64_t value) {
+  std::uint64_t current = min->load(std::memory_order_relaxed);
+  while (value < current &&
+         !min->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+void UpdateMax(std::atomic<std::uint64_t>* max, std::uint64_t value) {
+  std::uint64_t current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+std::size_t FrameTimeHistogram::GetBucketIndex(std::uint64_t frame_time_ns) {
+  if (frame_time_ns < kSubBucketCount) {
+    return static_cast<std::size_t>(frame_time_ns);
+  }
+  std::uint32_t exponent = kSubBucketBits;
+  while (exponent <= kMaxExponent && (frame_time_ns >> (exponent + 1)) != 0) {
+    ++exponent;
+  }
+  if (exponent > kMaxExponent) {
+    return kBucketCount - 1;
+  }
+  std::uint32_t shift = exponent - kSubBucketBits;
+  return static_cast<std::size_t>((shift + 1) * kSubBucketCount +
+                                  (frame_time_ns >> shift) - kSubBucketCount);
+}
+
+std::uint64_t FrameTimeHistogram::GetBucketLowerBound(std::size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  std::uint64_t shift = index / kSubBucketCount - 1;
+  return (kSubBucketCount + index % kSubBucketCount) << shift;
+}
+
+void FrameTimeHistogram::Record(std::uint64_t frame_time_ns) {
+  buckets_[GetBucketIndex(frame_time_ns)].fetch_add(1,
+                                                    std::memory_order_relaxed);
+  total_ns_.fetch_add(frame_time_ns, std::memory_order_relaxed);
+  UpdateMin(&min_ns_, frame_time_ns);
+  UpdateMax(&max_ns_, frame_time_ns);
+  // Last, so that a frame counted by |GetStats| is (usually) in the buckets.
+  count_.fetch_add(1, std::memory_order_release);
+}
+
+void FrameTimeHistogram::Clear() {
+  count_.store(0, std::memory_order_relaxed);
+  for (std::atomic<std::uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  total_ns_.store(0, std::memory_order_relaxed);
+  min_ns_.store(std::numeric_limits<std::uint64_t>::max(),
+                std::memory_order_relaxed);
+  max_ns_.store(0, std::memory_order_relaxed);
+}
+
+FrameTimeStats FrameTimeHistogram::GetStats() const {
+  FrameTimeStats result;
+  if (count_.load(std::memory_order_acquire) == 0) {
+    return result;
+  }
+
+  // The count is taken from the buckets, so that it is consistent with them.
+  std::array<std::uint64_t, kBucketCount> counts{};
+  std::uint64_t count = 0;
+  for (std::size_t index = 0; index < kBucketCount; ++index) {
+    counts[index] = buckets_[index].load(std::memory_order_relaxed);
+    count += counts[index];
+  }
+  if (count == 0) {
+    return result;
+  }
+  std::uint64_t min_ns = min_ns_.load(std::memory_order_relaxed);
+  std::uint64_t max_ns =
+      std::max(min_ns, max_ns_.load(std::memory_order_relaxed));
+
+  result.count = count;
+  result.min_ns = min_ns;
+  result.max_ns = max_ns;
+  result.mean_ns = total_ns_.load(std::memory_order_relaxed) / count;
+  result.p50_ns = GetPercentileValue(counts, count, 500, min_ns, max_ns);
+  result.p90_ns = GetPercentileValue(counts, count, 900, min_ns, max_ns);
+  result.p99_ns = GetPercentileValue(counts, count, 990, min_ns, max_ns);
+  result.p999_ns = GetPercentileValue(counts, count, 999, min_ns, max_ns);
+
+  // The mean frame time of the slowest 1% of frames.
+  std::uint64_t slow_count = std::max<std::uint64_t>(1, count / 100);
+  std::uint64_t remaining = slow_count;
+  double slow_total_ns = 0.0;
+  for (std::size_t index = kBucketCount; index > 0 && remaining > 0; --index) {
+    std::uint64_t frames = std::min(remaining, counts[index - 1]);
+    slow_total_ns += static_cast<double>(frames) *
+                     static_cast<double>(GetBucketValue(index - 1, min_ns,
+                                                        max_ns));
+    remaining -= frames;
+  }
+  if (slow_total_ns > 0.0) {
+    result.one_percent_low_fps =
+        1e9 * static_cast<double>(slow_count) / slow_total_ns;
+  }
+  return result;
+}
+
+}  // namespace gf_layers
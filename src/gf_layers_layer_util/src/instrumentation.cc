@@ -0,0 +1,300 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/instrumentation.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gf_layers_layer_util/logging.h"
+
+namespace gf_layers::instrumentation {
+
+namespace {
+
+// The counters of one entry point on one thread, in their own cache lines.
+// Only the owning thread writes the counters, so it uses plain loads and
+// stores rather than (more expensive) read-modify-write operations; they are
+// atomic so that |Dump| can read them concurrently.
+struct alignas(64) Counters {
+  std::atomic<std::uint64_t> calls;
+  std::atomic<std::uint64_t> total_ns;
+  std::atomic<std::uint64_t> max_ns;
+  std::array<std::atomic<std::uint64_t>, kHistogramBuckets> histogram;
+};
+
+struct ThreadCounters {
+  std::array<Counters, kMaxEntryPoints> entry_points;
+};
+
+// The sum of the counters of an entry point over all threads.
+struct Totals {
+  std::uint64_t calls = 0;
+  std::uint64_t total_ns = 0;
+  std::uint64_t max_ns = 0;
+  std::array<std::uint64_t, kHistogramBuckets> histogram{};
+};
+
+void Add(std::atomic<std::uint64_t>* counter, std::uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+std::size_t GetBucket(std::uint64_t elapsed_ns) {
+  std::size_t bucket = 0;
+  while (elapsed_ns != 0 && bucket < kHistogramBuckets - 1) {
+    elapsed_ns >>= 1U;
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Returns the exclusive upper bound, in nanoseconds, of the latency of the
+// calls in |bucket|.
+std::uint64_t GetBucketLimit(std::size_t bucket) {
+  return std::uint64_t{1} << bucket;
+}
+
+// Returns the exclusive upper bound of the latency of the |percentile|% of
+// fastest calls, or the maximum latency if this falls in the last bucket.
+std::uint64_t GetPercentileLimit(const Totals& totals,
+                                 std::uint64_t percentile) {
+  std::uint64_t calls = 0;
+  for (std::size_t bucket = 0; bucket < kHistogramBuckets - 1; ++bucket) {
+    calls += totals.histogram[bucket];
+    if (calls * 100 >= totals.calls * percentile) {
+      return GetBucketLimit(bucket);
+    }
+  }
+  return totals.max_ns;
+}
+
+// Returns a description of the non-empty buckets of |totals|.
+std::string FormatHistogram(const Totals& totals) {
+  std::string result;
+  for (std::size_t bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+    if (totals.histogram[bucket] == 0) {
+      continue;
+    }
+    std::array<char, 48> text{};
+    std::snprintf(
+        text.data(), text.size(), "%s%s%llu: %llu", result.empty() ? "" : ", ",
+        bucket == kHistogramBuckets - 1 ? ">=" : "<",
+        static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+            bucket == kHistogramBuckets - 1 ? GetBucketLimit(bucket - 1)
+                                            : GetBucketLimit(bucket)),
+        static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+            totals.histogram[bucket]));
+    result += text.data();
+  }
+  return result;
+}
+
+class Registry {
+ public:
+  std::uint32_t Register(EntryPoint* entry_point) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another thread may have registered the entry point.
+    std::uint32_t index = entry_point->index.load(std::memory_order_relaxed);
+    if (index != kUnregisteredIndex) {
+      return index;
+    }
+    if (entry_point_count_ == kMaxEntryPoints) {
+      return kUnregisteredIndex;
+    }
+    index = entry_point_count_++;
+    entry_points_[index] = entry_point;
+    entry_point->index.store(index, std::memory_order_release);
+    return index;
+  }
+
+  // Returns counters for a new thread, reusing those of an exited thread if
+  // possible. The counters are never freed, so that the calls made by exited
+  // threads are still included in the results.
+  ThreadCounters* AcquireThreadCounters() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_thread_counters_.empty()) {
+      ThreadCounters* result = free_thread_counters_.back();
+      free_thread_counters_.pop_back();
+      return result;
+    }
+    thread_counters_.push_back(std::make_unique<ThreadCounters>());
+    return thread_counters_.back().get();
+  }
+
+  void ReleaseThreadCounters(ThreadCounters* counters) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_thread_counters_.push_back(counters);
+  }
+
+  // Logs the totals of the entry points of |layer_name| (or all, if nullptr).
+  // If |only_new_calls|, only the entry points that have been called since
+  // they were last logged are logged.
+  void Dump(const char* layer_name, bool only_new_calls) {
+    if (!IsLogLevelEnabled(LogLevel::kInfo)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::uint32_t index = 0; index < entry_point_count_; ++index) {
+      const EntryPoint* entry_point = entry_points_[index];
+      if (layer_name != nullptr &&
+          std::strcmp(entry_point->layer_name, layer_name) != 0) {
+        continue;
+      }
+      Totals totals = GetTotals(index);
+      if (totals.calls == 0 ||
+          (only_new_calls && totals.calls == logged_calls_[index])) {
+        continue;
+      }
+      logged_calls_[index] = totals.calls;
+
+      // Each message has its own call site, so that the results are never
+      // rate limited.
+      LogCallSite call_site;
+      LogAt(LogLevel::kInfo, &call_site,
+            "Instrumentation: %s %s: calls: %llu, mean: %.1fns, p50: <%lluns, "
+            "p99: <%lluns, max: %lluns, histogram (ns): %s",
+            entry_point->layer_name, entry_point->function_name,
+            static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+                totals.calls),
+            static_cast<double>(totals.total_ns) /
+                static_cast<double>(totals.calls),
+            static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+                GetPercentileLimit(totals, 50)),
+            static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+                GetPercentileLimit(totals, 99)),
+            static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+                totals.max_ns),
+            FormatHistogram(totals).c_str());
+    }
+  }
+
+ private:
+  // Requires |mutex_|.
+  Totals GetTotals(std::uint32_t index) const {
+    Totals result;
+    for (const auto& thread_counters : thread_counters_) {
+      const Counters& counters = thread_counters->entry_points[index];
+      result.calls += counters.calls.load(std::memory_order_relaxed);
+      result.total_ns += counters.total_ns.load(std::memory_order_relaxed);
+      std::uint64_t max_ns = counters.max_ns.load(std::memory_order_relaxed);
+      if (max_ns > result.max_ns) {
+        result.max_ns = max_ns;
+      }
+      for (std::size_t bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+        result.histogram[bucket] +=
+            counters.histogram[bucket].load(std::memory_order_relaxed);
+      }
+    }
+    return result;
+  }
+
+  std::mutex mutex_;
+  std::array<const EntryPoint*, kMaxEntryPoints> entry_points_{};
+  std::uint32_t entry_point_count_ = 0;
+  // The number of calls of each entry point when it was last logged.
+  std::array<std::uint64_t, kMaxEntryPoints> logged_calls_{};
+  std::vector<std::unique_ptr<ThreadCounters>> thread_counters_;
+  std::vector<ThreadCounters*> free_thread_counters_;
+};
+
+Registry* GetRegistry() {
+  // Intentionally leaked, so that it can be used during static destruction.
+  static Registry* registry = new Registry();
+  return registry;
+}
+
+// Holds the counters of the current thread, and releases them when the thread
+// exits.
+class ThreadCountersHolder {
+ public:
+  ThreadCountersHolder() = default;
+  ThreadCountersHolder(const ThreadCountersHolder&) = delete;
+  ThreadCountersHolder& operator=(const ThreadCountersHolder&) = delete;
+  ThreadCountersHolder(ThreadCountersHolder&&) = delete;
+  ThreadCountersHolder& operator=(ThreadCountersHolder&&) = delete;
+
+  ~ThreadCountersHolder() {
+    if (counters_ != nullptr) {
+      GetRegistry()->ReleaseThreadCounters(counters_);
+    }
+  }
+
+  ThreadCounters* Get() {
+    if (counters_ == nullptr) {
+      counters_ = GetRegistry()->AcquireThreadCounters();
+    }
+    return counters_;
+  }
+
+ private:
+  ThreadCounters* counters_ = nullptr;
+};
+
+// Logs the calls that have not been logged already at exit, or when the layer
+// library is unloaded.
+struct DumpAtExit {
+  DumpAtExit() = default;
+  DumpAtExit(const DumpAtExit&) = delete;
+  DumpAtExit& operator=(const DumpAtExit&) = delete;
+  DumpAtExit(DumpAtExit&&) = delete;
+  DumpAtExit& operator=(DumpAtExit&&) = delete;
+
+  ~DumpAtExit() { GetRegistry()->Dump(nullptr, true); }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+DumpAtExit dump_at_exit_;  // NOLINT(cert-err58-cpp)
+#pragma clang diagnostic pop
+
+}  // namespace
+
+namespace internal {
+
+std::uint32_t RegisterEntryPoint(EntryPoint* entry_point) {
+  return GetRegistry()->Register(entry_point);
+}
+
+void RecordCall(std::uint32_t index, std::uint64_t elapsed_ns) {
+  if (index == kUnregisteredIndex) {
+    return;
+  }
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+  static thread_local ThreadCountersHolder thread_counters_holder;
+#pragma clang diagnostic pop
+  Counters& counters = thread_counters_holder.Get()->entry_points[index];
+  Add(&counters.calls, 1);
+  Add(&counters.total_ns, elapsed_ns);
+  if (elapsed_ns > counters.max_ns.load(std::memory_order_relaxed)) {
+    counters.max_ns.store(elapsed_ns, std::memory_order_relaxed);
+  }
+  Add(&counters.histogram[GetBucket(elapsed_ns)], 1);
+}
+
+}  // namespace internal
+
+void Dump(const char* layer_name) { GetRegistry()->Dump(layer_name, false); }
+
+}  // namespace gf_layers::instrumentation
@@ -0,0 +1,183 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/live_stats.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/util.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace gf_layers {
+
+namespace {
+
+using AtomicLiveStatsValues =
+    std::array<std::atomic<std::uint64_t>, kLiveStatsValueCount>;
+
+// Trivially destructible, so that it can be a function-local static.
+struct LiveStatsWriter {
+  // Serializes the updates of this layer library.
+  std::mutex* mutex = nullptr;
+  LiveStatsFile* file = nullptr;
+};
+
+std::uint64_t NowNs() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Returns the mapped file, or nullptr if it could not be created.
+LiveStatsFile* MapLiveStatsFile(const std::string& prefix) {
+#if defined(_WIN32)
+  (void)prefix;
+  LOG_WARNING("Live statistics are not supported on Windows.");
+  return nullptr;
+#else
+  // Name the file after the layer library, so that layers loaded as separate
+  // libraries do not share a file.
+  std::string path = prefix + "_" + GetThisLibraryStem() + "_" +
+                     std::to_string(getpid()) + ".stats";
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOG_ERROR("Failed to create live statistics file %s.", path.c_str());
+    return nullptr;
+  }
+  void* address = MAP_FAILED;
+  if (ftruncate(fd, sizeof(LiveStatsFile)) == 0) {
+    address = mmap(nullptr, sizeof(LiveStatsFile), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  }
+  // The mapping (which is never unmapped) keeps the file open.
+  close(fd);
+  if (address == MAP_FAILED) {
+    LOG_ERROR("Failed to map live statistics file %s.", path.c_str());
+    return nullptr;
+  }
+
+  auto* file = new (address) LiveStatsFile();
+  file->version = kLiveStatsVersion;
+  file->size = sizeof(LiveStatsFile);
+  file->process_id = static_cast<std::uint32_t>(getpid());
+  file->magic.store(kLiveStatsMagic, std::memory_order_release);
+  LOG("Writing live statistics to %s.", path.c_str());
+  return file;
+#endif
+}
+
+const LiveStatsWriter& GetLiveStatsWriter() {
+  // Initialized by the first caller; other callers wait until it is
+  // initialized. The mutex is intentionally leaked, so that it can be used
+  // during static destruction.
+  static const LiveStatsWriter writer = []() {
+    LiveStatsWriter result;
+    std::string prefix;
+    if (TryGetSettingString("VkLayer_GF_LIVE_STATS_FILE_PREFIX",
+                            "debug.gf.live_stats_file_prefix", &prefix) &&
+        !prefix.empty()) {
+      result.file = MapLiveStatsFile(prefix);
+    }
+    if (result.file != nullptr) {
+      result.mutex = new std::mutex();
+    }
+    return result;
+  }();
+  return writer;
+}
+
+// Publishes an update of |file| made by |update|, under the sequence lock.
+// Requires the writer's mutex.
+template <typename Update>
+void WriteLiveStats(LiveStatsFile* file, Update update) {
+  std::uint32_t sequence = file->sequence.load(std::memory_order_relaxed);
+  file->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  update(&file->values);
+  file->values[static_cast<std::size_t>(LiveStatsValue::kUpdateTimeNs)].store(
+      NowNs(), std::memory_order_relaxed);
+  file->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::uint64_t Get(const AtomicLiveStatsValues& values, LiveStatsValue value) {
+  return values[static_cast<std::size_t>(value)].load(
+      std::memory_order_relaxed);
+}
+
+void Set(AtomicLiveStatsValues* values, LiveStatsValue value,
+         std::uint64_t new_value) {
+  (*values)[static_cast<std::size_t>(value)].store(new_value,
+                                                   std::memory_order_relaxed);
+}
+
+}  // namespace
+
+namespace internal {
+
+std::atomic<std::int32_t> live_stats_state{-1};
+
+bool InitLiveStatsState() {
+  bool enabled = GetLiveStatsWriter().file != nullptr;
+  live_stats_state.store(enabled ? 1 : 0, std::memory_order_relaxed);
+  return enabled;
+}
+
+void AddLiveStatsFrame(std::uint64_t frame_time_ns) {
+  const LiveStatsWriter& writer = GetLiveStatsWriter();
+  std::lock_guard<std::mutex> lock(*writer.mutex);
+  WriteLiveStats(writer.file, [frame_time_ns](AtomicLiveStatsValues* values) {
+    std::uint64_t frame_count = Get(*values, LiveStatsValue::kFrameCount);
+    std::uint64_t min_frame_time_ns =
+        Get(*values, LiveStatsValue::kMinFrameTimeNs);
+    Set(values, LiveStatsValue::kFrameCount, frame_count + 1);
+    Set(values, LiveStatsValue::kLastFrameTimeNs, frame_time_ns);
+    if (frame_count == 0 || frame_time_ns < min_frame_time_ns) {
+      Set(values, LiveStatsValue::kMinFrameTimeNs, frame_time_ns);
+    }
+    if (frame_time_ns > Get(*values, LiveStatsValue::kMaxFrameTimeNs)) {
+      Set(values, LiveStatsValue::kMaxFrameTimeNs, frame_time_ns);
+    }
+    Set(values, LiveStatsValue::kTotalFrameTimeNs,
+        Get(*values, LiveStatsValue::kTotalFrameTimeNs) + frame_time_ns);
+  });
+}
+
+void AddLiveStat(LiveStatsValue value, std::uint64_t amount) {
+  const LiveStatsWriter& writer = GetLiveStatsWriter();
+  std::lock_guard<std::mutex> lock(*writer.mutex);
+  WriteLiveStats(writer.file, [value, amount](AtomicLiveStatsValues* values) {
+    Set(values, value, Get(*values, value) + amount);
+  });
+}
+
+}  // namespace internal
+
+}  // namespace gf_layers
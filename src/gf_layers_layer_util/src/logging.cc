@@ -14,38 +14,469 @@
 
 #include "gf_layers_layer_util/logging.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "gf_layers_layer_util/settings.h"
 
 #if defined(__ANDROID__)
 #include <android/log.h>
-#else
-#include <cstdio>
 #endif
 
 namespace gf_layers {
 
-void Log(const char* format_string, ...) {
-  va_list vargs;
+namespace internal {
 
-  // NOLINTNEXTLINE
-  va_start(vargs, format_string);
+std::atomic<std::int32_t> log_level_threshold{-1};
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
+std::int32_t InitLogLevelThreshold() {
+  auto threshold = static_cast<std::int32_t>(
+      GF_LAYERS_DEBUG ? LogLevel::kDebug : LogLevel::kInfo);
+
+  std::string value;
+  if (TryGetSettingString("VkLayer_GF_LOG_LEVEL", "debug.gf.log_level",
+                          &value)) {
+    if (value == "debug") {
+      threshold = static_cast<std::int32_t>(LogLevel::kDebug);
+    } else if (value == "info") {
+      threshold = static_cast<std::int32_t>(LogLevel::kInfo);
+    } else if (value == "warning") {
+      threshold = static_cast<std::int32_t>(LogLevel::kWarning);
+    } else if (value == "error") {
+      threshold = static_cast<std::int32_t>(LogLevel::kError);
+    } else if (value == "off") {
+      // Assertion failures are always logged.
+      threshold = static_cast<std::int32_t>(LogLevel::kFatal);
+    }
+  }
+
+  log_level_threshold.store(threshold, std::memory_order_relaxed);
+  return threshold;
+}
+
+}  // namespace internal
+
+namespace {
+
+// The number of messages that can be pending. Must be a power of two.
+constexpr std::size_t kRingCapacity = 256;
+
+// Longer messages are truncated when logged asynchronously.
+constexpr std::size_t kMaxMessageSize = 512;
+
+constexpr std::uint32_t kDefaultRateLimitPerSecond = 100;
+
+constexpr std::uint64_t kRateLimitWindowNs = 1000000000;
+
+// How long the flusher sleeps when idle before checking for messages, in case
+// a wake-up was missed.
+constexpr std::chrono::milliseconds kFlusherIdleTimeout{50};
+
+constexpr const char* kLogTag = "VkLayer_GF";
 
+bool GetSettingUint32Quiet(const char* env_var, const char* android_prop,
+                           std::uint32_t* value) {
+  std::string temp;
+  if (!TryGetSettingString(env_var, android_prop, &temp)) {
+    return false;
+  }
+  std::istringstream ss{temp};
+  std::uint32_t temp_uint{};
+  ss >> temp_uint;
+  if (ss.fail()) {
+    return false;
+  }
+  *value = temp_uint;
+  return true;
+}
+
+std::uint64_t NowNs() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void WriteMessage(LogLevel level, const char* message) {
 #if defined(__ANDROID__)
-  // NOLINTNEXTLINE
-  __android_log_vprint(ANDROID_LOG_DEBUG, "VkLayer_GF", format_string, vargs);
+  android_LogPriority priority = ANDROID_LOG_DEBUG;
+  switch (level) {
+    case LogLevel::kDebug:
+      priority = ANDROID_LOG_DEBUG;
+      break;
+    case LogLevel::kInfo:
+      priority = ANDROID_LOG_INFO;
+      break;
+    case LogLevel::kWarning:
+      priority = ANDROID_LOG_WARN;
+      break;
+    case LogLevel::kError:
+      priority = ANDROID_LOG_ERROR;
+      break;
+    case LogLevel::kFatal:
+      priority = ANDROID_LOG_FATAL;
+      break;
+  }
+  __android_log_write(priority, kLogTag, message);
 #else
+  (void)level;  // This parameter is deliberately unused.
+  std::fputs(message, stderr);
+  std::fputc('\n', stderr);
+#endif
+}
+
+void FlushOutput() {
+#if !defined(__ANDROID__)
+  std::fflush(stderr);
+#endif
+}
+
+// Formats the message into |buffer|, appending a note if messages were
+// suppressed by rate limiting. Truncates the message if needed.
+void FormatMessage(char* buffer, std::size_t buffer_size,
+                   std::uint32_t suppressed, const char* format_string,
+                   va_list vargs) {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
   // NOLINTNEXTLINE
-  std::vfprintf(stderr, format_string, vargs);
-  std::fprintf(stderr, "\n");
+  int length = std::vsnprintf(buffer, buffer_size, format_string, vargs);
+#pragma clang diagnostic pop
+
+  if (length < 0) {
+    std::snprintf(buffer, buffer_size, "%s", format_string);
+    return;
+  }
+
+  auto used = static_cast<std::size_t>(length);
+  if (used >= buffer_size) {
+    // Truncated; mark the end of the message.
+    const char kEllipsis[] = "...";
+    std::memcpy(buffer + buffer_size - sizeof(kEllipsis), kEllipsis,
+                sizeof(kEllipsis));
+    used = buffer_size - 1;
+  }
+
+  if (suppressed > 0 && used < buffer_size) {
+    std::snprintf(buffer + used, buffer_size - used,
+                  " [%u similar messages were suppressed]", suppressed);
+  }
+}
+
+// A bounded multi-producer, single-consumer queue of formatted messages.
+// Producers claim a slot with a single compare-and-swap and format directly
+// into it; they never block. Based on Dmitry Vyukov's bounded MPMC queue.
+class LogRing {
+ public:
+  LogRing() : slots_(new Slot[kRingCapacity]) {
+    for (std::size_t i = 0; i < kRingCapacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the ring is full.
+  bool TryPush(LogLevel level, std::uint32_t suppressed,
+               const char* format_string, va_list vargs) {
+    std::uint64_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[position & (kRingCapacity - 1)];
+      std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+      auto difference =
+          static_cast<std::int64_t>(sequence) -
+          static_cast<std::int64_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->level = level;
+    FormatMessage(slot->text.data(), slot->text.size(), suppressed,
+                  format_string, vargs);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Writes all messages that are ready, in order. Must only be called by one
+  // thread at a time. Returns whether any messages were written.
+  bool Drain() {
+    bool wrote = false;
+    while (true) {
+      Slot* slot = &slots_[dequeue_position_ & (kRingCapacity - 1)];
+      if (slot->sequence.load(std::memory_order_acquire) !=
+          dequeue_position_ + 1) {
+        break;
+      }
+      WriteMessage(slot->level, slot->text.data());
+      slot->sequence.store(dequeue_position_ + kRingCapacity,
+                           std::memory_order_release);
+      ++dequeue_position_;
+      wrote = true;
+    }
+    return wrote;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    LogLevel level = LogLevel::kInfo;
+    std::array<char, kMaxMessageSize> text{};
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<std::uint64_t> enqueue_position_{0};
+  // Only accessed by the consumer.
+  alignas(64) std::uint64_t dequeue_position_ = 0;
+};
+
+class Logger {
+ public:
+  Logger() {
+    GetSettingUint32Quiet("VkLayer_GF_LOG_RATE_LIMIT",
+                          "debug.gf.log_rate_limit", &rate_limit_per_second_);
+
+    // On Windows, the flusher thread could not be joined while the layer is
+    // being unloaded (under the loader lock), so we log synchronously.
+#if defined(_WIN32)
+    std::uint32_t async = 0;
+#else
+    std::uint32_t async = 1;
 #endif
+    GetSettingUint32Quiet("VkLayer_GF_LOG_ASYNC", "debug.gf.log_async", &async);
+
+    if (async != 0) {
+      ring_ = std::make_unique<LogRing>();
+      try {
+        flusher_ = std::thread([this]() { FlusherMain(); });
+        async_.store(true, std::memory_order_release);
+      } catch (const std::system_error&) {
+        ring_.reset();
+      }
+    }
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+  Logger(Logger&&) = delete;
+  Logger& operator=(Logger&&) = delete;
+  ~Logger() = delete;
+
+  // Returns true if the message should be logged. Otherwise, the message is
+  // counted as suppressed.
+  bool CheckRateLimit(LogCallSite* call_site, std::uint32_t* suppressed) const {
+    if (rate_limit_per_second_ == 0) {
+      *suppressed = 0;
+      return true;
+    }
+    std::uint64_t now = NowNs();
+    std::uint64_t window_start =
+        call_site->window_start_ns.load(std::memory_order_relaxed);
+    if (now - window_start >= kRateLimitWindowNs &&
+        call_site->window_start_ns.compare_exchange_strong(
+            window_start, now, std::memory_order_relaxed)) {
+      call_site->count.store(0, std::memory_order_relaxed);
+    }
+    if (call_site->count.fetch_add(1, std::memory_order_relaxed) >=
+        rate_limit_per_second_) {
+      call_site->suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    *suppressed = call_site->suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  void Log(LogLevel level, std::uint32_t suppressed, const char* format_string,
+           va_list vargs) {
+    if (level != LogLevel::kFatal && async_.load(std::memory_order_acquire)) {
+      if (ring_->TryPush(level, suppressed, format_string, vargs)) {
+        if (flusher_waiting_.load(std::memory_order_relaxed)) {
+          wake_condition_.notify_one();
+        }
+        return;
+      }
+      // The ring is full. Errors are too important to drop, so we fall back
+      // to writing them synchronously.
+      if (level < LogLevel::kError) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+
+    // Synchronous path: fatal messages, errors that did not fit in the ring,
+    // or asynchronous logging is disabled. Pending messages are written first
+    // to preserve their order.
+    std::vector<char> buffer(level == LogLevel::kFatal ? 4096
+                                                       : kMaxMessageSize);
+    FormatMessage(buffer.data(), buffer.size(), suppressed, format_string,
+                  vargs);
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    DrainLocked();
+    WriteMessage(level, buffer.data());
+    FlushOutput();
+  }
+
+  void Flush() {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    DrainLocked();
+    FlushOutput();
+  }
+
+  // Stops the flusher thread and writes any pending messages. Later messages
+  // are written synchronously.
+  void Shutdown() {
+    if (!async_.exchange(false, std::memory_order_acq_rel)) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stopping_ = true;
+    }
+    wake_condition_.notify_one();
+    flusher_.join();
+    Flush();
+  }
+
+ private:
+  // Requires |output_mutex_|. Returns whether any messages were written.
+  bool DrainLocked() {
+    if (!ring_) {
+      return false;
+    }
+    bool wrote = ring_->Drain();
+    std::uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      std::array<char, 128> message{};
+      std::snprintf(message.data(), message.size(),
+                    "%llu log messages were dropped because the log buffer "
+                    "was full",
+                    static_cast<unsigned long long>(dropped));  // NOLINT
+      WriteMessage(LogLevel::kWarning, message.data());
+      wrote = true;
+    }
+    return wrote;
+  }
+
+  void FlusherMain() {
+    while (true) {
+      bool wrote = false;
+      {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        wrote = DrainLocked();
+        if (wrote) {
+          FlushOutput();
+        }
+      }
+      if (wrote) {
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      if (stopping_) {
+        break;
+      }
+      flusher_waiting_.store(true, std::memory_order_relaxed);
+      // A producer may have pushed a message just before we set the flag; the
+      // timeout bounds the delay in that case.
+      wake_condition_.wait_for(lock, kFlusherIdleTimeout);
+      flusher_waiting_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  std::uint32_t rate_limit_per_second_ = kDefaultRateLimitPerSecond;
 
+  std::unique_ptr<LogRing> ring_;
+  std::atomic<bool> async_{false};
+  std::atomic<std::uint64_t> dropped_{0};
+
+  // Held while writing output so that messages are not interleaved, and by
+  // the single consumer of |ring_|.
+  std::mutex output_mutex_;
+
+  std::thread flusher_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_condition_;
+  std::atomic<bool> flusher_waiting_{false};
+  bool stopping_ = false;
+};
+
+std::atomic<Logger*> logger_instance{nullptr};
+
+Logger* GetLogger() {
+  // Intentionally leaked, so that it can be used during static destruction.
+  static Logger* logger = []() {
+    auto* result = new Logger();
+    logger_instance.store(result, std::memory_order_release);
+    return result;
+  }();
+  return logger;
+}
+
+// Stops the flusher thread at exit, or when the layer library is unloaded.
+struct LoggerShutdown {
+  LoggerShutdown() = default;
+  LoggerShutdown(const LoggerShutdown&) = delete;
+  LoggerShutdown& operator=(const LoggerShutdown&) = delete;
+  LoggerShutdown(LoggerShutdown&&) = delete;
+  LoggerShutdown& operator=(LoggerShutdown&&) = delete;
+
+  ~LoggerShutdown() {
+    Logger* logger = logger_instance.load(std::memory_order_acquire);
+    if (logger != nullptr) {
+      logger->Shutdown();
+    }
+  }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+LoggerShutdown logger_shutdown_;  // NOLINT(cert-err58-cpp)
 #pragma clang diagnostic pop
 
+}  // namespace
+
+void LogAt(LogLevel level, LogCallSite* call_site, const char* format_string,
+           ...) {
+  Logger* logger = GetLogger();
+
+  std::uint32_t suppressed = 0;
+  if (level != LogLevel::kFatal &&
+      !logger->CheckRateLimit(call_site, &suppressed)) {
+    return;
+  }
+
+  va_list vargs;
+
+  // NOLINTNEXTLINE
+  va_start(vargs, format_string);
+
+  logger->Log(level, suppressed, format_string, vargs);
+
   // NOLINTNEXTLINE
   va_end(vargs);
 }
 
+void FlushLog() { GetLogger()->Flush(); }
+
 }  // namespace gf_layers
@@ -14,10 +14,22 @@
 
 #include "gf_layers_layer_util/settings.h"
 
+#include <sys/stat.h>
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
 
+#include "gf_layers_layer_util/clock.h"
 #include "gf_layers_layer_util/logging.h"
 
 #if defined(__ANDROID__)
@@ -57,10 +69,138 @@ bool GetEnvVar(const char* env_var, std::string* value) {
   *value = result;
   return true;
 }
+
+// How often |CheckSettingsFile| looks for changes: one second.
+constexpr std::uint64_t kSettingsFileCheckIntervalNs = 1000000000;
+
+struct SettingsFile {
+  // Guards the fields below it.
+  std::mutex mutex;
+  std::string path = "gf_layers_settings.txt";
+  // The values of the settings, by environment variable name.
+  std::unordered_map<std::string, std::string> values;
+  // The contents of the file, and the size and modification time of the file
+  // when it was last read.
+  std::string contents;
+  std::int64_t size = -1;
+  std::int64_t modification_time = 0;
+
+  bool existed_at_start = false;
+  std::atomic<std::uint64_t> version{0};
+  // The |ClockNowNs| time of the next check for changes.
+  std::atomic<std::uint64_t> next_check_ns{0};
+};
+
+// Returns the "<name>=<value>" lines of |contents|, with surrounding spaces
+// removed.
+std::unordered_map<std::string, std::string> ParseSettingsFile(
+    const std::string& contents) {
+  const char* const kSpaces = " \t\r";
+  std::unordered_map<std::string, std::string> result;
+  std::istringstream lines(contents);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::size_t begin = line.find_first_not_of(kSpaces);
+    if (begin == std::string::npos || line[begin] == '#') {
+      continue;
+    }
+    std::size_t equals = line.find('=', begin);
+    if (equals == std::string::npos) {
+      continue;
+    }
+    std::size_t name_end = line.find_last_not_of(kSpaces, equals - 1);
+    std::size_t value_begin = line.find_first_not_of(kSpaces, equals + 1);
+    std::size_t value_end = line.find_last_not_of(kSpaces);
+    if (name_end == std::string::npos || name_end < begin) {
+      continue;
+    }
+    result[line.substr(begin, name_end + 1 - begin)] =
+        value_begin == std::string::npos || value_begin > value_end
+            ? std::string()
+            : line.substr(value_begin, value_end + 1 - value_begin);
+  }
+  return result;
+}
+
+// Requires the file's mutex. Rereads the file if its size or modification time
+// changed, and increments its version if its contents changed. Does not log,
+// as the logger reads its settings via this file.
+void ReadSettingsFileLocked(SettingsFile* file) {
+  struct stat file_stat {};
+  if (stat(file->path.c_str(), &file_stat) != 0) {
+    file_stat.st_size = -1;
+    file_stat.st_mtime = 0;
+  }
+  auto size = static_cast<std::int64_t>(file_stat.st_size);
+  auto modification_time = static_cast<std::int64_t>(file_stat.st_mtime);
+  if (size == file->size && modification_time == file->modification_time) {
+    return;
+  }
+  file->size = size;
+  file->modification_time = modification_time;
+
+  std::string contents;
+  if (size >= 0) {
+    std::ifstream stream(file->path, std::ios::binary);
+    std::ostringstream buffer;
+    buffer << stream.rdbuf();
+    contents = buffer.str();
+  }
+  if (contents == file->contents) {
+    return;
+  }
+  file->values = ParseSettingsFile(contents);
+  file->contents = std::move(contents);
+  file->version.fetch_add(1, std::memory_order_release);
+}
+
+SettingsFile* GetSettingsFile() {
+  // Initialized by the first caller; other callers wait until it is
+  // initialized. Intentionally leaked, so that settings can be read during
+  // static destruction.
+  static SettingsFile* file = []() {
+    auto* result = new SettingsFile();
+    std::string path;
+    if (GetEnvVar("VkLayer_GF_SETTINGS_FILE", &path)) {
+      result->path = path;
+    }
+#if defined(__ANDROID__)
+    else if (GetAndroidProperty("debug.gf.settings_file", &path)) {
+      result->path = path;
+    }
+#endif
+    ReadSettingsFileLocked(result);
+    result->existed_at_start = result->size >= 0;
+    result->next_check_ns.store(ClockNowNs() + kSettingsFileCheckIntervalNs,
+                                std::memory_order_relaxed);
+    return result;
+  }();
+  return file;
+}
+
+bool GetSettingsFileValue(const char* env_var, std::string* value) {
+  SettingsFile* file = GetSettingsFile();
+  if (!file->existed_at_start) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(file->mutex);
+  auto it = file->values.find(env_var);
+  // Also fail if the value is zero length.
+  if (it == file->values.end() || it->second.empty()) {
+    return false;
+  }
+  *value = it->second;
+  return true;
+}
+
 }  // namespace
 
-bool GetSettingString(const char* env_var, const char* android_prop,
-                      std::string* value) {
+bool TryGetSettingString(const char* env_var, const char* android_prop,
+                         std::string* value) {
+  if (GetSettingsFileValue(env_var, value)) {
+    return true;
+  }
+
   if (GetEnvVar(env_var, value)) {
     return true;
   }
@@ -69,8 +209,19 @@ bool GetSettingString(const char* env_var, const char* android_prop,
   if (GetAndroidProperty(android_prop, value)) {
     return true;
   }
+#else
+  (void)android_prop;  // This parameter is deliberately unused.
 #endif
 
+  return false;
+}
+
+bool GetSettingString(const char* env_var, const char* android_prop,
+                      std::string* value) {
+  if (TryGetSettingString(env_var, android_prop, value)) {
+    return true;
+  }
+
   LOG("Could not find setting: %s / %s", env_var, android_prop);
 
   return false;
@@ -83,18 +234,48 @@ bool GetSettingUint64(const char* env_var, const char* android_prop,
     return false;
   }
 
-  std::istringstream ss{temp};
-  std::uint64_t temp_uint{};
-  ss >> temp_uint;
-
-  if (ss.fail()) {
+  if (!ParseSettingUint64(temp, value)) {
     LOG("Failed to parse setting %s / %s with value %s", env_var, android_prop,
         temp.c_str());
     return false;
   }
+  return true;
+}
 
-  *value = temp_uint;
+bool ParseSettingUint64(const std::string& text, std::uint64_t* value) {
+  std::uint64_t result = 0;
+  const char* end = text.data() + text.size();
+  std::from_chars_result parsed = std::from_chars(text.data(), end, result);
+  if (parsed.ec != std::errc() || parsed.ptr != end) {
+    return false;
+  }
+  *value = result;
   return true;
 }
 
+bool CanReloadSettings() { return GetSettingsFile()->existed_at_start; }
+
+namespace internal {
+
+std::uint64_t CheckSettingsFile() {
+  SettingsFile* file = GetSettingsFile();
+  if (!file->existed_at_start) {
+    return 0;
+  }
+  std::uint64_t now_ns = ClockNowNs();
+  std::uint64_t next_check_ns =
+      file->next_check_ns.load(std::memory_order_relaxed);
+  // Only one thread checks the file when a check is due.
+  if (now_ns >= next_check_ns &&
+      file->next_check_ns.compare_exchange_strong(
+          next_check_ns, now_ns + kSettingsFileCheckIntervalNs,
+          std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(file->mutex);
+    ReadSettingsFileLocked(file);
+  }
+  return file->version.load(std::memory_order_acquire);
+}
+
+}  // namespace internal
+
 }  // namespace gf_layers
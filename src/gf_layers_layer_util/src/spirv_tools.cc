@@ -0,0 +1,174 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/spirv_tools.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/spirv_tools_interface.h"
+#include "gf_layers_layer_util/trace.h"
+#include "gf_layers_layer_util/util.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace gf_layers {
+
+namespace {
+
+#if defined(_WIN32)
+const char* const kLibraryFileName = "gf_layers_spirv_tools.dll";
+#elif defined(__APPLE__)
+const char* const kLibraryFileName = "libgf_layers_spirv_tools.dylib";
+#else
+const char* const kLibraryFileName = "libgf_layers_spirv_tools.so";
+#endif
+
+const char* const kNegotiateFunctionName =
+    "GfLayersSpirvToolsNegotiateInterface";
+
+// Trivially destructible, so that it can be a function-local static.
+struct SpirvTools {
+  bool loaded = false;
+  GfLayersSpirvToolsInterface functions = {};
+};
+
+PFN_GfLayersSpirvToolsNegotiateInterface OpenLibrary(const std::string& path) {
+#if defined(_WIN32)
+  HMODULE library = LoadLibraryA(path.c_str());
+  if (library == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<PFN_GfLayersSpirvToolsNegotiateInterface>(
+      GetProcAddress(library, kNegotiateFunctionName));
+#else
+  void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<PFN_GfLayersSpirvToolsNegotiateInterface>(
+      dlsym(library, kNegotiateFunctionName));
+#endif
+}
+
+SpirvTools LoadSpirvToolsLibrary() {
+  SpirvTools result;
+
+  // Prefer the library next to the layer. The library is never unloaded.
+  PFN_GfLayersSpirvToolsNegotiateInterface negotiate = nullptr;
+  std::string this_library_path = GetThisLibraryPath();
+  std::string::size_type separator = this_library_path.find_last_of("/\\");
+  if (separator != std::string::npos) {
+    negotiate = OpenLibrary(this_library_path.substr(0, separator + 1) +
+                            kLibraryFileName);
+  }
+  if (negotiate == nullptr) {
+    negotiate = OpenLibrary(kLibraryFileName);
+  }
+  if (negotiate == nullptr) {
+    LOG_ERROR("Could not load %s; SPIR-V will not be processed.",
+              kLibraryFileName);
+    return result;
+  }
+
+  result.functions.version = GF_LAYERS_SPIRV_TOOLS_INTERFACE_VERSION;
+  if (!negotiate(&result.functions)) {
+    LOG_ERROR("%s does not support interface version %u.", kLibraryFileName,
+              GF_LAYERS_SPIRV_TOOLS_INTERFACE_VERSION);
+    return result;
+  }
+
+  result.loaded = true;
+  return result;
+}
+
+const SpirvTools& GetSpirvTools() {
+  // Loaded by the first caller; other callers wait until it is loaded.
+  static const SpirvTools spirv_tools = LoadSpirvToolsLibrary();
+  return spirv_tools;
+}
+
+void LogMessage(void* /*user_data*/, GfLayersSpirvToolsMessageLevel level,
+                const char* message) {
+  switch (level) {
+    case GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR:
+      LOG_ERROR("%s", message);
+      break;
+    case GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_WARNING:
+      LOG_WARNING("%s", message);
+      break;
+    case GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_INFO:
+      LOG("%s", message);
+      break;
+    case GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_DEBUG:
+      DEBUG_LOG("%s", message);
+      break;
+  }
+}
+
+void AppendToString(void* user_data, const void* data, size_t size) {
+  static_cast<std::string*>(user_data)->append(static_cast<const char*>(data),
+                                               size);
+}
+
+void AppendToWords(void* user_data, const void* data, size_t size) {
+  auto* words = static_cast<std::vector<uint32_t>*>(user_data);
+  size_t old_size = words->size();
+  words->resize(old_size + size / sizeof(uint32_t));
+  std::memcpy(words->data() + old_size, data,
+              (words->size() - old_size) * sizeof(uint32_t));
+}
+
+}  // namespace
+
+bool LoadSpirvTools() { return GetSpirvTools().loaded; }
+
+bool DisassembleSpirv(const uint32_t* code, size_t word_count,
+                      std::string* result) {
+  TraceSpan trace_span("DisassembleSpirv");
+  trace_span.AddArg("word_count", word_count);
+
+  const SpirvTools& spirv_tools = GetSpirvTools();
+  if (!spirv_tools.loaded) {
+    return false;
+  }
+  result->clear();
+  GfLayersSpirvToolsCallbacks callbacks{result, LogMessage, AppendToString};
+  return spirv_tools.functions.disassemble(code, word_count, &callbacks);
+}
+
+bool FuzzSpirv(const uint32_t* code, size_t word_count, uint32_t seed,
+               const std::string& transformations_prefix,
+               std::vector<uint32_t>* result) {
+  TraceSpan trace_span("FuzzSpirv");
+  trace_span.AddArg("word_count", word_count);
+  trace_span.AddArg("seed", seed);
+
+  const SpirvTools& spirv_tools = GetSpirvTools();
+  if (!spirv_tools.loaded) {
+    return false;
+  }
+  result->clear();
+  GfLayersSpirvToolsCallbacks callbacks{result, LogMessage, AppendToWords};
+  return spirv_tools.functions.fuzz(code, word_count, seed,
+                                    transformations_prefix.c_str(), &callbacks);
+}
+
+}  // namespace gf_layers
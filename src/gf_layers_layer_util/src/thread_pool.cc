@@ -0,0 +1,322 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/util.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gf_layers {
+
+namespace {
+
+constexpr std::uint32_t kMaxDefaultWorkerCount = 2;
+constexpr std::uint32_t kDefaultNiceLevel = 10;
+constexpr std::uint32_t kMaxNiceLevel = 19;
+// Larger CPU numbers are rejected.
+constexpr std::uint64_t kMaxCpuCount = 1024;
+
+// The pool and worker index of the calling thread, if it is a worker.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_worker_index = 0;
+
+// Parses a list of CPUs, such as "0,1,6-7", into |cpus|.
+bool ParseCpuList(const std::string& text, std::vector<std::uint32_t>* cpus) {
+  std::size_t start = 0;
+  while (start <= text.size()) {
+    std::size_t end = std::min(text.find(',', start), text.size());
+    std::string item = text.substr(start, end - start);
+    std::size_t dash = item.find('-');
+    std::uint64_t first = 0;
+    std::uint64_t last = 0;
+    if (!ParseSettingUint64(item.substr(0, dash), &first)) {
+      return false;
+    }
+    last = first;
+    if (dash != std::string::npos &&
+        !ParseSettingUint64(item.substr(dash + 1), &last)) {
+      return false;
+    }
+    if (last < first || last >= kMaxCpuCount) {
+      return false;
+    }
+    for (std::uint64_t cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(static_cast<std::uint32_t>(cpu));
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+// Applies the CPU affinity and nice level of |options| to the calling thread.
+void ConfigureWorkerThread(const ThreadPoolOptions& options) {
+#if defined(__linux__)
+  if (!options.cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (std::uint32_t cpu : options.cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+    // A pid of 0 is the calling thread.
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+      LOG_WARNING("Failed to set the CPU affinity of a thread pool worker.");
+    }
+  }
+  if (options.nice_level != 0) {
+    // On Linux, the nice level is per thread.
+    auto thread_id = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, thread_id,
+                    static_cast<int>(options.nice_level)) != 0) {
+      LOG_WARNING("Failed to set the nice level of a thread pool worker.");
+    }
+  }
+#else
+  (void)options;
+#endif
+}
+
+}  // namespace
+
+ThreadPoolOptions GetThreadPoolOptionsFromSettings() {
+  ThreadPoolOptions result;
+
+  std::uint32_t hardware_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  std::uint64_t worker_count =
+      std::clamp(hardware_threads / 4, 1U, kMaxDefaultWorkerCount);
+  GetSettingUint64("VkLayer_GF_THREAD_POOL_WORKERS",
+                   "debug.gf.thread_pool_workers", &worker_count);
+  result.worker_count = static_cast<std::uint32_t>(
+      std::min<std::uint64_t>(worker_count, hardware_threads));
+
+  std::string cpus;
+  if (GetSettingString("VkLayer_GF_THREAD_POOL_CPUS",
+                       "debug.gf.thread_pool_cpus", &cpus) &&
+      !ParseCpuList(cpus, &result.cpus)) {
+    LOG_WARNING("Ignoring the invalid list of CPUs: %s", cpus.c_str());
+    result.cpus.clear();
+  }
+
+  std::uint64_t nice_level = kDefaultNiceLevel;
+  GetSettingUint64("VkLayer_GF_THREAD_POOL_NICE", "debug.gf.thread_pool_nice",
+                   &nice_level);
+  result.nice_level = static_cast<std::uint32_t>(
+      std::min<std::uint64_t>(nice_level, kMaxNiceLevel));
+
+  return result;
+}
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options) : options_(options) {
+  workers_.reserve(options_.worker_count);
+  for (std::uint32_t i = 0; i < options_.worker_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // The workers only access |workers_| once they are all created.
+  ScopedLock lock(wake_mutex_);
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    try {
+      workers_[i]->thread = std::thread([this, i]() { WorkerMain(i); });
+    } catch (const std::system_error&) {
+      LOG_WARNING("Failed to create thread pool worker %zu; using %zu.", i, i);
+      workers_.resize(i);
+      break;
+    }
+  }
+  if (workers_.empty()) {
+    stopped_.store(true, std::memory_order_release);
+  }
+}
+
+ThreadPool::~ThreadPool() { Shutdown(); }
+
+void ThreadPool::Shutdown() {
+  if (stopped_.load(std::memory_order_acquire)) {
+    return;
+  }
+  {
+    ScopedLock lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_condition_.notify_all();
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread.join();
+  }
+  stopped_.store(true, std::memory_order_release);
+  // Run any tasks that were submitted by other threads while the workers were
+  // exiting.
+  while (RunTask(0)) {
+  }
+}
+
+bool ThreadPool::IsWorkerThread() const { return current_pool == this; }
+
+bool ThreadPool::RunPendingTask() {
+  DEBUG_ASSERT(IsWorkerThread());
+  return RunTask(current_worker_index);
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  if (stopped_.load(std::memory_order_acquire)) {
+    task();
+    return;
+  }
+  std::size_t worker_index =
+      IsWorkerThread()
+          ? current_worker_index
+          : next_worker_index_.fetch_add(1, std::memory_order_relaxed) %
+                workers_.size();
+  // Counted before the task is queued, so that the count never underflows.
+  // Sequentially consistent, like the updates of |sleeping_worker_count_|:
+  // either we see a sleeping worker and wake it, or the worker sees the task
+  // before it sleeps.
+  queued_task_count_.fetch_add(1);
+  {
+    Worker& worker = *workers_[worker_index];
+    ScopedLock lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  if (sleeping_worker_count_.load() > 0) {
+    {
+      // Ensures that a worker that is about to sleep is waiting by the time
+      // we notify it.
+      ScopedLock lock(wake_mutex_);
+    }
+    wake_condition_.notify_one();
+  }
+}
+
+void ThreadPool::WorkerMain(std::size_t worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  {
+    // Wait until all workers are created.
+    ScopedLock lock(wake_mutex_);
+  }
+  ConfigureWorkerThread(options_);
+
+  while (true) {
+    if (RunTask(worker_index)) {
+      continue;
+    }
+    ScopedLock lock(wake_mutex_);
+    sleeping_worker_count_.fetch_add(1);
+    wake_condition_.wait(
+        lock, [this]() { return stopping_ || queued_task_count_.load() > 0; });
+    sleeping_worker_count_.fetch_sub(1);
+    // When stopping, the workers only exit once all tasks have run. A task
+    // that is still running on another worker may queue more tasks, but that
+    // worker then runs them itself.
+    if (stopping_ && queued_task_count_.load() == 0) {
+      break;
+    }
+  }
+}
+
+bool ThreadPool::RunTask(std::size_t worker_index) {
+  std::function<void()> task;
+  for (std::size_t i = 0; i < workers_.size() && !task; ++i) {
+    Worker& worker = *workers_[(worker_index + i) % workers_.size()];
+    ScopedLock lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      // Our own newest task, whose data is most likely to be in our cache.
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    } else {
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    }
+  }
+  if (!task) {
+    return false;
+  }
+  queued_task_count_.fetch_sub(1);
+  task();
+  return true;
+}
+
+namespace {
+
+// Trivially destructible, so that it can be a function-local static.
+struct LayerThreadPool {
+  MutexType* mutex = nullptr;
+  std::uint32_t instance_count = 0;
+  std::atomic<ThreadPool*> pool{nullptr};
+};
+
+LayerThreadPool& GetLayerThreadPoolData() {
+  static LayerThreadPool data{new MutexType()};
+  return data;
+}
+
+}  // namespace
+
+void AcquireLayerThreadPool() {
+  LayerThreadPool& data = GetLayerThreadPoolData();
+  ScopedLock lock(*data.mutex);
+  ++data.instance_count;
+}
+
+void ReleaseLayerThreadPool() {
+  LayerThreadPool& data = GetLayerThreadPoolData();
+  ScopedLock lock(*data.mutex);
+  DEBUG_ASSERT(data.instance_count > 0);
+  if (--data.instance_count == 0) {
+    ThreadPool* pool = data.pool.exchange(nullptr, std::memory_order_acq_rel);
+    delete pool;
+  }
+}
+
+ThreadPool* GetLayerThreadPool() {
+  LayerThreadPool& data = GetLayerThreadPoolData();
+  ThreadPool* result = data.pool.load(std::memory_order_acquire);
+  if (result != nullptr) {
+    return result;
+  }
+  ScopedLock lock(*data.mutex);
+  DEBUG_ASSERT(data.instance_count > 0);
+  result = data.pool.load(std::memory_order_relaxed);
+  if (result == nullptr) {
+    result = new ThreadPool(GetThreadPoolOptionsFromSettings());
+    data.pool.store(result, std::memory_order_release);
+  }
+  return result;
+}
+
+}  // namespace gf_layers
@@ -0,0 +1,264 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_layer_util/trace.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gf_layers_layer_util/logging.h"
+#include "gf_layers_layer_util/settings.h"
+#include "gf_layers_layer_util/util.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace gf_layers {
+
+namespace internal {
+
+std::atomic<std::int32_t> trace_state{-1};
+
+namespace {
+
+// Intentionally leaked, so that it can be used during static destruction.
+const std::string& GetTraceFilePrefix() {
+  static const std::string* prefix = []() {
+    auto* result = new std::string();
+    TryGetSettingString("VkLayer_GF_TRACE_FILE_PREFIX",
+                        "debug.gf.trace_file_prefix", result);
+    return result;
+  }();
+  return *prefix;
+}
+
+}  // namespace
+
+bool InitTraceState() {
+  bool enabled = !GetTraceFilePrefix().empty();
+  trace_state.store(enabled ? 1 : 0, std::memory_order_relaxed);
+  return enabled;
+}
+
+}  // namespace internal
+
+namespace {
+
+// Spans beyond this limit are dropped (and counted), so that tracing a long
+// run does not use unbounded memory.
+constexpr std::size_t kMaxSpansPerThread = 65536;
+
+struct Span {
+  const char* name;
+  std::uint64_t start_ns;
+  std::uint64_t end_ns;
+  std::array<internal::TraceArg, kMaxTraceArgs> args;
+  std::size_t arg_count;
+};
+
+struct ThreadTraceBuffer {
+  std::uint64_t thread_id = 0;
+  // Only contended when the trace is written.
+  std::mutex mutex;
+  std::vector<Span> spans;
+  std::uint64_t dropped_spans = 0;
+};
+
+std::uint64_t GetCurrentThreadIdForTrace() {
+#if defined(_WIN32)
+  return GetCurrentThreadId();
+#elif defined(__linux__)
+  return static_cast<std::uint64_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+  std::uint64_t thread_id = 0;
+  pthread_threadid_np(nullptr, &thread_id);
+  return thread_id;
+#else
+  return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
+
+std::uint64_t GetProcessIdForTrace() {
+#if defined(_WIN32)
+  return static_cast<std::uint64_t>(_getpid());
+#else
+  return static_cast<std::uint64_t>(getpid());
+#endif
+}
+
+// Appends |ns| in microseconds, the unit of the trace event format.
+void AppendMicroseconds(std::string* result, std::uint64_t ns) {
+  std::array<char, 4> fraction{};
+  std::snprintf(fraction.data(), fraction.size(), "%03u",
+                static_cast<unsigned>(ns % 1000));
+  *result += std::to_string(ns / 1000);
+  *result += ".";
+  *result += fraction.data();
+}
+
+void AppendSpan(std::string* result, const Span& span,
+                const std::string& process_id, std::uint64_t thread_id) {
+  *result += R"({"name":")";
+  *result += span.name;
+  *result += R"(","cat":"gf_layers","ph":"X","pid":)";
+  *result += process_id;
+  *result += R"(,"tid":)";
+  *result += std::to_string(thread_id);
+  *result += R"(,"ts":)";
+  AppendMicroseconds(result, span.start_ns);
+  *result += R"(,"dur":)";
+  AppendMicroseconds(result, span.end_ns - span.start_ns);
+  *result += R"(,"args":{)";
+  for (std::size_t i = 0; i < span.arg_count; ++i) {
+    if (i > 0) {
+      *result += ",";
+    }
+    *result += "\"";
+    *result += span.args[i].name;
+    *result += "\":";
+    *result += std::to_string(span.args[i].value);
+  }
+  *result += "}}";
+}
+
+class TraceRegistry {
+ public:
+  ThreadTraceBuffer* GetThreadTraceBuffer() {
+    // The buffers are never freed, so that the spans of exited threads are
+    // still written; the pointer is trivially destructible.
+    static thread_local ThreadTraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+      auto new_buffer = std::make_unique<ThreadTraceBuffer>();
+      new_buffer->thread_id = GetCurrentThreadIdForTrace();
+      buffer = new_buffer.get();
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffers_.push_back(std::move(new_buffer));
+    }
+    return buffer;
+  }
+
+  // Writes all spans recorded so far.
+  void Write() {
+    std::string process_id = std::to_string(GetProcessIdForTrace());
+    std::string path = internal::GetTraceFilePrefix() + "_" +
+                       GetThisLibraryStem() + "_" + process_id + ".json";
+
+    std::string json = R"({"displayTimeUnit":"ns","traceEvents":[)";
+    std::size_t span_count = 0;
+    std::uint64_t dropped_spans = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        for (const Span& span : buffer->spans) {
+          if (span_count++ > 0) {
+            json += ",\n";
+          }
+          AppendSpan(&json, span, process_id, buffer->thread_id);
+        }
+        dropped_spans += buffer->dropped_spans;
+      }
+    }
+    json += "]}\n";
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << json;
+    file.close();
+    if (file.fail()) {
+      LOG_ERROR("Failed to write trace file %s.", path.c_str());
+      return;
+    }
+    LOG("Wrote %zu trace spans to %s.", span_count, path.c_str());
+    if (dropped_spans > 0) {
+      LOG_WARNING(
+          "Dropped %llu trace spans; the limit is %zu per thread.",
+          static_cast<unsigned long long>(  // NOLINT(google-runtime-int)
+              dropped_spans),
+          kMaxSpansPerThread);
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers_;
+};
+
+TraceRegistry* GetTraceRegistry() {
+  // Intentionally leaked, so that it can be used during static destruction.
+  static TraceRegistry* registry = new TraceRegistry();
+  return registry;
+}
+
+// Writes the trace at exit, or when the layer library is unloaded.
+struct TraceWriter {
+  TraceWriter() = default;
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+  TraceWriter(TraceWriter&&) = delete;
+  TraceWriter& operator=(TraceWriter&&) = delete;
+
+  ~TraceWriter() {
+    // Nothing was recorded if tracing was never enabled.
+    if (internal::trace_state.load(std::memory_order_relaxed) > 0) {
+      GetTraceRegistry()->Write();
+    }
+  }
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+TraceWriter trace_writer_;  // NOLINT(cert-err58-cpp)
+#pragma clang diagnostic pop
+
+}  // namespace
+
+namespace internal {
+
+void RecordTraceSpan(const char* name, std::uint64_t start_ns,
+                     std::uint64_t end_ns,
+                     const std::array<TraceArg, kMaxTraceArgs>& args,
+                     std::size_t arg_count) {
+  ThreadTraceBuffer* buffer = GetTraceRegistry()->GetThreadTraceBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  if (buffer->spans.size() == kMaxSpansPerThread) {
+    ++buffer->dropped_spans;
+    return;
+  }
+  buffer->spans.push_back({name, start_ns, end_ns, args, arg_count});
+}
+
+}  // namespace internal
+
+}  // namespace gf_layers
@@ -16,6 +16,15 @@
 
 #include <vulkan/vk_layer.h>
 
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
 namespace gf_layers {
 
 void* InstanceKey(VkInstance handle) {
@@ -80,4 +89,39 @@ VkLayerDeviceCreateInfo* GetLayerDeviceCreateInfo(
   return next;
 }
 
+std::string GetThisLibraryPath() {
+#if defined(_WIN32)
+  HMODULE module = nullptr;
+  if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                             GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                         reinterpret_cast<LPCSTR>(&GetThisLibraryPath),
+                         &module) == 0) {
+    return {};
+  }
+  std::vector<char> path(MAX_PATH);
+  DWORD length = GetModuleFileNameA(module, path.data(),
+                                    static_cast<DWORD>(path.size()));
+  if (length == 0 || length == path.size()) {
+    return {};
+  }
+  return std::string(path.data(), length);
+#else
+  Dl_info info{};
+  if (dladdr(reinterpret_cast<void*>(&GetThisLibraryPath), &info) == 0 ||
+      info.dli_fname == nullptr) {
+    return {};
+  }
+  return info.dli_fname;
+#endif
+}
+
+std::string GetThisLibraryStem() {
+  std::string path = GetThisLibraryPath();
+  std::string::size_type separator = path.find_last_of("/\\");
+  std::string stem =
+      separator == std::string::npos ? path : path.substr(separator + 1);
+  stem = stem.substr(0, stem.find('.'));
+  return stem.empty() ? "gf_layers" : stem;
+}
+
 }  // namespace gf_layers
@@ -0,0 +1,206 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gf_layers_layer_util/live_stats.h"
+
+// Displays the live statistics written by the layers (see
+// gf_layers_layer_util/live_stats.h) while the application runs. The files are
+// only read, so the tool never blocks or slows down the application.
+
+namespace gf_layers::live_stats_tool {
+
+namespace {
+
+struct StatsFile {
+  std::string path;
+  const LiveStatsFile* file = nullptr;
+  LiveStatsValues previous_values{};
+  std::chrono::steady_clock::time_point previous_time;
+  bool has_previous_values = false;
+};
+
+// Returns the mapped file at |path|, or nullptr if it could not be mapped.
+const LiveStatsFile* MapStatsFile(const std::string& path) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat {};
+  void* address = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      static_cast<std::size_t>(file_stat.st_size) >= sizeof(LiveStatsFile)) {
+    address =
+        mmap(nullptr, sizeof(LiveStatsFile), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  return address == MAP_FAILED ? nullptr
+                               : static_cast<const LiveStatsFile*>(address);
+}
+
+std::uint64_t Get(const LiveStatsValues& values, LiveStatsValue value) {
+  return values[static_cast<std::size_t>(value)];
+}
+
+double ToMs(std::uint64_t ns) { return static_cast<double>(ns) / 1e6; }
+
+std::string FormatBytes(std::uint64_t bytes) {
+  const std::array<const char*, 4> units{"B", "KiB", "MiB", "GiB"};
+  auto value = static_cast<double>(bytes);
+  std::size_t unit = 0;
+  while (value >= 1024.0 && unit < units.size() - 1) {
+    value /= 1024.0;
+    ++unit;
+  }
+  std::array<char, 32> text{};
+  std::snprintf(text.data(), text.size(), "%.1f%s", value, units[unit]);
+  return text.data();
+}
+
+// Prints the current values of |stats_file|, with rates since the previous
+// call. Returns false if the file could not be read.
+bool PrintStats(StatsFile* stats_file) {
+  LiveStatsValues values{};
+  if (!ReadLiveStats(*stats_file->file, &values)) {
+    std::fprintf(stderr, "%s: not a live statistics file (version %u)\n",
+                 stats_file->path.c_str(), kLiveStatsVersion);
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+
+  std::uint64_t frame_count = Get(values, LiveStatsValue::kFrameCount);
+  std::uint64_t layer_cpu_time_ns =
+      Get(values, LiveStatsValue::kLayerCpuTimeNs);
+
+  // Rates since the previous call.
+  double fps = 0.0;
+  double layer_cpu_percent = 0.0;
+  if (stats_file->has_previous_values) {
+    double elapsed_ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - stats_file->previous_time)
+            .count());
+    if (elapsed_ns > 0.0) {
+      fps = static_cast<double>(
+                frame_count - Get(stats_file->previous_values,
+                                  LiveStatsValue::kFrameCount)) *
+            1e9 / elapsed_ns;
+      layer_cpu_percent =
+          static_cast<double>(
+              layer_cpu_time_ns - Get(stats_file->previous_values,
+                                      LiveStatsValue::kLayerCpuTimeNs)) *
+          100.0 / elapsed_ns;
+    }
+  }
+
+  // The layers use the same monotonic clock.
+  auto now_ns = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          now.time_since_epoch())
+          .count());
+  std::uint64_t update_time_ns = Get(values, LiveStatsValue::kUpdateTimeNs);
+  double seconds_since_update =
+      update_time_ns == 0 || update_time_ns > now_ns
+          ? 0.0
+          : static_cast<double>(now_ns - update_time_ns) / 1e9;
+
+  std::printf(
+      "%s (pid %u, updated %.1fs ago): frames %" PRIu64
+      " (%.1f fps), frame time last %.2fms mean %.2fms min %.2fms max "
+      "%.2fms, captured draw calls %" PRIu64 ", fuzzed shaders %" PRIu64
+      ", written %s, layer CPU %.2fms (%.2f%%)\n",
+      stats_file->path.c_str(), stats_file->file->process_id,
+      seconds_since_update, frame_count, fps,
+      ToMs(Get(values, LiveStatsValue::kLastFrameTimeNs)),
+      frame_count == 0
+          ? 0.0
+          : ToMs(Get(values, LiveStatsValue::kTotalFrameTimeNs)) /
+                static_cast<double>(frame_count),
+      ToMs(Get(values, LiveStatsValue::kMinFrameTimeNs)),
+      ToMs(Get(values, LiveStatsValue::kMaxFrameTimeNs)),
+      Get(values, LiveStatsValue::kCapturedDrawCalls),
+      Get(values, LiveStatsValue::kFuzzedShaders),
+      FormatBytes(Get(values, LiveStatsValue::kBytesWritten)).c_str(),
+      ToMs(layer_cpu_time_ns), layer_cpu_percent);
+
+  stats_file->previous_values = values;
+  stats_file->previous_time = now;
+  stats_file->has_previous_values = true;
+  return true;
+}
+
+}  // namespace
+
+}  // namespace gf_layers::live_stats_tool
+
+int main(int argc, const char** argv) {
+  // Usage: gf_layers_live_stats [--interval_ms=<ms>] [--once] <file>...
+  std::chrono::milliseconds interval{1000};
+  bool once = false;
+  std::vector<gf_layers::live_stats_tool::StatsFile> stats_files;
+  const std::string interval_flag = "--interval_ms=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, interval_flag.size(), interval_flag) == 0) {
+      interval = std::chrono::milliseconds(
+          std::strtoull(arg.c_str() + interval_flag.size(), nullptr, 10));
+    } else if (arg == "--once") {
+      once = true;
+    } else {
+      gf_layers::live_stats_tool::StatsFile stats_file;
+      stats_file.path = arg;
+      stats_file.file = gf_layers::live_stats_tool::MapStatsFile(arg);
+      if (stats_file.file == nullptr) {
+        std::fprintf(stderr, "Failed to map %s\n", arg.c_str());
+        return 1;
+      }
+      stats_files.push_back(stats_file);
+    }
+  }
+  if (stats_files.empty()) {
+    std::fprintf(stderr,
+                 "Usage: %s [--interval_ms=<ms>] [--once] <stats file>...\n",
+                 argv[0]);
+    return 1;
+  }
+
+  while (true) {
+    for (auto& stats_file : stats_files) {
+      if (!gf_layers::live_stats_tool::PrintStats(&stats_file)) {
+        return 1;
+      }
+    }
+    std::fflush(stdout);
+    if (once) {
+      return 0;
+    }
+    std::this_thread::sleep_for(interval);
+  }
+}
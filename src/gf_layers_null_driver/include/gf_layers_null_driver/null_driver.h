@@ -0,0 +1,49 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GF_LAYERS_NULL_DRIVER_NULL_DRIVER_H
+#define GF_LAYERS_NULL_DRIVER_NULL_DRIVER_H
+
+#include <vulkan/vulkan.h>
+
+// A Vulkan driver that does no GPU work, to be used as the "next layer" of the
+// layers so that they can be run (e.g. benchmarked) on machines without a GPU.
+//
+// It implements the functions that the layers call: instance and device
+// creation, command buffer recording, queue submission and presentation,
+// buffers and memory, fences, and the objects needed to create a graphics
+// pipeline. Work completes immediately: commands take effect when they are
+// recorded (only vkCmdCopyBuffer does anything), fences are signaled on
+// submission, and device memory is host memory. It has one physical device,
+// with one queue family that supports everything.
+//
+// The driver does not validate its inputs. Handles of dispatchable objects
+// point to an object whose first word is the dispatch table pointer; as there
+// is no loader, the driver sets it to a value that is unique to the instance
+// or device (which the layers use as the key for their maps).
+
+namespace gf_layers::null_driver {
+
+// Entry points to be used as |pfnNextGetInstanceProcAddr| and
+// |pfnNextGetDeviceProcAddr| in the layer link info. Both return nullptr for
+// functions that are not implemented.
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+GetInstanceProcAddr(VkInstance instance, const char* pName);
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device,
+                                                           const char* pName);
+
+}  // namespace gf_layers::null_driver
+
+#endif  // GF_LAYERS_NULL_DRIVER_NULL_DRIVER_H
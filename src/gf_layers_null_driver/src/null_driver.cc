@@ -0,0 +1,914 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gf_layers_null_driver/null_driver.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "gf_layers_layer_util/proc_table.h"
+
+namespace gf_layers::null_driver {
+
+namespace {
+
+// The maximum number of queues in the queue family.
+constexpr std::uint32_t kMaxQueues = 256;
+
+// The alignment of buffers in device memory.
+constexpr VkDeviceSize kBufferAlignment = 16;
+
+//
+// Objects.
+//
+
+// Dispatchable objects must start with the dispatch table pointer. Child
+// objects (physical devices, queues and command buffers) use the pointer of
+// their parent.
+
+struct NullPhysicalDevice {
+  void* dispatch = nullptr;
+};
+
+struct NullInstance {
+  void* dispatch = this;
+  NullPhysicalDevice physical_device{this};
+};
+
+struct NullQueue {
+  void* dispatch = nullptr;
+};
+
+struct NullDevice {
+  void* dispatch = this;
+  std::vector<NullQueue> queues;
+};
+
+struct NullCommandBuffer {
+  void* dispatch = nullptr;
+};
+
+struct NullCommandPool {
+  // Command pools are externally synchronized, so no lock is needed.
+  std::unordered_set<NullCommandBuffer*> command_buffers;
+};
+
+struct NullDeviceMemory {
+  std::vector<std::uint8_t> data;
+};
+
+struct NullBuffer {
+  VkDeviceSize size = 0;
+  NullDeviceMemory* memory = nullptr;
+  VkDeviceSize memory_offset = 0;
+};
+
+struct NullFence {
+  std::atomic<bool> signaled{false};
+};
+
+// Non-dispatchable handles are pointers on 64-bit platforms and 64-bit integers
+// otherwise.
+
+template <typename HandleType>
+HandleType ToHandle(std::uint64_t value) {
+  if constexpr (std::is_pointer_v<HandleType>) {
+    return reinterpret_cast<HandleType>(  // NOLINT
+        static_cast<std::uintptr_t>(value));
+  } else {
+    return static_cast<HandleType>(value);
+  }
+}
+
+template <typename HandleType>
+HandleType ToHandle(void* object) {
+  return ToHandle<HandleType>(
+      static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(object)));
+}
+
+template <typename ObjectType, typename HandleType>
+ObjectType* ToObject(HandleType handle) {
+  if constexpr (std::is_pointer_v<HandleType>) {
+    return reinterpret_cast<ObjectType*>(handle);  // NOLINT
+  } else {
+    return reinterpret_cast<ObjectType*>(  // NOLINT
+        static_cast<std::uintptr_t>(handle));
+  }
+}
+
+// Used for the handles of objects that have no state.
+std::atomic<std::uint64_t> next_handle_value{1};
+
+// Returns a new handle for an object that has no state. Such objects need not
+// be destroyed.
+template <typename HandleType>
+HandleType NewHandle() {
+  return ToHandle<HandleType>(
+      next_handle_value.fetch_add(1, std::memory_order_relaxed));
+}
+
+// Implements the usual pattern of functions that return an array: if
+// |pProperties| is nullptr, the count is returned; otherwise, up to
+// |*pPropertyCount| elements are copied.
+template <typename T, std::size_t N>
+VkResult GetArray(const std::array<T, N>& values, uint32_t* pPropertyCount,
+                  T* pProperties) {
+  if (pProperties == nullptr) {
+    *pPropertyCount = static_cast<uint32_t>(N);
+    return VK_SUCCESS;
+  }
+  std::size_t count = std::min<std::size_t>(*pPropertyCount, N);
+  std::copy_n(values.begin(), count, pProperties);
+  *pPropertyCount = static_cast<uint32_t>(count);
+  return count < N ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+//
+// Instance and physical device functions.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateInstance(const VkInstanceCreateInfo* /*pCreateInfo*/,
+                 const VkAllocationCallbacks* /*pAllocator*/,
+                 VkInstance* pInstance) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  *pInstance = reinterpret_cast<VkInstance>(new NullInstance());
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyInstance(VkInstance instance,
+                  const VkAllocationCallbacks* /*pAllocator*/) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete reinterpret_cast<NullInstance*>(instance);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumeratePhysicalDevices(VkInstance instance, uint32_t* pPhysicalDeviceCount,
+                           VkPhysicalDevice* pPhysicalDevices) {
+  auto* null_instance = reinterpret_cast<NullInstance*>(instance);
+  return GetArray(std::array{reinterpret_cast<VkPhysicalDevice>(
+                      &null_instance->physical_device)},
+                  pPhysicalDeviceCount, pPhysicalDevices);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(
+    VkPhysicalDevice /*physicalDevice*/,
+    VkPhysicalDeviceProperties* pProperties) {
+  *pProperties = {};
+  pProperties->apiVersion = VK_MAKE_VERSION(1U, 1U, 130U);
+  pProperties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+  pProperties->limits.timestampPeriod = 1.0F;
+  std::strncpy(pProperties->deviceName, "gf-layers null driver",
+               VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(
+    VkPhysicalDevice /*physicalDevice*/, uint32_t* pQueueFamilyPropertyCount,
+    VkQueueFamilyProperties* pQueueFamilyProperties) {
+  VkQueueFamilyProperties properties{};
+  properties.queueFlags =
+      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+  properties.queueCount = kMaxQueues;
+  properties.timestampValidBits = 64;
+  properties.minImageTransferGranularity = {1, 1, 1};
+  GetArray(std::array{properties}, pQueueFamilyPropertyCount,
+           pQueueFamilyProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice /*physicalDevice*/,
+    VkPhysicalDeviceMemoryProperties* pMemoryProperties) {
+  *pMemoryProperties = {};
+  pMemoryProperties->memoryTypeCount = 1;
+  pMemoryProperties->memoryTypes[0].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  pMemoryProperties->memoryTypes[0].heapIndex = 0;
+  pMemoryProperties->memoryHeapCount = 1;
+  pMemoryProperties->memoryHeaps[0].size = VkDeviceSize{1} << 32U;
+  pMemoryProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
+    VkPhysicalDevice /*physicalDevice*/, const char* pLayerName,
+    uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+  if (pLayerName != nullptr) {
+    return VK_ERROR_LAYER_NOT_PRESENT;
+  }
+  VkExtensionProperties swapchain{};
+  std::strncpy(swapchain.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+               VK_MAX_EXTENSION_NAME_SIZE - 1);
+  swapchain.specVersion = VK_KHR_SWAPCHAIN_SPEC_VERSION;
+  return GetArray(std::array{swapchain}, pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDevice(VkPhysicalDevice /*physicalDevice*/,
+               const VkDeviceCreateInfo* pCreateInfo,
+               const VkAllocationCallbacks* /*pAllocator*/, VkDevice* pDevice) {
+  std::uint32_t queue_count = 0;
+  for (std::uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    queue_count += pCreateInfo->pQueueCreateInfos[i].queueCount;
+  }
+  if (queue_count > kMaxQueues) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  auto* device = new NullDevice();
+  device->queues.resize(queue_count, NullQueue{device});
+  *pDevice = reinterpret_cast<VkDevice>(device);
+  return VK_SUCCESS;
+}
+
+//
+// Device and queue functions.
+//
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* /*pAllocator*/) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete reinterpret_cast<NullDevice*>(device);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice device,
+                                            uint32_t /*queueFamilyIndex*/,
+                                            uint32_t queueIndex,
+                                            VkQueue* pQueue) {
+  *pQueue = reinterpret_cast<VkQueue>(
+      &reinterpret_cast<NullDevice*>(device)->queues.at(queueIndex));
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue /*queue*/,
+                                             uint32_t /*submitCount*/,
+                                             const VkSubmitInfo* /*pSubmits*/,
+                                             VkFence fence) {
+  if (fence != VK_NULL_HANDLE) {
+    ToObject<NullFence>(fence)->signaled.store(true,
+                                               std::memory_order_release);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue /*queue*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice /*device*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkQueuePresentKHR(VkQueue /*queue*/, const VkPresentInfoKHR* pPresentInfo) {
+  if (pPresentInfo->pResults != nullptr) {
+    std::fill_n(pPresentInfo->pResults, pPresentInfo->swapchainCount,
+                VK_SUCCESS);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(
+    VkDevice /*device*/, const VkSwapchainCreateInfoKHR* /*pCreateInfo*/,
+    const VkAllocationCallbacks* /*pAllocator*/, VkSwapchainKHR* pSwapchain) {
+  *pSwapchain = NewHandle<VkSwapchainKHR>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySwapchainKHR(VkDevice /*device*/, VkSwapchainKHR /*swapchain*/,
+                      const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(
+    VkDevice /*device*/, VkSwapchainKHR /*swapchain*/, uint64_t /*timeout*/,
+    VkSemaphore /*semaphore*/, VkFence fence, uint32_t* pImageIndex) {
+  if (fence != VK_NULL_HANDLE) {
+    ToObject<NullFence>(fence)->signaled.store(true,
+                                               std::memory_order_release);
+  }
+  *pImageIndex = 0;
+  return VK_SUCCESS;
+}
+
+//
+// Memory and buffers.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(VkDevice /*device*/, const VkMemoryAllocateInfo* pAllocateInfo,
+                 const VkAllocationCallbacks* /*pAllocator*/,
+                 VkDeviceMemory* pMemory) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  auto* memory = new NullDeviceMemory();
+  memory->data.resize(static_cast<std::size_t>(pAllocateInfo->allocationSize));
+  *pMemory = ToHandle<VkDeviceMemory>(memory);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkFreeMemory(VkDevice /*device*/, VkDeviceMemory memory,
+             const VkAllocationCallbacks* /*pAllocator*/) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete ToObject<NullDeviceMemory>(memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice /*device*/,
+                                           VkDeviceMemory memory,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize /*size*/,
+                                           VkMemoryMapFlags /*flags*/,
+                                           void** ppData) {
+  *ppData = ToObject<NullDeviceMemory>(memory)->data.data() + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice /*device*/,
+                                         VkDeviceMemory /*memory*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(
+    VkDevice /*device*/, uint32_t /*memoryRangeCount*/,
+    const VkMappedMemoryRange* /*pMemoryRanges*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(
+    VkDevice /*device*/, uint32_t /*memoryRangeCount*/,
+    const VkMappedMemoryRange* /*pMemoryRanges*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateBuffer(VkDevice /*device*/, const VkBufferCreateInfo* pCreateInfo,
+               const VkAllocationCallbacks* /*pAllocator*/, VkBuffer* pBuffer) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  auto* buffer = new NullBuffer();
+  buffer->size = pCreateInfo->size;
+  *pBuffer = ToHandle<VkBuffer>(buffer);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyBuffer(VkDevice /*device*/, VkBuffer buffer,
+                const VkAllocationCallbacks* /*pAllocator*/) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete ToObject<NullBuffer>(buffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(
+    VkDevice /*device*/, VkBuffer buffer,
+    VkMemoryRequirements* pMemoryRequirements) {
+  pMemoryRequirements->size = ToObject<NullBuffer>(buffer)->size;
+  pMemoryRequirements->alignment = kBufferAlignment;
+  pMemoryRequirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice /*device*/,
+                                                  VkBuffer buffer,
+                                                  VkDeviceMemory memory,
+                                                  VkDeviceSize memoryOffset) {
+  NullBuffer* null_buffer = ToObject<NullBuffer>(buffer);
+  null_buffer->memory = ToObject<NullDeviceMemory>(memory);
+  null_buffer->memory_offset = memoryOffset;
+  return VK_SUCCESS;
+}
+
+//
+// Synchronization.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateFence(VkDevice /*device*/, const VkFenceCreateInfo* pCreateInfo,
+              const VkAllocationCallbacks* /*pAllocator*/, VkFence* pFence) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  auto* fence = new NullFence();
+  fence->signaled.store((pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) !=
+                        0U);
+  *pFence = ToHandle<VkFence>(fence);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(VkDevice /*device*/, VkFence fence,
+               const VkAllocationCallbacks* /*pAllocator*/) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete ToObject<NullFence>(fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice /*device*/,
+                                             uint32_t fenceCount,
+                                             const VkFence* pFences) {
+  for (uint32_t i = 0; i < fenceCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    ToObject<NullFence>(pFences[i])->signaled.store(false);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice /*device*/,
+                                                VkFence fence) {
+  return ToObject<NullFence>(fence)->signaled.load(std::memory_order_acquire)
+             ? VK_SUCCESS
+             : VK_NOT_READY;
+}
+
+// Work completes on submission, so a fence that is not signaled will only be
+// signaled by a later submission; we return VK_TIMEOUT rather than wait.
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device,
+                                               uint32_t fenceCount,
+                                               const VkFence* pFences,
+                                               VkBool32 waitAll,
+                                               uint64_t /*timeout*/) {
+  uint32_t signaled_count = 0;
+  for (uint32_t i = 0; i < fenceCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    if (vkGetFenceStatus(device, pFences[i]) == VK_SUCCESS) {
+      ++signaled_count;
+    }
+  }
+  bool done = waitAll == VK_TRUE ? signaled_count == fenceCount
+                                 : signaled_count > 0;
+  return done ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateSemaphore(VkDevice /*device*/,
+                  const VkSemaphoreCreateInfo* /*pCreateInfo*/,
+                  const VkAllocationCallbacks* /*pAllocator*/,
+                  VkSemaphore* pSemaphore) {
+  *pSemaphore = NewHandle<VkSemaphore>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(VkDevice /*device*/, VkSemaphore /*semaphore*/,
+                   const VkAllocationCallbacks* /*pAllocator*/) {}
+
+//
+// Command pools and command buffers.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateCommandPool(VkDevice /*device*/,
+                    const VkCommandPoolCreateInfo* /*pCreateInfo*/,
+                    const VkAllocationCallbacks* /*pAllocator*/,
+                    VkCommandPool* pCommandPool) {
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  *pCommandPool = ToHandle<VkCommandPool>(new NullCommandPool());
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice /*device*/, VkCommandPool commandPool,
+                     const VkAllocationCallbacks* /*pAllocator*/) {
+  auto* command_pool = ToObject<NullCommandPool>(commandPool);
+  if (command_pool == nullptr) {
+    return;
+  }
+  for (NullCommandBuffer* command_buffer : command_pool->command_buffers) {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    delete command_buffer;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+  delete command_pool;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(
+    VkDevice /*device*/, VkCommandPool /*commandPool*/,
+    VkCommandPoolResetFlags /*flags*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(VkDevice device,
+                         const VkCommandBufferAllocateInfo* pAllocateInfo,
+                         VkCommandBuffer* pCommandBuffers) {
+  auto* command_pool = ToObject<NullCommandPool>(pAllocateInfo->commandPool);
+  for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    auto* command_buffer = new NullCommandBuffer{
+        reinterpret_cast<NullDevice*>(device)->dispatch};
+    command_pool->command_buffers.insert(command_buffer);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    pCommandBuffers[i] = reinterpret_cast<VkCommandBuffer>(command_buffer);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkFreeCommandBuffers(VkDevice /*device*/, VkCommandPool commandPool,
+                     uint32_t commandBufferCount,
+                     const VkCommandBuffer* pCommandBuffers) {
+  auto* command_pool = ToObject<NullCommandPool>(commandPool);
+  for (uint32_t i = 0; i < commandBufferCount; ++i) {
+    auto* command_buffer =
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        reinterpret_cast<NullCommandBuffer*>(pCommandBuffers[i]);
+    if (command_buffer != nullptr) {
+      command_pool->command_buffers.erase(command_buffer);
+      // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+      delete command_buffer;
+    }
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer /*commandBuffer*/,
+                     const VkCommandBufferBeginInfo* /*pBeginInfo*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEndCommandBuffer(VkCommandBuffer /*commandBuffer*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(
+    VkCommandBuffer /*commandBuffer*/, VkCommandBufferResetFlags /*flags*/) {
+  return VK_SUCCESS;
+}
+
+//
+// Queries. Work completes on submission, so results are always available; as
+// no GPU time passes, they are all 0.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(
+    VkDevice /*device*/, const VkQueryPoolCreateInfo* /*pCreateInfo*/,
+    const VkAllocationCallbacks* /*pAllocator*/, VkQueryPool* pQueryPool) {
+  *pQueryPool = NewHandle<VkQueryPool>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyQueryPool(VkDevice /*device*/, VkQueryPool /*queryPool*/,
+                   const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(
+    VkDevice /*device*/, VkQueryPool /*queryPool*/, uint32_t /*firstQuery*/,
+    uint32_t queryCount, size_t /*dataSize*/, void* pData, VkDeviceSize stride,
+    VkQueryResultFlags flags) {
+  std::size_t value_size =
+      (flags & VK_QUERY_RESULT_64_BIT) != 0 ? sizeof(uint64_t)
+                                            : sizeof(uint32_t);
+  auto* data = static_cast<unsigned char*>(pData);
+  for (uint32_t i = 0; i < queryCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    unsigned char* result = data + i * stride;
+    std::memset(result, 0, value_size);
+    if ((flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != 0) {
+      // The availability follows the result.
+      uint64_t available = 1;
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      std::memcpy(result + value_size, &available, value_size);
+    }
+  }
+  return VK_SUCCESS;
+}
+
+//
+// Commands. Only vkCmdCopyBuffer has an effect, which happens immediately.
+//
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdBeginRenderPass(VkCommandBuffer /*commandBuffer*/,
+                     const VkRenderPassBeginInfo* /*pRenderPassBegin*/,
+                     VkSubpassContents /*contents*/) {}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdEndRenderPass(VkCommandBuffer /*commandBuffer*/) {}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdBindPipeline(VkCommandBuffer /*commandBuffer*/,
+                  VkPipelineBindPoint /*pipelineBindPoint*/,
+                  VkPipeline /*pipeline*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(
+    VkCommandBuffer /*commandBuffer*/,
+    VkPipelineBindPoint /*pipelineBindPoint*/, VkPipelineLayout /*layout*/,
+    uint32_t /*firstSet*/, uint32_t /*descriptorSetCount*/,
+    const VkDescriptorSet* /*pDescriptorSets*/,
+    uint32_t /*dynamicOffsetCount*/, const uint32_t* /*pDynamicOffsets*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(
+    VkCommandBuffer /*commandBuffer*/, uint32_t /*firstBinding*/,
+    uint32_t /*bindingCount*/, const VkBuffer* /*pBuffers*/,
+    const VkDeviceSize* /*pOffsets*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(
+    VkCommandBuffer /*commandBuffer*/, VkBuffer /*buffer*/,
+    VkDeviceSize /*offset*/, VkIndexType /*indexType*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer /*commandBuffer*/,
+                                     uint32_t /*vertexCount*/,
+                                     uint32_t /*instanceCount*/,
+                                     uint32_t /*firstVertex*/,
+                                     uint32_t /*firstInstance*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer /*commandBuffer*/,
+                                            uint32_t /*indexCount*/,
+                                            uint32_t /*instanceCount*/,
+                                            uint32_t /*firstIndex*/,
+                                            int32_t /*vertexOffset*/,
+                                            uint32_t /*firstInstance*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
+    VkCommandBuffer /*commandBuffer*/, VkPipelineStageFlags /*srcStageMask*/,
+    VkPipelineStageFlags /*dstStageMask*/,
+    VkDependencyFlags /*dependencyFlags*/, uint32_t /*memoryBarrierCount*/,
+    const VkMemoryBarrier* /*pMemoryBarriers*/,
+    uint32_t /*bufferMemoryBarrierCount*/,
+    const VkBufferMemoryBarrier* /*pBufferMemoryBarriers*/,
+    uint32_t /*imageMemoryBarrierCount*/,
+    const VkImageMemoryBarrier* /*pImageMemoryBarriers*/) {}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer /*commandBuffer*/,
+                                           VkBuffer srcBuffer,
+                                           VkBuffer dstBuffer,
+                                           uint32_t regionCount,
+                                           const VkBufferCopy* pRegions) {
+  NullBuffer* src = ToObject<NullBuffer>(srcBuffer);
+  NullBuffer* dst = ToObject<NullBuffer>(dstBuffer);
+  if (src->memory == nullptr || dst->memory == nullptr) {
+    return;
+  }
+  for (uint32_t i = 0; i < regionCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const VkBufferCopy& region = pRegions[i];
+    std::memmove(
+        dst->memory->data.data() + dst->memory_offset + region.dstOffset,
+        src->memory->data.data() + src->memory_offset + region.srcOffset,
+        static_cast<std::size_t>(region.size));
+  }
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(
+    VkCommandBuffer /*commandBuffer*/, VkQueryPool /*queryPool*/,
+    uint32_t /*firstQuery*/, uint32_t /*queryCount*/) {}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdWriteTimestamp(VkCommandBuffer /*commandBuffer*/,
+                    VkPipelineStageFlagBits /*pipelineStage*/,
+                    VkQueryPool /*queryPool*/, uint32_t /*query*/) {}
+
+//
+// Objects that have no state.
+//
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateShaderModule(VkDevice /*device*/,
+                     const VkShaderModuleCreateInfo* /*pCreateInfo*/,
+                     const VkAllocationCallbacks* /*pAllocator*/,
+                     VkShaderModule* pShaderModule) {
+  *pShaderModule = NewHandle<VkShaderModule>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyShaderModule(VkDevice /*device*/, VkShaderModule /*shaderModule*/,
+                      const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(
+    VkDevice /*device*/, const VkDescriptorSetLayoutCreateInfo* /*pCreateInfo*/,
+    const VkAllocationCallbacks* /*pAllocator*/,
+    VkDescriptorSetLayout* pSetLayout) {
+  *pSetLayout = NewHandle<VkDescriptorSetLayout>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(
+    VkDevice /*device*/, VkDescriptorSetLayout /*descriptorSetLayout*/,
+    const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorPool(VkDevice /*device*/,
+                       const VkDescriptorPoolCreateInfo* /*pCreateInfo*/,
+                       const VkAllocationCallbacks* /*pAllocator*/,
+                       VkDescriptorPool* pDescriptorPool) {
+  *pDescriptorPool = NewHandle<VkDescriptorPool>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorPool(VkDevice /*device*/, VkDescriptorPool /*pool*/,
+                        const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(
+    VkDevice /*device*/, VkDescriptorPool /*descriptorPool*/,
+    VkDescriptorPoolResetFlags /*flags*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateDescriptorSets(VkDevice /*device*/,
+                         const VkDescriptorSetAllocateInfo* pAllocateInfo,
+                         VkDescriptorSet* pDescriptorSets) {
+  for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    pDescriptorSets[i] = NewHandle<VkDescriptorSet>();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets(
+    VkDevice /*device*/, VkDescriptorPool /*descriptorPool*/,
+    uint32_t /*descriptorSetCount*/,
+    const VkDescriptorSet* /*pDescriptorSets*/) {
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(
+    VkDevice /*device*/, uint32_t /*descriptorWriteCount*/,
+    const VkWriteDescriptorSet* /*pDescriptorWrites*/,
+    uint32_t /*descriptorCopyCount*/,
+    const VkCopyDescriptorSet* /*pDescriptorCopies*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreatePipelineLayout(VkDevice /*device*/,
+                       const VkPipelineLayoutCreateInfo* /*pCreateInfo*/,
+                       const VkAllocationCallbacks* /*pAllocator*/,
+                       VkPipelineLayout* pPipelineLayout) {
+  *pPipelineLayout = NewHandle<VkPipelineLayout>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipelineLayout(VkDevice /*device*/, VkPipelineLayout /*layout*/,
+                        const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateRenderPass(VkDevice /*device*/,
+                   const VkRenderPassCreateInfo* /*pCreateInfo*/,
+                   const VkAllocationCallbacks* /*pAllocator*/,
+                   VkRenderPass* pRenderPass) {
+  *pRenderPass = NewHandle<VkRenderPass>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyRenderPass(VkDevice /*device*/, VkRenderPass /*renderPass*/,
+                    const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateFramebuffer(VkDevice /*device*/,
+                    const VkFramebufferCreateInfo* /*pCreateInfo*/,
+                    const VkAllocationCallbacks* /*pAllocator*/,
+                    VkFramebuffer* pFramebuffer) {
+  *pFramebuffer = NewHandle<VkFramebuffer>();
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFramebuffer(VkDevice /*device*/, VkFramebuffer /*framebuffer*/,
+                     const VkAllocationCallbacks* /*pAllocator*/) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(
+    VkDevice /*device*/, VkPipelineCache /*pipelineCache*/,
+    uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* /*pCreateInfos*/,
+    const VkAllocationCallbacks* /*pAllocator*/, VkPipeline* pPipelines) {
+  for (uint32_t i = 0; i < createInfoCount; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    pPipelines[i] = NewHandle<VkPipeline>();
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipeline(VkDevice /*device*/, VkPipeline /*pipeline*/,
+                  const VkAllocationCallbacks* /*pAllocator*/) {}
+
+//
+// The functions provided by the driver, used by our Get*ProcAddr functions.
+//
+
+#define GF_LAYERS_NULL_DRIVER_FUNCTIONS(HANDLE)    \
+  HANDLE(vkCreateInstance)                         \
+  HANDLE(vkDestroyInstance)                        \
+  HANDLE(vkEnumeratePhysicalDevices)               \
+  HANDLE(vkGetPhysicalDeviceProperties)            \
+  HANDLE(vkGetPhysicalDeviceQueueFamilyProperties) \
+  HANDLE(vkGetPhysicalDeviceMemoryProperties)      \
+  HANDLE(vkEnumerateDeviceExtensionProperties)     \
+  HANDLE(vkCreateDevice)                           \
+  HANDLE(vkDestroyDevice)                          \
+  HANDLE(vkGetDeviceQueue)                         \
+  HANDLE(vkQueueSubmit)                            \
+  HANDLE(vkQueueWaitIdle)                          \
+  HANDLE(vkDeviceWaitIdle)                         \
+  HANDLE(vkQueuePresentKHR)                        \
+  HANDLE(vkCreateSwapchainKHR)                     \
+  HANDLE(vkDestroySwapchainKHR)                    \
+  HANDLE(vkAcquireNextImageKHR)                    \
+  HANDLE(vkAllocateMemory)                         \
+  HANDLE(vkFreeMemory)                             \
+  HANDLE(vkMapMemory)                              \
+  HANDLE(vkUnmapMemory)                            \
+  HANDLE(vkFlushMappedMemoryRanges)                \
+  HANDLE(vkInvalidateMappedMemoryRanges)           \
+  HANDLE(vkCreateBuffer)                           \
+  HANDLE(vkDestroyBuffer)                          \
+  HANDLE(vkGetBufferMemoryRequirements)            \
+  HANDLE(vkBindBufferMemory)                       \
+  HANDLE(vkCreateFence)                            \
+  HANDLE(vkDestroyFence)                           \
+  HANDLE(vkResetFences)                            \
+  HANDLE(vkGetFenceStatus)                         \
+  HANDLE(vkWaitForFences)                          \
+  HANDLE(vkCreateSemaphore)                        \
+  HANDLE(vkDestroySemaphore)                       \
+  HANDLE(vkCreateCommandPool)                      \
+  HANDLE(vkDestroyCommandPool)                     \
+  HANDLE(vkResetCommandPool)                       \
+  HANDLE(vkAllocateCommandBuffers)                 \
+  HANDLE(vkFreeCommandBuffers)                     \
+  HANDLE(vkBeginCommandBuffer)                     \
+  HANDLE(vkEndCommandBuffer)                       \
+  HANDLE(vkResetCommandBuffer)                     \
+  HANDLE(vkCreateQueryPool)                        \
+  HANDLE(vkDestroyQueryPool)                       \
+  HANDLE(vkGetQueryPoolResults)                    \
+  HANDLE(vkCmdBeginRenderPass)                     \
+  HANDLE(vkCmdEndRenderPass)                       \
+  HANDLE(vkCmdBindPipeline)                        \
+  HANDLE(vkCmdBindDescriptorSets)                  \
+  HANDLE(vkCmdBindVertexBuffers)                   \
+  HANDLE(vkCmdBindIndexBuffer)                     \
+  HANDLE(vkCmdDraw)                                \
+  HANDLE(vkCmdDrawIndexed)                         \
+  HANDLE(vkCmdPipelineBarrier)                     \
+  HANDLE(vkCmdCopyBuffer)                          \
+  HANDLE(vkCmdResetQueryPool)                      \
+  HANDLE(vkCmdWriteTimestamp)                      \
+  HANDLE(vkCreateShaderModule)                     \
+  HANDLE(vkDestroyShaderModule)                    \
+  HANDLE(vkCreateDescriptorSetLayout)              \
+  HANDLE(vkDestroyDescriptorSetLayout)             \
+  HANDLE(vkCreateDescriptorPool)                   \
+  HANDLE(vkDestroyDescriptorPool)                  \
+  HANDLE(vkResetDescriptorPool)                    \
+  HANDLE(vkAllocateDescriptorSets)                 \
+  HANDLE(vkFreeDescriptorSets)                     \
+  HANDLE(vkUpdateDescriptorSets)                   \
+  HANDLE(vkCreatePipelineLayout)                   \
+  HANDLE(vkDestroyPipelineLayout)                  \
+  HANDLE(vkCreateRenderPass)                       \
+  HANDLE(vkDestroyRenderPass)                      \
+  HANDLE(vkCreateFramebuffer)                      \
+  HANDLE(vkDestroyFramebuffer)                     \
+  HANDLE(vkCreateGraphicsPipelines)                \
+  HANDLE(vkDestroyPipeline)
+
+#define HANDLE(func) std::string_view(#func),
+constexpr auto kFunctionTable = MakeProcNameTable(std::array{
+    std::string_view("vkGetInstanceProcAddr"),
+    std::string_view("vkGetDeviceProcAddr"),
+    GF_LAYERS_NULL_DRIVER_FUNCTIONS(HANDLE)});
+#undef HANDLE
+
+static_assert(kFunctionTable.IsPerfect(),
+              "Could not build a perfect hash table of functions");
+
+}  // namespace
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+GetInstanceProcAddr(VkInstance /*instance*/, const char* pName) {
+#define HANDLE(func) reinterpret_cast<PFN_vkVoidFunction>(func),
+  static const std::array<PFN_vkVoidFunction, kFunctionTable.size()>
+      kFunctions = {reinterpret_cast<PFN_vkVoidFunction>(GetInstanceProcAddr),
+                    reinterpret_cast<PFN_vkVoidFunction>(GetDeviceProcAddr),
+                    GF_LAYERS_NULL_DRIVER_FUNCTIONS(HANDLE)};
+#undef HANDLE
+
+  return kFunctionTable.Lookup(pName, kFunctions);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice /*device*/,
+                                                           const char* pName) {
+  // Like some real drivers, we also return instance functions.
+  return GetInstanceProcAddr(nullptr, pName);
+}
+
+}  // namespace gf_layers::null_driver
@@ -0,0 +1,293 @@
+// Copyright 2020 The gf-layers Project Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>  // IWYU pragma: keep
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gf_layers_layer_util/spirv.h"
+#include "gf_layers_layer_util/spirv_tools_interface.h"
+
+#pragma GCC diagnostic push  // Clang, GCC.
+#pragma warning(push, 1)     // MSVC: also reduces warning level to W1.
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpragmas"
+#endif
+
+// TODO(paulthomson): These are protobuf warning suppressions that could be
+//  moved upstream to SPIRV-Tools or fixed in protobuf.
+#pragma GCC diagnostic ignored "-Wreserved-id-macro"
+#pragma GCC diagnostic ignored "-Wdeprecated-dynamic-exception-spec"
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wextra-semi-stmt"
+#pragma GCC diagnostic ignored "-Winconsistent-missing-destructor-override"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+// TODO(paulthomson): SPIRV-Tools warning suppressions.
+#pragma GCC diagnostic ignored "-Wnewline-eof"
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wweak-vtables"
+
+// behavior change:
+// __is_pod(google::protobuf::internal::AuxiliaryParseTableField) has different
+// value in previous versions
+#pragma warning(disable : 4647)
+
+// reinterpret_cast used between related classes:
+// 'google::protobuf::SourceContext' and 'google::protobuf::MessageLite'
+#pragma warning(disable : 4946)
+
+// 'initializing': conversion from '_Ty' to '_Ty1', signed/unsigned mismatch
+#pragma warning(disable : 4365)
+
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/util/json_util.h"
+#include "source/fuzz/fuzzer.h"
+#include "source/fuzz/fuzzer_util.h"
+#include "source/fuzz/protobufs/spvtoolsfuzz.pb.h"
+#include "source/fuzz/pseudo_random_generator.h"
+#include "source/fuzz/random_generator.h"
+#include "spirv-tools/libspirv.h"
+#include "spirv-tools/libspirv.hpp"
+
+#pragma warning(pop)
+#pragma GCC diagnostic pop
+
+// The gf_layers_spirv_tools library, which the layers load on first use. See
+// gf_layers_layer_util/spirv_tools_interface.h.
+
+namespace gf_layers::spirv_tools {
+
+namespace {
+
+void Log(const GfLayersSpirvToolsCallbacks* callbacks,
+         GfLayersSpirvToolsMessageLevel level, const std::string& message) {
+  callbacks->log(callbacks->user_data, level, message.c_str());
+}
+
+spvtools::MessageConsumer MakeMessageConsumer(
+    const GfLayersSpirvToolsCallbacks* callbacks) {
+  return [callbacks](spv_message_level_t level, const char* source,
+                     const spv_position_t& position, const char* message) {
+    (void)source;  // This parameter is deliberately unused.
+    GfLayersSpirvToolsMessageLevel our_level =
+        GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_DEBUG;
+    const char* prefix = "debug";
+    switch (level) {
+      case SPV_MSG_FATAL:
+      case SPV_MSG_INTERNAL_ERROR:
+      case SPV_MSG_ERROR:
+        our_level = GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR;
+        prefix = "error";
+        break;
+      case SPV_MSG_WARNING:
+        our_level = GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_WARNING;
+        prefix = "warning";
+        break;
+      case SPV_MSG_INFO:
+        our_level = GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_INFO;
+        prefix = "info";
+        break;
+      case SPV_MSG_DEBUG:
+        break;
+    }
+    std::stringstream stream;
+    stream << prefix << ": line " << position.index << ": " << message;
+    Log(callbacks, our_level, stream.str());
+  };
+}
+
+// Sets |result| to the target environment for the SPIR-V version of |code|.
+// Returns false (and logs an error) if the version is not known.
+bool GetTargetEnv(const uint32_t* code, size_t word_count,
+                  const GfLayersSpirvToolsCallbacks* callbacks,
+                  spv_target_env* result) {
+  if (word_count < 2) {
+    Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR,
+        "SPIR-V module is too small.");
+    return false;
+  }
+
+  uint32_t version_word = code[1];
+
+  uint8_t major_version = GetSpirvVersionMajorPart(version_word);
+  uint8_t minor_version = GetSpirvVersionMinorPart(version_word);
+
+  if (major_version != 1) {
+    Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR,
+        "Unknown SPIR-V major version " + std::to_string(major_version));
+    return false;
+  }
+
+  switch (minor_version) {
+    case 0:
+      *result = SPV_ENV_UNIVERSAL_1_0;
+      return true;
+    case 1:
+      *result = SPV_ENV_UNIVERSAL_1_1;
+      return true;
+    case 2:
+      *result = SPV_ENV_UNIVERSAL_1_2;
+      return true;
+    case 3:
+      *result = SPV_ENV_UNIVERSAL_1_3;
+      return true;
+    case 4:
+      *result = SPV_ENV_UNIVERSAL_1_4;
+      return true;
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    case 5:
+      *result = SPV_ENV_UNIVERSAL_1_5;
+      return true;
+    default:
+      Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR,
+          "Unknown SPIR-V minor version " + std::to_string(minor_version));
+      return false;
+  }
+}
+
+bool Disassemble(const uint32_t* code, size_t word_count,
+                 const GfLayersSpirvToolsCallbacks* callbacks) {
+  spv_target_env target_env;  // NOLINT(cppcoreguidelines-init-variables)
+  if (!GetTargetEnv(code, word_count, callbacks, &target_env)) {
+    return false;
+  }
+
+  spvtools::SpirvTools tools(target_env);
+  if (!tools.IsValid()) {
+    Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR,
+        "Failed to instantiate SpirvTools object.");
+    return false;
+  }
+  tools.SetMessageConsumer(MakeMessageConsumer(callbacks));
+
+  std::string disassembly;
+  if (!tools.Disassemble(code, word_count, &disassembly,
+                         SPV_BINARY_TO_TEXT_OPTION_INDENT)) {
+    return false;
+  }
+
+  callbacks->append_output(callbacks->user_data, disassembly.data(),
+                           disassembly.size());
+  return true;
+}
+
+bool Fuzz(const uint32_t* code, size_t word_count, uint32_t seed,
+          const char* transformations_prefix,
+          const GfLayersSpirvToolsCallbacks* callbacks) {
+  spv_target_env target_env;  // NOLINT(cppcoreguidelines-init-variables)
+  if (!GetTargetEnv(code, word_count, callbacks, &target_env)) {
+    return false;
+  }
+
+  spvtools::SpirvTools tools(target_env);
+  if (!tools.IsValid()) {
+    Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_ERROR,
+        "Did not manage to create a SPIRV-Tools instance.");
+    return false;
+  }
+
+  // Create a fuzzer and the various parameters required for fuzzing.
+  spvtools::ValidatorOptions validator_options;
+  std::vector<uint32_t> binary_in(code, code + word_count);
+
+  spvtools::fuzz::protobufs::FactSequence no_facts;
+  std::vector<spvtools::fuzz::fuzzerutil::ModuleSupplier> no_donors;
+
+  // Fuzz the shader.
+  auto fuzzer_result =
+      spvtools::fuzz::Fuzzer(
+          target_env, MakeMessageConsumer(callbacks), binary_in, no_facts,
+          no_donors,
+          std::make_unique<spvtools::fuzz::PseudoRandomGenerator>(seed), false,
+          spvtools::fuzz::Fuzzer::RepeatedPassStrategy::
+              kLoopedWithRecommendations,
+          true, validator_options)
+          .Run();
+
+  if (fuzzer_result.status !=
+      spvtools::fuzz::Fuzzer::FuzzerResultStatus::kComplete) {
+    Log(callbacks, GF_LAYERS_SPIRV_TOOLS_MESSAGE_LEVEL_INFO,
+        "Fuzzing failed.");
+    return false;
+  }
+
+  // Write out the transformations
+  {
+    std::ofstream transformations_file(
+        std::string(transformations_prefix) + ".transformations",
+        std::ios::out | std::ios::binary);
+    fuzzer_result.applied_transformations.SerializeToOstream(
+        &transformations_file);
+  }
+
+  // Write out the transformations in JSON format
+  {
+    std::string json_string;
+    auto json_options = google::protobuf::util::JsonPrintOptions();
+    json_options.add_whitespace = true;
+
+    auto json_generation_status = google::protobuf::util::MessageToJsonString(
+        fuzzer_result.applied_transformations, &json_string, json_options);
+
+    if (json_generation_status == google::protobuf::util::Status::OK) {
+      std::ofstream transformations_json_file(
+          std::string(transformations_prefix) + ".transformations_json");
+      transformations_json_file << json_string;
+    }
+  }
+
+  callbacks->append_output(
+      callbacks->user_data, fuzzer_result.transformed_binary.data(),
+      fuzzer_result.transformed_binary.size() * sizeof(uint32_t));
+  return true;
+}
+
+}  // namespace
+}  // namespace gf_layers::spirv_tools
+
+//
+// Exported functions.
+//
+
+extern "C" {
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wmissing-prototypes"
+#pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
+
+VK_LAYER_EXPORT VKAPI_ATTR bool VKAPI_CALL
+GfLayersSpirvToolsNegotiateInterface(GfLayersSpirvToolsInterface* pInterface) {
+  if (pInterface->version != GF_LAYERS_SPIRV_TOOLS_INTERFACE_VERSION) {
+    return false;
+  }
+  pInterface->disassemble = gf_layers::spirv_tools::Disassemble;
+  pInterface->fuzz = gf_layers::spirv_tools::Fuzz;
+  return true;
+}
+
+#pragma clang diagnostic pop
+
+}  // extern "C"